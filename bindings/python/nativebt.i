@@ -58,6 +58,57 @@
 typedef int bt_intern_str;
 typedef int64_t ssize_t;
 
+/*
+ * Convert a Python sequence of integers to a (values, count) pair.
+ * Negative values are passed as their two's complement representation.
+ */
+%typemap(in) (const uint64_t *values, int count) {
+	Py_ssize_t i, len;
+
+	if (!PySequence_Check($input)) {
+		PyErr_SetString(PyExc_TypeError, "Expected a sequence of integers");
+		SWIG_fail;
+	}
+
+	len = PySequence_Length($input);
+	$1 = (uint64_t *) malloc(sizeof(uint64_t) * (len ? len : 1));
+	if (!$1) {
+		PyErr_NoMemory();
+		SWIG_fail;
+	}
+
+	for (i = 0; i < len; i++) {
+		PyObject *item = PySequence_GetItem($input, i);
+
+		if (!item || !PyLong_Check(item)) {
+			Py_XDECREF(item);
+			free($1);
+			$1 = NULL;
+			PyErr_SetString(PyExc_TypeError, "Expected a sequence of integers");
+			SWIG_fail;
+		}
+
+		$1[i] = PyLong_AsUnsignedLongLong(item);
+		if (PyErr_Occurred()) {
+			/* Negative value, try as a signed integer */
+			PyErr_Clear();
+			$1[i] = (uint64_t) PyLong_AsLongLong(item);
+		}
+		Py_DECREF(item);
+		if (PyErr_Occurred()) {
+			free($1);
+			$1 = NULL;
+			SWIG_fail;
+		}
+	}
+
+	$2 = (int) len;
+}
+
+%typemap(freearg) (const uint64_t *values, int count) {
+	free($1);
+}
+
 
 /* python-complements.h */
 struct bt_definition **_bt_python_field_listcaller(
@@ -113,6 +164,80 @@ int _bt_python_ctf_clock_get_uuid_index(struct bt_ctf_clock *clock,
 int _bt_python_ctf_clock_set_uuid_index(struct bt_ctf_clock *clock,
 		size_t index, unsigned char value);
 struct bt_iter_pos *_bt_python_create_iter_pos(void);
+long _bt_python_event_len(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_keys(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_values(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_dict(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_get(const struct bt_ctf_event *event,
+		const char *name);
+int _bt_python_event_has_field(const struct bt_ctf_event *event,
+		const char *name);
+enum bt_python_batch_column {
+	BT_PYTHON_BATCH_TIMESTAMPS = -1,
+	BT_PYTHON_BATCH_EVENT_IDS = -2,
+	BT_PYTHON_BATCH_NAME_IDS = -3,
+};
+struct bt_python_batch *_bt_python_batch_create(void);
+void _bt_python_batch_destroy(struct bt_python_batch *batch);
+int _bt_python_batch_add_field(struct bt_python_batch *batch,
+		const char *name, int scope);
+int _bt_python_batch_read(struct bt_python_batch *batch,
+		struct bt_ctf_iter *iter, unsigned int max_events);
+PyObject *_bt_python_batch_column(struct bt_python_batch *batch,
+		int column);
+PyObject *_bt_python_batch_valid(struct bt_python_batch *batch,
+		int field);
+const char *_bt_python_batch_field_type(struct bt_python_batch *batch,
+		int field);
+unsigned int _bt_python_batch_name_count(struct bt_python_batch *batch);
+const char *_bt_python_batch_name(struct bt_python_batch *batch,
+		unsigned int index);
+enum bt_python_aggregate_op {
+	BT_PYTHON_AGGREGATE_SUM,
+	BT_PYTHON_AGGREGATE_MIN,
+	BT_PYTHON_AGGREGATE_MAX,
+	BT_PYTHON_AGGREGATE_HISTOGRAM,
+};
+struct bt_python_aggregate *_bt_python_aggregate_create(void);
+void _bt_python_aggregate_destroy(struct bt_python_aggregate *agg);
+int _bt_python_aggregate_add_key(struct bt_python_aggregate *agg,
+		const char *name, int scope);
+int _bt_python_aggregate_add_op(struct bt_python_aggregate *agg,
+		enum bt_python_aggregate_op op, const char *name, int scope,
+		uint64_t width);
+int _bt_python_aggregate_add_event_name(struct bt_python_aggregate *agg,
+		const char *name);
+int _bt_python_aggregate_set_time_bucket(struct bt_python_aggregate *agg,
+		uint64_t ns);
+int64_t _bt_python_aggregate_run(struct bt_python_aggregate *agg,
+		struct bt_ctf_iter *iter);
+PyObject *_bt_python_aggregate_result(struct bt_python_aggregate *agg);
+struct bt_python_snapshot_arena *_bt_python_snapshot_arena_create(
+		size_t chunk_size);
+void _bt_python_snapshot_arena_destroy(
+		struct bt_python_snapshot_arena *arena);
+struct bt_python_snapshot *_bt_python_snapshot_create(
+		struct bt_python_snapshot_arena *arena,
+		const struct bt_ctf_event *event);
+void _bt_python_snapshot_get(struct bt_python_snapshot *snapshot);
+void _bt_python_snapshot_put(struct bt_python_snapshot *snapshot);
+const char *_bt_python_snapshot_name(
+		const struct bt_python_snapshot *snapshot);
+uint64_t _bt_python_snapshot_timestamp(
+		const struct bt_python_snapshot *snapshot);
+uint64_t _bt_python_snapshot_cycles(
+		const struct bt_python_snapshot *snapshot);
+long _bt_python_snapshot_len(const struct bt_python_snapshot *snapshot);
+PyObject *_bt_python_snapshot_keys(const struct bt_python_snapshot *snapshot,
+		int scope);
+PyObject *_bt_python_snapshot_values(
+		const struct bt_python_snapshot *snapshot);
+PyObject *_bt_python_snapshot_dict(const struct bt_python_snapshot *snapshot);
+PyObject *_bt_python_snapshot_get_field(
+		const struct bt_python_snapshot *snapshot, const char *name,
+		int scope);
+int _bt_python_snapshot_has_field(const struct bt_python_snapshot *snapshot,
+		const char *name);
 
 /* context.h, context-internal.h */
 %rename("_bt_context_create") bt_context_create(void);
@@ -528,6 +653,7 @@ void bt_ctf_field_put(struct bt_ctf_field *field);
 %rename("_bt_ctf_event_class_get_field_count") bt_ctf_event_class_get_field_count(struct bt_ctf_event_class *event_class);
 %rename("_bt_ctf_event_class_get_field") bt_ctf_event_class_get_field(struct bt_ctf_event_class *event_class, const char **field_name, struct bt_ctf_field_type **field_type, int index);
 %rename("_bt_ctf_event_class_get_field_by_name") bt_ctf_event_class_get_field_by_name(struct bt_ctf_event_class *event_class, const char *name);
+%rename("_bt_ctf_event_class_get_field_index") bt_ctf_event_class_get_field_index(struct bt_ctf_event_class *event_class, const char *name);
 %rename("_bt_ctf_event_class_get") bt_ctf_event_class_get(struct bt_ctf_event_class *event_class);
 %rename("_bt_ctf_event_class_put") bt_ctf_event_class_put(struct bt_ctf_event_class *event_class);
 
@@ -540,6 +666,7 @@ int bt_ctf_event_class_add_field(struct bt_ctf_event_class *event_class, struct
 int bt_ctf_event_class_get_field_count(struct bt_ctf_event_class *event_class);
 int bt_ctf_event_class_get_field(struct bt_ctf_event_class *event_class, const char **field_name, struct bt_ctf_field_type **field_type, int index);
 struct bt_ctf_field_type *bt_ctf_event_class_get_field_by_name(struct bt_ctf_event_class *event_class, const char *name);
+int bt_ctf_event_class_get_field_index(struct bt_ctf_event_class *event_class, const char *name);
 void bt_ctf_event_class_get(struct bt_ctf_event_class *event_class);
 void bt_ctf_event_class_put(struct bt_ctf_event_class *event_class);
 
@@ -551,6 +678,9 @@ void bt_ctf_event_class_put(struct bt_ctf_event_class *event_class);
 %rename("_bt_ctf_event_get_payload") bt_ctf_event_get_payload(struct bt_ctf_event *event, const char *name);
 %rename("_bt_ctf_event_set_payload") bt_ctf_event_set_payload(struct bt_ctf_event *event, const char *name, struct bt_ctf_field *value);
 %rename("_bt_ctf_event_get_payload_by_index") bt_ctf_event_get_payload_by_index(struct bt_ctf_event *event, int index);
+%rename("_bt_ctf_event_set_payload_unsigned_integer") bt_ctf_event_set_payload_unsigned_integer(struct bt_ctf_event *event, int index, uint64_t value);
+%rename("_bt_ctf_event_set_payload_signed_integer") bt_ctf_event_set_payload_signed_integer(struct bt_ctf_event *event, int index, int64_t value);
+%rename("_bt_ctf_event_set_payload_integers") bt_ctf_event_set_payload_integers(struct bt_ctf_event *event, const uint64_t *values, int count);
 %rename("_bt_ctf_event_get") bt_ctf_event_get(struct bt_ctf_event *event);
 %rename("_bt_ctf_event_put") bt_ctf_event_put(struct bt_ctf_event *event);
 
@@ -560,6 +690,9 @@ struct bt_ctf_clock *bt_ctf_event_get_clock(struct bt_ctf_event *event);
 struct bt_ctf_field *bt_ctf_event_get_payload(struct bt_ctf_event *event, const char *name);
 int bt_ctf_event_set_payload(struct bt_ctf_event *event, const char *name, struct bt_ctf_field *value);
 struct bt_ctf_field *bt_ctf_event_get_payload_by_index(struct bt_ctf_event *event, int index);
+int bt_ctf_event_set_payload_unsigned_integer(struct bt_ctf_event *event, int index, uint64_t value);
+int bt_ctf_event_set_payload_signed_integer(struct bt_ctf_event *event, int index, int64_t value);
+int bt_ctf_event_set_payload_integers(struct bt_ctf_event *event, const uint64_t *values, int count);
 void bt_ctf_event_get(struct bt_ctf_event *event);
 void bt_ctf_event_put(struct bt_ctf_event *event);
 
@@ -0,0 +1,769 @@
+/*
+ * python-aggregate.c
+ *
+ * Babeltrace Python module native aggregation
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "python-complements.h"
+#include <babeltrace/types.h>
+#include <babeltrace/ctf/iterator.h>
+#include <string.h>
+#include <glib.h>
+
+/*
+ * Native aggregation: events are read in C, grouped by the values of
+ * key fields, and only the resulting table is converted to Python
+ * objects. Fields are looked up once per event definition, i.e. per
+ * event type and stream.
+ */
+
+enum agg_value_type {
+	AGG_VALUE_NONE = 0,
+	AGG_VALUE_UNSIGNED,
+	AGG_VALUE_SIGNED,
+	AGG_VALUE_FLOAT,
+	AGG_VALUE_STRING,	/* GQuark */
+};
+
+/* Two 64-bit words, so that keys can be hashed and compared as bytes. */
+struct agg_value {
+	uint64_t type;
+	union {
+		uint64_t _unsigned;
+		int64_t _signed;
+		double _float;
+		uint64_t quark;
+	} v;
+};
+
+struct agg_field {
+	struct bt_ctf_field_key *key;	/* NULL for the event name */
+	int scope;
+};
+
+struct agg_spec {
+	enum bt_python_aggregate_op op;
+	struct agg_field field;
+	uint64_t width;			/* Histogram bucket width */
+};
+
+struct agg_state {
+	uint64_t count;			/* Values aggregated */
+	struct agg_value value;		/* Sum, minimum or maximum */
+	GHashTable *histogram;		/* Bucket index to uint64_t count */
+	int histogram_float;		/* Float values were bucketed */
+};
+
+struct agg_key {
+	unsigned int len;
+	struct agg_value values[];
+};
+
+struct agg_group {
+	struct agg_key *key;
+	uint64_t count;
+	struct agg_state states[];
+};
+
+/*
+ * Resolution of the fields for one event definition. Variants are kept
+ * as is: their current option is read for each event.
+ */
+struct agg_event {
+	int skip;			/* Filtered out */
+	GQuark name;
+	const struct bt_definition *defs[];	/* Keys, then specs */
+};
+
+struct bt_python_aggregate {
+	GArray *keys;			/* struct agg_field */
+	GArray *specs;			/* struct agg_spec */
+	GHashTable *event_names;	/* GQuark set filter, or NULL */
+	uint64_t time_bucket;		/* 0 for none */
+	GHashTable *events;		/* ctf_event_definition to agg_event */
+	GHashTable *groups;		/* struct agg_key to struct agg_group */
+	struct agg_key *scratch;	/* Key of the current event */
+};
+
+static
+guint agg_key_hash(gconstpointer data)
+{
+	const struct agg_key *key = data;
+	const unsigned char *p = (const unsigned char *) key->values;
+	size_t i, len = key->len * sizeof(key->values[0]);
+	guint hash = 2166136261U;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static
+gboolean agg_key_equal(gconstpointer a, gconstpointer b)
+{
+	const struct agg_key *key_a = a, *key_b = b;
+
+	return key_a->len == key_b->len
+		&& !memcmp(key_a->values, key_b->values,
+			key_a->len * sizeof(key_a->values[0]));
+}
+
+static
+void agg_field_fini(struct agg_field *field)
+{
+	if (field->key)
+		bt_ctf_field_key_destroy(field->key);
+}
+
+static
+int agg_field_init(struct agg_field *field, const char *name, int scope)
+{
+	field->scope = scope;
+	if (!name) {
+		field->key = NULL;
+		return 0;
+	}
+	field->key = bt_ctf_field_key_create(name);
+	return field->key ? 0 : -1;
+}
+
+struct bt_python_aggregate *_bt_python_aggregate_create(void)
+{
+	struct bt_python_aggregate *agg;
+
+	agg = g_new0(struct bt_python_aggregate, 1);
+	agg->keys = g_array_new(FALSE, TRUE, sizeof(struct agg_field));
+	agg->specs = g_array_new(FALSE, TRUE, sizeof(struct agg_spec));
+	agg->events = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, g_free);
+	return agg;
+}
+
+static
+void agg_groups_destroy(struct bt_python_aggregate *agg)
+{
+	GHashTableIter it;
+	gpointer key, value;
+	int i;
+
+	if (!agg->groups)
+		return;
+	g_hash_table_iter_init(&it, agg->groups);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		struct agg_group *group = value;
+
+		for (i = 0; i < agg->specs->len; i++) {
+			if (group->states[i].histogram)
+				g_hash_table_destroy(group->states[i].histogram);
+		}
+		g_free(group->key);
+		g_free(group);
+	}
+	g_hash_table_destroy(agg->groups);
+	agg->groups = NULL;
+}
+
+void _bt_python_aggregate_destroy(struct bt_python_aggregate *agg)
+{
+	int i;
+
+	if (!agg)
+		return;
+	agg_groups_destroy(agg);
+	for (i = 0; i < agg->keys->len; i++)
+		agg_field_fini(&g_array_index(agg->keys, struct agg_field, i));
+	for (i = 0; i < agg->specs->len; i++)
+		agg_field_fini(&g_array_index(agg->specs, struct agg_spec,
+				i).field);
+	g_array_free(agg->keys, TRUE);
+	g_array_free(agg->specs, TRUE);
+	if (agg->event_names)
+		g_hash_table_destroy(agg->event_names);
+	g_hash_table_destroy(agg->events);
+	g_free(agg->scratch);
+	g_free(agg);
+}
+
+/*
+ * The configuration functions below must be called before the first
+ * run. They return 0 on success, -1 on error.
+ */
+static
+int agg_configurable(struct bt_python_aggregate *agg)
+{
+	return !agg->groups;
+}
+
+/*
+ * Group by the value of a field, searched in "scope" or in all the
+ * scopes in order if scope is -1, or by event name if name is NULL.
+ */
+int _bt_python_aggregate_add_key(struct bt_python_aggregate *agg,
+		const char *name, int scope)
+{
+	struct agg_field field;
+
+	if (!agg_configurable(agg) || agg_field_init(&field, name, scope))
+		return -1;
+	g_array_append_val(agg->keys, field);
+	return 0;
+}
+
+/* Aggregate the values of a numeric field. */
+int _bt_python_aggregate_add_op(struct bt_python_aggregate *agg,
+		enum bt_python_aggregate_op op, const char *name, int scope,
+		uint64_t width)
+{
+	struct agg_spec spec;
+
+	memset(&spec, 0, sizeof(spec));
+	if (!agg_configurable(agg) || !name)
+		return -1;
+	switch (op) {
+	case BT_PYTHON_AGGREGATE_SUM:
+	case BT_PYTHON_AGGREGATE_MIN:
+	case BT_PYTHON_AGGREGATE_MAX:
+		break;
+	case BT_PYTHON_AGGREGATE_HISTOGRAM:
+		if (!width)
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+	if (agg_field_init(&spec.field, name, scope))
+		return -1;
+	spec.op = op;
+	spec.width = width;
+	g_array_append_val(agg->specs, spec);
+	return 0;
+}
+
+/* Only aggregate the events with this name, and the other ones added. */
+int _bt_python_aggregate_add_event_name(struct bt_python_aggregate *agg,
+		const char *name)
+{
+	if (!agg_configurable(agg) || !name)
+		return -1;
+	if (!agg->event_names)
+		agg->event_names = g_hash_table_new(g_direct_hash,
+				g_direct_equal);
+	g_hash_table_insert(agg->event_names,
+			GUINT_TO_POINTER(g_quark_from_string(name)),
+			GUINT_TO_POINTER(1));
+	return 0;
+}
+
+/* Group by time buckets of "ns" nanoseconds, before the other keys. */
+int _bt_python_aggregate_set_time_bucket(struct bt_python_aggregate *agg,
+		uint64_t ns)
+{
+	if (!agg_configurable(agg))
+		return -1;
+	agg->time_bucket = ns;
+	return 0;
+}
+
+static
+unsigned int agg_key_len(struct bt_python_aggregate *agg)
+{
+	return agg->keys->len + (agg->time_bucket ? 1 : 0);
+}
+
+static
+struct agg_event *agg_resolve(struct bt_python_aggregate *agg,
+		const struct bt_ctf_event *event)
+{
+	struct agg_event *resolved;
+	const char *name;
+	int i, nr_keys = agg->keys->len;
+
+	resolved = g_malloc0(sizeof(*resolved) + (nr_keys + agg->specs->len)
+			* sizeof(resolved->defs[0]));
+	name = bt_ctf_event_name(event);
+	resolved->name = name ? g_quark_from_string(name) : 0;
+	if (agg->event_names && !g_hash_table_lookup(agg->event_names,
+			GUINT_TO_POINTER(resolved->name)))
+		resolved->skip = 1;
+	for (i = 0; !resolved->skip && i < nr_keys; i++) {
+		struct agg_field *field =
+			&g_array_index(agg->keys, struct agg_field, i);
+
+		if (field->key)
+			resolved->defs[i] = _bt_python_lookup_field(event,
+					field->key, field->scope);
+	}
+	for (i = 0; !resolved->skip && i < agg->specs->len; i++) {
+		struct agg_spec *spec =
+			&g_array_index(agg->specs, struct agg_spec, i);
+
+		resolved->defs[nr_keys + i] = _bt_python_lookup_field(event,
+				spec->field.key, spec->field.scope);
+	}
+	g_hash_table_insert(agg->events, event->parent, resolved);
+	return resolved;
+}
+
+static
+GQuark agg_quark(const char *str)
+{
+	GQuark quark;
+
+	if (!str)
+		return 0;
+	/* Labels and repeated strings are already interned. */
+	quark = bt_quark_lookup(str);
+	return quark ? quark : g_quark_from_string(str);
+}
+
+/* Read the current value of a definition. */
+static
+void agg_read_value(const struct bt_definition *def, struct agg_value *value)
+{
+	memset(value, 0, sizeof(*value));
+	def = _bt_python_resolve_field(def);
+	if (!def)
+		return;
+
+	switch (def->declaration->id) {
+	case CTF_TYPE_INTEGER:
+	{
+		const struct definition_integer *integer =
+			container_of(def, const struct definition_integer, p);
+
+		if (integer->declaration->signedness) {
+			value->type = AGG_VALUE_SIGNED;
+			value->v._signed = integer->value._signed;
+		} else {
+			value->type = AGG_VALUE_UNSIGNED;
+			value->v._unsigned = integer->value._unsigned;
+		}
+		break;
+	}
+	case CTF_TYPE_FLOAT:
+		value->type = AGG_VALUE_FLOAT;
+		value->v._float = container_of(def,
+				const struct definition_float, p)->value;
+		break;
+	case CTF_TYPE_ENUM:
+		value->type = AGG_VALUE_STRING;
+		value->v.quark = agg_quark(bt_ctf_get_enum_str(def));
+		break;
+	case CTF_TYPE_STRING:
+		value->type = AGG_VALUE_STRING;
+		value->v.quark = agg_quark(bt_ctf_get_string(def));
+		break;
+	case CTF_TYPE_ARRAY:
+	{
+		const struct definition_array *array =
+			container_of(def, const struct definition_array, p);
+
+		if (array->string) {
+			value->type = AGG_VALUE_STRING;
+			value->v.quark = agg_quark(array->string->str);
+		}
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		const struct definition_sequence *sequence =
+			container_of(def, const struct definition_sequence, p);
+
+		if (sequence->string) {
+			value->type = AGG_VALUE_STRING;
+			value->v.quark = agg_quark(sequence->string->str);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/* Read a numeric value: enumerations count as their integer value. */
+static
+void agg_read_number(const struct bt_definition *def, struct agg_value *value)
+{
+	def = _bt_python_resolve_field(def);
+	if (def && def->declaration->id == CTF_TYPE_ENUM)
+		def = &container_of(def, const struct definition_enum,
+				p)->integer->p;
+	agg_read_value(def, value);
+	if (value->type == AGG_VALUE_STRING)
+		value->type = AGG_VALUE_NONE;
+}
+
+static
+double agg_to_float(const struct agg_value *value)
+{
+	switch (value->type) {
+	case AGG_VALUE_UNSIGNED:
+		return value->v._unsigned;
+	case AGG_VALUE_SIGNED:
+		return value->v._signed;
+	default:
+		return value->v._float;
+	}
+}
+
+/*
+ * Bring a and b to a common type: float if either is a float, signed
+ * if their signedness differs.
+ */
+static
+void agg_promote(struct agg_value *a, struct agg_value *b)
+{
+	if (a->type == b->type)
+		return;
+	if (a->type == AGG_VALUE_FLOAT || b->type == AGG_VALUE_FLOAT) {
+		a->v._float = agg_to_float(a);
+		b->v._float = agg_to_float(b);
+		a->type = b->type = AGG_VALUE_FLOAT;
+	} else {
+		a->type = b->type = AGG_VALUE_SIGNED;
+	}
+}
+
+static
+int agg_compare(const struct agg_value *a, const struct agg_value *b)
+{
+	switch (a->type) {
+	case AGG_VALUE_UNSIGNED:
+		return a->v._unsigned < b->v._unsigned ? -1
+			: a->v._unsigned > b->v._unsigned;
+	case AGG_VALUE_SIGNED:
+		return a->v._signed < b->v._signed ? -1
+			: a->v._signed > b->v._signed;
+	default:
+		return a->v._float < b->v._float ? -1
+			: a->v._float > b->v._float;
+	}
+}
+
+static
+void agg_histogram_add(struct agg_state *state, const struct agg_spec *spec,
+		const struct agg_value *value)
+{
+	int64_t index;
+	uint64_t *count;
+
+	switch (value->type) {
+	case AGG_VALUE_UNSIGNED:
+		index = value->v._unsigned / spec->width;
+		break;
+	case AGG_VALUE_SIGNED:
+		/* Round towards minus infinity. */
+		index = value->v._signed / (int64_t) spec->width;
+		if (value->v._signed % (int64_t) spec->width < 0)
+			index--;
+		break;
+	default:
+	{
+		double bucket = value->v._float / spec->width;
+
+		index = (int64_t) bucket;
+		if (bucket < index)
+			index--;
+		state->histogram_float = 1;
+		break;
+	}
+	}
+	if (!state->histogram)
+		state->histogram = g_hash_table_new_full(g_int64_hash,
+				g_int64_equal, g_free, g_free);
+	count = g_hash_table_lookup(state->histogram, &index);
+	if (!count) {
+		int64_t *key = g_new(int64_t, 1);
+
+		*key = index;
+		count = g_new0(uint64_t, 1);
+		g_hash_table_insert(state->histogram, key, count);
+	}
+	(*count)++;
+}
+
+static
+void agg_state_add(struct agg_state *state, const struct agg_spec *spec,
+		const struct bt_definition *def)
+{
+	struct agg_value value;
+
+	agg_read_number(def, &value);
+	if (value.type == AGG_VALUE_NONE)
+		return;
+	if (spec->op == BT_PYTHON_AGGREGATE_HISTOGRAM) {
+		agg_histogram_add(state, spec, &value);
+		state->count++;
+		return;
+	}
+	if (!state->count++) {
+		state->value = value;
+		return;
+	}
+	agg_promote(&state->value, &value);
+	switch (spec->op) {
+	case BT_PYTHON_AGGREGATE_SUM:
+		if (value.type == AGG_VALUE_FLOAT)
+			state->value.v._float += value.v._float;
+		else
+			state->value.v._unsigned += value.v._unsigned;
+		break;
+	case BT_PYTHON_AGGREGATE_MIN:
+		if (agg_compare(&value, &state->value) < 0)
+			state->value = value;
+		break;
+	case BT_PYTHON_AGGREGATE_MAX:
+		if (agg_compare(&value, &state->value) > 0)
+			state->value = value;
+		break;
+	default:
+		break;
+	}
+}
+
+static
+struct agg_group *agg_get_group(struct bt_python_aggregate *agg)
+{
+	struct agg_group *group;
+	size_t key_size;
+
+	group = g_hash_table_lookup(agg->groups, agg->scratch);
+	if (group)
+		return group;
+	group = g_malloc0(sizeof(*group)
+			+ agg->specs->len * sizeof(group->states[0]));
+	key_size = sizeof(*agg->scratch)
+		+ agg->scratch->len * sizeof(agg->scratch->values[0]);
+	group->key = g_malloc(key_size);
+	memcpy(group->key, agg->scratch, key_size);
+	g_hash_table_insert(agg->groups, group->key, group);
+	return group;
+}
+
+static
+void agg_add_event(struct bt_python_aggregate *agg,
+		const struct bt_ctf_event *event)
+{
+	struct agg_event *resolved;
+	struct agg_group *group;
+	struct agg_value *values = agg->scratch->values;
+	int i, nr_keys = agg->keys->len;
+
+	resolved = g_hash_table_lookup(agg->events, event->parent);
+	if (!resolved)
+		resolved = agg_resolve(agg, event);
+	if (resolved->skip)
+		return;
+
+	if (agg->time_bucket) {
+		values->type = AGG_VALUE_UNSIGNED;
+		values->v._unsigned = bt_ctf_get_timestamp(event)
+			/ agg->time_bucket * agg->time_bucket;
+		values++;
+	}
+	for (i = 0; i < nr_keys; i++) {
+		struct agg_field *field =
+			&g_array_index(agg->keys, struct agg_field, i);
+
+		if (!field->key) {
+			values[i].type = AGG_VALUE_STRING;
+			values[i].v.quark = resolved->name;
+		} else {
+			agg_read_value(resolved->defs[i], &values[i]);
+		}
+	}
+
+	group = agg_get_group(agg);
+	group->count++;
+	for (i = 0; i < agg->specs->len; i++)
+		agg_state_add(&group->states[i],
+				&g_array_index(agg->specs, struct agg_spec, i),
+				resolved->defs[nr_keys + i]);
+}
+
+/*
+ * Aggregate the events of iter, until its end. Several runs accumulate
+ * in the same table. Returns the number of events read, or -1 on error.
+ */
+int64_t _bt_python_aggregate_run(struct bt_python_aggregate *agg,
+		struct bt_ctf_iter *iter)
+{
+	struct bt_ctf_event *event;
+	int64_t count = 0;
+	int ret = 0;
+
+	if (!agg->groups) {
+		agg->groups = g_hash_table_new(agg_key_hash, agg_key_equal);
+		agg->scratch = g_malloc0(sizeof(*agg->scratch)
+				+ agg_key_len(agg)
+					* sizeof(agg->scratch->values[0]));
+		agg->scratch->len = agg_key_len(agg);
+	}
+
+	/* No Python object is touched while aggregating. */
+	Py_BEGIN_ALLOW_THREADS
+	for (;;) {
+		event = bt_ctf_iter_read_event(iter);
+		if (!event)
+			break;
+		agg_add_event(agg, event);
+		count++;
+		ret = bt_iter_next(bt_ctf_get_iter(iter));
+		if (ret)
+			break;
+	}
+	Py_END_ALLOW_THREADS
+
+	return ret < 0 ? -1 : count;
+}
+
+static
+PyObject *agg_value_to_python(const struct agg_value *value)
+{
+	switch (value->type) {
+	case AGG_VALUE_UNSIGNED:
+		return PyLong_FromUnsignedLongLong(value->v._unsigned);
+	case AGG_VALUE_SIGNED:
+		return PyLong_FromLongLong(value->v._signed);
+	case AGG_VALUE_FLOAT:
+		return PyFloat_FromDouble(value->v._float);
+	case AGG_VALUE_STRING:
+		if (value->v.quark)
+			return PyUnicode_DecodeUTF8(
+				g_quark_to_string(value->v.quark),
+				strlen(g_quark_to_string(value->v.quark)),
+				"surrogateescape");
+		/* Fall through */
+	default:
+		Py_RETURN_NONE;
+	}
+}
+
+/* Dictionary of the bucket start values to their counts. */
+static
+PyObject *agg_histogram_to_python(const struct agg_state *state,
+		const struct agg_spec *spec)
+{
+	GHashTableIter it;
+	gpointer key, value;
+	PyObject *dict, *bucket, *count;
+	int ret;
+
+	dict = PyDict_New();
+	if (!dict || !state->histogram)
+		return dict;
+	g_hash_table_iter_init(&it, state->histogram);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		int64_t index = *(int64_t *) key;
+
+		if (state->histogram_float)
+			bucket = PyFloat_FromDouble((double) index
+					* spec->width);
+		else
+			bucket = PyLong_FromLongLong(index
+					* (int64_t) spec->width);
+		count = PyLong_FromUnsignedLongLong(*(uint64_t *) value);
+		ret = bucket && count ? PyDict_SetItem(dict, bucket, count)
+			: -1;
+		Py_XDECREF(bucket);
+		Py_XDECREF(count);
+		if (ret) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+static
+PyObject *agg_group_to_python(struct bt_python_aggregate *agg,
+		const struct agg_group *group)
+{
+	PyObject *row, *item;
+	int i, nr_keys = group->key->len, pos = 0;
+
+	row = PyTuple_New(nr_keys + 1 + agg->specs->len);
+	if (!row)
+		return NULL;
+	for (i = 0; i < nr_keys; i++) {
+		item = agg_value_to_python(&group->key->values[i]);
+		if (!item)
+			goto error;
+		PyTuple_SET_ITEM(row, pos++, item);
+	}
+	item = PyLong_FromUnsignedLongLong(group->count);
+	if (!item)
+		goto error;
+	PyTuple_SET_ITEM(row, pos++, item);
+	for (i = 0; i < agg->specs->len; i++) {
+		const struct agg_spec *spec =
+			&g_array_index(agg->specs, struct agg_spec, i);
+		const struct agg_state *state = &group->states[i];
+
+		if (spec->op == BT_PYTHON_AGGREGATE_HISTOGRAM) {
+			item = agg_histogram_to_python(state, spec);
+		} else if (!state->count) {
+			Py_INCREF(Py_None);
+			item = Py_None;
+		} else {
+			item = agg_value_to_python(&state->value);
+		}
+		if (!item)
+			goto error;
+		PyTuple_SET_ITEM(row, pos++, item);
+	}
+	return row;
+
+error:
+	Py_DECREF(row);
+	return NULL;
+}
+
+/*
+ * List of the rows of the table, one tuple per group: the time bucket
+ * if any, the keys, the number of events, then each aggregate.
+ */
+PyObject *_bt_python_aggregate_result(struct bt_python_aggregate *agg)
+{
+	GHashTableIter it;
+	gpointer key, value;
+	PyObject *rows, *row;
+
+	rows = PyList_New(0);
+	if (!rows || !agg->groups)
+		return rows;
+	g_hash_table_iter_init(&it, agg->groups);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		row = agg_group_to_python(agg, value);
+		if (!row || PyList_Append(rows, row)) {
+			Py_XDECREF(row);
+			Py_DECREF(rows);
+			return NULL;
+		}
+		Py_DECREF(row);
+	}
+	return rows;
+}
@@ -32,6 +32,10 @@
 #include <babeltrace/ctf-ir/event.h>
 #include <babeltrace/ctf-ir/clock-internal.h>
 #include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/types.h>
+#include <limits.h>
+#include <string.h>
 #include <glib.h>
 
 /* List-related functions
@@ -399,3 +403,1598 @@ struct bt_iter_pos *_bt_python_create_iter_pos(void)
 {
 	return g_new0(struct bt_iter_pos, 1);
 }
+
+/* Event mapping
+   ----------------------------------------------------
+   Convert the fields of an event to Python objects in one call. The
+   names and positions of the fields of each event type, in each stream
+   class, are computed once and kept in a cache. The definitions are
+   taken from the scopes of the event on each call.
+*/
+
+/* Same order as the scopes searched by Event in reader.py. */
+static const enum bt_ctf_scope event_scopes[] = {
+	BT_EVENT_FIELDS,
+	BT_EVENT_CONTEXT,
+	BT_STREAM_EVENT_CONTEXT,
+	BT_STREAM_EVENT_HEADER,
+	BT_STREAM_PACKET_CONTEXT,
+	BT_TRACE_PACKET_HEADER,
+};
+
+#define NR_EVENT_SCOPES		G_N_ELEMENTS(event_scopes)
+/* Cleared when full: event declarations go away with their traces. */
+#define EVENT_FIELDS_CACHE_MAX	4096
+
+struct event_field_index {
+	unsigned int scope;		/* Index in event_scopes */
+	unsigned int index;		/* Index in the scope structure */
+	GQuark name;
+};
+
+struct event_fields {
+	/* Declarations of the top-level scopes the entry was computed from. */
+	const struct bt_declaration *scopes[NR_EVENT_SCOPES];
+	unsigned int len;		/* Fields of all scopes */
+	PyObject *names;		/* Tuple of the unique field names */
+	/* Position of each name, in the first scope having it. */
+	struct event_field_index fields[];
+};
+
+/* struct ctf_event_declaration * to struct event_fields */
+static GHashTable *event_fields_cache;
+
+static
+void event_fields_destroy(gpointer data)
+{
+	struct event_fields *entry = data;
+
+	Py_XDECREF(entry->names);
+	g_free(entry);
+}
+
+static
+const struct definition_struct *scope_struct(const struct bt_definition *scope)
+{
+	if (!scope || scope->declaration->id != CTF_TYPE_STRUCT)
+		return NULL;
+	return container_of(scope, const struct definition_struct, p);
+}
+
+static
+struct event_fields *event_fields_create(const struct bt_definition **scopes)
+{
+	struct event_fields *entry = NULL;
+	const struct definition_struct *fields_struct;
+	GArray *fields;
+	GHashTable *seen;
+	int i, j;
+
+	fields = g_array_new(FALSE, FALSE, sizeof(struct event_field_index));
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		fields_struct = scope_struct(scopes[i]);
+		if (!fields_struct)
+			continue;
+		for (j = 0; j < fields_struct->fields->len; j++) {
+			const struct bt_definition *def =
+				g_ptr_array_index(fields_struct->fields, j);
+			struct event_field_index field;
+			GQuark name;
+
+			if (!bt_ctf_field_name(def))
+				continue;
+			name = g_quark_from_string(bt_ctf_field_name(def));
+			if (g_hash_table_lookup(seen, GUINT_TO_POINTER(name)))
+				continue;
+			g_hash_table_insert(seen, GUINT_TO_POINTER(name),
+					GUINT_TO_POINTER(1));
+			field.scope = i;
+			field.index = j;
+			field.name = def->name;
+			g_array_append_val(fields, field);
+		}
+	}
+
+	entry = g_malloc0(sizeof(*entry)
+			+ fields->len * sizeof(entry->fields[0]));
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		entry->scopes[i] = scopes[i] ? scopes[i]->declaration : NULL;
+		fields_struct = scope_struct(scopes[i]);
+		if (fields_struct)
+			entry->len += fields_struct->fields->len;
+	}
+	entry->names = PyTuple_New(fields->len);
+	if (!entry->names) {
+		g_free(entry);
+		entry = NULL;
+		goto end;
+	}
+	for (i = 0; i < fields->len; i++) {
+		struct event_field_index *field =
+			&g_array_index(fields, struct event_field_index, i);
+		PyObject *name = PyUnicode_FromString(
+				rem_(g_quark_to_string(field->name)));
+
+		if (!name) {
+			event_fields_destroy(entry);
+			entry = NULL;
+			goto end;
+		}
+		PyTuple_SET_ITEM(entry->names, i, name);
+		entry->fields[i] = *field;
+	}
+end:
+	g_hash_table_destroy(seen);
+	g_array_free(fields, TRUE);
+	return entry;
+}
+
+/*
+ * Whether an entry describes the scopes of an event. Only the current
+ * scopes are dereferenced: the declarations an entry was computed from
+ * may have been freed, and their address reused.
+ */
+static
+int event_fields_match(const struct event_fields *entry,
+		const struct bt_definition **scopes)
+{
+	Py_ssize_t i, len;
+
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		if (entry->scopes[i]
+				!= (scopes[i] ? scopes[i]->declaration : NULL))
+			return 0;
+	}
+	len = PyTuple_GET_SIZE(entry->names);
+	for (i = 0; i < len; i++) {
+		const struct event_field_index *field = &entry->fields[i];
+		const struct definition_struct *fields_struct;
+		const struct bt_definition *def;
+
+		fields_struct = scope_struct(scopes[field->scope]);
+		if (!fields_struct || field->index >= fields_struct->fields->len)
+			return 0;
+		def = g_ptr_array_index(fields_struct->fields, field->index);
+		if (def->name != field->name)
+			return 0;
+	}
+	return 1;
+}
+
+/* Definition of the i-th field of an entry, in the scopes of an event. */
+static
+const struct bt_definition *event_fields_definition(
+		const struct event_fields *entry,
+		const struct bt_definition **scopes, Py_ssize_t i)
+{
+	const struct event_field_index *field = &entry->fields[i];
+
+	return g_ptr_array_index(scope_struct(scopes[field->scope])->fields,
+			field->index);
+}
+
+/*
+ * Return the fields of an event, or NULL with a Python exception set,
+ * and its top-level scopes in "scopes".
+ */
+static
+struct event_fields *event_fields_get(const struct bt_ctf_event *event,
+		const struct bt_definition **scopes)
+{
+	const struct ctf_stream_definition *stream;
+	struct ctf_event_declaration *event_class;
+	struct event_fields *entry;
+	int i;
+
+	if (!event || !event->parent->stream) {
+		PyErr_SetString(PyExc_ValueError, "Invalid event");
+		return NULL;
+	}
+	for (i = 0; i < NR_EVENT_SCOPES; i++)
+		scopes[i] = bt_ctf_get_top_level_scope(event, event_scopes[i]);
+	stream = event->parent->stream;
+	event_class = g_ptr_array_index(stream->stream_class->events_by_id,
+			stream->event_id);
+
+	if (!event_fields_cache)
+		event_fields_cache = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, event_fields_destroy);
+	entry = g_hash_table_lookup(event_fields_cache, event_class);
+	if (entry && event_fields_match(entry, scopes))
+		return entry;
+
+	entry = event_fields_create(scopes);
+	if (!entry) {
+		if (!PyErr_Occurred())
+			PyErr_NoMemory();
+		return NULL;
+	}
+	if (g_hash_table_size(event_fields_cache) >= EVENT_FIELDS_CACHE_MAX)
+		g_hash_table_remove_all(event_fields_cache);
+	g_hash_table_insert(event_fields_cache, event_class, entry);
+	return entry;
+}
+
+static
+PyObject *python_from_string(const char *str)
+{
+	if (!str)
+		Py_RETURN_NONE;
+	return PyUnicode_DecodeUTF8(str, strlen(str), "surrogateescape");
+}
+
+static
+int is_char_declaration(const struct bt_declaration *decl)
+{
+	const struct declaration_integer *integer;
+
+	if (decl->id != CTF_TYPE_INTEGER)
+		return 0;
+	integer = container_of(decl, const struct declaration_integer, p);
+	return integer->len == CHAR_BIT
+		&& (integer->encoding == CTF_STRING_ASCII
+			|| integer->encoding == CTF_STRING_UTF8);
+}
+
+static
+PyObject *python_from_definition(const struct bt_definition *def);
+
+static
+PyObject *python_list_from_definitions(GPtrArray *elems, uint64_t len)
+{
+	PyObject *list, *value;
+	uint64_t i;
+
+	list = PyList_New(len);
+	if (!list)
+		return NULL;
+	for (i = 0; i < len; i++) {
+		value = python_from_definition(g_ptr_array_index(elems, i));
+		if (!value) {
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, i, value);
+	}
+	return list;
+}
+
+/* Same conversions as _Definition.value in reader.py. */
+static
+PyObject *python_from_definition(const struct bt_definition *def)
+{
+	if (!def)
+		Py_RETURN_NONE;
+
+	switch (def->declaration->id) {
+	case CTF_TYPE_INTEGER:
+	{
+		const struct definition_integer *integer =
+			container_of(def, const struct definition_integer, p);
+
+		if (!integer->declaration->signedness)
+			return PyLong_FromUnsignedLongLong(
+					integer->value._unsigned);
+		return PyLong_FromLongLong(integer->value._signed);
+	}
+	case CTF_TYPE_FLOAT:
+		return PyFloat_FromDouble(container_of(def,
+				const struct definition_float, p)->value);
+	case CTF_TYPE_ENUM:
+		return python_from_string(bt_ctf_get_enum_str(def));
+	case CTF_TYPE_STRING:
+		return python_from_string(bt_ctf_get_string(def));
+	case CTF_TYPE_ARRAY:
+	{
+		const struct definition_array *array =
+			container_of(def, const struct definition_array, p);
+
+		if (is_char_declaration(array->declaration->elem))
+			return python_from_string(array->string->str);
+		return python_list_from_definitions(array->elems,
+				array->declaration->len);
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		const struct definition_sequence *sequence =
+			container_of(def, const struct definition_sequence, p);
+
+		if (is_char_declaration(sequence->declaration->elem))
+			return python_from_string(sequence->string->str);
+		return python_list_from_definitions(sequence->elems,
+				sequence->length->value._unsigned);
+	}
+	case CTF_TYPE_VARIANT:
+		return python_from_definition(bt_ctf_get_variant(def));
+	case CTF_TYPE_STRUCT:
+	{
+		const struct definition_struct *def_struct =
+			container_of(def, const struct definition_struct, p);
+		PyObject *dict, *value;
+		int i, ret;
+
+		dict = PyDict_New();
+		if (!dict)
+			return NULL;
+		for (i = 0; i < def_struct->fields->len; i++) {
+			const struct bt_definition *member =
+				g_ptr_array_index(def_struct->fields, i);
+
+			value = python_from_definition(member);
+			if (!value) {
+				Py_DECREF(dict);
+				return NULL;
+			}
+			ret = PyDict_SetItemString(dict,
+					bt_ctf_field_name(member), value);
+			Py_DECREF(value);
+			if (ret) {
+				Py_DECREF(dict);
+				return NULL;
+			}
+		}
+		return dict;
+	}
+	default:
+		Py_RETURN_NONE;
+	}
+}
+
+/* Number of fields of all scopes, as Event.__len__(). */
+long _bt_python_event_len(const struct bt_ctf_event *event)
+{
+	const struct bt_definition *scopes[NR_EVENT_SCOPES];
+	struct event_fields *entry = event_fields_get(event, scopes);
+
+	if (!entry) {
+		PyErr_Clear();
+		return 0;
+	}
+	return entry->len;
+}
+
+/* Tuple of the unique field names, in scope search order. */
+PyObject *_bt_python_event_keys(const struct bt_ctf_event *event)
+{
+	const struct bt_definition *scopes[NR_EVENT_SCOPES];
+	struct event_fields *entry = event_fields_get(event, scopes);
+
+	if (!entry)
+		return NULL;
+	Py_INCREF(entry->names);
+	return entry->names;
+}
+
+/* Tuple of the values of the fields named by _bt_python_event_keys(). */
+PyObject *_bt_python_event_values(const struct bt_ctf_event *event)
+{
+	const struct bt_definition *scopes[NR_EVENT_SCOPES];
+	struct event_fields *entry = event_fields_get(event, scopes);
+	PyObject *values, *value;
+	Py_ssize_t i, len;
+
+	if (!entry)
+		return NULL;
+	len = PyTuple_GET_SIZE(entry->names);
+	values = PyTuple_New(len);
+	if (!values)
+		return NULL;
+	for (i = 0; i < len; i++) {
+		value = python_from_definition(
+				event_fields_definition(entry, scopes, i));
+		if (!value) {
+			Py_DECREF(values);
+			return NULL;
+		}
+		PyTuple_SET_ITEM(values, i, value);
+	}
+	return values;
+}
+
+/* Dictionary of the fields of an event, by name. */
+PyObject *_bt_python_event_dict(const struct bt_ctf_event *event)
+{
+	const struct bt_definition *scopes[NR_EVENT_SCOPES];
+	struct event_fields *entry = event_fields_get(event, scopes);
+	PyObject *dict, *value;
+	Py_ssize_t i, len;
+	int ret;
+
+	if (!entry)
+		return NULL;
+	len = PyTuple_GET_SIZE(entry->names);
+	dict = PyDict_New();
+	if (!dict)
+		return NULL;
+	for (i = 0; i < len; i++) {
+		value = python_from_definition(
+				event_fields_definition(entry, scopes, i));
+		if (!value) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+		ret = PyDict_SetItem(dict, PyTuple_GET_ITEM(entry->names, i),
+				value);
+		Py_DECREF(value);
+		if (ret) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+static
+const struct bt_definition *event_lookup_field(
+		const struct bt_ctf_event *event, const char *name)
+{
+	const struct bt_definition *scope, *def;
+	int i;
+
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		scope = bt_ctf_get_top_level_scope(event, event_scopes[i]);
+		if (!scope)
+			continue;
+		def = bt_ctf_get_field(event, scope, name);
+		if (def)
+			return def;
+	}
+	return NULL;
+}
+
+/*
+ * Value of the field named "name", searched in the scopes in order.
+ * Raises KeyError if the event has no such field.
+ */
+PyObject *_bt_python_event_get(const struct bt_ctf_event *event,
+		const char *name)
+{
+	const struct bt_definition *def;
+
+	def = event ? event_lookup_field(event, name) : NULL;
+	if (!def) {
+		PyErr_SetString(PyExc_KeyError, name ? name : "");
+		return NULL;
+	}
+	return python_from_definition(def);
+}
+
+int _bt_python_event_has_field(const struct bt_ctf_event *event,
+		const char *name)
+{
+	return event && event_lookup_field(event, name) != NULL;
+}
+
+/* Columnar batches
+   ----------------------------------------------------
+   Decode events in C and keep only timestamps, ids and selected numeric
+   fields, in one array per column. Fields are looked up once per event
+   definition, i.e. per event type and stream, and read directly from
+   their definitions afterwards.
+*/
+
+struct bt_python_batch_field {
+	struct bt_ctf_field_key *key;
+	int scope;		/* -1 to search the scopes in order */
+	char type[2];		/* Array type code: "Q", "q" or "d" */
+	int typed;		/* Whether type was set by a resolution */
+	GArray *values;		/* 64-bit values of type "type" */
+	GArray *valid;		/* uint8_t, 0 when the event lacks the field */
+};
+
+/* Resolution of the fields for one event definition. */
+struct bt_python_batch_event {
+	uint32_t name_id;
+	const struct bt_definition *fields[];
+};
+
+struct bt_python_batch {
+	GPtrArray *fields;	/* struct bt_python_batch_field */
+	/* struct ctf_event_definition * to struct bt_python_batch_event */
+	GHashTable *events;
+	GArray *timestamps;	/* uint64_t */
+	GArray *event_ids;	/* uint64_t */
+	GArray *name_ids;	/* uint32_t, indexes in names */
+	GArray *names;		/* GQuark */
+	int end;
+};
+
+static
+void batch_field_destroy(struct bt_python_batch_field *field)
+{
+	bt_ctf_field_key_destroy(field->key);
+	g_array_free(field->values, TRUE);
+	g_array_free(field->valid, TRUE);
+	g_free(field);
+}
+
+struct bt_python_batch *_bt_python_batch_create(void)
+{
+	struct bt_python_batch *batch;
+
+	batch = g_new0(struct bt_python_batch, 1);
+	batch->fields = g_ptr_array_new();
+	batch->events = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, g_free);
+	batch->timestamps = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	batch->event_ids = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	batch->name_ids = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+	batch->names = g_array_new(FALSE, FALSE, sizeof(GQuark));
+	return batch;
+}
+
+void _bt_python_batch_destroy(struct bt_python_batch *batch)
+{
+	int i;
+
+	if (!batch)
+		return;
+	for (i = 0; i < batch->fields->len; i++)
+		batch_field_destroy(g_ptr_array_index(batch->fields, i));
+	g_ptr_array_free(batch->fields, TRUE);
+	g_hash_table_destroy(batch->events);
+	g_array_free(batch->timestamps, TRUE);
+	g_array_free(batch->event_ids, TRUE);
+	g_array_free(batch->name_ids, TRUE);
+	g_array_free(batch->names, TRUE);
+	g_free(batch);
+}
+
+/*
+ * Select a field, searched in "scope", or in all the scopes in order if
+ * scope is -1. Fields must be selected before the first read.
+ * Returns the index of the field's column, or -1 on error.
+ */
+int _bt_python_batch_add_field(struct bt_python_batch *batch,
+		const char *name, int scope)
+{
+	struct bt_python_batch_field *field;
+
+	if (g_hash_table_size(batch->events))
+		return -1;
+	field = g_new0(struct bt_python_batch_field, 1);
+	field->key = bt_ctf_field_key_create(name);
+	if (!field->key) {
+		g_free(field);
+		return -1;
+	}
+	field->scope = scope;
+	field->type[0] = 'q';
+	field->values = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	field->valid = g_array_new(FALSE, FALSE, sizeof(uint8_t));
+	g_ptr_array_add(batch->fields, field);
+	return batch->fields->len - 1;
+}
+
+static
+const struct bt_definition *lookup_field_by_key(
+		const struct bt_definition *scope,
+		const struct bt_ctf_field_key *key)
+{
+	const struct bt_definition *def;
+
+	def = bt_lookup_definition_quark(scope, key->name);
+	if (!def)
+		def = bt_lookup_definition_quark(scope, key->underscore_name);
+	return def;
+}
+
+/*
+ * Look a field up in "scope", or in all the scopes in order if scope is
+ * -1. Unlike bt_ctf_get_field_by_key(), variants are not resolved: the
+ * variant definition is the same for all the events of a definition,
+ * its current field is not. Use _bt_python_resolve_field() on each
+ * event.
+ */
+const struct bt_definition *_bt_python_lookup_field(
+		const struct bt_ctf_event *event,
+		const struct bt_ctf_field_key *key, int scope)
+{
+	const struct bt_definition *scope_def, *def;
+	int i;
+
+	if (scope >= 0) {
+		scope_def = bt_ctf_get_top_level_scope(event, scope);
+		return scope_def ? lookup_field_by_key(scope_def, key) : NULL;
+	}
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		scope_def = bt_ctf_get_top_level_scope(event, event_scopes[i]);
+		if (!scope_def)
+			continue;
+		def = lookup_field_by_key(scope_def, key);
+		if (def)
+			return def;
+	}
+	return NULL;
+}
+
+/* Current field of a definition returned by _bt_python_lookup_field(). */
+const struct bt_definition *_bt_python_resolve_field(
+		const struct bt_definition *def)
+{
+	while (def && def->declaration->id == CTF_TYPE_VARIANT)
+		def = bt_ctf_get_variant(def);
+	return def;
+}
+
+static
+uint32_t batch_name_id(struct bt_python_batch *batch,
+		const struct bt_ctf_event *event)
+{
+	const char *name = bt_ctf_event_name(event);
+	GQuark quark = name ? g_quark_from_string(name) : 0;
+	uint32_t i;
+
+	for (i = 0; i < batch->names->len; i++) {
+		if (g_array_index(batch->names, GQuark, i) == quark)
+			return i;
+	}
+	g_array_append_val(batch->names, quark);
+	return i;
+}
+
+/*
+ * Column type of a declaration, or 0 if it is not numeric. A variant
+ * has the widest type of its numeric options: its current option
+ * changes from one event to the next.
+ */
+static
+char batch_column_type(const struct bt_declaration *decl)
+{
+	const struct declaration_untagged_variant *variant;
+	char type = 0, option;
+	int i;
+
+	switch (decl->id) {
+	case CTF_TYPE_ENUM:
+		decl = &container_of(decl, const struct declaration_enum,
+				p)->integer_declaration->p;
+		/* Fall-through */
+	case CTF_TYPE_INTEGER:
+		return container_of(decl, const struct declaration_integer,
+				p)->signedness ? 'q' : 'Q';
+	case CTF_TYPE_FLOAT:
+		return 'd';
+	case CTF_TYPE_VARIANT:
+		variant = container_of(decl, const struct declaration_variant,
+				p)->untagged_variant;
+		for (i = 0; i < variant->fields->len; i++) {
+			option = batch_column_type(g_array_index(
+					variant->fields,
+					struct declaration_field,
+					i).declaration);
+			if (option == 'd' || (option == 'q' && type != 'd')
+					|| (option == 'Q' && !type))
+				type = option;
+		}
+		return type;
+	default:
+		return 0;
+	}
+}
+
+/* Resolve the selected fields of an event definition. */
+static
+struct bt_python_batch_event *batch_resolve(struct bt_python_batch *batch,
+		const struct bt_ctf_event *event)
+{
+	struct bt_python_batch_event *resolved;
+	int i;
+
+	resolved = g_malloc0(sizeof(*resolved)
+			+ batch->fields->len * sizeof(resolved->fields[0]));
+	resolved->name_id = batch_name_id(batch, event);
+	for (i = 0; i < batch->fields->len; i++) {
+		struct bt_python_batch_field *field =
+			g_ptr_array_index(batch->fields, i);
+		const struct bt_definition *def;
+		char type;
+
+		def = _bt_python_lookup_field(event, field->key, field->scope);
+		type = def ? batch_column_type(def->declaration) : 0;
+		if (!type) {
+			/* Only numeric fields have a column. */
+			def = NULL;
+		} else if (!field->typed) {
+			field->type[0] = type;
+			field->typed = 1;
+		}
+		resolved->fields[i] = def;
+	}
+	g_hash_table_insert(batch->events, event->parent, resolved);
+	return resolved;
+}
+
+/*
+ * The column type is the one of the field as first resolved: the values
+ * of fields of other types in other events are converted to it.
+ * Variants are resolved here, for each event.
+ */
+static
+void batch_append_value(struct bt_python_batch_field *field,
+		const struct bt_definition *def)
+{
+	union {
+		uint64_t _unsigned;
+		int64_t _signed;
+		double _float;
+	} value;
+	uint8_t valid = 1;
+
+	value._unsigned = 0;
+	def = _bt_python_resolve_field(def);
+	if (def && def->declaration->id == CTF_TYPE_ENUM)
+		def = &container_of(def, const struct definition_enum,
+				p)->integer->p;
+	if (!def || (def->declaration->id != CTF_TYPE_INTEGER
+			&& def->declaration->id != CTF_TYPE_FLOAT)) {
+		/* Also the non-numeric options of a variant. */
+		valid = 0;
+	} else if (def->declaration->id == CTF_TYPE_FLOAT) {
+		double v = container_of(def, struct definition_float,
+				p)->value;
+
+		if (field->type[0] == 'd')
+			value._float = v;
+		else if (field->type[0] == 'Q')
+			value._unsigned = (uint64_t) v;
+		else
+			value._signed = (int64_t) v;
+	} else {
+		const struct definition_integer *integer =
+			container_of(def, struct definition_integer, p);
+
+		if (field->type[0] != 'd')
+			value._unsigned = integer->value._unsigned;
+		else if (integer->declaration->signedness)
+			value._float = integer->value._signed;
+		else
+			value._float = integer->value._unsigned;
+	}
+	g_array_append_val(field->values, value);
+	g_array_append_val(field->valid, valid);
+}
+
+/*
+ * Decode up to max_events events from iter, replacing the columns of
+ * the previous read. Returns the number of events read, 0 at the end
+ * of the trace, or -1 on error.
+ */
+int _bt_python_batch_read(struct bt_python_batch *batch,
+		struct bt_ctf_iter *iter, unsigned int max_events)
+{
+	struct bt_ctf_event *event;
+	unsigned int count = 0;
+	int i, ret = 0;
+
+	g_array_set_size(batch->timestamps, 0);
+	g_array_set_size(batch->event_ids, 0);
+	g_array_set_size(batch->name_ids, 0);
+	for (i = 0; i < batch->fields->len; i++) {
+		struct bt_python_batch_field *field =
+			g_ptr_array_index(batch->fields, i);
+
+		g_array_set_size(field->values, 0);
+		g_array_set_size(field->valid, 0);
+	}
+
+	/* No Python object is touched while decoding. */
+	Py_BEGIN_ALLOW_THREADS
+	while (!batch->end && count < max_events) {
+		struct bt_python_batch_event *resolved;
+		uint64_t timestamp, event_id;
+
+		event = bt_ctf_iter_read_event(iter);
+		if (!event) {
+			batch->end = 1;
+			break;
+		}
+		resolved = g_hash_table_lookup(batch->events, event->parent);
+		if (!resolved)
+			resolved = batch_resolve(batch, event);
+
+		timestamp = bt_ctf_get_timestamp(event);
+		event_id = event->parent->stream->event_id;
+		g_array_append_val(batch->timestamps, timestamp);
+		g_array_append_val(batch->event_ids, event_id);
+		g_array_append_val(batch->name_ids, resolved->name_id);
+		for (i = 0; i < batch->fields->len; i++)
+			batch_append_value(g_ptr_array_index(batch->fields, i),
+					resolved->fields[i]);
+		count++;
+
+		ret = bt_iter_next(bt_ctf_get_iter(iter));
+		if (ret) {
+			batch->end = 1;
+			break;
+		}
+	}
+	Py_END_ALLOW_THREADS
+
+	return ret < 0 ? -1 : count;
+}
+
+static
+PyObject *batch_array_bytes(GArray *array, size_t elem_size)
+{
+	return PyBytes_FromStringAndSize(array->data, array->len * elem_size);
+}
+
+/*
+ * Return a copy of a column of the last read, a field index or a value
+ * of enum bt_python_batch_column, as bytes in native byte order.
+ */
+PyObject *_bt_python_batch_column(struct bt_python_batch *batch,
+		int column)
+{
+	struct bt_python_batch_field *field;
+
+	switch (column) {
+	case BT_PYTHON_BATCH_TIMESTAMPS:
+		return batch_array_bytes(batch->timestamps, sizeof(uint64_t));
+	case BT_PYTHON_BATCH_EVENT_IDS:
+		return batch_array_bytes(batch->event_ids, sizeof(uint64_t));
+	case BT_PYTHON_BATCH_NAME_IDS:
+		return batch_array_bytes(batch->name_ids, sizeof(uint32_t));
+	default:
+		break;
+	}
+	if (column < 0 || column >= batch->fields->len)
+		Py_RETURN_NONE;
+	field = g_ptr_array_index(batch->fields, column);
+	return batch_array_bytes(field->values, sizeof(uint64_t));
+}
+
+PyObject *_bt_python_batch_valid(struct bt_python_batch *batch,
+		int field)
+{
+	if (field < 0 || field >= batch->fields->len)
+		Py_RETURN_NONE;
+	return batch_array_bytes(((struct bt_python_batch_field *)
+			g_ptr_array_index(batch->fields, field))->valid,
+			sizeof(uint8_t));
+}
+
+const char *_bt_python_batch_field_type(struct bt_python_batch *batch,
+		int field)
+{
+	if (field < 0 || field >= batch->fields->len)
+		return NULL;
+	return ((struct bt_python_batch_field *)
+			g_ptr_array_index(batch->fields, field))->type;
+}
+
+unsigned int _bt_python_batch_name_count(struct bt_python_batch *batch)
+{
+	return batch->names->len;
+}
+
+const char *_bt_python_batch_name(struct bt_python_batch *batch,
+		unsigned int index)
+{
+	if (index >= batch->names->len)
+		return NULL;
+	return g_quark_to_string(g_array_index(batch->names, GQuark, index));
+}
+
+/* Event snapshots
+   ----------------------------------------------------
+   Copy the fields of an event into a compact, immutable and reference
+   counted record, which remains valid after the iterator moves on.
+   Records are allocated consecutively in the chunks of an arena, and a
+   chunk is recycled once all its records are released: keeping a
+   sliding window of events costs neither per-event allocations nor
+   per-field Python objects. Values are only converted to Python
+   objects when read.
+*/
+
+#define SNAPSHOT_CHUNK_SIZE	(1UL << 20)	/* 1 MiB */
+#define SNAPSHOT_FREE_CHUNKS	16		/* Kept for reuse */
+#define SNAPSHOT_ALIGN(len)	(((len) + 7) & ~(size_t) 7)
+
+enum snapshot_value_type {
+	SNAPSHOT_VALUE_NONE,
+	SNAPSHOT_VALUE_UNSIGNED,
+	SNAPSHOT_VALUE_SIGNED,
+	SNAPSHOT_VALUE_FLOAT,
+	SNAPSHOT_VALUE_QUARK,		/* Enumeration label */
+	SNAPSHOT_VALUE_STRING,		/* len bytes at offset */
+	SNAPSHOT_VALUE_LIST,		/* len snapshot_value at offset */
+	SNAPSHOT_VALUE_STRUCT,		/* len snapshot_field at offset */
+};
+
+struct snapshot_value {
+	uint32_t type;
+	uint32_t len;
+	union {
+		uint64_t _unsigned;
+		int64_t _signed;
+		double _float;
+		uint64_t quark;
+		uint64_t offset;	/* From the start of the record */
+	} v;
+};
+
+struct snapshot_field {
+	GQuark name;
+	uint16_t scope;			/* Index in event_scopes */
+	uint16_t unique;		/* First field of this name */
+	struct snapshot_value value;
+};
+
+struct snapshot_chunk {
+	struct bt_python_snapshot_arena *arena;
+	size_t size, used;
+	unsigned int live;		/* Records not released */
+	char data[] __attribute__((aligned(8)));
+};
+
+struct bt_python_snapshot_arena {
+	size_t chunk_size;
+	struct snapshot_chunk *current;
+	GPtrArray *free_chunks;		/* Empty chunks of chunk_size */
+	unsigned int nr_chunks;		/* Allocated */
+	int destroyed;			/* Freed with its last chunk */
+};
+
+struct bt_python_snapshot {
+	struct snapshot_chunk *chunk;
+	unsigned int refcount;
+	unsigned int nr_fields;		/* All the scopes */
+	uint64_t timestamp;
+	uint64_t cycles;
+	GQuark name;
+	struct snapshot_field fields[];
+};
+
+struct bt_python_snapshot_arena *_bt_python_snapshot_arena_create(
+		size_t chunk_size)
+{
+	struct bt_python_snapshot_arena *arena;
+
+	arena = g_new0(struct bt_python_snapshot_arena, 1);
+	arena->chunk_size = chunk_size ? chunk_size : SNAPSHOT_CHUNK_SIZE;
+	arena->free_chunks = g_ptr_array_new();
+	return arena;
+}
+
+static
+void snapshot_chunk_free(struct snapshot_chunk *chunk)
+{
+	struct bt_python_snapshot_arena *arena = chunk->arena;
+
+	g_free(chunk);
+	if (!--arena->nr_chunks && arena->destroyed) {
+		g_ptr_array_free(arena->free_chunks, TRUE);
+		g_free(arena);
+	}
+}
+
+/* Put an empty chunk back in the free list, or free it. */
+static
+void snapshot_chunk_recycle(struct snapshot_chunk *chunk)
+{
+	struct bt_python_snapshot_arena *arena = chunk->arena;
+
+	if (arena->destroyed || chunk->size != arena->chunk_size
+			|| arena->free_chunks->len >= SNAPSHOT_FREE_CHUNKS) {
+		snapshot_chunk_free(chunk);
+		return;
+	}
+	chunk->used = 0;
+	g_ptr_array_add(arena->free_chunks, chunk);
+}
+
+/*
+ * Records still alive keep the arena around: it is freed with the
+ * chunk of the last one.
+ */
+void _bt_python_snapshot_arena_destroy(struct bt_python_snapshot_arena *arena)
+{
+	struct snapshot_chunk *current;
+	int i;
+
+	if (!arena)
+		return;
+	arena->destroyed = 1;
+	current = arena->current;
+	arena->current = NULL;
+	/* Keep the arena alive while freeing its chunks. */
+	arena->nr_chunks++;
+	for (i = 0; i < arena->free_chunks->len; i++)
+		snapshot_chunk_free(g_ptr_array_index(arena->free_chunks, i));
+	g_ptr_array_set_size(arena->free_chunks, 0);
+	if (current && !current->live)
+		snapshot_chunk_free(current);
+	if (!--arena->nr_chunks) {
+		g_ptr_array_free(arena->free_chunks, TRUE);
+		g_free(arena);
+	}
+}
+
+static
+void *snapshot_alloc(struct bt_python_snapshot_arena *arena, size_t len,
+		struct snapshot_chunk **chunk_out)
+{
+	struct snapshot_chunk *chunk = arena->current;
+	void *p;
+
+	if (!chunk || chunk->size - chunk->used < len) {
+		if (chunk && !chunk->live)
+			snapshot_chunk_recycle(chunk);
+		if (len <= arena->chunk_size && arena->free_chunks->len) {
+			chunk = g_ptr_array_remove_index_fast(
+					arena->free_chunks,
+					arena->free_chunks->len - 1);
+		} else {
+			size_t size = MAX(len, arena->chunk_size);
+
+			chunk = g_malloc(sizeof(*chunk) + size);
+			chunk->arena = arena;
+			chunk->size = size;
+			chunk->used = 0;
+			chunk->live = 0;
+			arena->nr_chunks++;
+		}
+		arena->current = chunk;
+	}
+	p = chunk->data + chunk->used;
+	chunk->used += len;
+	chunk->live++;
+	*chunk_out = chunk;
+	return p;
+}
+
+static
+const struct bt_definition *snapshot_resolve(const struct bt_definition *def)
+{
+	while (def && def->declaration->id == CTF_TYPE_VARIANT)
+		def = bt_ctf_get_variant(def);
+	return def;
+}
+
+/* Text of character arrays and sequences, NULL for other definitions. */
+static
+const GString *snapshot_text(const struct bt_definition *def)
+{
+	if (def->declaration->id == CTF_TYPE_ARRAY) {
+		const struct definition_array *array =
+			container_of(def, const struct definition_array, p);
+
+		if (is_char_declaration(array->declaration->elem))
+			return array->string;
+	} else if (def->declaration->id == CTF_TYPE_SEQUENCE) {
+		const struct definition_sequence *sequence =
+			container_of(def, const struct definition_sequence, p);
+
+		if (is_char_declaration(sequence->declaration->elem))
+			return sequence->string;
+	}
+	return NULL;
+}
+
+/* Elements of arrays, sequences and structures. */
+static
+GPtrArray *snapshot_children(const struct bt_definition *def, uint64_t *len)
+{
+	switch (def->declaration->id) {
+	case CTF_TYPE_ARRAY:
+	{
+		const struct definition_array *array =
+			container_of(def, const struct definition_array, p);
+
+		*len = array->declaration->len;
+		return array->elems;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		const struct definition_sequence *sequence =
+			container_of(def, const struct definition_sequence, p);
+
+		*len = sequence->length->value._unsigned;
+		return sequence->elems;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		const struct definition_struct *def_struct =
+			container_of(def, const struct definition_struct, p);
+
+		*len = def_struct->fields->len;
+		return def_struct->fields;
+	}
+	default:
+		*len = 0;
+		return NULL;
+	}
+}
+
+/* Bytes needed by the data of a value, after its snapshot_value. */
+static
+size_t snapshot_value_size(const struct bt_definition *def)
+{
+	const GString *text;
+	GPtrArray *elems;
+	uint64_t i, len;
+	size_t size;
+
+	def = snapshot_resolve(def);
+	if (!def)
+		return 0;
+	if (def->declaration->id == CTF_TYPE_STRING) {
+		const char *str = bt_ctf_get_string(def);
+
+		return str ? SNAPSHOT_ALIGN(strlen(str) + 1) : 0;
+	}
+	text = snapshot_text(def);
+	if (text)
+		return SNAPSHOT_ALIGN(text->len + 1);
+	elems = snapshot_children(def, &len);
+	if (!elems)
+		return 0;
+	size = len * (def->declaration->id == CTF_TYPE_STRUCT
+			? sizeof(struct snapshot_field)
+			: sizeof(struct snapshot_value));
+	for (i = 0; i < len; i++)
+		size += snapshot_value_size(g_ptr_array_index(elems, i));
+	return size;
+}
+
+struct snapshot_builder {
+	char *base;			/* Record */
+	size_t used;			/* Bytes of the record filled */
+};
+
+static
+void snapshot_put_string(struct snapshot_builder *builder,
+		struct snapshot_value *value, const char *str, size_t len)
+{
+	value->type = SNAPSHOT_VALUE_STRING;
+	value->len = len;
+	value->v.offset = builder->used;
+	memcpy(builder->base + builder->used, str, len);
+	builder->base[builder->used + len] = '\0';
+	builder->used += SNAPSHOT_ALIGN(len + 1);
+}
+
+static
+void snapshot_fill_value(struct snapshot_builder *builder,
+		const struct bt_definition *def, struct snapshot_value *value)
+{
+	const GString *text;
+	GPtrArray *elems;
+	uint64_t i, len;
+
+	memset(value, 0, sizeof(*value));
+	def = snapshot_resolve(def);
+	if (!def)
+		return;
+
+	switch (def->declaration->id) {
+	case CTF_TYPE_INTEGER:
+	{
+		const struct definition_integer *integer =
+			container_of(def, const struct definition_integer, p);
+
+		if (integer->declaration->signedness) {
+			value->type = SNAPSHOT_VALUE_SIGNED;
+			value->v._signed = integer->value._signed;
+		} else {
+			value->type = SNAPSHOT_VALUE_UNSIGNED;
+			value->v._unsigned = integer->value._unsigned;
+		}
+		return;
+	}
+	case CTF_TYPE_FLOAT:
+		value->type = SNAPSHOT_VALUE_FLOAT;
+		value->v._float = container_of(def,
+				const struct definition_float, p)->value;
+		return;
+	case CTF_TYPE_ENUM:
+	{
+		const char *label = bt_ctf_get_enum_str(def);
+
+		if (label) {
+			value->type = SNAPSHOT_VALUE_QUARK;
+			value->v.quark = g_quark_from_string(label);
+		}
+		return;
+	}
+	case CTF_TYPE_STRING:
+	{
+		const char *str = bt_ctf_get_string(def);
+
+		if (str)
+			snapshot_put_string(builder, value, str, strlen(str));
+		return;
+	}
+	default:
+		break;
+	}
+
+	text = snapshot_text(def);
+	if (text) {
+		snapshot_put_string(builder, value, text->str, text->len);
+		return;
+	}
+	elems = snapshot_children(def, &len);
+	if (!elems)
+		return;
+	value->len = len;
+	value->v.offset = builder->used;
+	if (def->declaration->id == CTF_TYPE_STRUCT) {
+		struct snapshot_field *members =
+			(struct snapshot_field *) (builder->base + builder->used);
+
+		value->type = SNAPSHOT_VALUE_STRUCT;
+		builder->used += len * sizeof(*members);
+		for (i = 0; i < len; i++) {
+			const struct bt_definition *member =
+				g_ptr_array_index(elems, i);
+
+			members[i].name = member->name;
+			members[i].scope = 0;
+			members[i].unique = 1;
+			snapshot_fill_value(builder, member, &members[i].value);
+		}
+	} else {
+		struct snapshot_value *values =
+			(struct snapshot_value *) (builder->base + builder->used);
+
+		value->type = SNAPSHOT_VALUE_LIST;
+		builder->used += len * sizeof(*values);
+		for (i = 0; i < len; i++)
+			snapshot_fill_value(builder,
+					g_ptr_array_index(elems, i), &values[i]);
+	}
+}
+
+/*
+ * Capture an event. Returns a record with a reference count of 1, to
+ * release with _bt_python_snapshot_put(), or NULL on error.
+ */
+struct bt_python_snapshot *_bt_python_snapshot_create(
+		struct bt_python_snapshot_arena *arena,
+		const struct bt_ctf_event *event)
+{
+	const struct definition_struct *scopes[NR_EVENT_SCOPES];
+	struct bt_python_snapshot *snapshot;
+	struct snapshot_builder builder;
+	struct snapshot_chunk *chunk;
+	GHashTable *seen;
+	unsigned int nr_fields = 0, n = 0;
+	size_t size;
+	const char *name;
+	int i, j;
+
+	if (!arena || !event)
+		return NULL;
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		const struct bt_definition *scope;
+
+		scope = bt_ctf_get_top_level_scope(event, event_scopes[i]);
+		if (!scope || scope->declaration->id != CTF_TYPE_STRUCT) {
+			scopes[i] = NULL;
+			continue;
+		}
+		scopes[i] = container_of(scope, const struct definition_struct,
+				p);
+		nr_fields += scopes[i]->fields->len;
+	}
+
+	size = sizeof(*snapshot) + nr_fields * sizeof(snapshot->fields[0]);
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		for (j = 0; scopes[i] && j < scopes[i]->fields->len; j++)
+			size += snapshot_value_size(
+					g_ptr_array_index(scopes[i]->fields, j));
+	}
+
+	snapshot = snapshot_alloc(arena, SNAPSHOT_ALIGN(size), &chunk);
+	snapshot->chunk = chunk;
+	snapshot->refcount = 1;
+	snapshot->nr_fields = nr_fields;
+	snapshot->timestamp = bt_ctf_get_timestamp(event);
+	snapshot->cycles = bt_ctf_get_cycles(event);
+	name = bt_ctf_event_name(event);
+	snapshot->name = name ? g_quark_from_string(name) : 0;
+
+	builder.base = (char *) snapshot;
+	builder.used = sizeof(*snapshot)
+		+ nr_fields * sizeof(snapshot->fields[0]);
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		for (j = 0; scopes[i] && j < scopes[i]->fields->len; j++) {
+			const struct bt_definition *def =
+				g_ptr_array_index(scopes[i]->fields, j);
+			struct snapshot_field *field = &snapshot->fields[n++];
+
+			field->name = def->name;
+			field->scope = i;
+			field->unique = def->name && !g_hash_table_lookup(seen,
+					GUINT_TO_POINTER(def->name));
+			if (field->unique)
+				g_hash_table_insert(seen,
+					GUINT_TO_POINTER(def->name),
+					GUINT_TO_POINTER(1));
+			snapshot_fill_value(&builder, def, &field->value);
+		}
+	}
+	g_hash_table_destroy(seen);
+	return snapshot;
+}
+
+void _bt_python_snapshot_get(struct bt_python_snapshot *snapshot)
+{
+	if (snapshot)
+		snapshot->refcount++;
+}
+
+void _bt_python_snapshot_put(struct bt_python_snapshot *snapshot)
+{
+	struct snapshot_chunk *chunk;
+
+	if (!snapshot || --snapshot->refcount)
+		return;
+	chunk = snapshot->chunk;
+	if (--chunk->live)
+		return;
+	if (chunk == chunk->arena->current)
+		chunk->used = 0;
+	else
+		snapshot_chunk_recycle(chunk);
+}
+
+const char *_bt_python_snapshot_name(const struct bt_python_snapshot *snapshot)
+{
+	return snapshot->name ? g_quark_to_string(snapshot->name) : NULL;
+}
+
+uint64_t _bt_python_snapshot_timestamp(
+		const struct bt_python_snapshot *snapshot)
+{
+	return snapshot->timestamp;
+}
+
+uint64_t _bt_python_snapshot_cycles(const struct bt_python_snapshot *snapshot)
+{
+	return snapshot->cycles;
+}
+
+static
+PyObject *python_from_snapshot_value(const struct bt_python_snapshot *snapshot,
+		const struct snapshot_value *value)
+{
+	const char *base = (const char *) snapshot;
+	PyObject *obj, *item;
+	uint32_t i;
+
+	switch (value->type) {
+	case SNAPSHOT_VALUE_UNSIGNED:
+		return PyLong_FromUnsignedLongLong(value->v._unsigned);
+	case SNAPSHOT_VALUE_SIGNED:
+		return PyLong_FromLongLong(value->v._signed);
+	case SNAPSHOT_VALUE_FLOAT:
+		return PyFloat_FromDouble(value->v._float);
+	case SNAPSHOT_VALUE_QUARK:
+		return python_from_string(g_quark_to_string(value->v.quark));
+	case SNAPSHOT_VALUE_STRING:
+		return PyUnicode_DecodeUTF8(base + value->v.offset, value->len,
+				"surrogateescape");
+	case SNAPSHOT_VALUE_LIST:
+	{
+		const struct snapshot_value *values =
+			(const struct snapshot_value *) (base + value->v.offset);
+
+		obj = PyList_New(value->len);
+		if (!obj)
+			return NULL;
+		for (i = 0; i < value->len; i++) {
+			item = python_from_snapshot_value(snapshot, &values[i]);
+			if (!item) {
+				Py_DECREF(obj);
+				return NULL;
+			}
+			PyList_SET_ITEM(obj, i, item);
+		}
+		return obj;
+	}
+	case SNAPSHOT_VALUE_STRUCT:
+	{
+		const struct snapshot_field *members =
+			(const struct snapshot_field *) (base + value->v.offset);
+		int ret;
+
+		obj = PyDict_New();
+		if (!obj)
+			return NULL;
+		for (i = 0; i < value->len; i++) {
+			if (!members[i].name)
+				continue;
+			item = python_from_snapshot_value(snapshot,
+					&members[i].value);
+			if (!item) {
+				Py_DECREF(obj);
+				return NULL;
+			}
+			ret = PyDict_SetItemString(obj,
+					g_quark_to_string(members[i].name), item);
+			Py_DECREF(item);
+			if (ret) {
+				Py_DECREF(obj);
+				return NULL;
+			}
+		}
+		return obj;
+	}
+	default:
+		Py_RETURN_NONE;
+	}
+}
+
+/*
+ * Field named "name" in the scopes in order, or in the scope at
+ * "scope_index" of event_scopes if it is not negative.
+ */
+static
+const struct snapshot_field *snapshot_lookup_field(
+		const struct bt_python_snapshot *snapshot, const char *name,
+		int scope_index)
+{
+	GQuark quark;
+	unsigned int i;
+
+	quark = name ? g_quark_try_string(name) : 0;
+	if (!quark)
+		return NULL;
+	for (i = 0; i < snapshot->nr_fields; i++) {
+		const struct snapshot_field *field = &snapshot->fields[i];
+
+		if (field->name != quark)
+			continue;
+		if (scope_index < 0 ? field->unique
+				: field->scope == scope_index)
+			return field;
+	}
+	return NULL;
+}
+
+static
+int snapshot_scope_index(enum bt_ctf_scope scope)
+{
+	int i;
+
+	for (i = 0; i < NR_EVENT_SCOPES; i++) {
+		if (event_scopes[i] == scope)
+			return i;
+	}
+	return -1;
+}
+
+/* Number of fields of all scopes, as _bt_python_event_len(). */
+long _bt_python_snapshot_len(const struct bt_python_snapshot *snapshot)
+{
+	return snapshot->nr_fields;
+}
+
+/*
+ * List of the unique field names in scope search order, or of the
+ * names of the fields of "scope" if it is not negative.
+ */
+PyObject *_bt_python_snapshot_keys(const struct bt_python_snapshot *snapshot,
+		int scope)
+{
+	int scope_index = scope < 0 ? -1 : snapshot_scope_index(scope);
+	PyObject *keys, *key;
+	unsigned int i;
+
+	keys = PyList_New(0);
+	if (!keys)
+		return NULL;
+	for (i = 0; i < snapshot->nr_fields; i++) {
+		const struct snapshot_field *field = &snapshot->fields[i];
+		int ret;
+
+		if (scope < 0 ? !field->unique : field->scope != scope_index)
+			continue;
+		key = python_from_string(g_quark_to_string(field->name));
+		if (!key) {
+			Py_DECREF(keys);
+			return NULL;
+		}
+		ret = PyList_Append(keys, key);
+		Py_DECREF(key);
+		if (ret) {
+			Py_DECREF(keys);
+			return NULL;
+		}
+	}
+	return keys;
+}
+
+/* List of the values of the fields named by _bt_python_snapshot_keys(). */
+PyObject *_bt_python_snapshot_values(
+		const struct bt_python_snapshot *snapshot)
+{
+	PyObject *values, *value;
+	unsigned int i;
+	int ret;
+
+	values = PyList_New(0);
+	if (!values)
+		return NULL;
+	for (i = 0; i < snapshot->nr_fields; i++) {
+		if (!snapshot->fields[i].unique)
+			continue;
+		value = python_from_snapshot_value(snapshot,
+				&snapshot->fields[i].value);
+		if (!value) {
+			Py_DECREF(values);
+			return NULL;
+		}
+		ret = PyList_Append(values, value);
+		Py_DECREF(value);
+		if (ret) {
+			Py_DECREF(values);
+			return NULL;
+		}
+	}
+	return values;
+}
+
+/* Dictionary of the fields of a snapshot, by name. */
+PyObject *_bt_python_snapshot_dict(const struct bt_python_snapshot *snapshot)
+{
+	PyObject *dict, *value;
+	unsigned int i;
+	int ret;
+
+	dict = PyDict_New();
+	if (!dict)
+		return NULL;
+	for (i = 0; i < snapshot->nr_fields; i++) {
+		const struct snapshot_field *field = &snapshot->fields[i];
+
+		if (!field->unique)
+			continue;
+		value = python_from_snapshot_value(snapshot, &field->value);
+		if (!value) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+		ret = PyDict_SetItemString(dict,
+				g_quark_to_string(field->name), value);
+		Py_DECREF(value);
+		if (ret) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+/*
+ * Value of the field named "name", searched in the scopes in order, or
+ * in "scope" if it is not negative. Raises KeyError if the snapshot has
+ * no such field.
+ */
+PyObject *_bt_python_snapshot_get_field(
+		const struct bt_python_snapshot *snapshot, const char *name,
+		int scope)
+{
+	const struct snapshot_field *field;
+	int scope_index = scope < 0 ? -1 : snapshot_scope_index(scope);
+
+	field = scope < 0 || scope_index >= 0
+		? snapshot_lookup_field(snapshot, name, scope_index) : NULL;
+	if (!field) {
+		PyErr_SetString(PyExc_KeyError, name ? name : "");
+		return NULL;
+	}
+	return python_from_snapshot_value(snapshot, &field->value);
+}
+
+int _bt_python_snapshot_has_field(const struct bt_python_snapshot *snapshot,
+		const char *name)
+{
+	return snapshot_lookup_field(snapshot, name, -1) != NULL;
+}
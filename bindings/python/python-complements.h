@@ -25,6 +25,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  */
 
+#include <Python.h>
 #include <stdio.h>
 #include <glib.h>
 #include <babeltrace/babeltrace.h>
@@ -100,3 +101,101 @@ int _bt_python_ctf_clock_set_uuid_index(struct bt_ctf_clock *clock,
 
 /* iterator */
 struct bt_iter_pos *_bt_python_create_iter_pos(void);
+
+/* event mapping */
+long _bt_python_event_len(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_keys(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_values(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_dict(const struct bt_ctf_event *event);
+PyObject *_bt_python_event_get(const struct bt_ctf_event *event,
+		const char *name);
+int _bt_python_event_has_field(const struct bt_ctf_event *event,
+		const char *name);
+
+/* field lookup, shared by the native readers */
+const struct bt_definition *_bt_python_lookup_field(
+		const struct bt_ctf_event *event,
+		const struct bt_ctf_field_key *key, int scope);
+const struct bt_definition *_bt_python_resolve_field(
+		const struct bt_definition *def);
+
+/* columnar batches */
+enum bt_python_batch_column {
+	BT_PYTHON_BATCH_TIMESTAMPS = -1,
+	BT_PYTHON_BATCH_EVENT_IDS = -2,
+	BT_PYTHON_BATCH_NAME_IDS = -3,
+};
+
+struct bt_python_batch;
+
+struct bt_python_batch *_bt_python_batch_create(void);
+void _bt_python_batch_destroy(struct bt_python_batch *batch);
+int _bt_python_batch_add_field(struct bt_python_batch *batch,
+		const char *name, int scope);
+int _bt_python_batch_read(struct bt_python_batch *batch,
+		struct bt_ctf_iter *iter, unsigned int max_events);
+PyObject *_bt_python_batch_column(struct bt_python_batch *batch,
+		int column);
+PyObject *_bt_python_batch_valid(struct bt_python_batch *batch,
+		int field);
+const char *_bt_python_batch_field_type(struct bt_python_batch *batch,
+		int field);
+unsigned int _bt_python_batch_name_count(struct bt_python_batch *batch);
+const char *_bt_python_batch_name(struct bt_python_batch *batch,
+		unsigned int index);
+
+/* native aggregation */
+enum bt_python_aggregate_op {
+	BT_PYTHON_AGGREGATE_SUM,
+	BT_PYTHON_AGGREGATE_MIN,
+	BT_PYTHON_AGGREGATE_MAX,
+	BT_PYTHON_AGGREGATE_HISTOGRAM,
+};
+
+struct bt_python_aggregate;
+
+struct bt_python_aggregate *_bt_python_aggregate_create(void);
+void _bt_python_aggregate_destroy(struct bt_python_aggregate *agg);
+int _bt_python_aggregate_add_key(struct bt_python_aggregate *agg,
+		const char *name, int scope);
+int _bt_python_aggregate_add_op(struct bt_python_aggregate *agg,
+		enum bt_python_aggregate_op op, const char *name, int scope,
+		uint64_t width);
+int _bt_python_aggregate_add_event_name(struct bt_python_aggregate *agg,
+		const char *name);
+int _bt_python_aggregate_set_time_bucket(struct bt_python_aggregate *agg,
+		uint64_t ns);
+int64_t _bt_python_aggregate_run(struct bt_python_aggregate *agg,
+		struct bt_ctf_iter *iter);
+PyObject *_bt_python_aggregate_result(struct bt_python_aggregate *agg);
+
+/* event snapshots */
+struct bt_python_snapshot_arena;
+struct bt_python_snapshot;
+
+struct bt_python_snapshot_arena *_bt_python_snapshot_arena_create(
+		size_t chunk_size);
+void _bt_python_snapshot_arena_destroy(
+		struct bt_python_snapshot_arena *arena);
+struct bt_python_snapshot *_bt_python_snapshot_create(
+		struct bt_python_snapshot_arena *arena,
+		const struct bt_ctf_event *event);
+void _bt_python_snapshot_get(struct bt_python_snapshot *snapshot);
+void _bt_python_snapshot_put(struct bt_python_snapshot *snapshot);
+const char *_bt_python_snapshot_name(
+		const struct bt_python_snapshot *snapshot);
+uint64_t _bt_python_snapshot_timestamp(
+		const struct bt_python_snapshot *snapshot);
+uint64_t _bt_python_snapshot_cycles(
+		const struct bt_python_snapshot *snapshot);
+long _bt_python_snapshot_len(const struct bt_python_snapshot *snapshot);
+PyObject *_bt_python_snapshot_keys(const struct bt_python_snapshot *snapshot,
+		int scope);
+PyObject *_bt_python_snapshot_values(
+		const struct bt_python_snapshot *snapshot);
+PyObject *_bt_python_snapshot_dict(const struct bt_python_snapshot *snapshot);
+PyObject *_bt_python_snapshot_get_field(
+		const struct bt_python_snapshot *snapshot, const char *name,
+		int scope);
+int _bt_python_snapshot_has_field(const struct bt_python_snapshot *snapshot,
+		const char *name);
@@ -27,6 +27,7 @@
 
 import babeltrace.nativebt as nbt
 import babeltrace.common as common
+import array
 import collections
 import os
 from datetime import datetime
@@ -142,7 +143,8 @@ class TraceCollection:
         may be "alive" at a given time, i.e. a user **should never**
         store a copy of the events returned by this function for
         ulterior use. Users shall make sure to copy the information
-        they need *from* an event before accessing the next one.
+        they need *from* an event before accessing the next one, for
+        example with :meth:`Event.snapshot`.
         """
 
         begin_pos_ptr = nbt._bt_python_create_iter_pos()
@@ -180,6 +182,222 @@ class TraceCollection:
         nbt._bt_iter_free_pos(begin_pos_ptr);
         nbt._bt_iter_free_pos(end_pos_ptr);
 
+    def event_batches(self, fields=(), batch_size=65536, use_numpy=None):
+        """
+        Generates the events of all the opened traces contained in this
+        trace collection, in order, as :class:`EventBatch` objects of
+        up to *batch_size* events each.
+
+        Events are decoded natively and only their timestamps, ids,
+        names and the numeric fields named in *fields* are kept, in one
+        array per column: this is much faster than reading each field
+        of each :class:`Event` of :attr:`events`.
+
+        Each element of *fields* is either a field name, searched in
+        the scopes in the same order as :class:`Event` does, or a
+        ``(name, scope)`` tuple, where *scope* is one of
+        :class:`babeltrace.common.CTFScope`'s attributes. Fields are
+        looked up once per event type and stream. Integer and
+        enumeration fields are read as integers and floating point
+        number fields as floats; other fields are marked as missing.
+
+        Columns are :class:`array.array` objects, or NumPy arrays if
+        *use_numpy* is true. By default, NumPy arrays are used when
+        NumPy is available.
+        """
+
+        if use_numpy is None or use_numpy:
+            try:
+                import numpy
+            except ImportError:
+                if use_numpy:
+                    raise
+                numpy = None
+        else:
+            numpy = None
+
+        batch_ptr = nbt._bt_python_batch_create()
+        names = []
+
+        try:
+            for field in fields:
+                if isinstance(field, tuple):
+                    name, scope = field
+                else:
+                    name, scope = field, -1
+
+                if nbt._bt_python_batch_add_field(batch_ptr, str(name),
+                                                  scope) < 0:
+                    raise ValueError("Invalid field {}".format(name))
+
+                names.append(name)
+
+            begin_pos_ptr = nbt._bt_python_create_iter_pos()
+            end_pos_ptr = nbt._bt_python_create_iter_pos()
+            begin_pos_ptr.type = nbt.SEEK_BEGIN
+            end_pos_ptr.type = nbt.SEEK_LAST
+            ctf_it_ptr = nbt._bt_ctf_iter_create(self._tc, begin_pos_ptr,
+                                                 end_pos_ptr)
+            nbt._bt_iter_free_pos(begin_pos_ptr)
+            nbt._bt_iter_free_pos(end_pos_ptr)
+
+            if ctf_it_ptr is None:
+                raise NotImplementedError("Creation of multiple iterators is unsupported.")
+
+            try:
+                while True:
+                    count = nbt._bt_python_batch_read(batch_ptr, ctf_it_ptr,
+                                                      batch_size)
+
+                    if count < 0:
+                        raise IOError("Error reading events")
+
+                    if count == 0:
+                        break
+
+                    yield EventBatch._create(batch_ptr, names, count, numpy)
+            finally:
+                nbt._bt_ctf_iter_destroy(ctf_it_ptr)
+        finally:
+            nbt._bt_python_batch_destroy(batch_ptr)
+
+    _AGGREGATE_OPS = {
+        'sum': nbt.BT_PYTHON_AGGREGATE_SUM,
+        'min': nbt.BT_PYTHON_AGGREGATE_MIN,
+        'max': nbt.BT_PYTHON_AGGREGATE_MAX,
+        'histogram': nbt.BT_PYTHON_AGGREGATE_HISTOGRAM,
+    }
+
+    def aggregate(self, group_by=(), aggregates=(), event_names=None,
+                  time_bucket=None, timestamp_begin=None,
+                  timestamp_end=None):
+        """
+        Reads the events of all the opened traces contained in this
+        trace collection natively, groups them and returns one row per
+        group, without creating any :class:`Event` object.
+
+        Events are grouped by the values of the fields named in
+        *group_by*. Each element of *group_by* is either a field name,
+        searched in the scopes in the same order as :class:`Event`
+        does, a ``(name, scope)`` tuple, where *scope* is one of
+        :class:`babeltrace.common.CTFScope`'s attributes, or ``None``
+        to group by event name. Missing key fields group as ``None``.
+
+        Each element of *aggregates* is one of:
+
+        * ``('sum', field)``
+        * ``('min', field)``
+        * ``('max', field)``
+        * ``('histogram', field, width)``: dictionary of bucket start
+          values, multiples of *width*, to numbers of values.
+
+        where *field* is a field name or a ``(name, scope)`` tuple as
+        in *group_by*. Integer, enumeration and floating point number
+        fields are aggregated; events missing the field are skipped,
+        and the sum, minimum and maximum are ``None`` when no event
+        has it.
+
+        If *event_names* is set, only the events with one of these
+        names are aggregated. If *time_bucket* is set, events are also
+        grouped by their timestamp, rounded down to a multiple of
+        *time_bucket* nanoseconds. *timestamp_begin* and
+        *timestamp_end*, in nanoseconds since Epoch, restrict the
+        events to a time range.
+
+        Returns a list of tuples made of the time bucket if
+        *time_bucket* is set, the values of the *group_by* fields, the
+        number of events of the group, then the result of each
+        element of *aggregates*. Rows are in no particular order.
+        """
+
+        def field_args(field):
+            if field is None:
+                return None, -1
+
+            if isinstance(field, tuple):
+                name, scope = field
+
+                return str(name), scope
+
+            return str(field), -1
+
+        agg_ptr = nbt._bt_python_aggregate_create()
+
+        try:
+            if time_bucket is not None:
+                if time_bucket <= 0 or \
+                        nbt._bt_python_aggregate_set_time_bucket(agg_ptr,
+                                                                 time_bucket) < 0:
+                    raise ValueError("Invalid time bucket")
+
+            for key in group_by:
+                name, scope = field_args(key)
+
+                if nbt._bt_python_aggregate_add_key(agg_ptr, name, scope) < 0:
+                    raise ValueError("Invalid key {}".format(key))
+
+            for spec in aggregates:
+                op = self._AGGREGATE_OPS.get(spec[0])
+                width = 0
+
+                if op is None:
+                    raise ValueError("Invalid aggregate {}".format(spec[0]))
+
+                if op == nbt.BT_PYTHON_AGGREGATE_HISTOGRAM:
+                    if len(spec) != 3 or spec[2] <= 0:
+                        raise ValueError("Invalid histogram width")
+
+                    width = spec[2]
+                elif len(spec) != 2:
+                    raise ValueError("Invalid aggregate {}".format(spec))
+
+                name, scope = field_args(spec[1])
+
+                if name is None or \
+                        nbt._bt_python_aggregate_add_op(agg_ptr, op, name,
+                                                        scope, width) < 0:
+                    raise ValueError("Invalid field {}".format(spec[1]))
+
+            if event_names is not None:
+                for name in event_names:
+                    nbt._bt_python_aggregate_add_event_name(agg_ptr, str(name))
+
+                if not event_names:
+                    return []
+
+            begin_pos_ptr = nbt._bt_python_create_iter_pos()
+            end_pos_ptr = nbt._bt_python_create_iter_pos()
+
+            if timestamp_begin is None:
+                begin_pos_ptr.type = nbt.SEEK_BEGIN
+            else:
+                begin_pos_ptr.type = nbt.SEEK_TIME
+                begin_pos_ptr.u.seek_time = timestamp_begin
+
+            if timestamp_end is None:
+                end_pos_ptr.type = nbt.SEEK_LAST
+            else:
+                end_pos_ptr.type = nbt.SEEK_TIME
+                end_pos_ptr.u.seek_time = timestamp_end
+
+            ctf_it_ptr = nbt._bt_ctf_iter_create(self._tc, begin_pos_ptr,
+                                                 end_pos_ptr)
+            nbt._bt_iter_free_pos(begin_pos_ptr)
+            nbt._bt_iter_free_pos(end_pos_ptr)
+
+            if ctf_it_ptr is None:
+                raise NotImplementedError("Creation of multiple iterators is unsupported.")
+
+            try:
+                if nbt._bt_python_aggregate_run(agg_ptr, ctf_it_ptr) < 0:
+                    raise IOError("Error reading events")
+            finally:
+                nbt._bt_ctf_iter_destroy(ctf_it_ptr)
+
+            return nbt._bt_python_aggregate_result(agg_ptr)
+        finally:
+            nbt._bt_python_aggregate_destroy(agg_ptr)
+
     @property
     def timestamp_begin(self):
         """
@@ -337,6 +555,9 @@ _scopes = [
     common.CTFScope.TRACE_PACKET_HEADER
 ]
 
+# Shared by all the event snapshots
+_snapshot_arena = nbt._bt_python_snapshot_arena_create(0)
+
 
 class Event(collections.Mapping):
     """
@@ -501,31 +722,21 @@ class Event(collections.Mapping):
             return trace_collection
 
     def __getitem__(self, field_name):
-        field = self._field(field_name)
+        # Raises KeyError if there is no such field
+        value = nbt._bt_python_event_get(self._e, field_name)
+        self._check_field_error()
 
-        if field is not None:
-            return field.value
-
-        raise KeyError(field_name)
+        return value
 
     def __iter__(self):
         for key in self.keys():
             yield key
 
     def __len__(self):
-        count = 0
-
-        for scope in _scopes:
-            scope_ptr = nbt._bt_ctf_get_top_level_scope(self._e, scope)
-            ret = nbt._bt_python_field_listcaller(self._e, scope_ptr)
-
-            if isinstance(ret, list):
-                count += ret[1]
-
-        return count
+        return nbt._bt_python_event_len(self._e)
 
     def __contains__(self, field_name):
-        return self._field(field_name) is not None
+        return nbt._bt_python_event_has_field(self._e, field_name) != 0
 
     def keys(self):
         """
@@ -537,13 +748,7 @@ class Event(collections.Mapping):
         of a given scope.
         """
 
-        field_names = set()
-
-        for scope in _scopes:
-            for name in self.field_list_with_scope(scope):
-                field_names.add(name)
-
-        return list(field_names)
+        return list(nbt._bt_python_event_keys(self._e))
 
     def get(self, field_name, default=None):
         """
@@ -555,13 +760,11 @@ class Event(collections.Mapping):
         scopes.
         """
 
-        field = self._field(field_name)
-
-        if field is None:
+        try:
+            return self[field_name]
+        except KeyError:
             return default
 
-        return field.value
-
     def items(self):
         """
         Generates pairs of (field name, field value).
@@ -571,8 +774,53 @@ class Event(collections.Mapping):
         their names in scopes with higher priorities.
         """
 
-        for field in self.keys():
-            yield (field, self[field])
+        for item in self.as_dict().items():
+            yield item
+
+    def values(self):
+        """
+        Returns the list of the values of the fields named by
+        :meth:`keys`, in the same order.
+        """
+
+        values = nbt._bt_python_event_values(self._e)
+        self._check_field_error()
+
+        return list(values)
+
+    def as_dict(self):
+        """
+        Returns a :class:`dict` mapping the field names returned by
+        :meth:`keys` to their values.
+
+        The whole event is converted in a single native call: this is
+        the fastest way to read most fields of an event.
+        """
+
+        fields = nbt._bt_python_event_dict(self._e)
+        self._check_field_error()
+
+        return fields
+
+    def snapshot(self):
+        """
+        Returns an :class:`EventSnapshot` object holding a copy of
+        this event, which remains valid once the next event is read.
+        """
+
+        snapshot_ptr = nbt._bt_python_snapshot_create(_snapshot_arena,
+                                                      self._e)
+
+        if snapshot_ptr is None:
+            raise ValueError("Cannot take a snapshot of this event")
+
+        return EventSnapshot._create(snapshot_ptr)
+
+    def _check_field_error(self):
+        if field_error():
+            raise FieldError(
+                "Error occurred while accessing a field of event {}".format(
+                    self.name))
 
     def _field_with_scope(self, field_name, scope):
         scope_ptr = nbt._bt_ctf_get_top_level_scope(self._e, scope)
@@ -623,6 +871,241 @@ class Event(collections.Mapping):
         return fields
 
 
+class EventSnapshot(collections.Mapping):
+    """
+    An :class:`EventSnapshot` object is an immutable copy of an
+    :class:`Event`, returned by :meth:`Event.snapshot`.
+
+    Unlike :class:`Event` objects, snapshots may be kept for as long as
+    needed, for example in a sliding window of recent events. They are
+    stored compactly in native memory, and their field values are only
+    converted to Python objects when accessed, following the same
+    scope priority and type mapping as :class:`Event`.
+    """
+
+    def __init__(self):
+        raise NotImplementedError("EventSnapshot cannot be instantiated")
+
+    @classmethod
+    def _create(cls, snapshot_ptr):
+        snapshot = cls.__new__(cls)
+        snapshot._s = snapshot_ptr
+
+        return snapshot
+
+    def __del__(self):
+        nbt._bt_python_snapshot_put(self._s)
+
+    @property
+    def name(self):
+        """
+        Event name or ``None`` on error.
+        """
+
+        return nbt._bt_python_snapshot_name(self._s)
+
+    @property
+    def cycles(self):
+        """
+        Event timestamp in cycles or -1 on error.
+        """
+
+        return nbt._bt_python_snapshot_cycles(self._s)
+
+    @property
+    def timestamp(self):
+        """
+        Event timestamp (nanoseconds since Epoch) or -1 on error.
+        """
+
+        return nbt._bt_python_snapshot_timestamp(self._s)
+
+    @property
+    def datetime(self):
+        """
+        Event timestamp as a standard :class:`datetime.datetime`
+        object.
+
+        See :attr:`Event.datetime`.
+        """
+
+        return datetime.fromtimestamp(self.timestamp / 1E9)
+
+    def field_with_scope(self, field_name, scope):
+        """
+        Returns the value of a field named *field_name* within the
+        scope *scope*, or ``None`` if the field cannot be found.
+
+        *scope* must be one of :class:`babeltrace.common.CTFScope`
+        constants.
+        """
+
+        if scope not in _scopes:
+            raise ValueError("Invalid scope provided")
+
+        try:
+            return nbt._bt_python_snapshot_get_field(self._s, field_name,
+                                                     scope)
+        except KeyError:
+            return None
+
+    def field_list_with_scope(self, scope):
+        """
+        Returns a list of field names in the scope *scope*.
+        """
+
+        if scope not in _scopes:
+            raise ValueError("Invalid scope provided")
+
+        return nbt._bt_python_snapshot_keys(self._s, scope)
+
+    def __getitem__(self, field_name):
+        # Raises KeyError if there is no such field
+        return nbt._bt_python_snapshot_get_field(self._s, field_name, -1)
+
+    def __iter__(self):
+        for key in self.keys():
+            yield key
+
+    def __len__(self):
+        return nbt._bt_python_snapshot_len(self._s)
+
+    def __contains__(self, field_name):
+        return nbt._bt_python_snapshot_has_field(self._s, field_name) != 0
+
+    def keys(self):
+        """
+        Returns the list of field names.
+
+        See :meth:`Event.keys`.
+        """
+
+        return nbt._bt_python_snapshot_keys(self._s, -1)
+
+    def get(self, field_name, default=None):
+        """
+        Returns the value of the field named *field_name*, or *default*
+        when not found.
+        """
+
+        try:
+            return self[field_name]
+        except KeyError:
+            return default
+
+    def items(self):
+        """
+        Generates pairs of (field name, field value).
+        """
+
+        for item in self.as_dict().items():
+            yield item
+
+    def values(self):
+        """
+        Returns the list of the values of the fields named by
+        :meth:`keys`, in the same order.
+        """
+
+        return nbt._bt_python_snapshot_values(self._s)
+
+    def as_dict(self):
+        """
+        Returns a :class:`dict` mapping the field names returned by
+        :meth:`keys` to their values.
+        """
+
+        return nbt._bt_python_snapshot_dict(self._s)
+
+
+_numpy_dtypes = {
+    'Q': 'uint64',
+    'q': 'int64',
+    'd': 'float64',
+    'I': 'uint32',
+    'B': 'uint8',
+}
+
+
+def _batch_column(data, typecode, numpy):
+    if numpy is not None:
+        return numpy.frombuffer(data, dtype=_numpy_dtypes[typecode])
+
+    column = array.array(typecode)
+    column.frombytes(data)
+
+    return column
+
+
+class EventBatch:
+    """
+    Columns of consecutive events, generated by
+    :meth:`TraceCollection.event_batches`.
+
+    Unlike :class:`Event` objects, batches remain valid once the next
+    batch is generated.
+    """
+
+    def __init__(self):
+        raise NotImplementedError("EventBatch cannot be instantiated")
+
+    @classmethod
+    def _create(cls, batch_ptr, field_names, count, numpy):
+        batch = cls.__new__(cls)
+        batch._count = count
+        batch.timestamps = _batch_column(
+            nbt._bt_python_batch_column(batch_ptr,
+                                        nbt.BT_PYTHON_BATCH_TIMESTAMPS),
+            'Q', numpy)
+        batch.event_ids = _batch_column(
+            nbt._bt_python_batch_column(batch_ptr,
+                                        nbt.BT_PYTHON_BATCH_EVENT_IDS),
+            'Q', numpy)
+        batch.name_ids = _batch_column(
+            nbt._bt_python_batch_column(batch_ptr,
+                                        nbt.BT_PYTHON_BATCH_NAME_IDS),
+            'I', numpy)
+        batch.names = [nbt._bt_python_batch_name(batch_ptr, i)
+                       for i in range(nbt._bt_python_batch_name_count(batch_ptr))]
+        batch.fields = {}
+        batch.valid = {}
+
+        for i, name in enumerate(field_names):
+            typecode = nbt._bt_python_batch_field_type(batch_ptr, i)
+            batch.fields[name] = _batch_column(
+                nbt._bt_python_batch_column(batch_ptr, i), typecode, numpy)
+            batch.valid[name] = _batch_column(
+                nbt._bt_python_batch_valid(batch_ptr, i), 'B', numpy)
+
+        return batch
+
+    def __len__(self):
+        return self._count
+
+    # Documentation of the columns set by _create().
+
+    #: Timestamps of the events (nanoseconds since Epoch).
+    timestamps = None
+
+    #: Numeric IDs of the events within their stream class.
+    event_ids = None
+
+    #: Indexes of the events' names in :attr:`names`.
+    name_ids = None
+
+    #: Names of the events, indexed by :attr:`name_ids`, for all the
+    #: batches read so far.
+    names = None
+
+    #: Dictionary of the selected fields' values, by field name. The
+    #: value of a field is 0 in the events without it.
+    fields = None
+
+    #: Dictionary of arrays, by field name, with 1 for the events with
+    #: the field and 0 for the others.
+    valid = None
+
+
 class FieldError(Exception):
     """
     Field error, raised when the value of a field cannot be accessed.
@@ -1627,6 +1627,25 @@ class EventClass:
 
         return FieldDeclaration._create_field_declaration_from_native_instance(field_type_native)
 
+    def get_field_index(self, name):
+        """
+        Returns the index of the field named *name* in this event class.
+
+        The returned index may be resolved once and then used with
+        :meth:`Event.set_payload_integer` to set field values without
+        looking fields up by name on every event.
+
+        :exc:`TypeError` is raised on error.
+        """
+
+        ret = nbt._bt_ctf_event_class_get_field_index(self._ec, str(name))
+
+        if ret < 0:
+            msg = "Could not find EventClass field with name {}".format(name)
+            raise TypeError(msg)
+
+        return ret
+
 
 class Event:
     """
@@ -1744,6 +1763,48 @@ class Event:
         if ret < 0:
             raise ValueError("Could not set event field payload.")
 
+    def set_payload_integer(self, index, value):
+        """
+        Sets the value of the event's integer field at index *index*
+        to *value*.
+
+        *index* may be obtained once using
+        :meth:`EventClass.get_field_index`. This is faster than
+        getting the field with :meth:`payload` and setting its value.
+
+        :exc:`ValueError` is raised on error.
+        """
+
+        if value < 0:
+            ret = nbt._bt_ctf_event_set_payload_signed_integer(self._e,
+                                                                index, value)
+        else:
+            ret = nbt._bt_ctf_event_set_payload_unsigned_integer(self._e,
+                                                                  index, value)
+
+            if ret < 0:
+                # positive value in a signed integer field
+                ret = nbt._bt_ctf_event_set_payload_signed_integer(self._e,
+                                                                    index,
+                                                                    value)
+
+        if ret < 0:
+            raise ValueError("Could not set event integer field payload.")
+
+    def set_payload_integers(self, values):
+        """
+        Sets the values of the event's integer fields, in declaration
+        order, to the integers of the sequence *values* in a single
+        call. Fields which are not integers are skipped.
+
+        :exc:`ValueError` is raised on error.
+        """
+
+        ret = nbt._bt_ctf_event_set_payload_integers(self._e, values)
+
+        if ret < 0:
+            raise ValueError("Could not set event integer fields payload.")
+
 
 class StreamClass:
     """
@@ -34,6 +34,7 @@
 #include <babeltrace/ctf/events.h>
 /* TODO: fix object model for format-agnostic callbacks */
 #include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/ctf/metadata.h>
 #include <babeltrace/ctf/iterator.h>
 #include <babeltrace/ctf-text/types.h>
 #include <babeltrace/iterator.h>
@@ -101,6 +102,7 @@ enum {
 	OPT_CLOCK_DATE,
 	OPT_CLOCK_GMT,
 	OPT_CLOCK_FORCE_CORRELATE,
+	OPT_VERIFY,
 };
 
 /*
@@ -130,6 +132,7 @@ static struct poptOption long_options[] = {
 	{ "clock-date", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_DATE, NULL, NULL },
 	{ "clock-gmt", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_GMT, NULL, NULL },
 	{ "clock-force-correlate", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_FORCE_CORRELATE, NULL, NULL },
+	{ "verify", 0, POPT_ARG_NONE, NULL, OPT_VERIFY, NULL, NULL },
 	{ NULL, 0, 0, NULL, 0, NULL, NULL },
 };
 
@@ -175,6 +178,8 @@ static void usage(FILE *fp)
 	fprintf(fp, "      --clock-gmt                Print clock in GMT time zone (default: local time zone)\n");
 	fprintf(fp, "      --clock-force-correlate    Assume that clocks are inherently correlated\n");
 	fprintf(fp, "                                 across traces.\n");
+	fprintf(fp, "      --verify                   Check the packets of each stream and print a\n");
+	fprintf(fp, "                                 health report instead of the events\n");
 	list_formats(fp);
 	fprintf(fp, "\n");
 }
@@ -394,6 +399,9 @@ static int parse_options(int argc, char **argv)
 		case OPT_CLOCK_FORCE_CORRELATE:
 			opt_clock_force_correlate = 1;
 			break;
+		case OPT_VERIFY:
+			babeltrace_ctf_verify = 1;
+			break;
 
 		default:
 			ret = -EINVAL;
@@ -517,27 +525,38 @@ int bt_context_add_traces_recursive(struct bt_context *ctx, const char *path,
 
 	/* Process the array if ntfw did not return a fatal error */
 	if (ret >= 0) {
+		const char **paths;
+		int *handle_ids;
 		int i;
 
+		paths = g_new0(const char *, traversed_paths->len);
+		handle_ids = g_new0(int, traversed_paths->len);
+		for (i = 0; i < traversed_paths->len; i++) {
+			GString *trace_path = g_ptr_array_index(traversed_paths,
+								i);
+
+			paths[i] = trace_path->str;
+		}
+		/* Traces are opened concurrently, added in traversal order. */
+		trace_ids = bt_context_add_traces(ctx, paths,
+				traversed_paths->len, format_str,
+				packet_seek, handle_ids);
+		if (trace_ids < 0)
+			trace_ids = 0;
 		for (i = 0; i < traversed_paths->len; i++) {
 			GString *trace_path = g_ptr_array_index(traversed_paths,
 								i);
-			int trace_id = bt_context_add_trace(ctx,
-							    trace_path->str,
-							    format_str,
-							    packet_seek,
-							    NULL,
-							    NULL);
-			if (trace_id < 0) {
+
+			if (handle_ids[i] < 0) {
 				fprintf(stderr, "[warning] [Context] cannot open trace \"%s\" from %s "
 					"for reading.\n", trace_path->str, path);
 				/* Allow to skip erroneous traces. */
 				ret = 1;	/* partial error */
-			} else {
-				trace_ids++;
 			}
 			g_string_free(trace_path, TRUE);
 		}
+		g_free(handle_ids);
+		g_free(paths);
 	}
 
 	g_ptr_array_free(traversed_paths, TRUE);
@@ -655,6 +674,27 @@ error_iter:
 	return ret;
 }
 
+/*
+ * Print the health report of each trace, from the packet headers and
+ * contexts only. Return the number of traces with problems.
+ */
+static
+int verify_traces(struct bt_context *ctx)
+{
+	struct trace_collection *tc = ctx->tc;
+	int i, ret, nr_failed = 0;
+
+	for (i = 0; i < tc->array->len; i++) {
+		struct bt_trace_descriptor *td =
+			g_ptr_array_index(tc->array, i);
+
+		ret = ctf_verify_trace(stdout, td);
+		if (ret)
+			nr_failed++;
+	}
+	return nr_failed;
+}
+
 int main(int argc, char **argv)
 {
 	int ret, partial_error = 0, open_success = 0;
@@ -716,6 +756,12 @@ int main(int argc, char **argv)
 		partial_error = 1;
 		goto end;
 	}
+	if (babeltrace_ctf_verify
+			&& fmt_read->name != g_quark_from_static_string("ctf")) {
+		fprintf(stderr, "[error] Only ctf traces can be verified.\n\n");
+		partial_error = 1;
+		goto end;
+	}
 	fmt_write = bt_lookup_format(g_quark_from_static_string(opt_output_format));
 	if (!fmt_write) {
 		fprintf(stderr, "[error] format \"%s\" is not supported.\n\n",
@@ -724,6 +770,24 @@ int main(int argc, char **argv)
 		goto end;
 	}
 
+	/*
+	 * The relay daemons of several lttng-live URLs are followed by
+	 * one viewer, which merges their sessions.
+	 */
+	if (fmt_read->name == g_quark_from_static_string("lttng-live")
+			&& opt_input_paths->len > 1) {
+		GString *urls = g_string_new(NULL);
+
+		for (i = 0; i < opt_input_paths->len; i++) {
+			if (i)
+				g_string_append_c(urls, ',');
+			g_string_append(urls,
+				g_ptr_array_index(opt_input_paths, i));
+		}
+		g_ptr_array_set_size(opt_input_paths, 0);
+		g_ptr_array_add(opt_input_paths, g_string_free(urls, FALSE));
+	}
+
 	ctx = bt_context_create();
 	if (!ctx) {
 		goto error_td_read;
@@ -750,6 +814,13 @@ int main(int argc, char **argv)
 		goto error_td_read;
 	}
 
+	if (babeltrace_ctf_verify) {
+		if (verify_traces(ctx))
+			partial_error = 1;
+		bt_context_put(ctx);
+		goto end;
+	}
+
 	td_write = fmt_write->open_trace(opt_output_path, O_RDWR, NULL, NULL);
 	if (!td_write) {
 		fprintf(stderr, "Error opening trace \"%s\" for writing.\n\n",
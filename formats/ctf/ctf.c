@@ -32,6 +32,8 @@
 #include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/ctf/events-internal.h>
 #include <babeltrace/trace-handle-internal.h>
+#include <babeltrace/parallel-internal.h>
+#include <babeltrace/arena-internal.h>
 #include <babeltrace/context-internal.h>
 #include <babeltrace/compat/uuid.h>
 #include <babeltrace/endian.h>
@@ -92,6 +94,13 @@ extern int yydebug;
  */
 int babeltrace_ctf_console_output;
 
+/*
+ * Verify mode (babeltrace --verify): stream packet indexes are always
+ * built from the packet headers, and truncated packets are recorded
+ * for ctf_verify_trace() instead of failing the trace open.
+ */
+int babeltrace_ctf_verify;
+
 static
 struct bt_trace_descriptor *ctf_open_trace(const char *path, int flags,
 		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
@@ -113,6 +122,8 @@ void ctf_set_handle(struct bt_trace_descriptor *descriptor,
 static
 int ctf_close_trace(struct bt_trace_descriptor *descriptor);
 static
+int ctf_close_file_stream(struct ctf_file_stream *file_stream);
+static
 uint64_t ctf_timestamp_begin(struct bt_trace_descriptor *descriptor,
 		struct bt_trace_handle *handle, enum bt_clock_type type);
 static
@@ -182,7 +193,7 @@ uint64_t ctf_timestamp_begin(struct bt_trace_descriptor *descriptor,
 			struct ctf_stream_definition *stream;
 			struct ctf_file_stream *cfs;
 			struct ctf_stream_pos *stream_pos;
-			struct packet_index *index;
+			struct packet_index index;
 
 			stream = g_ptr_array_index(stream_class->streams, j);
 			cfs = container_of(stream, struct ctf_file_stream,
@@ -195,15 +206,15 @@ uint64_t ctf_timestamp_begin(struct bt_trace_descriptor *descriptor,
 			if (stream_pos->packet_index->len <= 0)
 				continue;
 
-			index = &g_array_index(stream_pos->packet_index,
-					struct packet_index,
-					stream_pos->packet_index->len - 1);
+			ctf_packet_index_get(stream_pos->packet_index,
+					stream_pos->packet_index->len - 1,
+					&index);
 			if (type == BT_CLOCK_REAL) {
-				if (index->ts_real.timestamp_begin < begin)
-					begin = index->ts_real.timestamp_begin;
+				if (index.ts_real.timestamp_begin < begin)
+					begin = index.ts_real.timestamp_begin;
 			} else if (type == BT_CLOCK_CYCLES) {
-				if (index->ts_cycles.timestamp_begin < begin)
-					begin = index->ts_cycles.timestamp_begin;
+				if (index.ts_cycles.timestamp_begin < begin)
+					begin = index.ts_cycles.timestamp_begin;
 			} else {
 				goto error;
 			}
@@ -241,7 +252,7 @@ uint64_t ctf_timestamp_end(struct bt_trace_descriptor *descriptor,
 			struct ctf_stream_definition *stream;
 			struct ctf_file_stream *cfs;
 			struct ctf_stream_pos *stream_pos;
-			struct packet_index *index;
+			struct packet_index index;
 
 			stream = g_ptr_array_index(stream_class->streams, j);
 			cfs = container_of(stream, struct ctf_file_stream,
@@ -254,15 +265,15 @@ uint64_t ctf_timestamp_end(struct bt_trace_descriptor *descriptor,
 			if (stream_pos->packet_index->len <= 0)
 				continue;
 
-			index = &g_array_index(stream_pos->packet_index,
-					struct packet_index,
-					stream_pos->packet_index->len - 1);
+			ctf_packet_index_get(stream_pos->packet_index,
+					stream_pos->packet_index->len - 1,
+					&index);
 			if (type == BT_CLOCK_REAL) {
-				if (index->ts_real.timestamp_end > end)
-					end = index->ts_real.timestamp_end;
+				if (index.ts_real.timestamp_end > end)
+					end = index.ts_real.timestamp_end;
 			} else if (type == BT_CLOCK_CYCLES) {
-				if (index->ts_cycles.timestamp_end > end)
-					end = index->ts_cycles.timestamp_end;
+				if (index.ts_cycles.timestamp_end > end)
+					end = index.ts_cycles.timestamp_end;
 			} else {
 				goto error;
 			}
@@ -759,9 +770,11 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 		int fd, int open_flags)
 {
 	pos->fd = fd;
+	pos->fd_pooled = 0;
+	pos->fd_pinned = 0;
+	BT_INIT_LIST_HEAD(&pos->fd_node);
 	if (fd >= 0) {
-		pos->packet_index = g_array_new(FALSE, TRUE,
-				sizeof(struct packet_index));
+		pos->packet_index = ctf_packet_index_table_new();
 	} else {
 		pos->packet_index = NULL;
 	}
@@ -801,8 +814,7 @@ int ctf_fini_pos(struct ctf_stream_pos *pos)
 			return -1;
 		}
 	}
-	if (pos->packet_index)
-		(void) g_array_free(pos->packet_index, TRUE);
+	ctf_packet_index_table_free(pos->packet_index);
 	return 0;
 }
 
@@ -878,7 +890,7 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 	struct ctf_file_stream *file_stream =
 		container_of(pos, struct ctf_file_stream, pos);
 	int ret;
-	struct packet_index *packet_index, *prev_index;
+	struct packet_index packet_index, prev_packet_index, *prev_index;
 
 	switch (whence) {
 	case SEEK_CUR:
@@ -951,22 +963,22 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 			assert(0);
 		}
 
-		packet_index = &g_array_index(pos->packet_index,
-				struct packet_index, pos->cur_index);
+		if (pos->cur_index >= pos->packet_index->len) {
+			pos->offset = EOF;
+			return;
+		}
+
+		ctf_packet_index_get(pos->packet_index, pos->cur_index,
+				&packet_index);
 		if (pos->cur_index > 0) {
-			prev_index = &g_array_index(pos->packet_index,
-					struct packet_index,
-					pos->cur_index - 1);
+			ctf_packet_index_get(pos->packet_index,
+					pos->cur_index - 1, &prev_packet_index);
+			prev_index = &prev_packet_index;
 		} else {
 			prev_index = NULL;
 		}
 		ctf_update_current_packet_index(&file_stream->parent,
-				prev_index, packet_index);
-
-		if (pos->cur_index >= pos->packet_index->len) {
-			pos->offset = EOF;
-			return;
-		}
+				prev_index, &packet_index);
 
 		/*
 		 * We need to check if we are in trace read or called
@@ -978,29 +990,34 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 			ctf_print_discarded_lost(stderr, &file_stream->parent);
 		}
 
-		packet_index = &g_array_index(pos->packet_index,
-				struct packet_index,
-				pos->cur_index);
-		file_stream->parent.cycles_timestamp = packet_index->ts_cycles.timestamp_begin;
+		file_stream->parent.cycles_timestamp = packet_index.ts_cycles.timestamp_begin;
 
-		file_stream->parent.real_timestamp = packet_index->ts_real.timestamp_begin;
+		file_stream->parent.real_timestamp = packet_index.ts_real.timestamp_begin;
 
 		/* Lookup context/packet size in index */
-		if (packet_index->data_offset == -1) {
-			ret = find_data_offset(pos, file_stream, packet_index);
+		if (packet_index.data_offset == -1) {
+			ret = ctf_fd_pool_get(pos);
 			if (ret < 0) {
+				pos->offset = EOF;
 				return;
 			}
-		}
-		pos->content_size = packet_index->content_size;
-		pos->packet_size = packet_index->packet_size;
-		pos->mmap_offset = packet_index->offset;
-		pos->data_offset = packet_index->data_offset;
-		if (pos->data_offset < packet_index->content_size) {
+			ret = find_data_offset(pos, file_stream, &packet_index);
+			ctf_fd_pool_put(pos);
+			if (ret < 0) {
+				return;
+			}
+			ctf_packet_index_set(pos->packet_index, pos->cur_index,
+					&packet_index);
+		}
+		pos->content_size = packet_index.content_size;
+		pos->packet_size = packet_index.packet_size;
+		pos->mmap_offset = packet_index.offset;
+		pos->data_offset = packet_index.data_offset;
+		if (pos->data_offset < packet_index.content_size) {
 			pos->offset = 0;	/* will read headers */
-		} else if (pos->data_offset == packet_index->content_size) {
+		} else if (pos->data_offset == packet_index.content_size) {
 			/* empty packet */
-			pos->offset = packet_index->data_offset;
+			pos->offset = packet_index.data_offset;
 			whence = SEEK_CUR;
 			goto read_next_packet;
 		} else {
@@ -1009,6 +1026,11 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 		}
 	}
 	/* map new base. Need mapping length from header. */
+	ret = ctf_fd_pool_get(pos);
+	if (ret < 0) {
+		pos->offset = EOF;
+		return;
+	}
 	pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
 			pos->flags, pos->fd, pos->mmap_offset);
 	if (pos->base_mma == MAP_FAILED) {
@@ -1016,6 +1038,7 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 			strerror(errno));
 		assert(0);
 	}
+	ctf_fd_pool_put(pos);
 
 	/* update trace_packet_header and stream_packet_context */
 	if (!(pos->prot & PROT_WRITE) &&
@@ -1084,54 +1107,67 @@ warning:
 	return 0;
 }
 
+/*
+ * Convert a metadata packet header to native byte order and validate
+ * it against the trace.
+ */
 static
-int ctf_trace_metadata_packet_read(struct ctf_trace *td, FILE *in,
-					FILE *out)
+int ctf_trace_metadata_packet_header_check(struct ctf_trace *td,
+		struct metadata_packet_header *header)
 {
-	struct metadata_packet_header header;
-	size_t readlen, writelen, toread;
-	char buf[4096 + 1];	/* + 1 for debug-mode \0 */
-	int ret = 0;
-
-	readlen = fread(&header, header_sizeof(header), 1, in);
-	if (readlen < 1)
-		return -EINVAL;
-
 	if (td->byte_order != BYTE_ORDER) {
-		header.magic = GUINT32_SWAP_LE_BE(header.magic);
-		header.checksum = GUINT32_SWAP_LE_BE(header.checksum);
-		header.content_size = GUINT32_SWAP_LE_BE(header.content_size);
-		header.packet_size = GUINT32_SWAP_LE_BE(header.packet_size);
+		header->magic = GUINT32_SWAP_LE_BE(header->magic);
+		header->checksum = GUINT32_SWAP_LE_BE(header->checksum);
+		header->content_size = GUINT32_SWAP_LE_BE(header->content_size);
+		header->packet_size = GUINT32_SWAP_LE_BE(header->packet_size);
 	}
-	if (header.checksum)
+	if (header->checksum)
 		fprintf(stderr, "[warning] checksum verification not supported yet.\n");
-	if (header.compression_scheme) {
+	if (header->compression_scheme) {
 		fprintf(stderr, "[error] compression (%u) not supported yet.\n",
-			header.compression_scheme);
+			header->compression_scheme);
 		return -EINVAL;
 	}
-	if (header.encryption_scheme) {
+	if (header->encryption_scheme) {
 		fprintf(stderr, "[error] encryption (%u) not supported yet.\n",
-			header.encryption_scheme);
+			header->encryption_scheme);
 		return -EINVAL;
 	}
-	if (header.checksum_scheme) {
+	if (header->checksum_scheme) {
 		fprintf(stderr, "[error] checksum (%u) not supported yet.\n",
-			header.checksum_scheme);
+			header->checksum_scheme);
 		return -EINVAL;
 	}
-	if (check_version(header.major, header.minor) < 0)
+	if (check_version(header->major, header->minor) < 0)
 		return -EINVAL;
 	if (!CTF_TRACE_FIELD_IS_SET(td, uuid)) {
-		memcpy(td->uuid, header.uuid, sizeof(header.uuid));
+		memcpy(td->uuid, header->uuid, sizeof(header->uuid));
 		CTF_TRACE_SET_FIELD(td, uuid);
 	} else {
-		if (bt_uuid_compare(header.uuid, td->uuid))
+		if (bt_uuid_compare(header->uuid, td->uuid))
 			return -EINVAL;
 	}
 
-	if ((header.content_size / CHAR_BIT) < header_sizeof(header))
+	if ((header->content_size / CHAR_BIT) < header_sizeof(*header))
 		return -EINVAL;
+	return 0;
+}
+
+static
+int ctf_trace_metadata_packet_read(struct ctf_trace *td, FILE *in,
+					FILE *out)
+{
+	struct metadata_packet_header header;
+	size_t readlen, writelen, toread;
+	char buf[4096 + 1];	/* + 1 for debug-mode \0 */
+	int ret = 0;
+
+	readlen = fread(&header, header_sizeof(header), 1, in);
+	if (readlen < 1)
+		return -EINVAL;
+	ret = ctf_trace_metadata_packet_header_check(td, &header);
+	if (ret)
+		return ret;
 
 	toread = (header.content_size / CHAR_BIT) - header_sizeof(header);
 
@@ -1234,13 +1270,226 @@ int ctf_trace_metadata_stream_read(struct ctf_trace *td, FILE **fp,
 	return 0;
 }
 
+/*
+ * Read the whole text-only metadata in memory, so that it can be
+ * hashed for the metadata cache, and reopen it for the parser.
+ */
+static
+int ctf_trace_metadata_text_read(FILE **fp, char **buf)
+{
+	FILE *in, *out;
+	size_t size, buflen, readlen;
+	char chunk[4096];
+	int ret = 0, closeret;
+
+	in = *fp;
+	out = babeltrace_open_memstream(buf, &size);
+	if (out == NULL) {
+		perror("Metadata open_memstream");
+		return -errno;
+	}
+	while ((readlen = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+		if (fwrite(chunk, 1, readlen, out) < readlen) {
+			ret = -EIO;
+			break;
+		}
+	}
+	if (ferror(in))
+		ret = -EIO;
+	closeret = babeltrace_close_memstream(buf, &size, out);
+	if (closeret < 0) {
+		perror("babeltrace_flush_memstream");
+		ret = -errno;
+	}
+	closeret = fclose(in);
+	if (closeret) {
+		perror("Error in fclose");
+	}
+	if (ret) {
+		*fp = NULL;
+		return ret;
+	}
+	buflen = strlen(*buf);
+	if (!buflen) {
+		*fp = NULL;
+		return -ENOENT;
+	}
+	*fp = babeltrace_fmemopen(*buf, buflen, "rb");
+	if (!*fp) {
+		perror("Metadata fmemopen");
+		return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Unpack the content of the packetized metadata found in the "size"
+ * bytes at "base" into "out", which must hold at least "size" bytes.
+ */
+static
+int ctf_trace_metadata_packets_unpack(struct ctf_trace *td,
+		const char *base, size_t size, char *out, size_t *out_len)
+{
+	struct metadata_packet_header header;
+	size_t offset = 0, len = 0, content_len, packet_len;
+	int ret;
+
+	while (offset < size) {
+		if (size - offset < header_sizeof(header))
+			return -EINVAL;
+		memcpy(&header, base + offset, header_sizeof(header));
+		ret = ctf_trace_metadata_packet_header_check(td, &header);
+		if (ret)
+			return ret;
+		content_len = header.content_size / CHAR_BIT;
+		packet_len = header.packet_size / CHAR_BIT;
+		if (content_len > size - offset)
+			return -EINVAL;
+		memcpy(out + len, base + offset + header_sizeof(header),
+			content_len - header_sizeof(header));
+		if (babeltrace_debug) {
+			fprintf(stderr, "[debug] metadata packet read: %.*s\n",
+				(int) (content_len - header_sizeof(header)),
+				out + len);
+		}
+		len += content_len - header_sizeof(header);
+		if (packet_len < content_len || packet_len > size - offset) {
+			fprintf(stderr, "[warning] Missing padding at end of file\n");
+			break;
+		}
+		offset += packet_len;
+	}
+	*out_len = len;
+	return 0;
+}
+
+/*
+ * Map the on-disk metadata and return its text followed by the two
+ * '\0' bytes yy_scan_buffer() expects, so the scanner can read it
+ * without going through stdio.
+ *
+ * The file is privately mapped over a zeroed anonymous area with room
+ * for the trailing '\0' bytes: text-only metadata is then scanned in
+ * place. Packetized metadata is unpacked straight
+ * from the mapping into td->metadata_string, and the mapping is
+ * released right away. Otherwise, the caller unmaps *map_len bytes
+ * at *map once done with the text.
+ */
+static
+int ctf_trace_metadata_map(struct ctf_trace *td, int fd, int append,
+		char **text, size_t *text_len, void **map, size_t *map_len)
+{
+	struct stat sb;
+	char *base, *buf = NULL;
+	size_t size, len, area_len;
+	uint32_t magic = 0;
+	int ret = 0;
+
+	if (fstat(fd, &sb) < 0) {
+		perror("Metadata fstat");
+		return -errno;
+	}
+	size = sb.st_size;
+	if (!size)
+		return -ENOENT;
+	area_len = ALIGN(size + 2, PAGE_SIZE);
+	base = mmap(NULL, area_len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		perror("Metadata mmap");
+		return -errno;
+	}
+	if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+			fd, 0) == MAP_FAILED) {
+		perror("Metadata mmap");
+		ret = -errno;
+		goto error;
+	}
+
+	if (size >= sizeof(magic))
+		memcpy(&magic, base, sizeof(magic));
+	if (magic == TSDL_MAGIC
+			|| magic == GUINT32_SWAP_LE_BE(TSDL_MAGIC)) {
+		if (magic == TSDL_MAGIC)
+			td->byte_order = BYTE_ORDER;
+		else
+			td->byte_order = (BYTE_ORDER == BIG_ENDIAN) ?
+						LITTLE_ENDIAN : BIG_ENDIAN;
+		CTF_TRACE_SET_FIELD(td, byte_order);
+		buf = malloc(size + 2);
+		if (!buf) {
+			ret = -ENOMEM;
+			goto error;
+		}
+		ret = ctf_trace_metadata_packets_unpack(td, base, size,
+				buf, &len);
+		if (ret)
+			goto error;
+		buf[len] = '\0';
+		len = strlen(buf);
+		if (!len) {
+			ret = -ENOENT;
+			goto error;
+		}
+		buf[len + 1] = '\0';
+		if (munmap(base, area_len)) {
+			perror("Metadata munmap");
+		}
+		td->metadata_string = buf;
+		td->metadata_packetized = 1;
+		*text = buf;
+		*text_len = len;
+		*map = NULL;
+		*map_len = 0;
+		return 0;
+	}
+
+	len = strlen(base);
+	if (!len) {
+		ret = -ENOENT;
+		goto error;
+	}
+	base[len + 1] = '\0';
+	if (!append) {
+		unsigned int major, minor;
+		ssize_t nr_items;
+
+		td->byte_order = BYTE_ORDER;
+
+		/* Check text-only metadata header and version */
+		nr_items = sscanf(base, "/* CTF %10u.%10u", &major, &minor);
+		if (nr_items < 2)
+			fprintf(stderr, "[warning] Ill-shapen or missing \"/* CTF x.y\" header for text-only metadata.\n");
+		if (check_version(major, minor) < 0) {
+			ret = -EINVAL;
+			goto error;
+		}
+	}
+	*text = base;
+	*text_len = len;
+	*map = base;
+	*map_len = area_len;
+	return 0;
+
+error:
+	free(buf);
+	if (munmap(base, area_len)) {
+		perror("Metadata munmap");
+	}
+	return ret;
+}
+
 static
 int ctf_trace_metadata_read(struct ctf_trace *td, FILE *metadata_fp,
 		struct ctf_scanner *scanner, int append)
 {
 	struct ctf_file_stream *metadata_stream;
-	FILE *fp;
-	char *buf = NULL;
+	FILE *fp = NULL;
+	char *buf = NULL, *text_buf = NULL, *map_text = NULL;
+	const char *cache_dir = NULL, *text = NULL;
+	struct bt_arena *prev_arena;
+	void *map = NULL;
+	size_t text_len = 0, map_len = 0;
 	int ret = 0, closeret;
 
 	metadata_stream = g_new0(struct ctf_file_stream, 1);
@@ -1257,21 +1506,22 @@ int ctf_trace_metadata_read(struct ctf_trace *td, FILE *metadata_fp,
 			ret = -1;
 			goto end_free;
 		}
-
-		fp = fdopen(metadata_stream->pos.fd, "r");
-		if (!fp) {
-			fprintf(stderr, "[error] Unable to open metadata stream.\n");
-			perror("Metadata stream open");
-			ret = -errno;
-			goto end_stream;
-		}
-		/* fd now belongs to fp */
-		metadata_stream->pos.fd = -1;
 	}
 	if (babeltrace_debug)
 		yydebug = 1;
 
-	if (packet_metadata(td, fp)) {
+	if (!fp) {
+		/*
+		 * On-disk metadata is mapped and handed to the scanner
+		 * as a single buffer.
+		 */
+		ret = ctf_trace_metadata_map(td, metadata_stream->pos.fd,
+				append, &map_text, &text_len, &map, &map_len);
+		if (ret) {
+			fprintf(stderr, "[error] Unable to read metadata.\n");
+			goto end;
+		}
+	} else if (packet_metadata(td, fp)) {
 		ret = ctf_trace_metadata_stream_read(td, &fp, &buf);
 		if (ret) {
 			goto end;
@@ -1297,7 +1547,42 @@ int ctf_trace_metadata_read(struct ctf_trace *td, FILE *metadata_fp,
 		}
 	}
 
-	ret = ctf_scanner_append_ast(scanner, fp);
+	/*
+	 * Metadata interning and the compiled metadata cache are only
+	 * used when no incremental append can follow, since appends
+	 * need the AST and the declaration scopes.
+	 */
+	if (!append && !td->scanner) {
+		if (map_text) {
+			text = map_text;
+		} else if (td->metadata_packetized) {
+			text = td->metadata_string;
+			text_len = strlen(text);
+		} else {
+			ret = ctf_trace_metadata_text_read(&fp, &text_buf);
+			if (ret) {
+				goto end;
+			}
+			text = text_buf;
+			text_len = strlen(text);
+		}
+		if (!ctf_metadata_intern_get(td, text, text_len)) {
+			goto end;
+		}
+		cache_dir = getenv("BABELTRACE_METADATA_CACHE");
+		if (cache_dir && cache_dir[0] == '\0') {
+			cache_dir = NULL;
+		}
+		if (cache_dir && !ctf_metadata_cache_load(td, cache_dir,
+				text, text_len)) {
+			goto intern;
+		}
+	}
+
+	if (map_text)
+		ret = ctf_scanner_append_ast_buffer(scanner, map_text, text_len);
+	else
+		ret = ctf_scanner_append_ast(scanner, fp);
 	if (ret) {
 		fprintf(stderr, "[error] Error creating AST\n");
 		goto end;
@@ -1314,14 +1599,42 @@ int ctf_trace_metadata_read(struct ctf_trace *td, FILE *metadata_fp,
 	ret = ctf_visitor_semantic_check(stderr, 0, &scanner->ast->root);
 	if (ret) {
 		fprintf(stderr, "[error] Error in CTF semantic validation %d\n", ret);
+		/* Don't check the invalid nodes again on the next append. */
+		if (append)
+			ctf_scanner_commit_ast(scanner);
 		goto end;
 	}
+	/* Declarations live as long as the trace metadata. */
+	if (!td->declaration_arena)
+		td->declaration_arena = bt_arena_create();
+	prev_arena = bt_declaration_set_arena(td->declaration_arena);
 	ret = ctf_visitor_construct_metadata(stderr, 0, &scanner->ast->root,
 			td, td->byte_order);
+	(void) bt_declaration_set_arena(prev_arena);
+	/*
+	 * Only the top-level nodes appended by the next read need to be
+	 * validated and constructed. The nodes of a failed append are
+	 * committed as well: what they registered before the failure is
+	 * kept, and constructing them again would fail on duplicates.
+	 */
+	if (!ret || append)
+		ctf_scanner_commit_ast(scanner);
 	if (ret) {
 		fprintf(stderr, "[error] Error in CTF metadata constructor %d\n", ret);
 		goto end;
 	}
+	if (cache_dir) {
+		/* Best effort: the trace is usable without the cache. */
+		if (ctf_metadata_cache_store(td, cache_dir, text, text_len)) {
+			fprintf(stderr, "[warning] Unable to store metadata cache in \"%s\".\n",
+				cache_dir);
+		}
+	}
+intern:
+	if (text) {
+		/* Best effort as well: sharing only saves memory and time. */
+		(void) ctf_metadata_intern_add(td, text, text_len);
+	}
 end:
 	if (fp) {
 		closeret = fclose(fp);
@@ -1329,7 +1642,13 @@ end:
 			perror("Error on fclose");
 		}
 	}
-end_stream:
+	free(text_buf);
+	if (map) {
+		closeret = munmap(map, map_len);
+		if (closeret) {
+			perror("Error on metadata munmap");
+		}
+	}
 	if (metadata_stream->pos.fd >= 0) {
 		closeret = close(metadata_stream->pos.fd);
 		if (closeret) {
@@ -1342,6 +1661,19 @@ end_free:
 	return ret;
 }
 
+/*
+ * Allocate the definitions of a stream from its own arena, released
+ * with the stream. Returns the arena to restore afterwards.
+ */
+static
+struct bt_arena *stream_definition_arena_enter(
+		struct ctf_stream_definition *stream)
+{
+	if (!stream->definition_arena)
+		stream->definition_arena = bt_arena_create();
+	return bt_definition_set_arena(stream->definition_arena);
+}
+
 static
 struct ctf_event_definition *create_event_definitions(struct ctf_trace *td,
 						  struct ctf_stream_definition *stream,
@@ -1389,9 +1721,11 @@ int copy_event_declarations_stream_class_to_stream(struct ctf_trace *td,
 		struct ctf_stream_declaration *stream_class,
 		struct ctf_stream_definition *stream)
 {
+	struct bt_arena *prev_arena;
 	size_t def_size, class_size, i;
 	int ret = 0;
 
+	prev_arena = stream_definition_arena_enter(stream);
 	def_size = stream->events_by_id->len;
 	class_size = stream_class->events_by_id->len;
 
@@ -1411,6 +1745,7 @@ int copy_event_declarations_stream_class_to_stream(struct ctf_trace *td,
 		g_ptr_array_index(stream->events_by_id, i) = stream_event;
 	}
 error:
+	(void) bt_definition_set_arena(prev_arena);
 	return ret;
 }
 
@@ -1418,6 +1753,7 @@ static
 int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition *stream)
 {
 	struct ctf_stream_declaration *stream_class;
+	struct bt_arena *prev_arena;
 	int ret;
 	int i;
 
@@ -1425,6 +1761,7 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 		return 0;
 
 	stream_class = stream->stream_class;
+	prev_arena = stream_definition_arena_enter(stream);
 
 	if (stream_class->packet_context_decl) {
 		struct bt_definition *definition =
@@ -1467,6 +1804,7 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 			stream_class, stream);
 	if (ret)
 		goto error_event;
+	(void) bt_definition_set_arena(prev_arena);
 	return 0;
 
 error_event:
@@ -1483,6 +1821,7 @@ error:
 		bt_definition_unref(&stream->stream_event_header->p);
 	if (stream->stream_packet_context)
 		bt_definition_unref(&stream->stream_packet_context->p);
+	(void) bt_definition_set_arena(prev_arena);
 	fprintf(stderr, "[error] Unable to create stream (%" PRIu64 ") definitions: %s\n",
 		stream_class->stream_id, strerror(-ret));
 	return ret;
@@ -1513,6 +1852,24 @@ int stream_assign_class(struct ctf_trace *td,
 	return 0;
 }
 
+/*
+ * In verify mode, record a truncated packet and stop indexing the
+ * stream before it. Returns 1 if the truncation has been recorded.
+ */
+static
+int stream_packet_truncated(struct ctf_file_stream *file_stream,
+		off_t filesize)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+
+	if (!babeltrace_ctf_verify)
+		return 0;
+	file_stream->truncated = 1;
+	file_stream->truncated_offset = pos->mmap_offset;
+	pos->mmap_offset = filesize;
+	return 1;
+}
+
 static
 int create_stream_one_packet_index(struct ctf_stream_pos *pos,
 			struct ctf_trace *td,
@@ -1733,6 +2090,8 @@ begin:
 	}
 
 	if (packet_index.packet_size > ((uint64_t) filesize - packet_index.offset) * CHAR_BIT) {
+		if (stream_packet_truncated(file_stream, filesize))
+			return 0;
 		fprintf(stderr, "[error] Packet size (%" PRIu64 " bits) is larger than remaining file size (%" PRIu64 " bits).\n",
 			packet_index.packet_size, ((uint64_t) filesize - packet_index.offset) * CHAR_BIT);
 		return -EINVAL;
@@ -1752,7 +2111,7 @@ begin:
 	packet_index.data_offset = pos->offset;
 
 	/* add index to packet array */
-	g_array_append_val(file_stream->pos.packet_index, packet_index);
+	ctf_packet_index_append(file_stream->pos.packet_index, &packet_index);
 
 	pos->mmap_offset += packet_index.packet_size >> LOG2_CHAR_BIT;
 
@@ -1764,6 +2123,8 @@ retry:
 		/*
 		 * Reached EOF, but still expecting header/context data.
 		 */
+		if (!first_packet && stream_packet_truncated(file_stream, filesize))
+			return 0;
 		fprintf(stderr, "[error] Reached end of file, but still expecting header or context fields.\n");
 		return -EFAULT;
 	}
@@ -1831,9 +2192,15 @@ int create_trace_definitions(struct ctf_trace *td, struct ctf_stream_definition
 	int ret;
 
 	if (td->packet_header_decl) {
-		struct bt_definition *definition =
-			td->packet_header_decl->p.definition_new(&td->packet_header_decl->p,
-				stream->parent_def_scope, 0, 0, "trace.packet.header");
+		struct bt_arena *prev_arena;
+		struct bt_definition *definition;
+
+		prev_arena = stream_definition_arena_enter(stream);
+		definition = td->packet_header_decl->p.definition_new(
+				&td->packet_header_decl->p,
+				stream->parent_def_scope, 0, 0,
+				"trace.packet.header");
+		(void) bt_definition_set_arena(prev_arena);
 		if (!definition) {
 			ret = -EINVAL;
 			goto error;
@@ -1921,7 +2288,7 @@ int import_stream_packet_index(struct ctf_trace *td,
 
 		if (!first_packet) {
 			/* add index to packet array */
-			g_array_append_val(file_stream->pos.packet_index, index);
+			ctf_packet_index_append(file_stream->pos.packet_index, &index);
 			continue;
 		}
 
@@ -1942,7 +2309,7 @@ int import_stream_packet_index(struct ctf_trace *td,
 			goto error;
 		first_packet = 0;
 		/* add index to packet array */
-		g_array_append_val(file_stream->pos.packet_index, index);
+		ctf_packet_index_append(file_stream->pos.packet_index, &index);
 	}
 
 	/* Index containing only the header. */
@@ -1959,19 +2326,23 @@ error:
 }
 
 /*
- * Note: many file streams can inherit from the same stream class
- * description (metadata).
+ * Open and index a stream file. The opened file stream is returned in
+ * file_stream_p, or NULL if the file is skipped; the caller adds it to
+ * its stream class. Only reads the trace metadata, so several stream
+ * files of a trace can be opened concurrently.
  */
 static
 int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
-			int whence))
+			int whence),
+		struct ctf_file_stream **file_stream_p)
 {
 	int ret, fd, closeret;
 	struct ctf_file_stream *file_stream;
 	struct stat statbuf;
 	char *index_name;
 
+	*file_stream_p = NULL;
 	fd = openat(td->dirfd, path, flags);
 	if (fd < 0) {
 		perror("File stream openat()");
@@ -2038,7 +2409,8 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 	snprintf(index_name, strlen(path) + sizeof(INDEX_PATH),
 			INDEX_PATH, path);
 
-	if (bt_faccessat(td->dirfd, td->parent.path, index_name, O_RDONLY, 0) < 0) {
+	if (babeltrace_ctf_verify
+			|| bt_faccessat(td->dirfd, td->parent.path, index_name, O_RDONLY, 0) < 0) {
 		ret = create_stream_packet_index(td, file_stream);
 		if (ret) {
 			fprintf(stderr, "[error] Stream index creation error.\n");
@@ -2069,9 +2441,9 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 	}
 	free(index_name);
 
-	/* Add stream file to stream class */
-	g_ptr_array_add(file_stream->parent.stream_class->streams,
-			&file_stream->parent);
+	/* The fd is reopened on demand from now on. */
+	ctf_fd_pool_add(&file_stream->pos);
+	*file_stream_p = file_stream;
 	return 0;
 
 error_index:
@@ -2090,6 +2462,7 @@ error_def:
 	if (closeret) {
 		fprintf(stderr, "Error on ctf_fini_pos\n");
 	}
+	bt_arena_put(file_stream->parent.definition_arena);
 	g_free(file_stream);
 fd_is_empty_file:
 fd_is_dir_ok:
@@ -2102,6 +2475,75 @@ error:
 	return ret;
 }
 
+struct open_file_streams_work {
+	struct ctf_trace *td;
+	GPtrArray *names;
+	int flags;
+	void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+		int whence);
+	struct ctf_file_stream **file_streams;
+	int *rets;
+};
+
+static
+void open_file_stream_worker(unsigned int index, void *priv)
+{
+	struct open_file_streams_work *work = priv;
+
+	work->rets[index] = ctf_open_file_stream_read(work->td,
+			g_ptr_array_index(work->names, index), work->flags,
+			work->packet_seek, &work->file_streams[index]);
+}
+
+/*
+ * Open and index the stream files of a trace on a thread pool, then
+ * add them to their stream class in directory order, so the result
+ * does not depend on which file is indexed first.
+ */
+static
+int ctf_open_file_streams_read(struct ctf_trace *td, GPtrArray *names,
+		int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence))
+{
+	struct open_file_streams_work work;
+	unsigned int i;
+	int ret = 0;
+
+	work.td = td;
+	work.names = names;
+	work.flags = flags;
+	work.packet_seek = packet_seek;
+	work.file_streams = g_new0(struct ctf_file_stream *, names->len);
+	work.rets = g_new0(int, names->len);
+	bt_parallel_for(names->len, bt_parallel_nr_threads(),
+			open_file_stream_worker, &work);
+
+	for (i = 0; i < names->len; i++) {
+		struct ctf_file_stream *file_stream = work.file_streams[i];
+
+		if (!ret && work.rets[i]) {
+			fprintf(stderr, "[error] Open file stream error.\n");
+			ret = work.rets[i];
+		}
+		if (!file_stream)
+			continue;
+		if (ret) {
+			/* Past the first error: a serial open stops there. */
+			(void) ctf_close_file_stream(file_stream);
+			bt_arena_put(file_stream->parent.definition_arena);
+			g_free(file_stream);
+			continue;
+		}
+		/* Add stream file to stream class */
+		g_ptr_array_add(file_stream->parent.stream_class->streams,
+				&file_stream->parent);
+	}
+	g_free(work.rets);
+	g_free(work.file_streams);
+	return ret;
+}
+
 static
 int ctf_open_trace_read(struct ctf_trace *td,
 		const char *path, int flags,
@@ -2113,7 +2555,9 @@ int ctf_open_trace_read(struct ctf_trace *td,
 	struct dirent *dirent;
 	struct dirent *diriter;
 	size_t dirent_len;
+	GPtrArray *names;
 	char *ext;
+	int i;
 
 	td->flags = flags;
 
@@ -2166,6 +2610,7 @@ int ctf_open_trace_read(struct ctf_trace *td,
 			fpathconf(td->dirfd, _PC_NAME_MAX) + 1;
 
 	dirent = malloc(dirent_len);
+	names = g_ptr_array_new();
 
 	for (;;) {
 		ret = readdir_r(td->dir, dirent, &diriter);
@@ -2187,18 +2632,23 @@ int ctf_open_trace_read(struct ctf_trace *td,
 			continue;
 		}
 
-		ret = ctf_open_file_stream_read(td, diriter->d_name,
-					flags, packet_seek);
-		if (ret) {
-			fprintf(stderr, "[error] Open file stream error.\n");
-			goto readdir_error;
-		}
+		g_ptr_array_add(names, g_strdup(diriter->d_name));
 	}
 
+	ret = ctf_open_file_streams_read(td, names, flags, packet_seek);
+	if (ret)
+		goto readdir_error;
+
+	for (i = 0; i < names->len; i++)
+		g_free(g_ptr_array_index(names, i));
+	g_ptr_array_free(names, TRUE);
 	free(dirent);
 	return 0;
 
 readdir_error:
+	for (i = 0; i < names->len; i++)
+		g_free(g_ptr_array_index(names, i));
+	g_ptr_array_free(names, TRUE);
 	free(dirent);
 error_metadata:
 	closeret = close(td->dirfd);
@@ -2277,8 +2727,7 @@ void ctf_init_mmap_pos(struct ctf_stream_pos *pos,
 	pos->parent.rw_table = read_dispatch_table;
 	pos->parent.event_cb = ctf_read_event;
 	pos->priv = mmap_info->priv;
-	pos->packet_index = g_array_new(FALSE, TRUE,
-			sizeof(struct packet_index));
+	pos->packet_index = ctf_packet_index_table_new();
 }
 
 static
@@ -2317,7 +2766,8 @@ static
 int ctf_open_mmap_stream_read(struct ctf_trace *td,
 		struct bt_mmap_stream *mmap_info,
 		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
-			int whence))
+			int whence),
+		struct ctf_file_stream **file_stream_p)
 {
 	int ret;
 	struct ctf_file_stream *file_stream;
@@ -2346,12 +2796,15 @@ int ctf_open_mmap_stream_read(struct ctf_trace *td,
 	/* Add stream file to stream class */
 	g_ptr_array_add(file_stream->parent.stream_class->streams,
 			&file_stream->parent);
+	if (file_stream_p)
+		*file_stream_p = file_stream;
 	return 0;
 
 error_index:
 	if (file_stream->parent.trace_packet_header)
 		bt_definition_unref(&file_stream->parent.trace_packet_header->p);
 error_def:
+	bt_arena_put(file_stream->parent.definition_arena);
 	g_free(file_stream);
 	return ret;
 }
@@ -2385,7 +2838,8 @@ int ctf_open_mmap_trace_read(struct ctf_trace *td,
 	 * stream ID to add to the right location in the stream array.
 	 */
 	bt_list_for_each_entry(mmap_info, &mmap_list->head, list) {
-		ret = ctf_open_mmap_stream_read(td, mmap_info, packet_seek);
+		ret = ctf_open_mmap_stream_read(td, mmap_info, packet_seek,
+				NULL);
 		if (ret) {
 			fprintf(stderr, "[error] Open file mmap stream error.\n");
 			goto error;
@@ -2431,25 +2885,46 @@ error:
 	return NULL;
 }
 
+/*
+ * Open a stream added to an mmap trace after it was opened, using the
+ * packet_seek function the trace was opened with.
+ */
+int ctf_append_mmap_stream(struct bt_trace_descriptor *tdp,
+		struct bt_mmap_stream *mmap_info,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence),
+		struct ctf_file_stream **file_stream)
+{
+	struct ctf_trace *td = container_of(tdp, struct ctf_trace, parent);
+
+	if (!td->scanner || !packet_seek)
+		return -EINVAL;
+	return ctf_open_mmap_stream_read(td, mmap_info, packet_seek,
+			file_stream);
+}
+
 int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 		FILE *metadata_fp)
 {
 	struct ctf_trace *td = container_of(tdp, struct ctf_trace, parent);
 	int i, j;
-	int ret;
+	int ret, read_ret;
 
 	if (!td->scanner)
 		return -EINVAL;
-	ret = ctf_trace_metadata_read(td, metadata_fp, td->scanner, 1);
-	if (ret)
-		return ret;
-	/* for each stream_class */
+	/*
+	 * A failed append may still have added events before failing:
+	 * their definitions are created all the same.
+	 */
+	read_ret = ctf_trace_metadata_read(td, metadata_fp, td->scanner, 1);
+	/* for each stream_class which received new events */
 	for (i = 0; i < td->streams->len; i++) {
 		struct ctf_stream_declaration *stream_class;
 
 		stream_class = g_ptr_array_index(td->streams, i);
-		if (!stream_class)
+		if (!stream_class || !stream_class->events_appended)
 			continue;
+		stream_class->events_appended = 0;
 		/* for each stream */
 		for (j = 0; j < stream_class->streams->len; j++) {
 			struct ctf_stream_definition *stream;
@@ -2463,7 +2938,7 @@ int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 				return ret;
 		}
 	}
-	return 0;
+	return read_ret;
 }
 
 static
@@ -2495,16 +2970,18 @@ int ctf_convert_index_timestamp(struct bt_trace_descriptor *tdp)
 				continue;
 
 			for (k = 0; k < stream_pos->packet_index->len; k++) {
-				struct packet_index *index;
+				struct packet_index index;
 
-				index = &g_array_index(stream_pos->packet_index,
-						struct packet_index, k);
-				index->ts_real.timestamp_begin =
+				ctf_packet_index_get(stream_pos->packet_index,
+						k, &index);
+				index.ts_real.timestamp_begin =
 					ctf_get_real_timestamp(stream,
-							index->ts_cycles.timestamp_begin);
-				index->ts_real.timestamp_end =
+							index.ts_cycles.timestamp_begin);
+				index.ts_real.timestamp_end =
 					ctf_get_real_timestamp(stream,
-							index->ts_cycles.timestamp_end);
+							index.ts_cycles.timestamp_end);
+				ctf_packet_index_set(stream_pos->packet_index,
+						k, &index);
 			}
 		}
 	}
@@ -2516,6 +2993,7 @@ int ctf_close_file_stream(struct ctf_file_stream *file_stream)
 {
 	int ret;
 
+	ctf_fd_pool_remove(&file_stream->pos);
 	ret = ctf_fini_pos(&file_stream->pos);
 	if (ret) {
 		fprintf(stderr, "Error on ctf_fini_pos\n");
@@ -2557,7 +3035,10 @@ int ctf_close_trace(struct bt_trace_descriptor *tdp)
 			}
 		}
 	}
-	ctf_destroy_metadata(td);
+	if (td->metadata_intern)
+		ctf_metadata_intern_destroy(td);
+	else
+		ctf_destroy_metadata(td);
 	ctf_scanner_free(td->scanner);
 	if (td->dirfd >= 0) {
 		ret = close(td->dirfd);
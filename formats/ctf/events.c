@@ -96,28 +96,19 @@ error:
 	return NULL;
 }
 
-const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_event,
-		const struct bt_definition *scope,
-		const char *field)
+static
+const struct bt_definition *get_field(const struct bt_definition *scope,
+		GQuark field, GQuark underscore_field)
 {
 	const struct bt_definition *def;
-	char *field_underscore;
-
-	if (!ctf_event || !scope || !field)
-		return NULL;
 
-	def = bt_lookup_definition(scope, field);
+	def = bt_lookup_definition_quark(scope, field);
 	/*
 	 * optionally a field can have an underscore prefix, try
 	 * to lookup the field with this prefix if it failed
 	 */
-	if (!def) {
-		field_underscore = g_new(char, strlen(field) + 2);
-		field_underscore[0] = '_';
-		strcpy(&field_underscore[1], field);
-		def = bt_lookup_definition(scope, field_underscore);
-		g_free(field_underscore);
-	}
+	if (!def && underscore_field)
+		def = bt_lookup_definition_quark(scope, underscore_field);
 	if (bt_ctf_field_type(bt_ctf_get_decl_from_def(def)) == CTF_TYPE_VARIANT) {
 		const struct definition_variant *variant_definition;
 		variant_definition = container_of(def,
@@ -127,6 +118,59 @@ const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_even
 	return def;
 }
 
+const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_event,
+		const struct bt_definition *scope,
+		const char *field)
+{
+	GQuark quark;
+
+	if (!ctf_event || !scope || !field)
+		return NULL;
+
+	/*
+	 * Underscore-prefixed fields register their unprefixed name as
+	 * an alias when the metadata is constructed: if the name was
+	 * never interned, no field can match it.
+	 */
+	quark = bt_quark_lookup(field);
+	if (!quark)
+		return NULL;
+	return get_field(scope, quark, bt_lookup_field_alias(scope, quark));
+}
+
+struct bt_ctf_field_key *bt_ctf_field_key_create(const char *field)
+{
+	struct bt_ctf_field_key *key;
+	char *field_underscore;
+
+	if (!field)
+		return NULL;
+
+	key = g_new(struct bt_ctf_field_key, 1);
+	key->name = g_quark_from_string(field);
+	field_underscore = g_new(char, strlen(field) + 2);
+	field_underscore[0] = '_';
+	strcpy(&field_underscore[1], field);
+	key->underscore_name = g_quark_from_string(field_underscore);
+	g_free(field_underscore);
+	return key;
+}
+
+void bt_ctf_field_key_destroy(struct bt_ctf_field_key *key)
+{
+	g_free(key);
+}
+
+const struct bt_definition *bt_ctf_get_field_by_key(const struct bt_ctf_event *ctf_event,
+		const struct bt_definition *scope,
+		const struct bt_ctf_field_key *key)
+{
+	if (!ctf_event || !scope || !key)
+		return NULL;
+
+	return get_field(scope, key->name, key->underscore_name);
+}
+
 const struct bt_definition *bt_ctf_get_index(const struct bt_ctf_event *ctf_event,
 		const struct bt_definition *field,
 		unsigned int index)
@@ -0,0 +1,168 @@
+/*
+ * fd-pool.c
+ *
+ * Common Trace Format - stream file descriptor pool
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/list.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+
+#define FD_POOL_MIN_OPEN	16
+#define FD_POOL_DEFAULT_OPEN	1024
+
+static pthread_mutex_t fd_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Unpinned open fds, most recently used first. */
+static BT_LIST_HEAD(fd_pool_lru);
+static unsigned long fd_pool_nr_open;	/* pinned and unpinned */
+static unsigned long fd_pool_max_open;	/* 0 until first use */
+
+/*
+ * The limit comes from BABELTRACE_MAX_OPEN_FILES, else half of the
+ * RLIMIT_NOFILE soft limit, leaving room for other files.
+ */
+static
+unsigned long fd_pool_get_max_open(void)
+{
+	const char *env;
+	struct rlimit rlim;
+	unsigned long max_open = 0;
+
+	env = getenv("BABELTRACE_MAX_OPEN_FILES");
+	if (env) {
+		max_open = strtoul(env, NULL, 10);
+		if (max_open < 1)
+			max_open = 1;
+		return max_open;
+	}
+	if (!getrlimit(RLIMIT_NOFILE, &rlim)
+			&& rlim.rlim_cur != RLIM_INFINITY) {
+		max_open = rlim.rlim_cur / 2;
+	} else {
+		max_open = FD_POOL_DEFAULT_OPEN;
+	}
+	if (max_open < FD_POOL_MIN_OPEN)
+		max_open = FD_POOL_MIN_OPEN;
+	return max_open;
+}
+
+/* Called with fd_pool_lock held. */
+static
+void fd_pool_evict(void)
+{
+	if (!fd_pool_max_open)
+		fd_pool_max_open = fd_pool_get_max_open();
+	while (fd_pool_nr_open > fd_pool_max_open
+			&& !bt_list_empty(&fd_pool_lru)) {
+		struct ctf_stream_pos *pos;
+
+		pos = bt_list_entry(fd_pool_lru.prev,
+				struct ctf_stream_pos, fd_node);
+		bt_list_del(&pos->fd_node);
+		/* Current mappings remain valid once the fd is closed. */
+		if (close(pos->fd))
+			perror("Error closing pooled file fd");
+		pos->fd = -1;
+		fd_pool_nr_open--;
+	}
+}
+
+void ctf_fd_pool_add(struct ctf_stream_pos *pos)
+{
+	pthread_mutex_lock(&fd_pool_lock);
+	pos->fd_pooled = 1;
+	pos->fd_pinned = 0;
+	bt_list_add(&pos->fd_node, &fd_pool_lru);
+	fd_pool_nr_open++;
+	fd_pool_evict();
+	pthread_mutex_unlock(&fd_pool_lock);
+}
+
+void ctf_fd_pool_remove(struct ctf_stream_pos *pos)
+{
+	if (!pos->fd_pooled)
+		return;
+	pthread_mutex_lock(&fd_pool_lock);
+	if (pos->fd >= 0) {
+		if (!pos->fd_pinned)
+			bt_list_del(&pos->fd_node);
+		fd_pool_nr_open--;
+	}
+	pos->fd_pooled = 0;
+	pthread_mutex_unlock(&fd_pool_lock);
+}
+
+int ctf_fd_pool_get(struct ctf_stream_pos *pos)
+{
+	struct ctf_file_stream *file_stream;
+	struct ctf_trace *td;
+	int ret = 0;
+
+	if (!pos->fd_pooled)
+		return 0;
+	pthread_mutex_lock(&fd_pool_lock);
+	assert(!pos->fd_pinned);
+	if (pos->fd >= 0) {
+		bt_list_del(&pos->fd_node);
+	} else {
+		file_stream = container_of(pos, struct ctf_file_stream, pos);
+		td = container_of(pos->parent.trace, struct ctf_trace, parent);
+		pos->fd = openat(td->dirfd, file_stream->parent.path,
+				td->flags);
+		if (pos->fd < 0) {
+			ret = -errno;
+			fprintf(stderr, "[error] Unable to reopen stream file \"%s\": %s\n",
+				file_stream->parent.path, strerror(errno));
+			goto end;
+		}
+		fd_pool_nr_open++;
+	}
+	pos->fd_pinned = 1;
+	/* Make room for this fd if needed. */
+	fd_pool_evict();
+end:
+	pthread_mutex_unlock(&fd_pool_lock);
+	return ret;
+}
+
+void ctf_fd_pool_put(struct ctf_stream_pos *pos)
+{
+	if (!pos->fd_pooled)
+		return;
+	pthread_mutex_lock(&fd_pool_lock);
+	assert(pos->fd_pinned);
+	pos->fd_pinned = 0;
+	bt_list_add(&pos->fd_node, &fd_pool_lru);
+	fd_pool_evict();
+	pthread_mutex_unlock(&fd_pool_lock);
+}
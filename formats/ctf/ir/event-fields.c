@@ -255,6 +255,7 @@ struct bt_ctf_field *bt_ctf_field_create(struct bt_ctf_field_type *type)
 	bt_get(type);
 	bt_object_init(field, bt_ctf_field_destroy);
 	field->type = type;
+	field->modified = 1;
 error:
 	return field;
 }
@@ -405,6 +406,7 @@ int bt_ctf_field_sequence_set_length(struct bt_ctf_field *field,
 	g_ptr_array_set_size(sequence->elements, (size_t) sequence_length);
 	bt_get(length_field);
 	sequence->length = length_field;
+	field->modified = 1;
 end:
 	return ret;
 }
@@ -454,24 +456,23 @@ error:
 	return new_field;
 }
 
-struct bt_ctf_field *bt_ctf_field_structure_get_field_by_index(
+BT_HIDDEN
+struct bt_ctf_field *bt_ctf_field_structure_peek_field_by_index(
 		struct bt_ctf_field *field, int index)
 {
-	int ret;
-	const char *field_name;
 	struct bt_ctf_field_structure *structure;
-	struct bt_ctf_field_type *structure_type;
-	struct bt_ctf_field_type *field_type = NULL;
+	struct bt_ctf_field_type_structure *structure_type;
+	struct structure_field *structure_field;
 	struct bt_ctf_field *ret_field = NULL;
 
-	if (!field ||
+	if (!field || index < 0 ||
 		bt_ctf_field_type_get_type_id(field->type) != CTF_TYPE_STRUCT) {
 		goto end;
 	}
 
 	structure = container_of(field, struct bt_ctf_field_structure, parent);
 	if (index >= structure->fields->len) {
-		goto error;
+		goto end;
 	}
 
 	ret_field = structure->fields->pdata[index];
@@ -480,31 +481,157 @@ struct bt_ctf_field *bt_ctf_field_structure_get_field_by_index(
 	}
 
 	/* Field has not been instanciated yet, create it */
-	structure_type = bt_ctf_field_get_type(field);
-	if (!structure_type) {
-		goto error;
-	}
-
-	ret = bt_ctf_field_type_structure_get_field(structure_type,
-		&field_name, &field_type, index);
-	bt_put(structure_type);
-	if (ret) {
-		goto error;
-	}
-
-	ret_field = bt_ctf_field_create(field_type);
+	structure_type = container_of(field->type,
+		struct bt_ctf_field_type_structure, parent);
+	structure_field = g_ptr_array_index(structure_type->fields, index);
+	ret_field = bt_ctf_field_create(structure_field->type);
 	if (!ret_field) {
-		goto error;
+		goto end;
 	}
 
 	structure->fields->pdata[index] = ret_field;
 end:
+	return ret_field;
+}
+
+struct bt_ctf_field *bt_ctf_field_structure_get_field_by_index(
+		struct bt_ctf_field *field, int index)
+{
+	struct bt_ctf_field *ret_field =
+		bt_ctf_field_structure_peek_field_by_index(field, index);
+
 	bt_get(ret_field);
-error:
-	bt_put(field_type);
 	return ret_field;
 }
 
+static
+int set_integer_value(struct bt_ctf_field *integer, uint64_t value)
+{
+	int ret;
+	struct bt_ctf_field_type_integer *integer_type;
+
+	if (bt_ctf_field_type_get_type_id(integer->type) != CTF_TYPE_INTEGER) {
+		ret = -1;
+		goto end;
+	}
+
+	integer_type = container_of(integer->type,
+		struct bt_ctf_field_type_integer, parent);
+	if (integer_type->declaration.signedness) {
+		ret = bt_ctf_field_signed_integer_set_value(integer,
+			(int64_t) value);
+	} else {
+		ret = bt_ctf_field_unsigned_integer_set_value(integer, value);
+	}
+end:
+	return ret;
+}
+
+int bt_ctf_field_structure_set_unsigned_integer_by_index(
+		struct bt_ctf_field *structure, int index, uint64_t value)
+{
+	return bt_ctf_field_unsigned_integer_set_value(
+		bt_ctf_field_structure_peek_field_by_index(structure, index),
+		value);
+}
+
+int bt_ctf_field_structure_set_signed_integer_by_index(
+		struct bt_ctf_field *structure, int index, int64_t value)
+{
+	return bt_ctf_field_signed_integer_set_value(
+		bt_ctf_field_structure_peek_field_by_index(structure, index),
+		value);
+}
+
+static
+struct bt_ctf_field *peek_field_by_path(struct bt_ctf_field *field,
+		const int *indexes, int depth)
+{
+	int i;
+
+	if (!indexes || depth <= 0) {
+		field = NULL;
+		goto end;
+	}
+
+	for (i = 0; i < depth && field; i++) {
+		field = bt_ctf_field_structure_peek_field_by_index(field,
+			indexes[i]);
+	}
+end:
+	return field;
+}
+
+int bt_ctf_field_structure_set_unsigned_integer_by_path(
+		struct bt_ctf_field *structure, const int *indexes, int depth,
+		uint64_t value)
+{
+	return bt_ctf_field_unsigned_integer_set_value(
+		peek_field_by_path(structure, indexes, depth), value);
+}
+
+int bt_ctf_field_structure_set_signed_integer_by_path(
+		struct bt_ctf_field *structure, const int *indexes, int depth,
+		int64_t value)
+{
+	return bt_ctf_field_signed_integer_set_value(
+		peek_field_by_path(structure, indexes, depth), value);
+}
+
+int bt_ctf_field_structure_set_integers(struct bt_ctf_field *field,
+		const uint64_t *values, int count)
+{
+	int ret = 0;
+	size_t i;
+	int value_index = 0;
+	struct bt_ctf_field_type_structure *structure_type;
+
+	if (!field || !values || count < 0 ||
+		bt_ctf_field_type_get_type_id(field->type) != CTF_TYPE_STRUCT) {
+		ret = -1;
+		goto end;
+	}
+
+	structure_type = container_of(field->type,
+		struct bt_ctf_field_type_structure, parent);
+	for (i = 0; i < structure_type->fields->len &&
+			value_index < count; i++) {
+		struct bt_ctf_field *integer;
+		struct structure_field *structure_field =
+			g_ptr_array_index(structure_type->fields, i);
+		enum ctf_type_id type_id =
+			bt_ctf_field_type_get_type_id(structure_field->type);
+
+		if (type_id == CTF_TYPE_ENUM) {
+			/* Its value would go to the next integer field */
+			ret = -1;
+			goto end;
+		}
+
+		if (type_id != CTF_TYPE_INTEGER) {
+			continue;
+		}
+
+		integer = bt_ctf_field_structure_peek_field_by_index(field, i);
+		if (!integer) {
+			ret = -1;
+			goto end;
+		}
+
+		ret = set_integer_value(integer, values[value_index++]);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	if (value_index != count) {
+		/* More values than integer fields */
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
 BT_HIDDEN
 int bt_ctf_field_structure_set_field(struct bt_ctf_field *field,
 		const char *name, struct bt_ctf_field *value)
@@ -543,6 +670,7 @@ int bt_ctf_field_structure_set_field(struct bt_ctf_field *field,
 
 	structure->fields->pdata[index] = value;
 	bt_get(value);
+	field->modified = 1;
 end:
 	if (expected_field_type) {
 		bt_put(expected_field_type);
@@ -697,6 +825,7 @@ struct bt_ctf_field *bt_ctf_field_variant_get_field(struct bt_ctf_field *field,
 	bt_get(tag_field);
 	variant->tag = tag_field;
 	variant->payload = new_field;
+	field->modified = 1;
 end:
 	bt_put(tag_enum);
 	return new_field;
@@ -871,6 +1000,7 @@ int bt_ctf_field_signed_integer_set_value(struct bt_ctf_field *field,
 
 	integer->definition.value._signed = value;
 	integer->parent.payload_set = 1;
+	integer->parent.modified = 1;
 end:
 	return ret;
 }
@@ -936,6 +1066,7 @@ int bt_ctf_field_unsigned_integer_set_value(struct bt_ctf_field *field,
 
 	integer->definition.value._unsigned = value;
 	integer->parent.payload_set = 1;
+	integer->parent.modified = 1;
 end:
 	return ret;
 }
@@ -976,6 +1107,7 @@ int bt_ctf_field_floating_point_set_value(struct bt_ctf_field *field,
 		parent);
 	floating_point->definition.value = value;
 	floating_point->parent.payload_set = 1;
+	floating_point->parent.modified = 1;
 end:
 	return ret;
 }
@@ -1019,6 +1151,7 @@ int bt_ctf_field_string_set_value(struct bt_ctf_field *field,
 	}
 
 	string->parent.payload_set = 1;
+	string->parent.modified = 1;
 end:
 	return ret;
 }
@@ -1045,6 +1178,7 @@ int bt_ctf_field_string_append(struct bt_ctf_field *field,
 	}
 
 	string_field->parent.payload_set = 1;
+	string_field->parent.modified = 1;
 
 end:
 	return ret;
@@ -1084,6 +1218,7 @@ int bt_ctf_field_string_append_len(struct bt_ctf_field *field,
 	}
 
 	string_field->parent.payload_set = 1;
+	string_field->parent.modified = 1;
 
 end:
 	return ret;
@@ -1133,6 +1268,82 @@ end:
 	return ret;
 }
 
+static
+int field_array_clear_modified(GPtrArray *fields)
+{
+	size_t i;
+	int modified = 0;
+
+	for (i = 0; i < fields->len; i++) {
+		modified |= bt_ctf_field_clear_modified(
+			g_ptr_array_index(fields, i));
+	}
+
+	return modified;
+}
+
+BT_HIDDEN
+int bt_ctf_field_clear_modified(struct bt_ctf_field *field)
+{
+	int modified;
+
+	if (!field) {
+		return 0;
+	}
+
+	modified = field->modified;
+	field->modified = 0;
+	switch (bt_ctf_field_type_get_type_id(field->type)) {
+	case CTF_TYPE_ENUM:
+	{
+		struct bt_ctf_field_enumeration *enumeration = container_of(
+			field, struct bt_ctf_field_enumeration, parent);
+
+		modified |= bt_ctf_field_clear_modified(enumeration->payload);
+		break;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		struct bt_ctf_field_structure *structure = container_of(
+			field, struct bt_ctf_field_structure, parent);
+
+		modified |= field_array_clear_modified(structure->fields);
+		break;
+	}
+	case CTF_TYPE_VARIANT:
+	{
+		struct bt_ctf_field_variant *variant = container_of(
+			field, struct bt_ctf_field_variant, parent);
+
+		modified |= bt_ctf_field_clear_modified(variant->payload);
+		break;
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		struct bt_ctf_field_array *array = container_of(
+			field, struct bt_ctf_field_array, parent);
+
+		modified |= field_array_clear_modified(array->elements);
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct bt_ctf_field_sequence *sequence = container_of(
+			field, struct bt_ctf_field_sequence, parent);
+
+		if (sequence->elements) {
+			modified |= field_array_clear_modified(
+				sequence->elements);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	return modified;
+}
+
 BT_HIDDEN
 int bt_ctf_field_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos)
@@ -1586,6 +1797,7 @@ int bt_ctf_field_generic_reset(struct bt_ctf_field *field)
 	}
 
 	field->payload_set = 0;
+	field->modified = 1;
 end:
 	return ret;
 }
@@ -1904,29 +2116,50 @@ static
 int bt_ctf_field_string_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos)
 {
-	size_t i;
-	int ret = 0;
+	int ret;
+	size_t len;
 	struct bt_ctf_field_string *string = container_of(field,
 		struct bt_ctf_field_string, parent);
-	struct bt_ctf_field_type *character_type =
-		get_field_type(FIELD_TYPE_ALIAS_UINT8_T);
-	struct bt_ctf_field *character = bt_ctf_field_create(character_type);
 
-	for (i = 0; i < string->payload->len + 1; i++) {
-		ret = bt_ctf_field_unsigned_integer_set_value(character,
-			(uint64_t) string->payload->str[i]);
-		if (ret) {
-			goto end;
-		}
+	/*
+	 * Copy the characters, including the null terminator, in one
+	 * go. This does not take any reference and is therefore safe to
+	 * use from a background flushing thread.
+	 */
+	len = string->payload->len + 1;
+	ret = bt_ctf_serialize_raw_bytes(pos, string->payload->str, len,
+		CHAR_BIT);
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_serialize_raw_bytes(struct ctf_stream_pos *pos, const void *data,
+		size_t len, unsigned int alignment)
+{
+	int ret = 0;
 
-		ret = bt_ctf_field_integer_serialize(character, pos);
+	assert(alignment >= CHAR_BIT);
+	while (!ctf_pos_access_ok(pos,
+		offset_align(pos->offset, alignment) + len * CHAR_BIT)) {
+		ret = increase_packet_size(pos);
 		if (ret) {
 			goto end;
 		}
 	}
+
+	if (!ctf_align_pos(pos, alignment)) {
+		ret = -1;
+		goto end;
+	}
+
+	if (!pos->dummy) {
+		memcpy(ctf_get_pos_addr(pos), data, len);
+	}
+
+	if (!ctf_move_pos(pos, len * CHAR_BIT)) {
+		ret = -1;
+	}
 end:
-	bt_put(character);
-	bt_put(character_type);
 	return ret;
 }
 
@@ -36,6 +36,7 @@
 #include <babeltrace/ref.h>
 #include <babeltrace/compiler.h>
 #include <babeltrace/endian.h>
+#include <babeltrace/align.h>
 #include <float.h>
 #include <inttypes.h>
 #include <stdlib.h>
@@ -1251,6 +1252,53 @@ end:
 	return field_type;
 }
 
+int bt_ctf_field_type_structure_get_field_path(struct bt_ctf_field_type *type,
+		const char *name, int *indexes, int max_depth)
+{
+	int ret;
+	int depth;
+	gchar **names = NULL;
+
+	if (!type || !name || !indexes || max_depth <= 0) {
+		ret = -1;
+		goto end;
+	}
+
+	names = g_strsplit(name, ".", -1);
+	if (!names || !names[0]) {
+		ret = -1;
+		goto end;
+	}
+
+	for (depth = 0; names[depth]; depth++) {
+		struct bt_ctf_field_type_structure *structure;
+		struct structure_field *field;
+		int index;
+
+		if (depth == max_depth) {
+			ret = -1;
+			goto end;
+		}
+
+		index = bt_ctf_field_type_structure_get_field_name_index(type,
+			names[depth]);
+		if (index < 0) {
+			ret = -1;
+			goto end;
+		}
+
+		indexes[depth] = index;
+		structure = container_of(type,
+			struct bt_ctf_field_type_structure, parent);
+		field = structure->fields->pdata[index];
+		type = field->type;
+	}
+	ret = depth;
+end:
+	g_strfreev(names);
+	return ret;
+}
+
 struct bt_ctf_field_type *bt_ctf_field_type_variant_create(
 	struct bt_ctf_field_type *enum_tag, const char *tag_name)
 {
@@ -2179,6 +2227,101 @@ void bt_ctf_field_path_destroy(struct bt_ctf_field_path *path)
 	g_free(path);
 }
 
+static
+int field_type_fixed_layout(struct bt_ctf_field_type *type, uint64_t *offset)
+{
+	int ret = 0;
+
+	/* Fields are aligned on their type's alignment */
+	*offset = ALIGN(*offset, (uint64_t) type->declaration->alignment);
+	switch (type->declaration->id) {
+	case CTF_TYPE_INTEGER:
+	{
+		struct bt_ctf_field_type_integer *integer = container_of(type,
+			struct bt_ctf_field_type_integer, parent);
+
+		*offset += integer->declaration.len;
+		break;
+	}
+	case CTF_TYPE_ENUM:
+	{
+		struct bt_ctf_field_type_enumeration *enumeration =
+			container_of(type,
+				struct bt_ctf_field_type_enumeration, parent);
+
+		ret = field_type_fixed_layout(enumeration->container, offset);
+		break;
+	}
+	case CTF_TYPE_FLOAT:
+	{
+		struct bt_ctf_field_type_floating_point *floating_point =
+			container_of(type,
+				struct bt_ctf_field_type_floating_point,
+				parent);
+
+		*offset += floating_point->sign.len +
+			floating_point->mantissa.len +
+			floating_point->exp.len;
+		break;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		size_t i;
+		struct bt_ctf_field_type_structure *structure =
+			container_of(type, struct bt_ctf_field_type_structure,
+				parent);
+
+		for (i = 0; i < structure->fields->len && !ret; i++) {
+			struct structure_field *field = g_ptr_array_index(
+				structure->fields, i);
+
+			ret = field_type_fixed_layout(field->type, offset);
+		}
+		break;
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		unsigned int i;
+		struct bt_ctf_field_type_array *array = container_of(type,
+			struct bt_ctf_field_type_array, parent);
+
+		for (i = 0; i < array->length && !ret; i++) {
+			ret = field_type_fixed_layout(array->element_type,
+				offset);
+		}
+		break;
+	}
+	default:
+		/* Strings, sequences and variants have a variable size */
+		ret = -1;
+		break;
+	}
+
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_field_type_get_fixed_layout_size(struct bt_ctf_field_type *type,
+		uint64_t *size)
+{
+	int ret;
+	uint64_t offset = 0;
+
+	if (!type || !size || !type->frozen) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = field_type_fixed_layout(type, &offset);
+	if (ret) {
+		goto end;
+	}
+
+	*size = offset;
+end:
+	return ret;
+}
+
 BT_HIDDEN
 int bt_ctf_field_type_structure_get_field_name_index(
 		struct bt_ctf_field_type *type, const char *name)
@@ -463,6 +463,44 @@ end:
 	return field_type;
 }
 
+int bt_ctf_event_class_get_field_index(struct bt_ctf_event_class *event_class,
+		const char *name)
+{
+	int ret;
+
+	if (!event_class || !name) {
+		ret = -1;
+		goto end;
+	}
+
+	if (bt_ctf_field_type_get_type_id(event_class->fields) !=
+		CTF_TYPE_STRUCT) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_get_field_name_index(
+		event_class->fields, name);
+end:
+	return ret;
+}
+
+int bt_ctf_event_class_get_field_path(struct bt_ctf_event_class *event_class,
+		const char *name, int *indexes, int max_depth)
+{
+	int ret;
+
+	if (!event_class) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_get_field_path(event_class->fields,
+		name, indexes, max_depth);
+end:
+	return ret;
+}
+
 struct bt_ctf_field_type *bt_ctf_event_class_get_context_type(
 		struct bt_ctf_event_class *event_class)
 {
@@ -658,7 +696,7 @@ int bt_ctf_event_set_payload(struct bt_ctf_event *event,
 {
 	int ret = 0;
 
-	if (!event || !payload) {
+	if (!event || !payload || event->flushing) {
 		ret = -1;
 		goto end;
 	}
@@ -704,7 +742,7 @@ int bt_ctf_event_set_payload_field(struct bt_ctf_event *event,
 	int ret = 0;
 	struct bt_ctf_field_type *payload_type = NULL;
 
-	if (!event || !payload) {
+	if (!event || !payload || event->flushing) {
 		ret = -1;
 		goto end;
 	}
@@ -764,6 +802,88 @@ end:
 	return field;
 }
 
+int bt_ctf_event_set_payload_unsigned_integer(struct bt_ctf_event *event,
+		int index, uint64_t value)
+{
+	int ret;
+
+	if (!event || event->flushing) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_structure_set_unsigned_integer_by_index(
+		event->fields_payload, index, value);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_payload_signed_integer(struct bt_ctf_event *event,
+		int index, int64_t value)
+{
+	int ret;
+
+	if (!event || event->flushing) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_structure_set_signed_integer_by_index(
+		event->fields_payload, index, value);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_payload_integers(struct bt_ctf_event *event,
+		const uint64_t *values, int count)
+{
+	int ret;
+
+	if (!event || event->flushing) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_structure_set_integers(event->fields_payload,
+		values, count);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_payload_unsigned_integer_by_path(
+		struct bt_ctf_event *event, const int *indexes, int depth,
+		uint64_t value)
+{
+	int ret;
+
+	if (!event || event->flushing) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_structure_set_unsigned_integer_by_path(
+		event->fields_payload, indexes, depth, value);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_payload_signed_integer_by_path(
+		struct bt_ctf_event *event, const int *indexes, int depth,
+		int64_t value)
+{
+	int ret;
+
+	if (!event || event->flushing) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_structure_set_signed_integer_by_path(
+		event->fields_payload, indexes, depth, value);
+end:
+	return ret;
+}
+
 struct bt_ctf_field *bt_ctf_event_get_header(
 		struct bt_ctf_event *event)
 {
@@ -785,7 +905,7 @@ int bt_ctf_event_set_header(struct bt_ctf_event *event,
 	int ret = 0;
 	struct bt_ctf_field_type *field_type = NULL;
 
-	if (!event || !header) {
+	if (!event || !header || event->flushing) {
 		ret = -1;
 		goto end;
 	}
@@ -835,7 +955,7 @@ int bt_ctf_event_set_event_context(struct bt_ctf_event *event,
 	int ret = 0;
 	struct bt_ctf_field_type *field_type = NULL;
 
-	if (!event || !context) {
+	if (!event || !context || event->flushing) {
 		ret = -1;
 		goto end;
 	}
@@ -939,11 +1059,30 @@ end:
 BT_HIDDEN
 void bt_ctf_event_class_freeze(struct bt_ctf_event_class *event_class)
 {
+	uint64_t payload_size;
+
 	assert(event_class);
+	if (event_class->frozen) {
+		return;
+	}
+
 	event_class->frozen = 1;
 	bt_ctf_field_type_freeze(event_class->context);
 	bt_ctf_field_type_freeze(event_class->fields);
 	bt_ctf_attributes_freeze(event_class->attributes);
+
+	/*
+	 * Payloads can only be appended as raw bytes if their layout is
+	 * fixed and starts and ends on a byte boundary.
+	 */
+	event_class->raw_payload_size = -1;
+	if (!event_class->context &&
+		bt_ctf_field_type_get_alignment(event_class->fields) >=
+			CHAR_BIT &&
+		!bt_ctf_field_type_get_fixed_layout_size(event_class->fields,
+			&payload_size) && !(payload_size % CHAR_BIT)) {
+		event_class->raw_payload_size = payload_size / CHAR_BIT;
+	}
 }
 
 BT_HIDDEN
@@ -1144,6 +1283,7 @@ BT_HIDDEN
 int bt_ctf_event_populate_event_header(struct bt_ctf_event *event)
 {
 	int ret = 0;
+	struct bt_ctf_stream_class *stream_class;
 	struct bt_ctf_field *id_field = NULL, *timestamp_field = NULL;
 
 	if (!event) {
@@ -1151,8 +1291,17 @@ int bt_ctf_event_populate_event_header(struct bt_ctf_event *event)
 		goto end;
 	}
 
-	id_field = bt_ctf_field_structure_get_field(event->event_header, "id");
-	if (id_field) {
+	/*
+	 * The header field indexes are resolved once when the stream class
+	 * is frozen, which bt_ctf_event_create() guarantees. Fields are
+	 * peeked to avoid reference count churn on every appended event.
+	 */
+	stream_class = event->event_class->stream_class;
+	assert(stream_class->frozen);
+	if (stream_class->event_header_id_index >= 0) {
+		id_field = bt_ctf_field_structure_peek_field_by_index(
+			event->event_header,
+			stream_class->event_header_id_index);
 		ret = set_integer_field_value(id_field,
 			(uint64_t) bt_ctf_event_class_get_id(
 				event->event_class));
@@ -1161,22 +1310,29 @@ int bt_ctf_event_populate_event_header(struct bt_ctf_event *event)
 		}
 	}
 
-	timestamp_field = bt_ctf_field_structure_get_field(event->event_header,
-		"timestamp");
-	if (timestamp_field) {
-		struct bt_ctf_field_type *timestamp_field_type =
-			bt_ctf_field_get_type(timestamp_field);
-		struct bt_ctf_clock *mapped_clock;
+	if (stream_class->event_header_timestamp_index >= 0) {
+		struct bt_ctf_field_type_integer *timestamp_type;
+
+		timestamp_field = bt_ctf_field_structure_peek_field_by_index(
+			event->event_header,
+			stream_class->event_header_timestamp_index);
+		if (!timestamp_field) {
+			ret = -1;
+			goto end;
+		}
+
+		if (bt_ctf_field_type_get_type_id(timestamp_field->type) !=
+			CTF_TYPE_INTEGER) {
+			/* Not mapped to a clock, nothing to populate */
+			goto end;
+		}
 
-		assert(timestamp_field_type);
-		mapped_clock = bt_ctf_field_type_integer_get_mapped_clock(
-			timestamp_field_type);
-		bt_put(timestamp_field_type);
-		if (mapped_clock) {
+		timestamp_type = container_of(timestamp_field->type,
+			struct bt_ctf_field_type_integer, parent);
+		if (timestamp_type->mapped_clock) {
 			uint64_t timestamp = bt_ctf_clock_get_time(
-				mapped_clock);
+				timestamp_type->mapped_clock);
 
-			bt_put(mapped_clock);
 			if (timestamp == (uint64_t) -1ULL) {
 				goto end;
 			}
@@ -1189,8 +1345,6 @@ int bt_ctf_event_populate_event_header(struct bt_ctf_event *event)
 		}
 	}
 end:
-	bt_put(id_field);
-	bt_put(timestamp_field);
 	return ret;
 }
 
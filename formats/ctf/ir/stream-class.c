@@ -64,6 +64,8 @@ struct bt_ctf_stream_class *bt_ctf_stream_class_create(const char *name)
 	}
 
 	stream_class->name = g_string_new(name);
+	stream_class->event_header_id_index = -1;
+	stream_class->event_header_timestamp_index = -1;
 	stream_class->event_classes = g_ptr_array_new_with_free_func(
 		(GDestroyNotify) bt_put);
 	if (!stream_class->event_classes) {
@@ -624,6 +626,12 @@ void bt_ctf_stream_class_freeze(struct bt_ctf_stream_class *stream_class)
 	}
 
 	stream_class->frozen = 1;
+	stream_class->event_header_id_index =
+		bt_ctf_field_type_structure_get_field_name_index(
+			stream_class->event_header_type, "id");
+	stream_class->event_header_timestamp_index =
+		bt_ctf_field_type_structure_get_field_name_index(
+			stream_class->event_header_type, "timestamp");
 	bt_ctf_field_type_freeze(stream_class->event_header_type);
 	bt_ctf_field_type_freeze(stream_class->packet_context_type);
 	bt_ctf_field_type_freeze(stream_class->event_context_type);
@@ -236,6 +236,11 @@ end:
 static
 void put_event(struct bt_ctf_event *event)
 {
+	if (!event) {
+		return;
+	}
+
+	event->flushing = 0;
 	bt_ctf_event_set_stream(event, NULL);
 	bt_put(event);
 }
@@ -296,6 +301,11 @@ struct bt_ctf_stream *bt_ctf_stream_create(
 	if (!stream->events) {
 		goto error;
 	}
+	stream->raw_events = g_ptr_array_new_with_free_func(
+		(GDestroyNotify) g_free);
+	if (!stream->raw_events) {
+		goto error;
+	}
 	if (stream_class->event_context_type) {
 		stream->event_contexts = g_ptr_array_new_with_free_func(
 			(GDestroyNotify) bt_ctf_field_put);
@@ -479,60 +489,256 @@ end:
 	bt_put(events_discarded_field_type);
 }
 
+/*
+ * Sample the current stream event context. A new copy is only taken if
+ * the context was modified since the last append; otherwise, the
+ * previous snapshot is shared.
+ */
+static
+int sample_event_context(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
+
+	if (!stream->event_context ||
+		(!bt_ctf_field_clear_modified(stream->event_context) &&
+			stream->event_context_snapshot)) {
+		goto end;
+	}
+
+	/*
+	 * The modifications are now cleared; drop the previous snapshot
+	 * so that a failure below does not cause it to be reused on the
+	 * next append.
+	 */
+	BT_PUT(stream->event_context_snapshot);
+
+	/* Make sure the event context's payload is set */
+	ret = bt_ctf_field_validate(stream->event_context);
+	if (ret) {
+		goto end;
+	}
+
+	stream->event_context_snapshot =
+		bt_ctf_field_copy(stream->event_context);
+	if (!stream->event_context_snapshot) {
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Save an event, or a raw event, along with the current stream event
+ * context snapshot. Takes ownership of the event.
+ */
+static
+void add_stream_event(struct bt_ctf_stream *stream,
+		struct bt_ctf_event *event,
+		struct bt_ctf_stream_raw_event *raw_event)
+{
+	g_ptr_array_add(stream->events, event);
+	g_ptr_array_add(stream->raw_events, raw_event);
+	if (stream->event_context_snapshot) {
+		bt_get(stream->event_context_snapshot);
+		g_ptr_array_add(stream->event_contexts,
+			stream->event_context_snapshot);
+	}
+}
+
 int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		struct bt_ctf_event *event)
 {
 	int ret = 0;
-	struct bt_ctf_field *event_context_copy = NULL;
 
 	if (!stream || !event) {
 		ret = -1;
 		goto end;
 	}
 
+	/*
+	 * Fails if the event was already associated to a stream, which it
+	 * keeps, e.g. while its packet is queued for writing.
+	 */
 	ret = bt_ctf_event_set_stream(event, stream);
 	if (ret) {
-		/* Event was already associated to a stream */
 		ret = -1;
 		goto end;
 	}
 
 	ret = bt_ctf_event_populate_event_header(event);
 	if (ret) {
-		goto end;
+		goto error;
 	}
 
 	/* Make sure the event's payload is set */
 	ret = bt_ctf_event_validate(event);
 	if (ret) {
+		goto error;
+	}
+
+	ret = sample_event_context(stream);
+	if (ret) {
+		goto error;
+	}
+
+	bt_get(event);
+	add_stream_event(stream, event, NULL);
+end:
+	return ret;
+error:
+	(void) bt_ctf_event_set_stream(event, NULL);
+	return ret;
+}
+
+/*
+ * Check that a value fits in one of the raw event header's unsigned
+ * integer fields. Absent fields (negative index) accept any value.
+ */
+static
+int check_raw_event_header_value(struct bt_ctf_stream *stream, int index,
+		uint64_t value)
+{
+	int ret = 0;
+	int size;
+	struct bt_ctf_field *field;
+
+	if (index < 0) {
 		goto end;
 	}
 
-	/* Sample the current stream event context by copying it */
-	if (stream->event_context) {
-		/* Make sure the event context's payload is set */
-		ret = bt_ctf_field_validate(stream->event_context);
-		if (ret) {
-			goto end;
+	field = bt_ctf_field_structure_peek_field_by_index(
+		stream->raw_event_header, index);
+	assert(field);
+	size = bt_ctf_field_type_integer_get_size(field->type);
+	if (size < 64 && (value >> size)) {
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Create the header used to serialize raw events. Raw events can only be
+ * appended to streams whose event header is made of the "id" and/or
+ * "timestamp" unsigned integer fields, which are populated by the
+ * library. These fields are instanciated here, on the appending thread,
+ * since the header is later used by the background flushing thread.
+ */
+static
+int create_raw_event_header(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
+	int i, expected_count = 0;
+	struct bt_ctf_field *header = NULL;
+	struct bt_ctf_stream_class *stream_class = stream->stream_class;
+	const int indexes[] = {
+		stream_class->event_header_id_index,
+		stream_class->event_header_timestamp_index,
+	};
+
+	header = bt_ctf_field_create(stream_class->event_header_type);
+	if (!header) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < sizeof(indexes) / sizeof(*indexes); i++) {
+		struct bt_ctf_field *field;
+
+		if (indexes[i] < 0) {
+			continue;
 		}
 
-		event_context_copy = bt_ctf_field_copy(stream->event_context);
-		if (!event_context_copy) {
+		expected_count++;
+		field = bt_ctf_field_structure_peek_field_by_index(header,
+			indexes[i]);
+		if (!field || !bt_ctf_field_type_is_integer(field->type) ||
+			bt_ctf_field_type_integer_get_signed(field->type)) {
 			ret = -1;
 			goto end;
 		}
 	}
 
-	bt_get(event);
-	/* Save the new event along with its associated stream event context */
-	g_ptr_array_add(stream->events, event);
-	if (event_context_copy) {
-		g_ptr_array_add(stream->event_contexts, event_context_copy);
+	if (bt_ctf_field_type_structure_get_field_count(
+		stream_class->event_header_type) != expected_count) {
+		/* The header has fields which can't be populated */
+		ret = -1;
+		goto end;
 	}
+
+	stream->raw_event_header = header;
+	header = NULL;
 end:
+	bt_put(header);
+	return ret;
+}
+
+int bt_ctf_stream_append_raw_event(struct bt_ctf_stream *stream,
+		struct bt_ctf_event_class *event_class, uint64_t timestamp,
+		const void *payload, size_t payload_size)
+{
+	int ret = 0;
+	int64_t id;
+	struct bt_ctf_stream_raw_event *raw_event = NULL;
+
+	if (!stream || !event_class || (!payload && payload_size) ||
+		event_class->stream_class != stream->stream_class) {
+		ret = -1;
+		goto end;
+	}
+
+	/* Computes the class' raw payload size, if not already frozen */
+	bt_ctf_event_class_freeze(event_class);
+	if (event_class->raw_payload_size < 0 ||
+		(uint64_t) event_class->raw_payload_size != payload_size) {
+		ret = -1;
+		goto end;
+	}
+
+	if (!stream->raw_event_header) {
+		ret = create_raw_event_header(stream);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	id = bt_ctf_event_class_get_id(event_class);
+	if (id < 0) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = check_raw_event_header_value(stream,
+		stream->stream_class->event_header_id_index, (uint64_t) id);
 	if (ret) {
-		(void) bt_ctf_event_set_stream(event, NULL);
+		goto end;
+	}
+
+	ret = check_raw_event_header_value(stream,
+		stream->stream_class->event_header_timestamp_index, timestamp);
+	if (ret) {
+		goto end;
 	}
+
+	ret = sample_event_context(stream);
+	if (ret) {
+		goto end;
+	}
+
+	raw_event = g_malloc(sizeof(*raw_event) + payload_size);
+	if (!raw_event) {
+		ret = -1;
+		goto end;
+	}
+
+	raw_event->id = (uint64_t) id;
+	raw_event->timestamp = timestamp;
+	raw_event->alignment = bt_ctf_field_type_get_alignment(
+		event_class->fields);
+	raw_event->size = payload_size;
+	memcpy(raw_event->payload, payload, payload_size);
+	add_stream_event(stream, NULL, raw_event);
+end:
 	return ret;
 }
 
@@ -615,6 +821,7 @@ int bt_ctf_stream_set_event_context(struct bt_ctf_stream *stream,
 	bt_get(field);
 	bt_put(stream->event_context);
 	stream->event_context = field;
+	BT_PUT(stream->event_context_snapshot);
 end:
 	bt_put(field_type);
 	return ret;
@@ -706,10 +913,577 @@ end:
 	return ret;
 }
 
-int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
+/* Get the timestamp of the current packet's event at "index". */
+static
+int get_stream_event_timestamp(struct bt_ctf_stream *stream, size_t index,
+		uint64_t *timestamp)
+{
+	int ret = 0;
+	struct bt_ctf_event *event = g_ptr_array_index(stream->events, index);
+	struct bt_ctf_stream_raw_event *raw_event =
+		g_ptr_array_index(stream->raw_events, index);
+
+	if (event) {
+		ret = get_event_header_timestamp(event->event_header,
+			timestamp);
+		goto end;
+	}
+
+	if (stream->stream_class->event_header_timestamp_index < 0) {
+		ret = -1;
+		goto end;
+	}
+
+	*timestamp = raw_event->timestamp;
+end:
+	return ret;
+}
+
+/*
+ * Set a pre-resolved integer field. Only uses the field's type without
+ * acquiring a reference since this is called from the background
+ * flushing thread.
+ */
+static
+int set_preresolved_integer(struct bt_ctf_field *integer, uint64_t value)
+{
+	int ret = 0;
+
+	if (!integer) {
+		goto end;
+	}
+
+	if (bt_ctf_field_type_integer_get_signed(integer->type)) {
+		ret = bt_ctf_field_signed_integer_set_value(integer,
+			(int64_t) value);
+	} else {
+		ret = bt_ctf_field_unsigned_integer_set_value(integer, value);
+	}
+end:
+	return ret;
+}
+
+/*
+ * Write a raw event's header and payload. The header's fields were
+ * instanciated by create_raw_event_header(), which makes this safe to
+ * call from the background flushing thread.
+ */
+static
+int serialize_raw_event_header(struct bt_ctf_stream *stream,
+		struct bt_ctf_stream_raw_event *raw_event)
+{
+	int ret;
+	struct bt_ctf_stream_class *stream_class = stream->stream_class;
+	struct bt_ctf_field *header = stream->raw_event_header;
+
+	ret = bt_ctf_field_reset(header);
+	if (ret) {
+		goto end;
+	}
+
+	if (stream_class->event_header_id_index >= 0) {
+		ret = set_preresolved_integer(
+			bt_ctf_field_structure_peek_field_by_index(header,
+				stream_class->event_header_id_index),
+			raw_event->id);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	if (stream_class->event_header_timestamp_index >= 0) {
+		ret = set_preresolved_integer(
+			bt_ctf_field_structure_peek_field_by_index(header,
+				stream_class->event_header_timestamp_index),
+			raw_event->timestamp);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	ret = bt_ctf_field_serialize(header, &stream->pos);
+end:
+	return ret;
+}
+
+static
+int serialize_events(struct bt_ctf_stream *stream, GPtrArray *events,
+		GPtrArray *event_contexts, GPtrArray *raw_events)
 {
 	int ret = 0;
 	size_t i;
+	struct ctf_stream_pos *pos = &stream->pos;
+
+	for (i = 0; i < events->len; i++) {
+		struct bt_ctf_event *event = g_ptr_array_index(events, i);
+		struct bt_ctf_stream_raw_event *raw_event =
+			g_ptr_array_index(raw_events, i);
+
+		/* Write event header */
+		if (raw_event) {
+			ret = serialize_raw_event_header(stream, raw_event);
+		} else {
+			ret = bt_ctf_field_reset(event->event_header);
+			if (ret) {
+				goto end;
+			}
+
+			ret = bt_ctf_field_serialize(event->event_header, pos);
+		}
+		if (ret) {
+			goto end;
+		}
+
+		/* Write stream event context */
+		if (event_contexts) {
+			ret = bt_ctf_field_serialize(
+				g_ptr_array_index(event_contexts, i), pos);
+			if (ret) {
+				goto end;
+			}
+		}
+
+		/* Write event content */
+		if (raw_event) {
+			ret = bt_ctf_serialize_raw_bytes(pos,
+				raw_event->payload, raw_event->size,
+				raw_event->alignment);
+		} else {
+			ret = bt_ctf_event_serialize(event, pos);
+		}
+		if (ret) {
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+static
+void packet_job_destroy(struct bt_ctf_stream_packet_job *job)
+{
+	if (!job) {
+		return;
+	}
+
+	if (job->events) {
+		g_ptr_array_free(job->events, TRUE);
+	}
+	if (job->event_contexts) {
+		g_ptr_array_free(job->event_contexts, TRUE);
+	}
+	if (job->raw_events) {
+		g_ptr_array_free(job->raw_events, TRUE);
+	}
+	bt_put(job->content_size);
+	bt_put(job->packet_size);
+	bt_put(job->packet_header);
+	bt_put(job->packet_context);
+	g_free(job);
+}
+
+/* Called from the background flushing thread. */
+static
+int write_packet_job(struct bt_ctf_stream *stream,
+		struct bt_ctf_stream_packet_job *job)
+{
+	int ret;
+	struct ctf_stream_pos packet_context_pos;
+
+	/* mmap the next packet */
+	ctf_packet_seek(&stream->pos.parent, 0, SEEK_CUR);
+
+	ret = bt_ctf_field_serialize(job->packet_header, &stream->pos);
+	if (ret) {
+		goto end;
+	}
+
+	/* Write packet context */
+	memcpy(&packet_context_pos, &stream->pos,
+	       sizeof(struct ctf_stream_pos));
+	ret = bt_ctf_field_serialize(job->packet_context, &stream->pos);
+	if (ret) {
+		goto end;
+	}
+
+	ret = serialize_events(stream, job->events, job->event_contexts,
+		job->raw_events);
+	if (ret) {
+		goto end;
+	}
+
+	/* Overwrite the packet context with the final sizes */
+	packet_context_pos.base_mma = stream->pos.base_mma;
+	ret = set_preresolved_integer(job->content_size, stream->pos.offset);
+	if (ret) {
+		goto end;
+	}
+
+	ret = set_preresolved_integer(job->packet_size,
+		stream->pos.packet_size);
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_serialize(job->packet_context,
+		&packet_context_pos);
+end:
+	return ret;
+}
+
+static
+void *async_flush_thread(void *data)
+{
+	struct bt_ctf_stream *stream = data;
+	struct bt_ctf_stream_async_flush *async_flush = stream->async_flush;
+
+	pthread_mutex_lock(&async_flush->lock);
+	for (;;) {
+		struct bt_ctf_stream_packet_job *job;
+
+		while (g_queue_is_empty(async_flush->pending) &&
+				!async_flush->quit) {
+			pthread_cond_wait(&async_flush->cond,
+				&async_flush->lock);
+		}
+
+		job = g_queue_pop_head(async_flush->pending);
+		if (!job) {
+			/* Asked to quit and no packet is left to write */
+			break;
+		}
+
+		pthread_mutex_unlock(&async_flush->lock);
+		job->ret = write_packet_job(stream, job);
+		pthread_mutex_lock(&async_flush->lock);
+		g_queue_push_tail(async_flush->completed, job);
+		async_flush->in_flight--;
+		pthread_cond_broadcast(&async_flush->cond);
+	}
+	pthread_mutex_unlock(&async_flush->lock);
+	return NULL;
+}
+
+/*
+ * Release the jobs written by the background thread. Must be called
+ * from the producing thread. Returns the first error reported since the
+ * last call.
+ */
+static
+int async_flush_release_completed(struct bt_ctf_stream_async_flush *async_flush)
+{
+	int ret;
+	struct bt_ctf_stream_packet_job *job;
+
+	pthread_mutex_lock(&async_flush->lock);
+	while ((job = g_queue_pop_head(async_flush->completed))) {
+		if (job->ret && !async_flush->error) {
+			async_flush->error = job->ret;
+		}
+		packet_job_destroy(job);
+	}
+	ret = async_flush->error;
+	async_flush->error = 0;
+	pthread_mutex_unlock(&async_flush->lock);
+	return ret;
+}
+
+static
+void async_flush_destroy(struct bt_ctf_stream_async_flush *async_flush)
+{
+	if (!async_flush) {
+		return;
+	}
+
+	if (async_flush->pending) {
+		g_queue_free(async_flush->pending);
+	}
+	if (async_flush->completed) {
+		g_queue_free(async_flush->completed);
+	}
+	pthread_mutex_destroy(&async_flush->lock);
+	pthread_cond_destroy(&async_flush->cond);
+	g_free(async_flush);
+}
+
+static
+void async_flush_stop(struct bt_ctf_stream *stream)
+{
+	struct bt_ctf_stream_async_flush *async_flush = stream->async_flush;
+
+	pthread_mutex_lock(&async_flush->lock);
+	async_flush->quit = 1;
+	pthread_cond_broadcast(&async_flush->cond);
+	pthread_mutex_unlock(&async_flush->lock);
+	if (pthread_join(async_flush->thread, NULL)) {
+		perror("pthread_join");
+	}
+
+	if (async_flush_release_completed(async_flush)) {
+		fprintf(stderr, "[error] Failed to write stream packet.\n");
+	}
+	async_flush_destroy(async_flush);
+	stream->async_flush = NULL;
+}
+
+static
+int async_flush_packet(struct bt_ctf_stream *stream)
+{
+	int ret;
+	int queue_full;
+	size_t i;
+	uint64_t timestamp_begin, timestamp_end, events_discarded;
+	GPtrArray *events = NULL, *event_contexts = NULL, *raw_events = NULL;
+	struct bt_ctf_stream_packet_job *job = NULL;
+	struct bt_ctf_stream_async_flush *async_flush = stream->async_flush;
+
+	ret = async_flush_release_completed(async_flush);
+	if (ret) {
+		goto end;
+	}
+
+	if (!stream->events->len) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_validate(stream->packet_header);
+	if (ret) {
+		goto end;
+	}
+
+	pthread_mutex_lock(&async_flush->lock);
+	while (async_flush->in_flight >= async_flush->queue_depth &&
+			async_flush->policy ==
+			BT_CTF_STREAM_FLUSH_POLICY_BLOCK) {
+		pthread_cond_wait(&async_flush->cond, &async_flush->lock);
+	}
+	queue_full = async_flush->in_flight >= async_flush->queue_depth;
+	pthread_mutex_unlock(&async_flush->lock);
+
+	if (queue_full) {
+		uint64_t discarded = stream->events->len;
+
+		/* Drop the packet and account for its events. */
+		g_ptr_array_set_size(stream->events, 0);
+		g_ptr_array_set_size(stream->raw_events, 0);
+		if (stream->event_contexts) {
+			g_ptr_array_set_size(stream->event_contexts, 0);
+		}
+		bt_ctf_stream_append_discarded_events(stream, discarded);
+		goto end;
+	}
+
+	job = g_new0(struct bt_ctf_stream_packet_job, 1);
+	events = g_ptr_array_new_with_free_func((GDestroyNotify) put_event);
+	raw_events = g_ptr_array_new_with_free_func((GDestroyNotify) g_free);
+	if (!job || !events || !raw_events) {
+		ret = -1;
+		goto end;
+	}
+	if (stream->event_contexts) {
+		event_contexts = g_ptr_array_new_with_free_func(
+			(GDestroyNotify) bt_ctf_field_put);
+		if (!event_contexts) {
+			ret = -1;
+			goto end;
+		}
+	}
+
+	/* Set the default context attributes if present and unset. */
+	if (!get_stream_event_timestamp(stream, 0, &timestamp_begin)) {
+		ret = set_structure_field_integer(stream->packet_context,
+			"timestamp_begin", timestamp_begin);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	if (!get_stream_event_timestamp(stream, stream->events->len - 1,
+		&timestamp_end)) {
+		ret = set_structure_field_integer(stream->packet_context,
+			"timestamp_end", timestamp_end);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	ret = set_structure_field_integer(stream->packet_context,
+		"content_size", UINT64_MAX);
+	if (ret) {
+		goto end;
+	}
+
+	ret = set_structure_field_integer(stream->packet_context,
+		"packet_size", UINT64_MAX);
+	if (ret) {
+		goto end;
+	}
+
+	/*
+	 * The packet header and context are copied since the user may
+	 * modify them while the packet is being written.
+	 */
+	job->packet_header = bt_ctf_field_copy(stream->packet_header);
+	job->packet_context = bt_ctf_field_copy(stream->packet_context);
+	if (!job->packet_header || !job->packet_context) {
+		ret = -1;
+		goto end;
+	}
+
+	job->content_size = bt_ctf_field_structure_get_field(
+		job->packet_context, "content_size");
+	job->packet_size = bt_ctf_field_structure_get_field(
+		job->packet_context, "packet_size");
+	if ((job->content_size && !bt_ctf_field_type_is_integer(
+			job->content_size->type)) ||
+			(job->packet_size && !bt_ctf_field_type_is_integer(
+			job->packet_size->type))) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_stream_get_discarded_events_count(stream,
+		&events_discarded);
+	if (ret) {
+		goto end;
+	}
+
+	/* Unset the packet context's fields. */
+	ret = bt_ctf_field_reset(stream->packet_context);
+	if (ret) {
+		goto end;
+	}
+
+	/* Set the previous number of discarded events. */
+	ret = set_structure_field_integer(stream->packet_context,
+		"events_discarded", events_discarded);
+	if (ret) {
+		goto end;
+	}
+
+	/*
+	 * Hand the current packet's events over to the job. They may not
+	 * be modified until the job is released.
+	 */
+	for (i = 0; i < stream->events->len; i++) {
+		struct bt_ctf_event *event =
+			g_ptr_array_index(stream->events, i);
+
+		if (event) {
+			event->flushing = 1;
+		}
+	}
+	job->events = stream->events;
+	job->event_contexts = stream->event_contexts;
+	job->raw_events = stream->raw_events;
+	stream->events = events;
+	stream->event_contexts = event_contexts;
+	stream->raw_events = raw_events;
+	events = NULL;
+	event_contexts = NULL;
+	raw_events = NULL;
+
+	pthread_mutex_lock(&async_flush->lock);
+	g_queue_push_tail(async_flush->pending, job);
+	async_flush->in_flight++;
+	pthread_cond_broadcast(&async_flush->cond);
+	pthread_mutex_unlock(&async_flush->lock);
+	job = NULL;
+	stream->flushed_packet_count++;
+end:
+	packet_job_destroy(job);
+	if (events) {
+		g_ptr_array_free(events, TRUE);
+	}
+	if (event_contexts) {
+		g_ptr_array_free(event_contexts, TRUE);
+	}
+	if (raw_events) {
+		g_ptr_array_free(raw_events, TRUE);
+	}
+	return ret;
+}
+
+int bt_ctf_stream_set_async_flush(struct bt_ctf_stream *stream,
+		unsigned int queue_depth,
+		enum bt_ctf_stream_flush_policy policy)
+{
+	int ret = 0;
+	struct bt_ctf_stream_async_flush *async_flush = NULL;
+
+	if (!stream || stream->pos.fd < 0 || stream->async_flush ||
+			!queue_depth) {
+		ret = -1;
+		goto end;
+	}
+
+	switch (policy) {
+	case BT_CTF_STREAM_FLUSH_POLICY_BLOCK:
+	case BT_CTF_STREAM_FLUSH_POLICY_DISCARD:
+		break;
+	default:
+		ret = -1;
+		goto end;
+	}
+
+	async_flush = g_new0(struct bt_ctf_stream_async_flush, 1);
+	if (!async_flush) {
+		ret = -1;
+		goto end;
+	}
+
+	pthread_mutex_init(&async_flush->lock, NULL);
+	pthread_cond_init(&async_flush->cond, NULL);
+	async_flush->pending = g_queue_new();
+	async_flush->completed = g_queue_new();
+	if (!async_flush->pending || !async_flush->completed) {
+		ret = -1;
+		goto end;
+	}
+
+	async_flush->queue_depth = queue_depth;
+	async_flush->policy = policy;
+	stream->async_flush = async_flush;
+	if (pthread_create(&async_flush->thread, NULL, async_flush_thread,
+			stream)) {
+		stream->async_flush = NULL;
+		ret = -1;
+		goto end;
+	}
+	async_flush = NULL;
+end:
+	async_flush_destroy(async_flush);
+	return ret;
+}
+
+int bt_ctf_stream_wait_flush(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
+	struct bt_ctf_stream_async_flush *async_flush;
+
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	async_flush = stream->async_flush;
+	if (!async_flush) {
+		goto end;
+	}
+
+	pthread_mutex_lock(&async_flush->lock);
+	while (async_flush->in_flight) {
+		pthread_cond_wait(&async_flush->cond, &async_flush->lock);
+	}
+	pthread_mutex_unlock(&async_flush->lock);
+	ret = async_flush_release_completed(async_flush);
+end:
+	return ret;
+}
+
+int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
 	uint64_t timestamp_begin, timestamp_end, events_discarded;
 	struct bt_ctf_field *integer = NULL;
 	struct ctf_stream_pos packet_context_pos;
@@ -723,6 +1497,11 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 		goto end;
 	}
 
+	if (stream->async_flush) {
+		ret = async_flush_packet(stream);
+		goto end;
+	}
+
 	if (!stream->events->len) {
 		goto end;
 	}
@@ -741,9 +1520,7 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 	}
 
 	/* Set the default context attributes if present and unset. */
-	if (!get_event_header_timestamp(
-		((struct bt_ctf_event *) g_ptr_array_index(
-		stream->events, 0))->event_header, &timestamp_begin)) {
+	if (!get_stream_event_timestamp(stream, 0, &timestamp_begin)) {
 		ret = set_structure_field_integer(stream->packet_context,
 			"timestamp_begin", timestamp_begin);
 		if (ret) {
@@ -751,9 +1528,7 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 		}
 	}
 
-	if (!get_event_header_timestamp(
-		((struct bt_ctf_event *) g_ptr_array_index(
-		stream->events, stream->events->len - 1))->event_header,
+	if (!get_stream_event_timestamp(stream, stream->events->len - 1,
 		&timestamp_end)) {
 
 		ret = set_structure_field_integer(stream->packet_context,
@@ -802,37 +1577,10 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 		goto end;
 	}
 
-	for (i = 0; i < stream->events->len; i++) {
-		struct bt_ctf_event *event = g_ptr_array_index(
-			stream->events, i);
-
-		ret = bt_ctf_field_reset(event->event_header);
-		if (ret) {
-			goto end;
-		}
-
-		/* Write event header */
-		ret = bt_ctf_field_serialize(event->event_header,
-			&stream->pos);
-		if (ret) {
-			goto end;
-		}
-
-		/* Write stream event context */
-		if (stream->event_contexts) {
-			ret = bt_ctf_field_serialize(
-				g_ptr_array_index(stream->event_contexts, i),
-				&stream->pos);
-			if (ret) {
-				goto end;
-			}
-		}
-
-		/* Write event content */
-		ret = bt_ctf_event_serialize(event, &stream->pos);
-		if (ret) {
-			goto end;
-		}
+	ret = serialize_events(stream, stream->events,
+		stream->event_contexts, stream->raw_events);
+	if (ret) {
+		goto end;
 	}
 
 	/*
@@ -861,6 +1609,7 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 	}
 
 	g_ptr_array_set_size(stream->events, 0);
+	g_ptr_array_set_size(stream->raw_events, 0);
 	if (stream->event_contexts) {
 		g_ptr_array_set_size(stream->event_contexts, 0);
 	}
@@ -886,6 +1635,9 @@ void bt_ctf_stream_destroy(struct bt_object *obj)
 	struct bt_ctf_stream *stream;
 
 	stream = container_of(obj, struct bt_ctf_stream, base);
+	if (stream->async_flush) {
+		async_flush_stop(stream);
+	}
 	ctf_fini_pos(&stream->pos);
 	if (stream->pos.fd >= 0 && close(stream->pos.fd)) {
 		perror("close");
@@ -898,9 +1650,14 @@ void bt_ctf_stream_destroy(struct bt_object *obj)
 	if (stream->event_contexts) {
 		g_ptr_array_free(stream->event_contexts, TRUE);
 	}
+	if (stream->raw_events) {
+		g_ptr_array_free(stream->raw_events, TRUE);
+	}
 	bt_put(stream->packet_header);
 	bt_put(stream->packet_context);
 	bt_put(stream->event_context);
+	bt_put(stream->event_context_snapshot);
+	bt_put(stream->raw_event_header);
 	g_free(stream);
 }
 
@@ -111,7 +111,7 @@ struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
 	struct ctf_file_stream *file_stream;
 	struct bt_ctf_event *ret;
 	struct ctf_stream_definition *stream;
-	struct packet_index *packet_index;
+	struct packet_index packet_index_copy, *packet_index;
 
 	/*
 	 * We do not want to fail for any other reason than end of
@@ -152,11 +152,15 @@ struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
 	ret->parent = g_ptr_array_index(stream->events_by_id,
 			stream->event_id);
 
-	if (!file_stream->pos.packet_index)
+	if (!file_stream->pos.packet_index
+			|| file_stream->pos.cur_index >=
+				file_stream->pos.packet_index->len) {
 		packet_index = NULL;
-	else
-		packet_index = &g_array_index(file_stream->pos.packet_index,
-				struct packet_index, file_stream->pos.cur_index);
+	} else {
+		ctf_packet_index_get(file_stream->pos.packet_index,
+				file_stream->pos.cur_index, &packet_index_copy);
+		packet_index = &packet_index_copy;
+	}
 	iter->events_lost = 0;
 	if (packet_index && packet_index->events_discarded >
 			file_stream->pos.last_events_discarded) {
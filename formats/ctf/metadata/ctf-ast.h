@@ -297,7 +297,10 @@ struct ctf_node {
 };
 
 struct ctf_ast {
+	/* Top-level nodes parsed since the last ctf_scanner_commit_ast(). */
 	struct ctf_node root;
+	/* Top-level nodes already validated and constructed. */
+	struct ctf_node constructed;
 };
 
 const char *node_type(struct ctf_node *node);
@@ -314,6 +317,23 @@ BT_HIDDEN
 int ctf_visitor_construct_metadata(FILE *fd, int depth, struct ctf_node *node,
 			struct ctf_trace *trace, int byte_order);
 BT_HIDDEN
+void ctf_init_metadata(struct ctf_trace *trace);
+BT_HIDDEN
 int ctf_destroy_metadata(struct ctf_trace *trace);
 
+BT_HIDDEN
+int ctf_metadata_cache_load(struct ctf_trace *trace, const char *cache_dir,
+			const char *text, size_t len);
+BT_HIDDEN
+int ctf_metadata_cache_store(struct ctf_trace *trace, const char *cache_dir,
+			const char *text, size_t len);
+BT_HIDDEN
+int ctf_metadata_intern_get(struct ctf_trace *trace, const char *text,
+			size_t len);
+BT_HIDDEN
+int ctf_metadata_intern_add(struct ctf_trace *trace, const char *text,
+			size_t len);
+BT_HIDDEN
+void ctf_metadata_intern_destroy(struct ctf_trace *trace);
+
 #endif /* _CTF_AST_H */
@@ -0,0 +1,1601 @@
+/*
+ * ctf-metadata-cache.c
+ *
+ * Common Trace Format Metadata Cache (compiled declarations).
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The cache holds the declarations constructed from a metadata text,
+ * in a file named after the SHA-256 of that text. Layout, in host byte
+ * order:
+ *
+ *   header (magic, version, host byte order, flags, text length)
+ *   string table (every name, path component and clock string once)
+ *   clocks
+ *   declarations (children before parents, referenced by index)
+ *   trace, callsites, stream classes and events
+ *
+ * References to strings and declarations are 1-based indexes, 0
+ * standing for NULL. Declarations shared between several fields
+ * (typealiases) are stored once and stay shared when loaded.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <pthread.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/list.h>
+#include <babeltrace/types.h>
+#include <babeltrace/arena-internal.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/endian.h>
+#include <babeltrace/ctf/events-internal.h>
+#include "ctf-ast.h"
+
+#define CACHE_MAGIC	0x434d5442	/* "BTMC" */
+#define CACHE_VERSION	2
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t host_byte_order;
+	uint32_t flags;
+	uint64_t text_len;
+};
+
+enum cache_flags {
+	CACHE_FLAG_FORCE_CORRELATE =	(1U << 0),
+};
+
+struct cache_writer {
+	GHashTable *string_index;	/* string -> index + 1 */
+	GPtrArray *strings;
+	GHashTable *declaration_index;	/* declaration -> index + 1 */
+	GString *declarations;
+	uint32_t nr_declarations;
+};
+
+struct cache_reader {
+	const char *pos, *end;
+	GPtrArray *strings;		/* Pointers into the cache file */
+	GPtrArray *declarations;	/* One reference held on each */
+	struct ctf_trace *trace;
+};
+
+static
+void write_u8(GString *out, uint8_t v)
+{
+	g_string_append_len(out, (const char *) &v, sizeof(v));
+}
+
+static
+void write_u32(GString *out, uint32_t v)
+{
+	g_string_append_len(out, (const char *) &v, sizeof(v));
+}
+
+static
+void write_u64(GString *out, uint64_t v)
+{
+	g_string_append_len(out, (const char *) &v, sizeof(v));
+}
+
+static
+void write_string(struct cache_writer *w, GString *out, const char *str)
+{
+	gpointer index;
+
+	if (!str) {
+		write_u32(out, 0);
+		return;
+	}
+	index = g_hash_table_lookup(w->string_index, str);
+	if (!index) {
+		g_ptr_array_add(w->strings, (gpointer) str);
+		index = GUINT_TO_POINTER(w->strings->len);
+		g_hash_table_insert(w->string_index, (gpointer) str, index);
+	}
+	write_u32(out, GPOINTER_TO_UINT(index));
+}
+
+static
+void write_quark(struct cache_writer *w, GString *out, GQuark q)
+{
+	write_string(w, out, q ? g_quark_to_string(q) : NULL);
+}
+
+static
+void write_path(struct cache_writer *w, GString *out, GArray *path)
+{
+	int i;
+
+	write_u32(out, path->len);
+	for (i = 0; i < path->len; i++)
+		write_quark(w, out, g_array_index(path, GQuark, i));
+}
+
+static
+int write_declaration(struct cache_writer *w,
+		struct bt_declaration *declaration, uint32_t *ref);
+
+static
+int write_fields(struct cache_writer *w, GString *out, GArray *fields)
+{
+	uint32_t *refs;
+	int i, ret = 0;
+
+	/* Children are written first, so that loading never looks ahead. */
+	refs = g_new(uint32_t, fields->len);
+	for (i = 0; i < fields->len; i++) {
+		struct declaration_field *field =
+			&g_array_index(fields, struct declaration_field, i);
+
+		ret = write_declaration(w, field->declaration, &refs[i]);
+		if (ret)
+			goto end;
+	}
+	write_u32(out, fields->len);
+	for (i = 0; i < fields->len; i++) {
+		struct declaration_field *field =
+			&g_array_index(fields, struct declaration_field, i);
+
+		write_quark(w, out, field->name);
+		write_u32(out, refs[i]);
+	}
+end:
+	g_free(refs);
+	return ret;
+}
+
+/*
+ * Ranges are written in their insertion order: the labels of a value
+ * matched by several ranges are returned in that order.
+ */
+static
+void write_enum_ranges(struct cache_writer *w, GString *out,
+		struct declaration_enum *enum_declaration)
+{
+	GArray *entries = enum_declaration->table.entries;
+	int i;
+
+	write_u32(out, entries->len);
+	for (i = 0; i < entries->len; i++) {
+		struct enum_entry *entry =
+			&g_array_index(entries, struct enum_entry, i);
+
+		write_quark(w, out, entry->quark);
+		write_u64(out, entry->range.start._unsigned);
+		write_u64(out, entry->range.end._unsigned);
+	}
+}
+
+static
+int write_declaration(struct cache_writer *w,
+		struct bt_declaration *declaration, uint32_t *ref)
+{
+	GString *rec;
+	gpointer index;
+	uint32_t child;
+	int ret = 0;
+
+	if (!declaration) {
+		*ref = 0;
+		return 0;
+	}
+	index = g_hash_table_lookup(w->declaration_index, declaration);
+	if (index) {
+		*ref = GPOINTER_TO_UINT(index);
+		return 0;
+	}
+
+	rec = g_string_new(NULL);
+	write_u8(rec, declaration->id);
+	write_u64(rec, declaration->alignment);
+	switch (declaration->id) {
+	case CTF_TYPE_INTEGER:
+	{
+		struct declaration_integer *integer_declaration =
+			container_of(declaration, struct declaration_integer, p);
+
+		write_u64(rec, integer_declaration->len);
+		write_u32(rec, integer_declaration->byte_order);
+		write_u32(rec, integer_declaration->signedness);
+		write_u32(rec, integer_declaration->base);
+		write_u32(rec, integer_declaration->encoding);
+		write_quark(w, rec, integer_declaration->clock ?
+			integer_declaration->clock->name : 0);
+		break;
+	}
+	case CTF_TYPE_FLOAT:
+	{
+		struct declaration_float *float_declaration =
+			container_of(declaration, struct declaration_float, p);
+
+		write_u32(rec, float_declaration->byte_order);
+		write_u64(rec, float_declaration->mantissa->len + 1);
+		write_u64(rec, float_declaration->exp->len);
+		break;
+	}
+	case CTF_TYPE_ENUM:
+	{
+		struct declaration_enum *enum_declaration =
+			container_of(declaration, struct declaration_enum, p);
+
+		ret = write_declaration(w, &enum_declaration->integer_declaration->p,
+				&child);
+		if (ret)
+			goto end;
+		write_u32(rec, child);
+		write_enum_ranges(w, rec, enum_declaration);
+		break;
+	}
+	case CTF_TYPE_STRING:
+	{
+		struct declaration_string *string_declaration =
+			container_of(declaration, struct declaration_string, p);
+
+		write_u32(rec, string_declaration->encoding);
+		break;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		struct declaration_struct *struct_declaration =
+			container_of(declaration, struct declaration_struct, p);
+
+		ret = write_fields(w, rec, struct_declaration->fields);
+		break;
+	}
+	case CTF_TYPE_UNTAGGED_VARIANT:
+	{
+		struct declaration_untagged_variant *untagged_variant_declaration =
+			container_of(declaration, struct declaration_untagged_variant, p);
+
+		ret = write_fields(w, rec, untagged_variant_declaration->fields);
+		break;
+	}
+	case CTF_TYPE_VARIANT:
+	{
+		struct declaration_variant *variant_declaration =
+			container_of(declaration, struct declaration_variant, p);
+
+		ret = write_declaration(w, &variant_declaration->untagged_variant->p,
+				&child);
+		if (ret)
+			goto end;
+		write_u32(rec, child);
+		write_path(w, rec, variant_declaration->tag_name);
+		break;
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		struct declaration_array *array_declaration =
+			container_of(declaration, struct declaration_array, p);
+
+		ret = write_declaration(w, array_declaration->elem, &child);
+		if (ret)
+			goto end;
+		write_u64(rec, array_declaration->len);
+		write_u32(rec, child);
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct declaration_sequence *sequence_declaration =
+			container_of(declaration, struct declaration_sequence, p);
+
+		ret = write_declaration(w, sequence_declaration->elem, &child);
+		if (ret)
+			goto end;
+		write_path(w, rec, sequence_declaration->length_name);
+		write_u32(rec, child);
+		break;
+	}
+	default:
+		ret = -EINVAL;
+		break;
+	}
+	if (ret)
+		goto end;
+
+	g_string_append_len(w->declarations, rec->str, rec->len);
+	*ref = ++w->nr_declarations;
+	g_hash_table_insert(w->declaration_index, declaration,
+		GUINT_TO_POINTER(*ref));
+end:
+	g_string_free(rec, TRUE);
+	return ret;
+}
+
+static
+void write_clocks(struct cache_writer *w, GString *out, struct ctf_trace *trace)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	write_u32(out, g_hash_table_size(trace->parent.clocks));
+	g_hash_table_iter_init(&iter, trace->parent.clocks);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ctf_clock *clock = value;
+
+		write_quark(w, out, clock->name);
+		write_quark(w, out, clock->uuid);
+		write_string(w, out, clock->description);
+		write_u64(out, clock->freq);
+		write_u64(out, clock->precision);
+		write_u64(out, clock->offset_s);
+		write_u64(out, clock->offset);
+		write_u32(out, clock->absolute);
+		write_u32(out, clock->field_mask);
+	}
+	write_quark(w, out, trace->parent.single_clock ?
+		trace->parent.single_clock->name : 0);
+}
+
+static
+void write_trace(struct cache_writer *w, GString *out, struct ctf_trace *trace,
+		uint32_t packet_header)
+{
+	struct ctf_tracer_env *env = &trace->env;
+
+	write_u64(out, trace->major);
+	write_u64(out, trace->minor);
+	g_string_append_len(out, (const char *) trace->uuid,
+		sizeof(trace->uuid));
+	write_u32(out, trace->byte_order);
+	write_u32(out, trace->field_mask);
+	write_u32(out, packet_header);
+	write_u32(out, env->vpid);
+	write_string(w, out, env->procname);
+	write_string(w, out, env->hostname);
+	write_string(w, out, env->domain);
+	write_string(w, out, env->sysname);
+	write_string(w, out, env->release);
+	write_string(w, out, env->version);
+}
+
+static
+void write_callsites(struct cache_writer *w, GString *out,
+		struct ctf_trace *trace)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	uint32_t nr_callsites = 0;
+	struct ctf_callsite *callsite;
+
+	g_hash_table_iter_init(&iter, trace->callsites);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ctf_callsite_dups *cs_dups = value;
+
+		bt_list_for_each_entry(callsite, &cs_dups->head, node)
+			nr_callsites++;
+	}
+	write_u32(out, nr_callsites);
+
+	g_hash_table_iter_init(&iter, trace->callsites);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ctf_callsite_dups *cs_dups = value;
+
+		bt_list_for_each_entry(callsite, &cs_dups->head, node) {
+			write_quark(w, out, callsite->name);
+			write_string(w, out, callsite->func);
+			write_string(w, out, callsite->file);
+			write_u64(out, callsite->line);
+			write_u64(out, callsite->ip);
+			write_u32(out, callsite->field_mask);
+		}
+	}
+}
+
+static
+int write_streams(struct cache_writer *w, GString *out,
+		struct ctf_trace *trace)
+{
+	int i, ret;
+
+	write_u32(out, trace->streams->len);
+	for (i = 0; i < trace->streams->len; i++) {
+		struct ctf_stream_declaration *stream;
+		uint32_t packet_context, event_header, event_context;
+
+		stream = g_ptr_array_index(trace->streams, i);
+		if (!stream) {
+			write_u8(out, 0);
+			continue;
+		}
+		ret = write_declaration(w, stream->packet_context_decl ?
+				&stream->packet_context_decl->p : NULL,
+				&packet_context);
+		if (ret)
+			return ret;
+		ret = write_declaration(w, stream->event_header_decl ?
+				&stream->event_header_decl->p : NULL,
+				&event_header);
+		if (ret)
+			return ret;
+		ret = write_declaration(w, stream->event_context_decl ?
+				&stream->event_context_decl->p : NULL,
+				&event_context);
+		if (ret)
+			return ret;
+		write_u8(out, 1);
+		write_u64(out, stream->stream_id);
+		write_u32(out, stream->field_mask);
+		write_u32(out, packet_context);
+		write_u32(out, event_header);
+		write_u32(out, event_context);
+	}
+	return 0;
+}
+
+static
+int write_events(struct cache_writer *w, GString *out,
+		struct ctf_trace *trace)
+{
+	int i, ret;
+
+	write_u32(out, trace->event_declarations->len);
+	for (i = 0; i < trace->event_declarations->len; i++) {
+		struct bt_ctf_event_decl *event_decl;
+		struct ctf_event_declaration *event;
+		uint32_t context, fields;
+
+		event_decl = g_ptr_array_index(trace->event_declarations, i);
+		event = &event_decl->parent;
+		ret = write_declaration(w, event->context_decl ?
+				&event->context_decl->p : NULL, &context);
+		if (ret)
+			return ret;
+		ret = write_declaration(w, event->fields_decl ?
+				&event->fields_decl->p : NULL, &fields);
+		if (ret)
+			return ret;
+		write_quark(w, out, event->name);
+		write_u64(out, event->id);
+		write_u64(out, event->stream_id);
+		write_u32(out, event->loglevel);
+		write_quark(w, out, event->model_emf_uri);
+		write_u32(out, event->field_mask);
+		write_u32(out, context);
+		write_u32(out, fields);
+	}
+	return 0;
+}
+
+static
+char *cache_path(const char *cache_dir, const char *text, size_t len)
+{
+	gchar *checksum;
+	char *path;
+
+	checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+			(const guchar *) text, len);
+	if (!checksum)
+		return NULL;
+	path = g_build_filename(cache_dir, checksum, NULL);
+	g_free(checksum);
+	return path;
+}
+
+static
+void init_header(struct cache_header *header, size_t len)
+{
+	memset(header, 0, sizeof(*header));
+	header->magic = CACHE_MAGIC;
+	header->version = CACHE_VERSION;
+	header->host_byte_order = BYTE_ORDER;
+	if (opt_clock_force_correlate)
+		header->flags |= CACHE_FLAG_FORCE_CORRELATE;
+	header->text_len = len;
+}
+
+/*
+ * Store the declarations constructed from a metadata text. The trace
+ * byte order is mandatory in the metadata, so the text alone
+ * determines the construction result.
+ */
+int ctf_metadata_cache_store(struct ctf_trace *trace, const char *cache_dir,
+		const char *text, size_t len)
+{
+	struct cache_writer w;
+	struct cache_header header;
+	GString *clocks = NULL, *body = NULL, *out = NULL;
+	uint32_t packet_header;
+	char *path = NULL, *tmp_path = NULL;
+	int i, fd = -1, ret = 0;
+
+	memset(&w, 0, sizeof(w));
+	w.string_index = g_hash_table_new(g_str_hash, g_str_equal);
+	w.strings = g_ptr_array_new();
+	w.declaration_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+	w.declarations = g_string_new(NULL);
+	clocks = g_string_new(NULL);
+	body = g_string_new(NULL);
+
+	write_clocks(&w, clocks, trace);
+	ret = write_declaration(&w, trace->packet_header_decl ?
+			&trace->packet_header_decl->p : NULL, &packet_header);
+	if (ret)
+		goto end;
+	write_trace(&w, body, trace, packet_header);
+	write_callsites(&w, body, trace);
+	ret = write_streams(&w, body, trace);
+	if (ret)
+		goto end;
+	ret = write_events(&w, body, trace);
+	if (ret)
+		goto end;
+
+	out = g_string_new(NULL);
+	init_header(&header, len);
+	g_string_append_len(out, (const char *) &header, sizeof(header));
+	write_u32(out, w.strings->len);
+	for (i = 0; i < w.strings->len; i++) {
+		const char *str = g_ptr_array_index(w.strings, i);
+		size_t str_len = strlen(str);
+
+		write_u32(out, str_len);
+		g_string_append_len(out, str, str_len + 1);
+	}
+	g_string_append_len(out, clocks->str, clocks->len);
+	write_u32(out, w.nr_declarations);
+	g_string_append_len(out, w.declarations->str, w.declarations->len);
+	g_string_append_len(out, body->str, body->len);
+
+	if (g_mkdir_with_parents(cache_dir, 0755) < 0) {
+		ret = -errno;
+		goto end;
+	}
+	path = cache_path(cache_dir, text, len);
+	if (!path) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	/* Write to a temporary file, so readers never see a partial cache. */
+	tmp_path = g_strdup_printf("%s.XXXXXX", path);
+	fd = g_mkstemp(tmp_path);
+	if (fd < 0) {
+		ret = -errno;
+		goto end;
+	}
+	if (write(fd, out->str, out->len) != out->len) {
+		ret = -EIO;
+		goto end;
+	}
+	if (close(fd)) {
+		fd = -1;
+		ret = -errno;
+		goto end;
+	}
+	fd = -1;
+	if (rename(tmp_path, path)) {
+		ret = -errno;
+		goto end;
+	}
+	printf_verbose("Stored compiled metadata in \"%s\".\n", path);
+end:
+	if (fd >= 0)
+		close(fd);
+	if (ret && tmp_path)
+		(void) unlink(tmp_path);
+	g_free(tmp_path);
+	g_free(path);
+	if (out)
+		g_string_free(out, TRUE);
+	g_string_free(body, TRUE);
+	g_string_free(clocks, TRUE);
+	g_string_free(w.declarations, TRUE);
+	g_hash_table_destroy(w.declaration_index);
+	g_ptr_array_free(w.strings, TRUE);
+	g_hash_table_destroy(w.string_index);
+	return ret;
+}
+
+static
+int read_bytes(struct cache_reader *r, void *dest, size_t len)
+{
+	if (r->end - r->pos < len)
+		return -EINVAL;
+	memcpy(dest, r->pos, len);
+	r->pos += len;
+	return 0;
+}
+
+static
+int read_u8(struct cache_reader *r, uint8_t *v)
+{
+	return read_bytes(r, v, sizeof(*v));
+}
+
+static
+int read_u32(struct cache_reader *r, uint32_t *v)
+{
+	return read_bytes(r, v, sizeof(*v));
+}
+
+static
+int read_u64(struct cache_reader *r, uint64_t *v)
+{
+	return read_bytes(r, v, sizeof(*v));
+}
+
+static
+int read_string(struct cache_reader *r, const char **str)
+{
+	uint32_t index;
+
+	if (read_u32(r, &index))
+		return -EINVAL;
+	if (index > r->strings->len)
+		return -EINVAL;
+	*str = index ? g_ptr_array_index(r->strings, index - 1) : NULL;
+	return 0;
+}
+
+static
+int read_quark(struct cache_reader *r, GQuark *q)
+{
+	const char *str;
+
+	if (read_string(r, &str))
+		return -EINVAL;
+	*q = str ? g_quark_from_string(str) : 0;
+	return 0;
+}
+
+static
+int read_env_string(struct cache_reader *r, char *dest)
+{
+	const char *str;
+
+	if (read_string(r, &str))
+		return -EINVAL;
+	if (!str || strlen(str) >= TRACER_ENV_LEN)
+		return -EINVAL;
+	strcpy(dest, str);
+	return 0;
+}
+
+/*
+ * Returns a borrowed reference on an already loaded declaration,
+ * optionally checking its type. A 0 reference yields NULL.
+ */
+static
+int read_declaration_ref(struct cache_reader *r,
+		enum ctf_type_id id, struct bt_declaration **declaration)
+{
+	uint32_t index;
+
+	if (read_u32(r, &index))
+		return -EINVAL;
+	if (index > r->declarations->len)
+		return -EINVAL;
+	if (!index) {
+		*declaration = NULL;
+		return 0;
+	}
+	*declaration = g_ptr_array_index(r->declarations, index - 1);
+	if (id != CTF_TYPE_UNKNOWN && (*declaration)->id != id)
+		return -EINVAL;
+	return 0;
+}
+
+static
+int read_path(struct cache_reader *r, GArray *path)
+{
+	uint32_t len, i;
+
+	if (read_u32(r, &len))
+		return -EINVAL;
+	for (i = 0; i < len; i++) {
+		GQuark q;
+
+		if (read_quark(r, &q) || !q)
+			return -EINVAL;
+		g_array_append_val(path, q);
+	}
+	return 0;
+}
+
+static
+struct bt_declaration *read_integer(struct cache_reader *r, uint64_t alignment)
+{
+	struct declaration_integer *integer_declaration;
+	struct ctf_clock *clock = NULL;
+	uint64_t len;
+	uint32_t byte_order, signedness, base, encoding;
+	GQuark clock_name;
+
+	if (read_u64(r, &len) || read_u32(r, &byte_order)
+	    || read_u32(r, &signedness) || read_u32(r, &base)
+	    || read_u32(r, &encoding) || read_quark(r, &clock_name))
+		return NULL;
+	if (!len || len > 64 || encoding >= CTF_STRING_UNKNOWN)
+		return NULL;
+	if (clock_name) {
+		clock = g_hash_table_lookup(r->trace->parent.clocks,
+			(gpointer) (unsigned long) clock_name);
+		if (!clock)
+			return NULL;
+	}
+	integer_declaration = bt_integer_declaration_new(len, byte_order,
+			signedness, alignment, base, encoding, clock);
+	return &integer_declaration->p;
+}
+
+static
+struct bt_declaration *read_float(struct cache_reader *r, uint64_t alignment)
+{
+	struct declaration_float *float_declaration;
+	uint32_t byte_order;
+	uint64_t mantissa_len, exp_len;
+
+	if (read_u32(r, &byte_order) || read_u64(r, &mantissa_len)
+	    || read_u64(r, &exp_len))
+		return NULL;
+	if (mantissa_len < 2 || !exp_len || mantissa_len + exp_len > 128)
+		return NULL;
+	float_declaration = bt_float_declaration_new(mantissa_len, exp_len,
+			byte_order, alignment);
+	return &float_declaration->p;
+}
+
+static
+struct bt_declaration *read_enum(struct cache_reader *r)
+{
+	struct bt_declaration *integer;
+	struct declaration_integer *integer_declaration;
+	struct declaration_enum *enum_declaration;
+	uint32_t nr_ranges, i;
+
+	if (read_declaration_ref(r, CTF_TYPE_INTEGER, &integer) || !integer)
+		return NULL;
+	if (read_u32(r, &nr_ranges))
+		return NULL;
+	integer_declaration = container_of(integer,
+			struct declaration_integer, p);
+	enum_declaration = bt_enum_declaration_new(integer_declaration);
+	for (i = 0; i < nr_ranges; i++) {
+		GQuark q;
+		uint64_t start, end;
+
+		if (read_quark(r, &q) || !q || read_u64(r, &start)
+		    || read_u64(r, &end))
+			goto error;
+		if (integer_declaration->signedness)
+			bt_enum_signed_insert(enum_declaration,
+				(int64_t) start, (int64_t) end, q);
+		else
+			bt_enum_unsigned_insert(enum_declaration,
+				start, end, q);
+	}
+	return &enum_declaration->p;
+
+error:
+	bt_declaration_unref(&enum_declaration->p);
+	return NULL;
+}
+
+static
+struct bt_declaration *read_string_declaration(struct cache_reader *r)
+{
+	struct declaration_string *string_declaration;
+	uint32_t encoding;
+
+	if (read_u32(r, &encoding) || encoding >= CTF_STRING_UNKNOWN)
+		return NULL;
+	string_declaration = bt_string_declaration_new(encoding);
+	return &string_declaration->p;
+}
+
+static
+struct bt_declaration *read_struct(struct cache_reader *r, uint64_t alignment)
+{
+	struct declaration_struct *struct_declaration;
+	uint32_t nr_fields, i;
+
+	if (read_u32(r, &nr_fields))
+		return NULL;
+	struct_declaration = bt_struct_declaration_new(
+			r->trace->root_declaration_scope, alignment);
+	for (i = 0; i < nr_fields; i++) {
+		const char *name;
+		struct bt_declaration *field;
+
+		if (read_string(r, &name) || !name
+		    || read_declaration_ref(r, CTF_TYPE_UNKNOWN, &field)
+		    || !field)
+			goto error;
+		bt_struct_declaration_add_field(struct_declaration, name, field);
+	}
+	return &struct_declaration->p;
+
+error:
+	bt_declaration_unref(&struct_declaration->p);
+	return NULL;
+}
+
+static
+struct bt_declaration *read_untagged_variant(struct cache_reader *r)
+{
+	struct declaration_untagged_variant *untagged_variant_declaration;
+	uint32_t nr_fields, i;
+
+	if (read_u32(r, &nr_fields))
+		return NULL;
+	untagged_variant_declaration = bt_untagged_bt_variant_declaration_new(
+			r->trace->root_declaration_scope);
+	for (i = 0; i < nr_fields; i++) {
+		const char *name;
+		struct bt_declaration *field;
+
+		if (read_string(r, &name) || !name
+		    || read_declaration_ref(r, CTF_TYPE_UNKNOWN, &field)
+		    || !field)
+			goto error;
+		bt_untagged_variant_declaration_add_field(
+			untagged_variant_declaration, name, field);
+	}
+	return &untagged_variant_declaration->p;
+
+error:
+	bt_declaration_unref(&untagged_variant_declaration->p);
+	return NULL;
+}
+
+static
+struct bt_declaration *read_variant(struct cache_reader *r)
+{
+	struct bt_declaration *untagged;
+	struct declaration_variant *variant_declaration;
+
+	if (read_declaration_ref(r, CTF_TYPE_UNTAGGED_VARIANT, &untagged)
+	    || !untagged)
+		return NULL;
+	/* The tag path is restored as is, without splitting it on dots. */
+	variant_declaration = bt_variant_declaration_new(
+			container_of(untagged,
+				struct declaration_untagged_variant, p), "");
+	if (read_path(r, variant_declaration->tag_name)) {
+		bt_declaration_unref(&variant_declaration->p);
+		return NULL;
+	}
+	return &variant_declaration->p;
+}
+
+static
+struct bt_declaration *read_array(struct cache_reader *r)
+{
+	struct declaration_array *array_declaration;
+	struct bt_declaration *elem;
+	uint64_t len;
+
+	if (read_u64(r, &len)
+	    || read_declaration_ref(r, CTF_TYPE_UNKNOWN, &elem) || !elem)
+		return NULL;
+	array_declaration = bt_array_declaration_new(len, elem,
+			r->trace->root_declaration_scope);
+	return &array_declaration->p;
+}
+
+static
+struct bt_declaration *read_sequence(struct cache_reader *r)
+{
+	struct declaration_sequence *sequence_declaration;
+	struct bt_declaration *elem;
+	GArray *length_name;
+
+	length_name = g_array_new(FALSE, TRUE, sizeof(GQuark));
+	if (read_path(r, length_name)
+	    || read_declaration_ref(r, CTF_TYPE_UNKNOWN, &elem) || !elem) {
+		g_array_free(length_name, TRUE);
+		return NULL;
+	}
+	sequence_declaration = bt_sequence_declaration_new("", elem,
+			r->trace->root_declaration_scope);
+	g_array_append_vals(sequence_declaration->length_name,
+		length_name->data, length_name->len);
+	g_array_free(length_name, TRUE);
+	return &sequence_declaration->p;
+}
+
+static
+int read_declaration(struct cache_reader *r)
+{
+	struct bt_declaration *declaration;
+	uint8_t id;
+	uint64_t alignment;
+
+	if (read_u8(r, &id) || read_u64(r, &alignment))
+		return -EINVAL;
+	if (!alignment || (alignment & (alignment - 1)))
+		return -EINVAL;
+	switch (id) {
+	case CTF_TYPE_INTEGER:
+		declaration = read_integer(r, alignment);
+		break;
+	case CTF_TYPE_FLOAT:
+		declaration = read_float(r, alignment);
+		break;
+	case CTF_TYPE_ENUM:
+		declaration = read_enum(r);
+		break;
+	case CTF_TYPE_STRING:
+		declaration = read_string_declaration(r);
+		break;
+	case CTF_TYPE_STRUCT:
+		declaration = read_struct(r, alignment);
+		break;
+	case CTF_TYPE_UNTAGGED_VARIANT:
+		declaration = read_untagged_variant(r);
+		break;
+	case CTF_TYPE_VARIANT:
+		declaration = read_variant(r);
+		break;
+	case CTF_TYPE_ARRAY:
+		declaration = read_array(r);
+		break;
+	case CTF_TYPE_SEQUENCE:
+		declaration = read_sequence(r);
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (!declaration)
+		return -EINVAL;
+	/* Alignment may have been raised by the fields after construction. */
+	declaration->alignment = alignment;
+	g_ptr_array_add(r->declarations, declaration);
+	return 0;
+}
+
+/*
+ * Helpers filling a trace from decoded or shared metadata. The
+ * declarations passed in are referenced, not owned.
+ */
+static
+struct ctf_trace *alloc_metadata_trace(void)
+{
+	struct ctf_trace *trace;
+
+	trace = g_new0(struct ctf_trace, 1);
+	ctf_init_metadata(trace);
+	trace->root_declaration_scope = bt_new_declaration_scope(NULL);
+	trace->declaration_scope = bt_new_declaration_scope(
+			trace->root_declaration_scope);
+	trace->streams = g_ptr_array_new();
+	trace->event_declarations = g_ptr_array_new();
+	return trace;
+}
+
+static
+void free_metadata_trace(struct ctf_trace *trace)
+{
+	ctf_destroy_metadata(trace);
+	g_free(trace);
+}
+
+/* Move the metadata of "src" into "dst", and free "src". */
+static
+void move_metadata_trace(struct ctf_trace *dst, struct ctf_trace *src)
+{
+	int i;
+
+	dst->root_declaration_scope = src->root_declaration_scope;
+	dst->declaration_scope = src->declaration_scope;
+	dst->streams = src->streams;
+	dst->event_declarations = src->event_declarations;
+	dst->packet_header_decl = src->packet_header_decl;
+	dst->callsites = src->callsites;
+	dst->parent.clocks = src->parent.clocks;
+	dst->parent.single_clock = src->parent.single_clock;
+	dst->major = src->major;
+	dst->minor = src->minor;
+	memcpy(dst->uuid, src->uuid, sizeof(dst->uuid));
+	dst->byte_order = src->byte_order;
+	dst->env = src->env;
+	dst->field_mask = src->field_mask;
+	dst->declaration_arena = src->declaration_arena;
+	for (i = 0; i < dst->streams->len; i++) {
+		struct ctf_stream_declaration *stream;
+
+		stream = g_ptr_array_index(dst->streams, i);
+		if (stream)
+			stream->trace = dst;
+	}
+	g_free(src);
+}
+
+static
+struct ctf_clock *add_clock(struct ctf_trace *trace,
+		const struct ctf_clock *model)
+{
+	struct ctf_clock *clock;
+
+	clock = g_new(struct ctf_clock, 1);
+	*clock = *model;
+	clock->description = g_strdup(model->description);
+	g_hash_table_insert(trace->parent.clocks,
+		(gpointer) (unsigned long) clock->name, clock);
+	return clock;
+}
+
+static
+void add_callsite(struct ctf_trace *trace, const struct ctf_callsite *model)
+{
+	struct ctf_callsite *callsite;
+	struct ctf_callsite_dups *cs_dups;
+
+	callsite = g_new(struct ctf_callsite, 1);
+	*callsite = *model;
+	callsite->func = g_strdup(model->func);
+	callsite->file = g_strdup(model->file);
+
+	cs_dups = g_hash_table_lookup(trace->callsites,
+		(gpointer) (unsigned long) callsite->name);
+	if (!cs_dups) {
+		cs_dups = g_new0(struct ctf_callsite_dups, 1);
+		BT_INIT_LIST_HEAD(&cs_dups->head);
+		g_hash_table_insert(trace->callsites,
+			(gpointer) (unsigned long) callsite->name, cs_dups);
+	}
+	bt_list_add_tail(&callsite->node, &cs_dups->head);
+}
+
+static
+struct declaration_struct *get_struct(struct declaration_struct *declaration)
+{
+	if (declaration)
+		bt_declaration_ref(&declaration->p);
+	return declaration;
+}
+
+static
+int add_stream(struct ctf_trace *trace,
+		const struct ctf_stream_declaration *model)
+{
+	struct ctf_stream_declaration *stream;
+
+	if (trace->streams->len <= model->stream_id)
+		g_ptr_array_set_size(trace->streams, model->stream_id + 1);
+	if (g_ptr_array_index(trace->streams, model->stream_id))
+		return -EINVAL;
+
+	stream = g_new0(struct ctf_stream_declaration, 1);
+	stream->declaration_scope = bt_new_declaration_scope(
+			trace->root_declaration_scope);
+	stream->events_by_id = g_ptr_array_new();
+	stream->event_quark_to_id = g_hash_table_new(g_direct_hash,
+			g_direct_equal);
+	stream->streams = g_ptr_array_new();
+	stream->stream_id = model->stream_id;
+	stream->field_mask = model->field_mask;
+	stream->packet_context_decl = get_struct(model->packet_context_decl);
+	stream->event_header_decl = get_struct(model->event_header_decl);
+	stream->event_context_decl = get_struct(model->event_context_decl);
+	stream->trace = trace;
+	g_ptr_array_index(trace->streams, model->stream_id) = stream;
+	return 0;
+}
+
+static
+int add_event(struct ctf_trace *trace,
+		const struct ctf_event_declaration *model)
+{
+	struct bt_ctf_event_decl *event_decl;
+	struct ctf_event_declaration *event;
+	struct ctf_stream_declaration *stream;
+
+	if (model->stream_id >= trace->streams->len)
+		return -EINVAL;
+	stream = g_ptr_array_index(trace->streams, model->stream_id);
+	if (!stream || model->id > UINT32_MAX)
+		return -EINVAL;
+	if (model->id < stream->events_by_id->len
+	    && g_ptr_array_index(stream->events_by_id, model->id))
+		return -EINVAL;
+
+	event_decl = g_new0(struct bt_ctf_event_decl, 1);
+	event = &event_decl->parent;
+	event->declaration_scope = bt_new_declaration_scope(
+			trace->root_declaration_scope);
+	event->name = model->name;
+	event->id = model->id;
+	event->stream_id = model->stream_id;
+	event->loglevel = model->loglevel;
+	event->model_emf_uri = model->model_emf_uri;
+	event->field_mask = model->field_mask;
+	event->stream = stream;
+	event->context_decl = get_struct(model->context_decl);
+	event->fields_decl = get_struct(model->fields_decl);
+	if (stream->events_by_id->len <= event->id)
+		g_ptr_array_set_size(stream->events_by_id, event->id + 1);
+	g_ptr_array_index(stream->events_by_id, event->id) = event;
+	g_hash_table_insert(stream->event_quark_to_id,
+			(gpointer) (unsigned long) event->name,
+			&event->id);
+	g_ptr_array_add(trace->event_declarations, event_decl);
+	return 0;
+}
+
+static
+int read_clocks(struct cache_reader *r)
+{
+	struct ctf_trace *trace = r->trace;
+	uint32_t nr_clocks, i;
+	GQuark single_clock;
+
+	if (read_u32(r, &nr_clocks))
+		return -EINVAL;
+	for (i = 0; i < nr_clocks; i++) {
+		struct ctf_clock clock;
+		const char *description;
+		uint32_t absolute, field_mask;
+
+		memset(&clock, 0, sizeof(clock));
+		if (read_quark(r, &clock.name) || !clock.name
+		    || read_quark(r, &clock.uuid)
+		    || read_string(r, &description)
+		    || read_u64(r, &clock.freq)
+		    || read_u64(r, &clock.precision)
+		    || read_u64(r, &clock.offset_s)
+		    || read_u64(r, &clock.offset)
+		    || read_u32(r, &absolute)
+		    || read_u32(r, &field_mask))
+			return -EINVAL;
+		clock.description = (char *) description;
+		clock.absolute = absolute;
+		clock.field_mask = field_mask;
+		add_clock(trace, &clock);
+	}
+	if (read_quark(r, &single_clock))
+		return -EINVAL;
+	if (single_clock) {
+		trace->parent.single_clock = g_hash_table_lookup(
+			trace->parent.clocks,
+			(gpointer) (unsigned long) single_clock);
+		if (!trace->parent.single_clock)
+			return -EINVAL;
+	}
+	return 0;
+}
+
+static
+int read_trace(struct cache_reader *r)
+{
+	struct ctf_trace *trace = r->trace;
+	struct bt_declaration *packet_header;
+	uint32_t byte_order, field_mask, vpid;
+
+	if (read_u64(r, &trace->major) || read_u64(r, &trace->minor)
+	    || read_bytes(r, trace->uuid, sizeof(trace->uuid))
+	    || read_u32(r, &byte_order) || read_u32(r, &field_mask)
+	    || read_declaration_ref(r, CTF_TYPE_STRUCT, &packet_header)
+	    || read_u32(r, &vpid)
+	    || read_env_string(r, trace->env.procname)
+	    || read_env_string(r, trace->env.hostname)
+	    || read_env_string(r, trace->env.domain)
+	    || read_env_string(r, trace->env.sysname)
+	    || read_env_string(r, trace->env.release)
+	    || read_env_string(r, trace->env.version))
+		return -EINVAL;
+	trace->byte_order = byte_order;
+	trace->field_mask = field_mask;
+	trace->env.vpid = vpid;
+	if (packet_header) {
+		bt_declaration_ref(packet_header);
+		trace->packet_header_decl = container_of(packet_header,
+				struct declaration_struct, p);
+	}
+	return 0;
+}
+
+static
+int read_callsites(struct cache_reader *r)
+{
+	uint32_t nr_callsites, i;
+
+	if (read_u32(r, &nr_callsites))
+		return -EINVAL;
+	for (i = 0; i < nr_callsites; i++) {
+		struct ctf_callsite callsite;
+		const char *func, *file;
+		uint32_t field_mask;
+
+		memset(&callsite, 0, sizeof(callsite));
+		if (read_quark(r, &callsite.name) || read_string(r, &func)
+		    || read_string(r, &file) || read_u64(r, &callsite.line)
+		    || read_u64(r, &callsite.ip)
+		    || read_u32(r, &field_mask))
+			return -EINVAL;
+		callsite.func = (char *) func;
+		callsite.file = (char *) file;
+		callsite.field_mask = field_mask;
+		add_callsite(r->trace, &callsite);
+	}
+	return 0;
+}
+
+static
+int read_streams(struct cache_reader *r)
+{
+	uint32_t nr_streams, i;
+
+	if (read_u32(r, &nr_streams))
+		return -EINVAL;
+	for (i = 0; i < nr_streams; i++) {
+		struct ctf_stream_declaration stream;
+		struct bt_declaration *packet_context, *event_header,
+			*event_context;
+		uint8_t present;
+		uint32_t field_mask;
+
+		if (read_u8(r, &present))
+			return -EINVAL;
+		if (!present)
+			continue;
+		memset(&stream, 0, sizeof(stream));
+		if (read_u64(r, &stream.stream_id) || stream.stream_id != i
+		    || read_u32(r, &field_mask)
+		    || read_declaration_ref(r, CTF_TYPE_STRUCT, &packet_context)
+		    || read_declaration_ref(r, CTF_TYPE_STRUCT, &event_header)
+		    || read_declaration_ref(r, CTF_TYPE_STRUCT, &event_context))
+			return -EINVAL;
+		stream.field_mask = field_mask;
+		if (packet_context)
+			stream.packet_context_decl = container_of(packet_context,
+					struct declaration_struct, p);
+		if (event_header)
+			stream.event_header_decl = container_of(event_header,
+					struct declaration_struct, p);
+		if (event_context)
+			stream.event_context_decl = container_of(event_context,
+					struct declaration_struct, p);
+		if (add_stream(r->trace, &stream))
+			return -EINVAL;
+	}
+	g_ptr_array_set_size(r->trace->streams, nr_streams);
+	return 0;
+}
+
+static
+int read_events(struct cache_reader *r)
+{
+	uint32_t nr_events, i;
+
+	if (read_u32(r, &nr_events))
+		return -EINVAL;
+	for (i = 0; i < nr_events; i++) {
+		struct ctf_event_declaration event;
+		struct bt_declaration *context, *fields;
+		uint32_t loglevel, field_mask;
+
+		memset(&event, 0, sizeof(event));
+		if (read_quark(r, &event.name) || !event.name
+		    || read_u64(r, &event.id)
+		    || read_u64(r, &event.stream_id)
+		    || read_u32(r, &loglevel)
+		    || read_quark(r, &event.model_emf_uri)
+		    || read_u32(r, &field_mask)
+		    || read_declaration_ref(r, CTF_TYPE_STRUCT, &context)
+		    || read_declaration_ref(r, CTF_TYPE_STRUCT, &fields))
+			return -EINVAL;
+		event.loglevel = (int32_t) loglevel;
+		event.field_mask = field_mask;
+		if (context)
+			event.context_decl = container_of(context,
+					struct declaration_struct, p);
+		if (fields)
+			event.fields_decl = container_of(fields,
+					struct declaration_struct, p);
+		if (add_event(r->trace, &event))
+			return -EINVAL;
+	}
+	return 0;
+}
+
+static
+int read_cache(struct cache_reader *r)
+{
+	uint32_t nr_strings, nr_declarations, i;
+
+	if (read_u32(r, &nr_strings))
+		return -EINVAL;
+	for (i = 0; i < nr_strings; i++) {
+		uint32_t len;
+
+		if (read_u32(r, &len) || r->end - r->pos <= len
+		    || r->pos[len] != '\0')
+			return -EINVAL;
+		g_ptr_array_add(r->strings, (gpointer) r->pos);
+		r->pos += len + 1;
+	}
+	if (read_clocks(r))
+		return -EINVAL;
+	if (read_u32(r, &nr_declarations))
+		return -EINVAL;
+	for (i = 0; i < nr_declarations; i++) {
+		if (read_declaration(r))
+			return -EINVAL;
+	}
+	if (read_trace(r) || read_callsites(r) || read_streams(r)
+	    || read_events(r))
+		return -EINVAL;
+	if (r->pos != r->end)
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * Fill the trace declarations from the cache entry of a metadata
+ * text, as ctf_visitor_construct_metadata() would. Returns -ENOENT
+ * if there is no usable entry, leaving the trace untouched.
+ */
+int ctf_metadata_cache_load(struct ctf_trace *trace, const char *cache_dir,
+		const char *text, size_t len)
+{
+	struct cache_reader r;
+	struct cache_header header, expected;
+	struct ctf_trace *tmp;
+	struct bt_arena *prev_arena;
+	gchar *contents = NULL;
+	gsize contents_len;
+	char *path;
+	int i, ret = 0;
+
+	path = cache_path(cache_dir, text, len);
+	if (!path)
+		return -ENOMEM;
+	if (!g_file_get_contents(path, &contents, &contents_len, NULL)) {
+		ret = -ENOENT;
+		goto end_path;
+	}
+	init_header(&expected, len);
+	if (contents_len < sizeof(header)) {
+		ret = -ENOENT;
+		goto end_contents;
+	}
+	memcpy(&header, contents, sizeof(header));
+	if (memcmp(&header, &expected, sizeof(header))) {
+		ret = -ENOENT;
+		goto end_contents;
+	}
+
+	/*
+	 * Decode into a scratch trace, so that a corrupted entry can be
+	 * dropped without touching the caller's trace.
+	 */
+	tmp = alloc_metadata_trace();
+	tmp->declaration_arena = bt_arena_create();
+	prev_arena = bt_declaration_set_arena(tmp->declaration_arena);
+	memset(&r, 0, sizeof(r));
+	r.pos = contents + sizeof(header);
+	r.end = contents + contents_len;
+	r.strings = g_ptr_array_new();
+	r.declarations = g_ptr_array_new();
+	r.trace = tmp;
+	ret = read_cache(&r);
+	(void) bt_declaration_set_arena(prev_arena);
+	for (i = 0; i < r.declarations->len; i++)
+		bt_declaration_unref(g_ptr_array_index(r.declarations, i));
+	g_ptr_array_free(r.declarations, TRUE);
+	g_ptr_array_free(r.strings, TRUE);
+	if (ret) {
+		fprintf(stderr, "[warning] Ignoring corrupted metadata cache \"%s\".\n",
+			path);
+		free_metadata_trace(tmp);
+		ret = -ENOENT;
+		goto end_contents;
+	}
+	move_metadata_trace(trace, tmp);
+	printf_verbose("Loaded compiled metadata from \"%s\".\n", path);
+
+end_contents:
+	g_free(contents);
+end_path:
+	g_free(path);
+	return ret;
+}
+
+/*
+ * Metadata interning: traces opened with byte-identical metadata share
+ * their declarations. Each interned metadata keeps a template trace,
+ * which owns the clocks the shared integer declarations refer to. The
+ * traces themselves get their own clocks, callsites, environment,
+ * stream classes and event declarations, referencing the shared
+ * declarations.
+ *
+ * Traces may be opened and closed concurrently: the intern table and
+ * the template traces are protected by intern_lock.
+ */
+struct ctf_metadata_intern {
+	char *key;			/* SHA-256 of the metadata text */
+	int refcount;
+	struct ctf_trace *trace;	/* Template */
+};
+
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *intern_table;	/* key -> struct ctf_metadata_intern */
+
+/* Fill the scratch trace "dst" with a copy of "src" sharing its declarations. */
+static
+void clone_metadata_trace(struct ctf_trace *dst, struct ctf_trace *src)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	int i;
+
+	g_hash_table_iter_init(&iter, src->parent.clocks);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ctf_clock *clock;
+
+		clock = add_clock(dst, value);
+		if (value == src->parent.single_clock)
+			dst->parent.single_clock = clock;
+	}
+	g_hash_table_iter_init(&iter, src->callsites);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ctf_callsite_dups *cs_dups = value;
+		struct ctf_callsite *callsite;
+
+		bt_list_for_each_entry(callsite, &cs_dups->head, node)
+			add_callsite(dst, callsite);
+	}
+	dst->major = src->major;
+	dst->minor = src->minor;
+	memcpy(dst->uuid, src->uuid, sizeof(dst->uuid));
+	dst->byte_order = src->byte_order;
+	dst->env = src->env;
+	dst->field_mask = src->field_mask;
+	/* The declarations are shared: so is the arena holding them. */
+	bt_arena_get(src->declaration_arena);
+	dst->declaration_arena = src->declaration_arena;
+	dst->packet_header_decl = get_struct(src->packet_header_decl);
+	for (i = 0; i < src->streams->len; i++) {
+		struct ctf_stream_declaration *stream;
+
+		stream = g_ptr_array_index(src->streams, i);
+		if (stream)
+			(void) add_stream(dst, stream);
+	}
+	g_ptr_array_set_size(dst->streams, src->streams->len);
+	for (i = 0; i < src->event_declarations->len; i++) {
+		struct bt_ctf_event_decl *event_decl;
+
+		event_decl = g_ptr_array_index(src->event_declarations, i);
+		(void) add_event(dst, &event_decl->parent);
+	}
+}
+
+static
+char *intern_key(const char *text, size_t len)
+{
+	return g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+			(const guchar *) text, len);
+}
+
+/*
+ * Fill the trace with the interned metadata matching the text, if any.
+ * Returns -ENOENT otherwise.
+ */
+int ctf_metadata_intern_get(struct ctf_trace *trace, const char *text,
+		size_t len)
+{
+	struct ctf_metadata_intern *intern = NULL;
+	struct ctf_trace *tmp;
+	char *key;
+
+	key = intern_key(text, len);
+	if (!key)
+		return -ENOMEM;
+	pthread_mutex_lock(&intern_lock);
+	if (intern_table)
+		intern = g_hash_table_lookup(intern_table, key);
+	if (!intern) {
+		pthread_mutex_unlock(&intern_lock);
+		g_free(key);
+		return -ENOENT;
+	}
+	tmp = alloc_metadata_trace();
+	clone_metadata_trace(tmp, intern->trace);
+	move_metadata_trace(trace, tmp);
+	intern->refcount++;
+	trace->metadata_intern = intern;
+	pthread_mutex_unlock(&intern_lock);
+	g_free(key);
+	return 0;
+}
+
+/*
+ * Intern the metadata just constructed for the trace, so that the
+ * next traces opened with the same text share its declarations.
+ */
+int ctf_metadata_intern_add(struct ctf_trace *trace, const char *text,
+		size_t len)
+{
+	struct ctf_metadata_intern *intern;
+	struct ctf_trace *tmpl;
+	GHashTable *clocks;
+	struct ctf_clock *single_clock;
+	char *key;
+
+	key = intern_key(text, len);
+	if (!key)
+		return -ENOMEM;
+	pthread_mutex_lock(&intern_lock);
+	if (!intern_table)
+		intern_table = g_hash_table_new(g_str_hash, g_str_equal);
+	if (g_hash_table_lookup(intern_table, key)) {
+		/* Interned concurrently: keep our own copy. */
+		pthread_mutex_unlock(&intern_lock);
+		g_free(key);
+		return 0;
+	}
+	tmpl = alloc_metadata_trace();
+	clone_metadata_trace(tmpl, trace);
+	/*
+	 * The declarations refer to the clocks of the trace: hand them
+	 * over to the template, which lives as long as the declarations
+	 * are shared, and give the trace the copies.
+	 */
+	clocks = tmpl->parent.clocks;
+	single_clock = tmpl->parent.single_clock;
+	tmpl->parent.clocks = trace->parent.clocks;
+	tmpl->parent.single_clock = trace->parent.single_clock;
+	trace->parent.clocks = clocks;
+	trace->parent.single_clock = single_clock;
+
+	intern = g_new0(struct ctf_metadata_intern, 1);
+	intern->key = key;
+	intern->refcount = 1;
+	intern->trace = tmpl;
+	g_hash_table_insert(intern_table, intern->key, intern);
+	trace->metadata_intern = intern;
+	pthread_mutex_unlock(&intern_lock);
+	return 0;
+}
+
+/*
+ * Destroy the metadata of a trace filled by ctf_metadata_intern_get()
+ * or interned by ctf_metadata_intern_add(), releasing the template
+ * with its last user.
+ */
+void ctf_metadata_intern_destroy(struct ctf_trace *trace)
+{
+	struct ctf_metadata_intern *intern = trace->metadata_intern;
+
+	pthread_mutex_lock(&intern_lock);
+	ctf_destroy_metadata(trace);
+	trace->metadata_intern = NULL;
+	if (--intern->refcount == 0) {
+		g_hash_table_remove(intern_table, intern->key);
+		free_metadata_trace(intern->trace);
+		g_free(intern->key);
+		g_free(intern);
+	}
+	pthread_mutex_unlock(&intern_lock);
+}
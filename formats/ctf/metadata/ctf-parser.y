@@ -68,6 +68,11 @@ int yylex_destroy(yyscan_t yyscanner);
 BT_HIDDEN
 void yyrestart(FILE * in_str, yyscan_t yyscanner);
 BT_HIDDEN
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size,
+		yyscan_t yyscanner);
+BT_HIDDEN
+void yy_delete_buffer(struct yy_buffer_state *b, yyscan_t yyscanner);
+BT_HIDDEN
 int yyget_lineno(yyscan_t yyscanner);
 BT_HIDDEN
 char *yyget_text(yyscan_t yyscanner);
@@ -969,6 +974,15 @@ static struct ctf_ast *ctf_ast_alloc(struct ctf_scanner *scanner)
 	BT_INIT_LIST_HEAD(&ast->root.u.root.event);
 	BT_INIT_LIST_HEAD(&ast->root.u.root.clock);
 	BT_INIT_LIST_HEAD(&ast->root.u.root.callsite);
+	ast->constructed.type = NODE_ROOT;
+	BT_INIT_LIST_HEAD(&ast->constructed.tmp_head);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.declaration_list);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.trace);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.env);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.stream);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.event);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.clock);
+	BT_INIT_LIST_HEAD(&ast->constructed.u.root.callsite);
 	return ast;
 }
 
@@ -983,6 +997,55 @@ int ctf_scanner_append_ast(struct ctf_scanner *scanner, FILE *input)
 	return yyparse(scanner, scanner->scanner);
 }
 
+/*
+ * Parse the "len" bytes of text at "buf", which must be followed by
+ * two '\0' bytes. The scanner reads the buffer in place: its content
+ * is temporarily modified while parsing.
+ */
+int ctf_scanner_append_ast_buffer(struct ctf_scanner *scanner, char *buf,
+		size_t len)
+{
+	struct yy_buffer_state *bs;
+	int ret;
+
+	bs = yy_scan_buffer(buf, len + 2, scanner->scanner);
+	if (!bs)
+		return -EINVAL;
+	if (yydebug)
+		fprintf(stdout, "Scanner input is a %zu bytes buffer.\n", len);
+	ret = yyparse(scanner, scanner->scanner);
+	yy_delete_buffer(bs, scanner->scanner);
+	return ret;
+}
+
+void ctf_scanner_commit_ast(struct ctf_scanner *scanner)
+{
+	struct ctf_node *root = &scanner->ast->root;
+	struct ctf_node *constructed = &scanner->ast->constructed;
+
+	_bt_list_splice_tail(&root->u.root.declaration_list,
+		&constructed->u.root.declaration_list);
+	BT_INIT_LIST_HEAD(&root->u.root.declaration_list);
+	_bt_list_splice_tail(&root->u.root.trace,
+		&constructed->u.root.trace);
+	BT_INIT_LIST_HEAD(&root->u.root.trace);
+	_bt_list_splice_tail(&root->u.root.env,
+		&constructed->u.root.env);
+	BT_INIT_LIST_HEAD(&root->u.root.env);
+	_bt_list_splice_tail(&root->u.root.stream,
+		&constructed->u.root.stream);
+	BT_INIT_LIST_HEAD(&root->u.root.stream);
+	_bt_list_splice_tail(&root->u.root.event,
+		&constructed->u.root.event);
+	BT_INIT_LIST_HEAD(&root->u.root.event);
+	_bt_list_splice_tail(&root->u.root.clock,
+		&constructed->u.root.clock);
+	BT_INIT_LIST_HEAD(&root->u.root.clock);
+	_bt_list_splice_tail(&root->u.root.callsite,
+		&constructed->u.root.callsite);
+	BT_INIT_LIST_HEAD(&root->u.root.callsite);
+}
+
 struct ctf_scanner *ctf_scanner_alloc(void)
 {
 	struct ctf_scanner *scanner;
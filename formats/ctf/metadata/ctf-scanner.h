@@ -42,6 +42,9 @@ struct ctf_scanner {
 struct ctf_scanner *ctf_scanner_alloc(void);
 void ctf_scanner_free(struct ctf_scanner *scanner);
 int ctf_scanner_append_ast(struct ctf_scanner *scanner, FILE *input);
+int ctf_scanner_append_ast_buffer(struct ctf_scanner *scanner, char *buf,
+		size_t len);
+void ctf_scanner_commit_ast(struct ctf_scanner *scanner);
 
 static inline
 struct ctf_ast *ctf_scanner_get_ast(struct ctf_scanner *scanner)
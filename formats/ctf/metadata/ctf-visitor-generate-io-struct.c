@@ -35,6 +35,7 @@
 #include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/list.h>
 #include <babeltrace/types.h>
+#include <babeltrace/arena-internal.h>
 #include <babeltrace/ctf/metadata.h>
 #include <babeltrace/compat/uuid.h>
 #include <babeltrace/endian.h>
@@ -677,7 +678,7 @@ int ctf_typedef_visit(FILE *fd, int depth, struct declaration_scope *scope,
 		}
 		ret = bt_register_declaration(identifier, type_declaration, scope);
 		if (ret) {
-			type_declaration->declaration_free(type_declaration);
+			bt_declaration_unref(type_declaration);
 			return ret;
 		}
 		bt_declaration_unref(type_declaration);
@@ -750,7 +751,7 @@ int ctf_typealias_visit(FILE *fd, int depth, struct declaration_scope *scope,
 
 error:
 	if (type_declaration) {
-		type_declaration->declaration_free(type_declaration);
+		bt_declaration_unref(type_declaration);
 	}
 	return err;
 }
@@ -908,7 +909,7 @@ struct bt_declaration *ctf_declaration_struct_visit(FILE *fd,
 		return &struct_declaration->p;
 	}
 error_free_declaration:
-	struct_declaration->p.declaration_free(&struct_declaration->p);
+	bt_declaration_unref(&struct_declaration->p);
 error:
 	return NULL;
 }
@@ -979,7 +980,7 @@ struct bt_declaration *ctf_declaration_variant_visit(FILE *fd,
 		return &variant_declaration->p;
 	}
 error:
-	untagged_variant_declaration->p.declaration_free(&untagged_variant_declaration->p);
+	bt_declaration_unref(&untagged_variant_declaration->p);
 	return NULL;
 }
 
@@ -1165,7 +1166,7 @@ struct bt_declaration *ctf_declaration_enum_visit(FILE *fd, int depth,
 		return &enum_declaration->p;
 	}
 error:
-	enum_declaration->p.declaration_free(&enum_declaration->p);
+	bt_declaration_unref(&enum_declaration->p);
 	return NULL;
 }
 
@@ -1907,6 +1908,7 @@ int ctf_event_visit(FILE *fd, int depth, struct ctf_node *node,
 	if (event->stream->events_by_id->len <= event->id)
 		g_ptr_array_set_size(event->stream->events_by_id, event->id + 1);
 	g_ptr_array_index(event->stream->events_by_id, event->id) = event;
+	event->stream->events_appended = 1;
 	g_hash_table_insert(event->stream->event_quark_to_id,
 			    (gpointer) (unsigned long) event->name,
 			    &event->id);
@@ -2959,18 +2961,98 @@ int ctf_root_declaration_visit(FILE *fd, int depth, struct ctf_node *node, struc
 	return 0;
 }
 
+/*
+ * Construct the top-level nodes appended to an already constructed
+ * trace. The clock and callsite tables and the root declaration scope
+ * are kept, and the AST root only holds the nodes parsed since the
+ * previous construction (see ctf_scanner_commit_ast()).
+ */
+static
+int ctf_visitor_append_metadata(FILE *fd, int depth, struct ctf_node *node,
+		struct ctf_trace *trace)
+{
+	int ret = 0;
+	struct ctf_node *iter;
+
+	if (node->type != NODE_ROOT) {
+		fprintf(fd, "[error] %s: unknown node type %d\n", __func__,
+			(int) node->type);
+		return -EINVAL;
+	}
+	bt_list_for_each_entry(iter, &node->u.root.clock, siblings) {
+		ret = ctf_clock_visit(fd, depth + 1, iter, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: clock declaration error\n", __func__);
+			return ret;
+		}
+	}
+	bt_list_for_each_entry(iter, &node->u.root.declaration_list, siblings) {
+		ret = ctf_root_declaration_visit(fd, depth + 1, iter, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: root declaration error\n", __func__);
+			return ret;
+		}
+	}
+	bt_list_for_each_entry(iter, &node->u.root.trace, siblings) {
+		/*
+		 * Restarting the root declarations (-EINTR) is only
+		 * possible before the first construction completed.
+		 */
+		ret = ctf_trace_visit(fd, depth + 1, iter, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: trace declaration error\n", __func__);
+			return ret == -EINTR ? -EPERM : ret;
+		}
+	}
+	bt_list_for_each_entry(iter, &node->u.root.callsite, siblings) {
+		ret = ctf_callsite_visit(fd, depth + 1, iter, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: callsite declaration error\n", __func__);
+			return ret;
+		}
+	}
+	bt_list_for_each_entry(iter, &node->u.root.env, siblings) {
+		ret = ctf_env_visit(fd, depth + 1, iter, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: env declaration error\n", __func__);
+			return ret;
+		}
+	}
+	bt_list_for_each_entry(iter, &node->u.root.stream, siblings) {
+		ret = ctf_stream_visit(fd, depth + 1, iter,
+				trace->root_declaration_scope, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: stream declaration error\n", __func__);
+			return ret;
+		}
+	}
+	bt_list_for_each_entry(iter, &node->u.root.event, siblings) {
+		ret = ctf_event_visit(fd, depth + 1, iter,
+				trace->root_declaration_scope, trace);
+		if (ret) {
+			fprintf(fd, "[error] %s: event declaration error\n", __func__);
+			return ret;
+		}
+	}
+	return 0;
+}
+
 int ctf_visitor_construct_metadata(FILE *fd, int depth, struct ctf_node *node,
 		struct ctf_trace *trace, int byte_order)
 {
 	int ret = 0;
 	struct ctf_node *iter;
 
+	if (trace->root_declaration_scope) {
+		printf_verbose("CTF visitor: metadata append...\n");
+		ret = ctf_visitor_append_metadata(fd, depth, node, trace);
+		if (!ret)
+			printf_verbose("done.\n");
+		return ret;
+	}
 	printf_verbose("CTF visitor: metadata construction...\n");
 	trace->byte_order = byte_order;
-	trace->parent.clocks = g_hash_table_new_full(g_direct_hash,
-				g_direct_equal, NULL, clock_free);
-	trace->callsites = g_hash_table_new_full(g_direct_hash, g_direct_equal,
-				NULL, callsite_free);
+	ctf_init_metadata(trace);
 
 retry:
 	trace->root_declaration_scope = bt_new_declaration_scope(NULL);
@@ -3068,11 +3150,20 @@ retry:
 
 error:
 	bt_free_declaration_scope(trace->root_declaration_scope);
+	trace->root_declaration_scope = NULL;
 	g_hash_table_destroy(trace->callsites);
 	g_hash_table_destroy(trace->parent.clocks);
 	return ret;
 }
 
+void ctf_init_metadata(struct ctf_trace *trace)
+{
+	trace->parent.clocks = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, clock_free);
+	trace->callsites = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				NULL, callsite_free);
+}
+
 int ctf_destroy_metadata(struct ctf_trace *trace)
 {
 	int i;
@@ -3113,6 +3204,7 @@ int ctf_destroy_metadata(struct ctf_trace *trace)
 					bt_definition_unref(&stream_def->stream_packet_context->p);
 				if (&stream_def->stream_event_context->p)
 					bt_definition_unref(&stream_def->stream_event_context->p);
+				bt_arena_put(stream_def->definition_arena);
 				g_ptr_array_free(stream_def->events_by_id, TRUE);
 				g_free(stream_def);
 			}
@@ -3166,6 +3258,9 @@ int ctf_destroy_metadata(struct ctf_trace *trace)
 
 	bt_free_declaration_scope(trace->root_declaration_scope);
 	bt_free_declaration_scope(trace->declaration_scope);
+	/* Everything above may still look at the declarations. */
+	bt_arena_put(trace->declaration_arena);
+	trace->declaration_arena = NULL;
 
 	g_hash_table_destroy(trace->callsites);
 	g_hash_table_destroy(trace->parent.clocks);
@@ -0,0 +1,167 @@
+/*
+ * verify.c
+ *
+ * Common Trace Format - trace health report
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+
+struct stream_report {
+	unsigned int packets;
+	uint64_t begin, end;
+	unsigned int gaps;
+	uint64_t gaps_len;
+	unsigned int overlaps;
+	uint64_t packets_lost;
+	uint64_t events_discarded;
+};
+
+static
+void stream_report_packet(struct stream_report *report,
+		const struct packet_index *prev,
+		const struct packet_index *cur, int real)
+{
+	const struct packet_index_time *prev_ts, *cur_ts;
+	uint64_t events_discarded;
+
+	cur_ts = real ? &cur->ts_real : &cur->ts_cycles;
+	events_discarded = cur->events_discarded;
+	if (!prev) {
+		report->begin = cur_ts->timestamp_begin;
+		report->end = cur_ts->timestamp_end;
+		report->events_discarded = events_discarded;
+		return;
+	}
+	prev_ts = real ? &prev->ts_real : &prev->ts_cycles;
+
+	if (cur_ts->timestamp_begin < prev_ts->timestamp_end) {
+		report->overlaps++;
+	} else if (cur_ts->timestamp_begin > prev_ts->timestamp_end) {
+		report->gaps++;
+		report->gaps_len += cur_ts->timestamp_begin
+			- prev_ts->timestamp_end;
+	}
+	if (cur_ts->timestamp_end > report->end)
+		report->end = cur_ts->timestamp_end;
+
+	/*
+	 * The discarded events field is a free-running counter, which
+	 * may wrap around if the tracer provided a 32-bit field.
+	 */
+	events_discarded -= prev->events_discarded;
+	if (prev->events_discarded_len == 32)
+		events_discarded = (uint32_t) events_discarded;
+	report->events_discarded += events_discarded;
+	/* packet_seq_num stays at 0 if not produced by the tracer */
+	if (cur->packet_seq_num > prev->packet_seq_num + 1)
+		report->packets_lost += cur->packet_seq_num
+			- prev->packet_seq_num - 1;
+}
+
+static
+int verify_file_stream(FILE *fp, struct ctf_file_stream *cfs, int real,
+		unsigned int *nr_packets)
+{
+	struct packet_index_table *packet_index = cfs->pos.packet_index;
+	struct stream_report report;
+	struct packet_index prev, cur;
+	const char *unit = real ? "ns" : "cycles";
+	unsigned int i;
+	int problems;
+
+	memset(&report, 0, sizeof(report));
+	for (i = 0; packet_index && i < packet_index->len; i++) {
+		ctf_packet_index_get(packet_index, i, &cur);
+		stream_report_packet(&report, i ? &prev : NULL, &cur, real);
+		prev = cur;
+	}
+	report.packets = i;
+
+	fprintf(fp, "  stream %s (id %" PRIu64 "): %u packets",
+		cfs->parent.path, cfs->parent.stream_id, report.packets);
+	if (report.packets)
+		fprintf(fp, ", [%" PRIu64 ", %" PRIu64 "] %s",
+			report.begin, report.end, unit);
+	fprintf(fp, "\n");
+	fprintf(fp, "    gaps: %u (%" PRIu64 " %s), overlaps: %u, "
+		"lost packets: %" PRIu64 ", discarded events: %" PRIu64 "\n",
+		report.gaps, report.gaps_len, unit, report.overlaps,
+		report.packets_lost, report.events_discarded);
+	if (cfs->truncated)
+		fprintf(fp, "    truncated packet at offset %jd\n",
+			(intmax_t) cfs->truncated_offset);
+
+	*nr_packets += report.packets;
+	problems = report.overlaps;
+	if (cfs->truncated)
+		problems++;
+	return problems;
+}
+
+int ctf_verify_trace(FILE *fp, struct bt_trace_descriptor *descriptor)
+{
+	struct ctf_trace *td = container_of(descriptor, struct ctf_trace, parent);
+	unsigned int nr_streams = 0, nr_packets = 0;
+	int i, j, problems = 0;
+	int real;
+
+	if (!td->streams)
+		return -EINVAL;
+	/* Real timestamps are only known once added to a context. */
+	real = descriptor->collection != NULL;
+
+	fprintf(fp, "trace %s\n", descriptor->path);
+	/* for each stream_class */
+	for (i = 0; i < td->streams->len; i++) {
+		struct ctf_stream_declaration *stream_class;
+
+		stream_class = g_ptr_array_index(td->streams, i);
+		if (!stream_class)
+			continue;
+		/* for each file_stream */
+		for (j = 0; j < stream_class->streams->len; j++) {
+			struct ctf_stream_definition *stream;
+			struct ctf_file_stream *cfs;
+
+			stream = g_ptr_array_index(stream_class->streams, j);
+			if (!stream)
+				continue;
+			cfs = container_of(stream, struct ctf_file_stream,
+					parent);
+			problems += verify_file_stream(fp, cfs, real,
+					&nr_packets);
+			nr_streams++;
+		}
+	}
+	fprintf(fp, "  %u streams, %u packets, %d problems\n",
+		nr_streams, nr_packets, problems);
+	return problems;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <dirent.h>
+#include <glib.h>
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/mmap-align.h>
+
+#include "lttng-live.h"
+
+/*
+ * Packet buffers are anonymous mappings of power of two sizes, kept in
+ * one free list per size so that the buffers released by a stream,
+ * e.g. when it grows or hangs up, are reused by the others instead of
+ * being unmapped and mapped again.
+ */
+#define BUFFER_MIN_ORDER	16	/* 64 kB */
+#define BUFFER_MAX_ORDER	(sizeof(size_t) * CHAR_BIT - 1)
+/* Transparent huge page size on most architectures. */
+#define BUFFER_HUGEPAGE_ORDER	21	/* 2 MB */
+
+struct lttng_live_buffer_pool {
+	GPtrArray *free[BUFFER_MAX_ORDER + 1];	/* struct mmap_align */
+	size_t cached;			/* Bytes in the free lists */
+	size_t max_cached;
+};
+
+static
+unsigned int get_order(size_t len)
+{
+	unsigned int order = BUFFER_MIN_ORDER;
+
+	while (order < BUFFER_MAX_ORDER && ((size_t) 1 << order) < len)
+		order++;
+	return order;
+}
+
+struct lttng_live_buffer_pool *lttng_live_buffer_pool_create(
+		size_t max_cached)
+{
+	struct lttng_live_buffer_pool *pool;
+
+	pool = g_new0(struct lttng_live_buffer_pool, 1);
+	pool->max_cached = max_cached;
+	return pool;
+}
+
+void lttng_live_buffer_pool_destroy(struct lttng_live_buffer_pool *pool)
+{
+	unsigned int order, i;
+
+	if (!pool)
+		return;
+	for (order = 0; order <= BUFFER_MAX_ORDER; order++) {
+		GPtrArray *list = pool->free[order];
+
+		if (!list)
+			continue;
+		for (i = 0; i < list->len; i++)
+			(void) munmap_align(g_ptr_array_index(list, i));
+		g_ptr_array_free(list, TRUE);
+	}
+	g_free(pool);
+}
+
+/*
+ * Get a buffer of at least len bytes. Its actual size is its length.
+ * Returns NULL on error.
+ */
+struct mmap_align *lttng_live_buffer_get(struct lttng_live_buffer_pool *pool,
+		size_t len)
+{
+	unsigned int order = get_order(len);
+	GPtrArray *list = pool->free[order];
+	struct mmap_align *mma;
+
+	if (list && list->len) {
+		mma = g_ptr_array_remove_index_fast(list, list->len - 1);
+		pool->cached -= mma->length;
+		return mma;
+	}
+
+	mma = mmap_align((size_t) 1 << order, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mma == MAP_FAILED) {
+		perror("[error] mmap error");
+		return NULL;
+	}
+#ifdef MADV_HUGEPAGE
+	if (order >= BUFFER_HUGEPAGE_ORDER)
+		(void) madvise(mma->page_aligned_addr,
+				mma->page_aligned_length, MADV_HUGEPAGE);
+#endif
+	printf_verbose("Mapped a %zu bytes packet buffer\n", mma->length);
+	return mma;
+}
+
+/* Release a buffer obtained from lttng_live_buffer_get(). */
+void lttng_live_buffer_put(struct lttng_live_buffer_pool *pool,
+		struct mmap_align *mma)
+{
+	unsigned int order;
+
+	if (!mma)
+		return;
+	order = get_order(mma->length);
+	if (mma->length != (size_t) 1 << order
+			|| pool->cached + mma->length > pool->max_cached) {
+		if (munmap_align(mma))
+			perror("[error] Unable to unmap packet buffer");
+		return;
+	}
+	if (!pool->free[order])
+		pool->free[order] = g_ptr_array_new();
+	g_ptr_array_add(pool->free[order], mma);
+	pool->cached += mma->length;
+}
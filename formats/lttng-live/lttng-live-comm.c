@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <poll.h>
+#include <time.h>
 
 #include <babeltrace/ctf/ctf-index.h>
 
@@ -77,21 +78,57 @@ static int get_new_metadata(struct lttng_live_ctx *ctx,
 		struct lttng_live_viewer_stream *viewer_stream,
 		char **metadata_buf);
 
+static
+uint64_t get_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The relay sockets are non-blocking, so that the prefetch responses of
+ * several relays can be received as they arrive, see
+ * prefetch_drain(). Block here until the socket is ready otherwise.
+ */
+static
+int lttng_live_wait_fd(int fd, short events)
+{
+	struct pollfd pollfd;
+	int ret;
+
+	pollfd.fd = fd;
+	pollfd.events = events;
+	do {
+		ret = poll(&pollfd, 1, -1);
+	} while (ret < 0 && errno == EINTR);
+	return ret < 0 ? -1 : 0;
+}
+
 static
 ssize_t lttng_live_recv(int fd, void *buf, size_t len)
 {
 	ssize_t ret;
 	size_t copied = 0, to_copy = len;
 
-	do {
+	for (;;) {
 		ret = recv(fd, buf + copied, to_copy, 0);
 		if (ret > 0) {
 			assert(ret <= to_copy);
 			copied += ret;
 			to_copy -= ret;
+			if (!to_copy)
+				break;
+		} else if (ret == 0) {
+			break;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (lttng_live_wait_fd(fd, POLLIN))
+				break;
+		} else if (errno != EINTR) {
+			break;
 		}
-	} while ((ret > 0 && to_copy > 0)
-		|| (ret < 0 && errno == EINTR));
+	}
 	if (ret > 0)
 		ret = copied;
 	/* ret = 0 means orderly shutdown, ret < 0 is error. */
@@ -102,10 +139,23 @@ static
 ssize_t lttng_live_send(int fd, const void *buf, size_t len)
 {
 	ssize_t ret;
+	size_t sent = 0;
 
-	do {
-		ret = bt_send_nosigpipe(fd, buf, len);
-	} while (ret < 0 && errno == EINTR);
+	for (;;) {
+		ret = bt_send_nosigpipe(fd, buf + sent, len - sent);
+		if (ret >= 0) {
+			sent += ret;
+			if (sent == len)
+				break;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (lttng_live_wait_fd(fd, POLLOUT))
+				break;
+		} else if (errno != EINTR) {
+			break;
+		}
+	}
+	if (ret >= 0)
+		ret = sent;
 	return ret;
 }
 
@@ -143,6 +193,13 @@ int lttng_live_connect_viewer(struct lttng_live_ctx *ctx)
 		goto error;
 	}
 
+	ret = fcntl(ctx->control_sock, F_GETFL);
+	if (ret < 0 || fcntl(ctx->control_sock, F_SETFL,
+			ret | O_NONBLOCK) < 0) {
+		perror("fcntl");
+		goto error;
+	}
+
 	ret = 0;
 
 end:
@@ -618,6 +675,7 @@ int append_metadata(struct lttng_live_ctx *ctx,
 		ret = -1;
 		goto error;
 	}
+	viewer_stream->ctf_trace->metadata_seq = ctx->prefetch_seq;
 	ret = ctf_append_trace_metadata(
 			viewer_stream->ctf_trace->handle->td,
 			metadata->ctf_trace->metadata_fp);
@@ -642,13 +700,26 @@ int get_data_packet(struct lttng_live_ctx *ctx,
 	struct lttng_viewer_get_packet rq;
 	struct lttng_viewer_trace_packet rp;
 	ssize_t ret_len;
-	int ret;
+	int ret, prefetched;
 
 retry:
 	if (lttng_live_should_quit()) {
 		ret = -1;
 		goto end;
 	}
+	prefetched = stream->packet_prefetched
+		&& stream->packet_offset == offset;
+	stream->packet_prefetched = 0;
+	if (!prefetched && stream->packet_mma) {
+		lttng_live_buffer_put(ctx->buffer_pool, stream->packet_mma);
+		stream->packet_mma = NULL;
+	}
+	if (prefetched) {
+		rp.status = stream->packet_status;
+		rp.len = stream->packet_len;
+		rp.flags = stream->packet_flags;
+		goto response;
+	}
 	cmd.cmd = htobe32(LTTNG_VIEWER_GET_PACKET);
 	cmd.data_size = sizeof(rq);
 	cmd.cmd_version = 0;
@@ -688,6 +759,7 @@ retry:
 		goto error;
 	}
 
+response:
 	rp.flags = be32toh(rp.flags);
 
 	switch (be32toh(rp.status)) {
@@ -701,7 +773,13 @@ retry:
 		printf_verbose("get_data_packet: retry\n");
 		goto error;
 	case LTTNG_VIEWER_GET_PACKET_ERR:
-		if (rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA) {
+		/*
+		 * A prefetched response may predate a metadata fetch
+		 * done since: only fetch metadata again if newer.
+		 */
+		if ((rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA)
+				&& (!prefetched || stream->ctf_trace->metadata_seq
+					< stream->index_seq)) {
 			printf_verbose("get_data_packet: new metadata needed\n");
 			ret = append_metadata(ctx, stream);
 			if (ret)
@@ -713,10 +791,8 @@ retry:
 			if (ret < 0) {
 				goto error;
 			} else if (ret > 0) {
-				ret = add_traces(ctx);
-				if (ret < 0) {
-					goto error;
-				}
+				/* Opened by lttng_live_read(). */
+				ctx->session->new_streams = 1;
 			}
 		}
 		if (rp.flags & (LTTNG_VIEWER_FLAG_NEW_METADATA
@@ -737,29 +813,24 @@ retry:
 		goto error;
 	}
 
-	if (len > stream->mmap_size) {
-		uint64_t new_size;
+	if (prefetched) {
+		/* Decode from the buffer the packet was received in. */
+		lttng_live_buffer_put(ctx->buffer_pool, pos->base_mma);
+		pos->base_mma = stream->packet_mma;
+		stream->packet_mma = NULL;
+		stream->mmap_size = pos->base_mma->length;
+		ret = 0;
+		goto received;
+	}
 
-		new_size = max_t(uint64_t, len, stream->mmap_size << 1);
-		if (pos->base_mma) {
-			/* unmap old base */
-			ret = munmap_align(pos->base_mma);
-			if (ret) {
-				perror("[error] Unable to unmap old base");
-				goto error;
-			}
-			pos->base_mma = NULL;
-		}
-		pos->base_mma = mmap_align(new_size,
-				PROT_READ | PROT_WRITE,
-				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-		if (pos->base_mma == MAP_FAILED) {
-			perror("[error] mmap error");
-			pos->base_mma = NULL;
+	if (len > stream->mmap_size) {
+		lttng_live_buffer_put(ctx->buffer_pool, pos->base_mma);
+		pos->base_mma = lttng_live_buffer_get(ctx->buffer_pool, len);
+		if (!pos->base_mma) {
+			stream->mmap_size = 0;
 			goto error;
 		}
-
-		stream->mmap_size = new_size;
+		stream->mmap_size = pos->base_mma->length;
 		printf_verbose("Expanding stream mmap size to %" PRIu64 " bytes\n",
 				stream->mmap_size);
 	}
@@ -775,7 +846,16 @@ retry:
 		goto error;
 	}
 	assert(ret_len == len);
+	stream->packet_time = get_monotonic_ns();
 	ret = 0;
+received:
+	ctx->viewer->stats.packets++;
+	ctx->viewer->stats.bytes += len;
+	stream->stats.packets++;
+	stream->stats.bytes += len;
+	lttng_live_histogram_record(&ctx->viewer->stats.index_to_packet,
+			stream->packet_time - stream->index_time);
+	stream->output_pending = 1;
 end:
 	return ret;
 
@@ -900,6 +980,7 @@ int get_new_metadata(struct lttng_live_ctx *ctx,
 	int ret = 0;
 	struct lttng_live_viewer_stream *metadata_stream;
 	size_t size, len_read = 0;
+	uint64_t begin = get_monotonic_ns();
 
 	metadata_stream = viewer_stream->ctf_trace->metadata_stream;
 	if (!metadata_stream) {
@@ -939,6 +1020,9 @@ int get_new_metadata(struct lttng_live_ctx *ctx,
 	metadata_stream->metadata_fp_write = NULL;
 
 error:
+	ctx->viewer->stats.metadata_fetches++;
+	lttng_live_histogram_record(&ctx->viewer->stats.metadata_stall,
+			get_monotonic_ns() - begin);
 	return ret;
 }
 
@@ -961,57 +1045,474 @@ void lttng_index_to_packet_index(struct lttng_viewer_index *lindex,
 }
 
 /*
- * Get one index for a stream.
+ * Pipelined requests.
  *
- * Returns 0 on success or a negative value on error.
+ * The relay daemon answers the commands of a connection in order. When
+ * a stream needs an index, lttng_live_prefetch() sends GET_NEXT_INDEX
+ * for it and for up to pipeline_depth - 1 other streams without an
+ * index pending, then GET_PACKET for the packets those indexes
+ * describe, and matches each batch of responses in order: two round
+ * trips per batch instead of two per stream. The other relays of the
+ * viewer get their own batches at the same time. Responses are kept in
+ * their viewer stream, and consumed by get_next_index() and
+ * get_data_packet() as if they had just been received.
  */
-static
-int get_next_index(struct lttng_live_ctx *ctx,
-		struct lttng_live_viewer_stream *viewer_stream,
-		struct packet_index *index, uint64_t *stream_id)
-{
+struct index_request {
 	struct lttng_viewer_cmd cmd;
 	struct lttng_viewer_get_next_index rq;
-	int ret;
-	ssize_t ret_len;
-	struct lttng_viewer_index *rp = &viewer_stream->current_index;
+} __attribute__((__packed__));
 
-	cmd.cmd = htobe32(LTTNG_VIEWER_GET_NEXT_INDEX);
-	cmd.data_size = sizeof(rq);
-	cmd.cmd_version = 0;
+struct packet_request {
+	struct lttng_viewer_cmd cmd;
+	struct lttng_viewer_get_packet rq;
+} __attribute__((__packed__));
 
-	memset(&rq, 0, sizeof(rq));
-	rq.stream_id = htobe64(viewer_stream->id);
+/*
+ * The relay had no index for this stream: do not ask for one again
+ * before a delay, doubled on each consecutive retry.
+ */
+static
+void stream_backoff(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *stream)
+{
+	if (!stream->retry_delay_ms)
+		stream->retry_delay_ms = ctx->retry_min_ms;
+	else if (stream->retry_delay_ms < ctx->retry_max_ms / 2)
+		stream->retry_delay_ms *= 2;
+	else
+		stream->retry_delay_ms = ctx->retry_max_ms;
+	stream->retry_time = get_monotonic_ns()
+		+ (uint64_t) stream->retry_delay_ms * 1000000ULL;
+}
 
-retry:
-	if (lttng_live_should_quit()) {
-		ret = -1;
-		goto end;
+static
+void stream_ready(struct lttng_live_viewer_stream *stream)
+{
+	stream->retry_delay_ms = 0;
+	stream->retry_time = 0;
+}
+
+/* Wait until the back-off delay of a stream expires. */
+static
+void stream_wait(struct lttng_live_viewer_stream *stream)
+{
+	uint64_t now = get_monotonic_ns();
+
+	if (stream->retry_time > now)
+		(void) poll(NULL, 0, (stream->retry_time - now + 999999)
+				/ 1000000);
+}
+
+static
+int stream_can_prefetch(struct lttng_live_viewer_stream *stream,
+		uint64_t now)
+{
+	return !stream->metadata_flag && stream->id != -1ULL
+		&& !stream->index_prefetched && !stream->data_pending
+		&& stream->ctf_trace->in_use && stream->retry_time <= now;
+}
+
+static
+void prefetch_add_streams(struct lttng_live_ctx *ctx, GPtrArray *batch)
+{
+	struct lttng_live_viewer_stream *first =
+		batch->len ? g_ptr_array_index(batch, 0) : NULL;
+	uint64_t now = get_monotonic_ns();
+	GHashTableIter it;
+	gpointer key, value;
+	int i;
+
+	g_hash_table_iter_init(&it, ctx->session->ctf_traces);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		struct lttng_live_ctf_trace *trace = value;
+
+		for (i = 0; i < trace->streams->len; i++) {
+			struct lttng_live_viewer_stream *stream =
+				g_ptr_array_index(trace->streams, i);
+
+			if (batch->len >= ctx->pipeline_depth)
+				return;
+			if (stream == first
+					|| !stream_can_prefetch(stream, now))
+				continue;
+			g_ptr_array_add(batch, stream);
+		}
 	}
-	ret_len = lttng_live_send(ctx->control_sock, &cmd, sizeof(cmd));
-	if (ret_len < 0) {
-		perror("[error] Error sending cmd");
-		goto error;
+}
+
+static
+int send_index_requests(struct lttng_live_ctx *ctx, GPtrArray *batch)
+{
+	struct index_request *requests;
+	size_t len = batch->len * sizeof(*requests);
+	ssize_t ret_len;
+	int i, ret = 0;
+
+	requests = zmalloc(len);
+	if (!requests) {
+		perror("index requests zmalloc");
+		return -1;
 	}
-	assert(ret_len == sizeof(cmd));
+	for (i = 0; i < batch->len; i++) {
+		struct lttng_live_viewer_stream *stream =
+			g_ptr_array_index(batch, i);
 
-	ret_len = lttng_live_send(ctx->control_sock, &rq, sizeof(rq));
+		requests[i].cmd.cmd = htobe32(LTTNG_VIEWER_GET_NEXT_INDEX);
+		requests[i].cmd.data_size = sizeof(requests[i].rq);
+		requests[i].cmd.cmd_version = 0;
+		requests[i].rq.stream_id = htobe64(stream->id);
+	}
+	/* Send the whole batch at once. */
+	ret_len = lttng_live_send(ctx->control_sock, requests, len);
 	if (ret_len < 0) {
 		perror("[error] Error sending get_next_index request");
-		goto error;
+		ret = -1;
+		goto end;
 	}
-	assert(ret_len == sizeof(rq));
+	assert(ret_len == len);
+end:
+	free(requests);
+	return ret;
+}
+
+static
+int recv_index_response(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *stream, int requested)
+{
+	struct lttng_viewer_index rp;
+	ssize_t ret_len;
 
-	ret_len = lttng_live_recv(ctx->control_sock, rp, sizeof(*rp));
+	ret_len = lttng_live_recv(ctx->control_sock, &rp, sizeof(rp));
 	if (ret_len == 0) {
 		fprintf(stderr, "[error] Remote side has closed connection\n");
-		goto error;
+		return -1;
 	}
 	if (ret_len < 0) {
 		perror("[error] Error receiving index response");
-		goto error;
+		return -1;
+	}
+	assert(ret_len == sizeof(rp));
+
+	ctx->viewer->stats.index_requests++;
+	stream->stats.index_requests++;
+	/*
+	 * Other streams ask again when they need an index, once their
+	 * back-off delay expired.
+	 */
+	if (be32toh(rp.status) == LTTNG_VIEWER_INDEX_RETRY) {
+		ctx->viewer->stats.index_retries++;
+		stream->stats.index_retries++;
+		stream_backoff(ctx, stream);
+		if (!requested)
+			return 0;
+	} else {
+		stream_ready(stream);
+		stream->index_time = get_monotonic_ns();
+	}
+	stream->current_index = rp;
+	stream->index_prefetched = 1;
+	stream->index_seq = ctx->prefetch_seq;
+	return 0;
+}
+
+static
+int recv_packet_response(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *stream)
+{
+	struct lttng_viewer_trace_packet rp;
+	ssize_t ret_len;
+	uint32_t len;
+
+	ret_len = lttng_live_recv(ctx->control_sock, &rp, sizeof(rp));
+	if (ret_len == 0) {
+		fprintf(stderr, "[error] Remote side has closed connection\n");
+		return -1;
+	}
+	if (ret_len < 0) {
+		perror("[error] Error receiving data response");
+		return -1;
+	}
+	assert(ret_len == sizeof(rp));
+
+	stream->packet_status = rp.status;
+	stream->packet_len = rp.len;
+	stream->packet_flags = rp.flags;
+	if (be32toh(rp.status) == LTTNG_VIEWER_GET_PACKET_OK) {
+		len = be32toh(rp.len);
+		if (stream->packet_mma && stream->packet_mma->length < len) {
+			lttng_live_buffer_put(ctx->buffer_pool,
+					stream->packet_mma);
+			stream->packet_mma = NULL;
+		}
+		if (!stream->packet_mma) {
+			stream->packet_mma = lttng_live_buffer_get(
+					ctx->buffer_pool, len);
+			if (!stream->packet_mma)
+				return -1;
+		}
+		ret_len = lttng_live_recv(ctx->control_sock,
+				mmap_align_addr(stream->packet_mma), len);
+		if (ret_len == 0) {
+			fprintf(stderr, "[error] Remote side has closed connection\n");
+			return -1;
+		}
+		if (ret_len < 0) {
+			perror("[error] Error receiving trace packet");
+			return -1;
+		}
+		assert(ret_len == len);
+		stream->packet_time = get_monotonic_ns();
 	}
-	assert(ret_len == sizeof(*rp));
+	stream->packet_offset = be64toh(stream->current_index.offset);
+	stream->packet_prefetched = 1;
+	return 0;
+}
+
+/*
+ * Request the packets of the indexes received in the index batch of a
+ * relay. Indexes flagged with new metadata or streams are left for
+ * get_data_packet(), after these are handled.
+ */
+static
+int send_packet_requests(struct lttng_live_ctx *ctx)
+{
+	struct packet_request *requests;
+	GPtrArray *batch = ctx->prefetch_streams;
+	GPtrArray *packets;
+	ssize_t ret_len;
+	size_t len;
+	int i, ret = 0;
+
+	packets = g_ptr_array_new();
+	for (i = 0; i < batch->len; i++) {
+		struct lttng_live_viewer_stream *stream =
+			g_ptr_array_index(batch, i);
+		struct lttng_viewer_index *index = &stream->current_index;
+
+		if (!stream->index_prefetched
+				|| be32toh(index->status) != LTTNG_VIEWER_INDEX_OK
+				|| index->flags || !index->packet_size)
+			continue;
+		g_ptr_array_add(packets, stream);
+	}
+	if (!packets->len)
+		goto end;
+
+	len = packets->len * sizeof(*requests);
+	requests = zmalloc(len);
+	if (!requests) {
+		perror("packet requests zmalloc");
+		ret = -1;
+		goto end;
+	}
+	for (i = 0; i < packets->len; i++) {
+		struct lttng_live_viewer_stream *stream =
+			g_ptr_array_index(packets, i);
+		struct lttng_viewer_index *index = &stream->current_index;
+
+		requests[i].cmd.cmd = htobe32(LTTNG_VIEWER_GET_PACKET);
+		requests[i].cmd.data_size = sizeof(requests[i].rq);
+		requests[i].cmd.cmd_version = 0;
+		requests[i].rq.stream_id = htobe64(stream->id);
+		requests[i].rq.offset = index->offset;
+		requests[i].rq.len = htobe32(be64toh(index->packet_size)
+				/ CHAR_BIT);
+	}
+	ret_len = lttng_live_send(ctx->control_sock, requests, len);
+	free(requests);
+	if (ret_len < 0) {
+		perror("[error] Error sending get_data_packet request");
+		ret = -1;
+		goto end;
+	}
+	assert(ret_len == len);
+end:
+	g_ptr_array_set_size(batch, 0);
+	for (i = 0; i < packets->len; i++)
+		g_ptr_array_add(batch, g_ptr_array_index(packets, i));
+	ctx->prefetch_received = 0;
+	ctx->prefetch_stage = packets->len ? LTTNG_LIVE_PREFETCH_PACKET
+		: LTTNG_LIVE_PREFETCH_IDLE;
+	g_ptr_array_free(packets, TRUE);
+	return ret;
+}
+
+/*
+ * Send the index requests of a relay: for the stream which needs an
+ * index, if any, and for the other streams ready for one.
+ */
+static
+int prefetch_start(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *viewer_stream)
+{
+	GPtrArray *batch = ctx->prefetch_streams;
+	int ret;
+
+	assert(ctx->prefetch_stage == LTTNG_LIVE_PREFETCH_IDLE);
+	g_ptr_array_set_size(batch, 0);
+	if (viewer_stream)
+		g_ptr_array_add(batch, viewer_stream);
+	prefetch_add_streams(ctx, batch);
+	if (!batch->len)
+		return 0;
+
+	ret = send_index_requests(ctx, batch);
+	if (ret)
+		return ret;
+	ctx->prefetch_seq++;
+	ctx->prefetch_requested = viewer_stream;
+	ctx->prefetch_received = 0;
+	ctx->prefetch_stage = LTTNG_LIVE_PREFETCH_INDEX;
+	return 0;
+}
+
+/* Receive the next response expected from a relay. */
+static
+int prefetch_recv_one(struct lttng_live_ctx *ctx)
+{
+	struct lttng_live_viewer_stream *stream;
+	GPtrArray *batch = ctx->prefetch_streams;
+	int ret;
+
+	stream = g_ptr_array_index(batch, ctx->prefetch_received++);
+	switch (ctx->prefetch_stage) {
+	case LTTNG_LIVE_PREFETCH_INDEX:
+		ret = recv_index_response(ctx, stream,
+				stream == ctx->prefetch_requested);
+		if (ret || ctx->prefetch_received < batch->len)
+			return ret;
+		ctx->prefetch_requested = NULL;
+		if (ctx->pipeline_depth > 1)
+			return send_packet_requests(ctx);
+		break;
+	case LTTNG_LIVE_PREFETCH_PACKET:
+		ret = recv_packet_response(ctx, stream);
+		if (ret || ctx->prefetch_received < batch->len)
+			return ret;
+		break;
+	default:
+		abort();
+	}
+	ctx->prefetch_stage = LTTNG_LIVE_PREFETCH_IDLE;
+	return 0;
+}
+
+/*
+ * Receive the responses of all the relays with requests in flight, in
+ * the order they become readable, until every relay is idle again:
+ * other requests expect no response to be pending.
+ */
+static
+int prefetch_drain(struct lttng_live_viewer *viewer)
+{
+	struct pollfd *pollfds;
+	struct lttng_live_ctx **relays;
+	int i, nfds, ret = 0;
+
+	pollfds = g_new(struct pollfd, viewer->relays->len);
+	relays = g_new(struct lttng_live_ctx *, viewer->relays->len);
+	for (;;) {
+		nfds = 0;
+		for (i = 0; i < viewer->relays->len; i++) {
+			struct lttng_live_ctx *ctx =
+				g_ptr_array_index(viewer->relays, i);
+
+			if (ctx->prefetch_stage == LTTNG_LIVE_PREFETCH_IDLE)
+				continue;
+			pollfds[nfds].fd = ctx->control_sock;
+			pollfds[nfds].events = POLLIN;
+			pollfds[nfds].revents = 0;
+			relays[nfds++] = ctx;
+		}
+		if (!nfds)
+			break;
+
+		ret = poll(pollfds, nfds, -1);
+		if (ret < 0) {
+			if (errno != EINTR) {
+				perror("[error] poll");
+				goto end;
+			}
+			if (lttng_live_should_quit())
+				goto end;
+			continue;
+		}
+		for (i = 0; i < nfds; i++) {
+			if (!pollfds[i].revents)
+				continue;
+			ret = prefetch_recv_one(relays[i]);
+			if (ret)
+				goto end;
+		}
+	}
+	ret = 0;
+end:
+	g_free(relays);
+	g_free(pollfds);
+	return ret;
+}
+
+/*
+ * Receive the next index of a stream, and prefetch the next index and
+ * packet of other streams along, on its relay and on the other relays
+ * followed by the viewer.
+ *
+ * Returns 0 on success or a negative value on error.
+ */
+static
+int lttng_live_prefetch(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *viewer_stream)
+{
+	struct lttng_live_viewer *viewer = ctx->viewer;
+	int i, ret;
+
+	ret = prefetch_start(ctx, viewer_stream);
+	if (ret)
+		return ret;
+	for (i = 0; ctx->pipeline_depth > 1 && i < viewer->relays->len;
+			i++) {
+		struct lttng_live_ctx *relay =
+			g_ptr_array_index(viewer->relays, i);
+
+		if (relay == ctx || !relay->session->stream_count
+				|| relay->prefetch_stage
+					!= LTTNG_LIVE_PREFETCH_IDLE)
+			continue;
+		ret = prefetch_start(relay, NULL);
+		if (ret)
+			return ret;
+	}
+	return prefetch_drain(viewer);
+}
+
+/*
+ * Get one index for a stream.
+ *
+ * Returns 0 on success or a negative value on error.
+ */
+static
+int get_next_index(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *viewer_stream,
+		struct packet_index *index, uint64_t *stream_id)
+{
+	int ret;
+	struct lttng_viewer_index *rp = &viewer_stream->current_index;
+
+retry:
+	if (lttng_live_should_quit()) {
+		ret = -1;
+		goto end;
+	}
+	/* A stream may be retried for long: keep the statistics reachable. */
+	if (lttng_live_should_dump_stats())
+		lttng_live_stats_dump(ctx->viewer, ctx->viewer->stats_fp);
+	if (!viewer_stream->index_prefetched) {
+		stream_wait(viewer_stream);
+		ret = lttng_live_prefetch(ctx, viewer_stream);
+		if (ret < 0)
+			goto error;
+	}
+	viewer_stream->index_prefetched = 0;
 
 	rp->flags = be32toh(rp->flags);
 
@@ -1029,7 +1530,14 @@ retry:
 		*stream_id = be64toh(rp->stream_id);
 		viewer_stream->data_pending = 1;
 
-		if (rp->flags & LTTNG_VIEWER_FLAG_NEW_METADATA) {
+		/*
+		 * The index may have been received in the same batch as
+		 * the index of another stream of this trace, which
+		 * already triggered the metadata fetch.
+		 */
+		if ((rp->flags & LTTNG_VIEWER_FLAG_NEW_METADATA)
+				&& viewer_stream->ctf_trace->metadata_seq
+					< viewer_stream->index_seq) {
 			ret = append_metadata(ctx, viewer_stream);
 			if (ret)
 				goto error;
@@ -1040,20 +1548,21 @@ retry:
 			if (ret < 0) {
 				goto error;
 			} else if (ret > 0) {
-				ret = add_traces(ctx);
-				if (ret < 0) {
-					goto error;
-				}
+				/* Opened by lttng_live_read(). */
+				ctx->session->new_streams = 1;
 			}
 		}
 		break;
 	case LTTNG_VIEWER_INDEX_RETRY:
-		printf_verbose("get_next_index: retry\n");
-		(void) poll(NULL, 0, ACTIVE_POLL_DELAY);
+		printf_verbose("get_next_index: retry in %d ms\n",
+				viewer_stream->retry_delay_ms);
 		goto retry;
 	case LTTNG_VIEWER_INDEX_HUP:
 		printf_verbose("get_next_index: stream hung up\n");
 		viewer_stream->id = -1ULL;
+		lttng_live_buffer_put(ctx->buffer_pool,
+				viewer_stream->packet_mma);
+		viewer_stream->packet_mma = NULL;
 		index->offset = EOF;
 		ctx->session->stream_count--;
 		break;
@@ -1150,13 +1659,39 @@ end:
 	return ret;
 }
 
+/* Append the current packet to the index, dropping the oldest one. */
 static
-void ctf_live_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
+void live_index_push(struct ctf_stream_pos *pos,
+		const struct packet_index *cur_index)
+{
+	struct packet_index last;
+
+	if (pos->packet_index->len < 2) {
+		ctf_packet_index_append(pos->packet_index, cur_index);
+		return;
+	}
+	ctf_packet_index_get(pos->packet_index, 1, &last);
+	ctf_packet_index_set(pos->packet_index, 0, &last);
+	ctf_packet_index_set(pos->packet_index, 1, cur_index);
+}
+
+/* Store back the current packet, last in the index. */
+static
+void live_index_update(struct ctf_stream_pos *pos,
+		const struct packet_index *cur_index)
+{
+	ctf_packet_index_set(pos->packet_index, pos->packet_index->len - 1,
+			cur_index);
+}
+
+static
+void live_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
 		int whence)
 {
 	struct ctf_stream_pos *pos;
 	struct ctf_file_stream *file_stream;
 	struct packet_index *prev_index = NULL, *cur_index;
+	struct packet_index prev_packet_index, cur_packet_index;
 	struct lttng_live_viewer_stream *viewer_stream;
 	struct lttng_live_session *session;
 	uint64_t stream_id = -1ULL;
@@ -1174,28 +1709,23 @@ void ctf_live_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
 	}
 
 retry:
+	/*
+	 * The index only keeps the previous and the current packet: work
+	 * on copies, stored back by live_index_push() and
+	 * live_index_update().
+	 */
+	memset(&cur_packet_index, 0, sizeof(cur_packet_index));
+	cur_index = &cur_packet_index;
 	switch (pos->packet_index->len) {
 	case 0:
-		g_array_set_size(pos->packet_index, 1);
-		cur_index = &g_array_index(pos->packet_index,
-				struct packet_index, 0);
 		break;
 	case 1:
-		g_array_set_size(pos->packet_index, 2);
-		prev_index = &g_array_index(pos->packet_index,
-				struct packet_index, 0);
-		cur_index = &g_array_index(pos->packet_index,
-				struct packet_index, 1);
-		break;
 	case 2:
-		g_array_index(pos->packet_index,
-			struct packet_index, 0) =
-				g_array_index(pos->packet_index,
-					struct packet_index, 1);
-		prev_index = &g_array_index(pos->packet_index,
-				struct packet_index, 0);
-		cur_index = &g_array_index(pos->packet_index,
-				struct packet_index, 1);
+		ctf_packet_index_get(pos->packet_index,
+				pos->packet_index->len - 1, &prev_packet_index);
+		prev_index = &prev_packet_index;
+		if (pos->packet_index->len == 2)
+			cur_packet_index = prev_packet_index;
 		break;
 	default:
 		abort();
@@ -1223,6 +1753,8 @@ retry:
 
 	}
 
+	live_index_push(pos, cur_index);
+
 	/*
 	 * On the first time we receive an index, the stream_id needs to
 	 * be set for the stream in order to use it, we don't want any
@@ -1249,6 +1781,11 @@ retry:
 	pos->mmap_base_offset = 0;
 	if (cur_index->offset == EOF) {
 		pos->offset = EOF;
+		/* Hung up: let the other streams reuse its buffer. */
+		lttng_live_buffer_put(session->ctx->buffer_pool,
+				pos->base_mma);
+		pos->base_mma = NULL;
+		viewer_stream->mmap_size = 0;
 	} else {
 		pos->offset = 0;
 	}
@@ -1270,6 +1807,7 @@ retry:
 			cur_index->ts_real.timestamp_end = ctf_get_real_timestamp(
 					&file_stream->parent,
 					cur_index->ts_cycles.timestamp_end);
+			live_index_update(pos, cur_index);
 		}
 
 		ctf_update_current_packet_index(&file_stream->parent,
@@ -1307,6 +1845,24 @@ end:
 	return;
 }
 
+/*
+ * The iterator heap waits here for the next packet of the stream with
+ * the oldest event.
+ */
+static
+void ctf_live_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
+		int whence)
+{
+	struct ctf_stream_pos *pos = ctf_pos(stream_pos);
+	struct lttng_live_viewer_stream *viewer_stream = pos->priv;
+	struct lttng_live_viewer *viewer = viewer_stream->session->ctx->viewer;
+	uint64_t begin = get_monotonic_ns();
+
+	live_packet_seek(stream_pos, index, whence);
+	lttng_live_histogram_record(&viewer->stats.heap_wait,
+			get_monotonic_ns() - begin);
+}
+
 int lttng_live_create_viewer_session(struct lttng_live_ctx *ctx)
 {
 	struct lttng_viewer_cmd cmd;
@@ -1368,11 +1924,50 @@ int del_traces(gpointer key, gpointer value, gpointer user_data)
 	return 1;
 }
 
+/*
+ * Open the streams received for a trace already in the context, and
+ * add them to the iterator without resetting the other streams.
+ */
+static
+int add_new_streams(struct lttng_live_ctx *ctx,
+		struct lttng_live_ctf_trace *trace)
+{
+	struct bt_iter *iter = ctx->bt_ctx->current_iterator;
+	int ret = 0;
+
+	while (trace->streams_opened < trace->streams->len) {
+		struct lttng_live_viewer_stream *stream;
+		struct ctf_file_stream *file_stream;
+		struct bt_mmap_stream mmap_stream;
+
+		stream = g_ptr_array_index(trace->streams,
+				trace->streams_opened++);
+		if (stream->metadata_flag)
+			continue;
+		memset(&mmap_stream, 0, sizeof(mmap_stream));
+		mmap_stream.priv = (void *) stream;
+		mmap_stream.fd = -1;
+		ret = ctf_append_mmap_stream(trace->handle->td, &mmap_stream,
+				ctf_live_packet_seek, &file_stream);
+		if (ret) {
+			fprintf(stderr, "[error] Error adding stream\n");
+			goto end;
+		}
+		if (iter) {
+			ret = bt_iter_add_stream(iter, file_stream);
+			if (ret)
+				goto end;
+		}
+	}
+end:
+	return ret;
+}
+
 static
 int add_one_trace(struct lttng_live_ctx *ctx,
 		struct lttng_live_ctf_trace *trace)
 {
-	int i, ret;
+	int i, ret, nr_streams;
 	struct bt_context *bt_ctx = ctx->bt_ctx;
 	struct lttng_live_viewer_stream *stream;
 	struct bt_mmap_stream *new_mmap_stream;
@@ -1390,13 +1985,18 @@ int add_one_trace(struct lttng_live_ctx *ctx,
 	 * If a trace is already in the context, we just skip this function.
 	 */
 	if (trace->in_use) {
-		ret = 0;
+		ret = add_new_streams(ctx, trace);
 		goto end;
 	}
 
 	BT_INIT_LIST_HEAD(&mmap_list.head);
 
-	for (i = 0; i < trace->streams->len; i++) {
+	/*
+	 * Opening the trace asks for the first index of each stream,
+	 * which may announce more streams, opened on the next call.
+	 */
+	nr_streams = trace->streams->len;
+	for (i = 0; i < nr_streams; i++) {
 		stream = g_ptr_array_index(trace->streams, i);
 
 		if (!stream->metadata_flag) {
@@ -1408,6 +2008,7 @@ int add_one_trace(struct lttng_live_ctx *ctx,
 			char *metadata_buf = NULL;
 
 			/* Get all possible metadata before starting */
+			trace->metadata_seq = ctx->prefetch_seq;
 			ret = get_new_metadata(ctx, stream, &metadata_buf);
 			if (ret) {
 				free(metadata_buf);
@@ -1457,6 +2058,7 @@ int add_one_trace(struct lttng_live_ctx *ctx,
 
 	trace->trace_id = ret;
 	trace->in_use = 1;
+	trace->streams_opened = nr_streams;
 
 	goto end;
 
@@ -1616,20 +2218,116 @@ error:
 	return -1;
 }
 
-int lttng_live_read(struct lttng_live_ctx *ctx)
+/*
+ * Ask the relays without streams for new ones.
+ * Returns the number of streams received or a negative value on error.
+ */
+static
+int ask_idle_relays(struct lttng_live_viewer *viewer)
+{
+	int i, ret, nb_streams = 0;
+
+	for (i = 0; i < viewer->relays->len; i++) {
+		struct lttng_live_ctx *ctx =
+			g_ptr_array_index(viewer->relays, i);
+
+		if (ctx->session->stream_count || !ctx->session_ids->len)
+			continue;
+		ret = ask_new_streams(ctx);
+		if (ret < 0)
+			return ret;
+		if (ctx->session->stream_count)
+			ctx->session->new_streams = 1;
+		nb_streams += ret;
+	}
+	return nb_streams;
+}
+
+/*
+ * Wait until a relay has streams.
+ * Returns 0 once there are streams, 1 once every session is closed, or
+ * a negative value on error.
+ */
+static
+int wait_for_streams(struct lttng_live_viewer *viewer)
+{
+	int i, ret, active;
+
+	for (;;) {
+		active = 0;
+		for (i = 0; i < viewer->relays->len; i++) {
+			struct lttng_live_ctx *ctx =
+				g_ptr_array_index(viewer->relays, i);
+
+			if (ctx->session->stream_count)
+				return 0;
+			if (ctx->session_ids->len)
+				active = 1;
+		}
+		if (lttng_live_should_quit() || !active)
+			return 1;
+		if (lttng_live_should_dump_stats())
+			lttng_live_stats_dump(viewer, viewer->stats_fp);
+		ret = ask_idle_relays(viewer);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			(void) poll(NULL, 0, ACTIVE_POLL_DELAY);
+	}
+}
+
+static
+void event_written(struct lttng_live_viewer *viewer,
+		const struct bt_ctf_event *event)
+{
+	struct ctf_file_stream *file_stream;
+	struct lttng_live_viewer_stream *viewer_stream;
+
+	viewer->stats.events++;
+	file_stream = container_of(event->parent->stream,
+			struct ctf_file_stream, parent);
+	viewer_stream = file_stream->pos.priv;
+	if (!viewer_stream->output_pending)
+		return;
+	viewer_stream->output_pending = 0;
+	lttng_live_histogram_record(&viewer->stats.packet_to_output,
+			get_monotonic_ns() - viewer_stream->packet_time);
+}
+
+/* Open the streams announced since they were last added. */
+static
+int add_new_traces(struct lttng_live_viewer *viewer)
+{
+	int i, ret;
+
+	for (i = 0; i < viewer->relays->len; i++) {
+		struct lttng_live_ctx *ctx =
+			g_ptr_array_index(viewer->relays, i);
+
+		if (!ctx->session->new_streams)
+			continue;
+		ctx->session->new_streams = 0;
+		ret = add_traces(ctx);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+int lttng_live_read(struct lttng_live_viewer *viewer)
 {
 	int ret = -1;
-	int i;
-	struct bt_ctf_iter *iter;
+	int i, j;
+	struct bt_ctf_iter *iter = NULL;
 	const struct bt_ctf_event *event;
 	struct bt_iter_pos begin_pos;
 	struct bt_trace_descriptor *td_write;
 	struct bt_format *fmt_write;
 	struct ctf_text_stream_pos *sout;
-	uint64_t id;
+	uint64_t id, last_poll = 0;
 
-	ctx->bt_ctx = bt_context_create();
-	if (!ctx->bt_ctx) {
+	viewer->bt_ctx = bt_context_create();
+	if (!viewer->bt_ctx) {
 		fprintf(stderr, "[error] bt_context_create allocation\n");
 		goto end;
 	}
@@ -1652,70 +2350,103 @@ int lttng_live_read(struct lttng_live_ctx *ctx)
 		goto end_free;
 	}
 
-	ret = lttng_live_create_viewer_session(ctx);
-	if (ret < 0) {
-		goto end_free;
-	}
+	/* The traces of every relay are merged by one iterator. */
+	for (j = 0; j < viewer->relays->len; j++) {
+		struct lttng_live_ctx *ctx =
+			g_ptr_array_index(viewer->relays, j);
 
-	for (i = 0; i < ctx->session_ids->len; i++) {
-		id = g_array_index(ctx->session_ids, uint64_t, i);
-		printf_verbose("Attaching to session %" PRIu64 "\n", id);
-		ret = lttng_live_attach_session(ctx, id);
-		printf_verbose("Attaching session returns %d\n", ret);
+		ctx->bt_ctx = viewer->bt_ctx;
+		if (!ctx->session_ids->len) {
+			continue;
+		}
+		ret = lttng_live_create_viewer_session(ctx);
 		if (ret < 0) {
-			if (ret == -LTTNG_VIEWER_ATTACH_UNK) {
-				fprintf(stderr, "[error] Unknown session ID\n");
-			}
 			goto end_free;
 		}
+
+		for (i = 0; i < ctx->session_ids->len; i++) {
+			id = g_array_index(ctx->session_ids, uint64_t, i);
+			printf_verbose("Attaching to session %" PRIu64
+					" on %s\n", id, ctx->relay_hostname);
+			ret = lttng_live_attach_session(ctx, id);
+			printf_verbose("Attaching session returns %d\n", ret);
+			if (ret < 0) {
+				if (ret == -LTTNG_VIEWER_ATTACH_UNK) {
+					fprintf(stderr, "[error] Unknown session ID\n");
+				}
+				goto end_free;
+			}
+		}
+		ctx->session->new_streams = 1;
 	}
 
 	/*
-	 * As long as the session is active, we try to get new streams.
+	 * As long as a session is active, we try to get new streams.
 	 */
 	for (;;) {
 		int flags;
 
-		if (lttng_live_should_quit()) {
-			ret = 0;
-			goto end_free;
-		}
-
-		while (!ctx->session->stream_count) {
-			if (lttng_live_should_quit()
-					|| ctx->session_ids->len == 0) {
+		ret = wait_for_streams(viewer);
+		if (ret) {
+			if (ret > 0) {
 				ret = 0;
-				goto end_free;
-			}
-			ret = ask_new_streams(ctx);
-			if (ret < 0) {
-				goto end_free;
-			}
-			if (!ctx->session->stream_count) {
-				(void) poll(NULL, 0, ACTIVE_POLL_DELAY);
 			}
+			goto end_free;
 		}
-
-		ret = add_traces(ctx);
+		ret = add_new_traces(viewer);
 		if (ret < 0) {
 			goto end_free;
 		}
 
-		begin_pos.type = BT_SEEK_BEGIN;
-		iter = bt_ctf_iter_create(ctx->bt_ctx, &begin_pos, NULL);
+		/*
+		 * The iterator is kept across sessions and stream
+		 * arrivals: new streams are inserted in its heap.
+		 */
 		if (!iter) {
-			if (lttng_live_should_quit()) {
-				ret = 0;
+			begin_pos.type = BT_SEEK_BEGIN;
+			iter = bt_ctf_iter_create(viewer->bt_ctx, &begin_pos,
+					NULL);
+			if (!iter) {
+				if (lttng_live_should_quit()) {
+					ret = 0;
+					goto end;
+				}
+				fprintf(stderr, "[error] Iterator creation error\n");
 				goto end;
 			}
-			fprintf(stderr, "[error] Iterator creation error\n");
-			goto end;
 		}
 		for (;;) {
 			if (lttng_live_should_quit()) {
 				ret = 0;
 				goto end_free;
 			}
+			if (lttng_live_should_dump_stats()) {
+				lttng_live_stats_dump(viewer, viewer->stats_fp);
+			}
+			/*
+			 * Relays which had no streams yet are asked for
+			 * some while the others are read.
+			 */
+			if (viewer->relays->len > 1) {
+				uint64_t now = get_monotonic_ns();
+
+				if (now - last_poll >= ACTIVE_POLL_DELAY
+						* 1000000ULL) {
+					last_poll = now;
+					ret = ask_idle_relays(viewer);
+					if (ret < 0) {
+						goto end_free;
+					}
+				}
+			}
+			/*
+			 * Streams announced while the iterator was moving
+			 * are only added between two moves.
+			 */
+			ret = add_new_traces(viewer);
+			if (ret < 0) {
+				goto end_free;
+			}
 			event = bt_ctf_iter_read_event_flags(iter, &flags);
 			if (!(flags & BT_ITER_FLAG_RETRY)) {
 				if (!event) {
@@ -1729,20 +2460,29 @@ int lttng_live_read(struct lttng_live_ctx *ctx)
 							"event failed.\n");
 					goto end_free;
 				}
+				event_written(viewer, event);
 			}
 			ret = bt_iter_next(bt_ctf_get_iter(iter));
 			if (ret < 0) {
 				goto end_free;
 			}
 		}
-		bt_ctf_iter_destroy(iter);
-		g_hash_table_foreach_remove(ctx->session->ctf_traces,
-				del_traces, ctx->bt_ctx);
-		ctx->session->stream_count = 0;
+		/* Every stream hung up: only the traces are removed. */
+		for (j = 0; j < viewer->relays->len; j++) {
+			struct lttng_live_ctx *ctx =
+				g_ptr_array_index(viewer->relays, j);
+
+			g_hash_table_foreach_remove(ctx->session->ctf_traces,
+					del_traces, viewer->bt_ctx);
+			ctx->session->stream_count = 0;
+		}
 	}
 
 end_free:
-	bt_context_put(ctx->bt_ctx);
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	bt_context_put(viewer->bt_ctx);
 end:
 	if (lttng_live_should_quit()) {
 		ret = 0;
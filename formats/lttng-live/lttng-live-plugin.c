@@ -36,16 +36,27 @@
 #include <glib.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include "lttng-live.h"
 
 static volatile int should_quit;
+static volatile int should_dump_stats;
 
 int lttng_live_should_quit(void)
 {
 	return should_quit;
 }
 
+/* Statistics dump requested by SIGUSR1 since the last call. */
+int lttng_live_should_dump_stats(void)
+{
+	if (!should_dump_stats)
+		return 0;
+	should_dump_stats = 0;
+	return 1;
+}
+
 static
 void sighandler(int sig)
 {
@@ -54,6 +65,9 @@ void sighandler(int sig)
 	case SIGINT:
 		should_quit = 1;
 		break;
+	case SIGUSR1:
+		should_dump_stats = 1;
+		break;
 	default:
 		break;
 	}
@@ -86,6 +100,10 @@ int setup_sighandler(void)
 		perror("sigaction");
 		return ret;
 	}
+	if ((ret = sigaction(SIGUSR1, &sa, NULL)) < 0) {
+		perror("sigaction");
+		return ret;
+	}
 	return 0;
 }
 
@@ -211,7 +229,69 @@ gboolean g_uint64p_equal(gconstpointer a, gconstpointer b)
 	return TRUE;
 }
 
-static int lttng_live_open_trace_read(const char *path)
+static
+int get_pipeline_depth(void)
+{
+	const char *env;
+	long depth;
+
+	env = getenv("BABELTRACE_LIVE_PIPELINE_DEPTH");
+	if (!env)
+		return LTTNG_LIVE_DEFAULT_PIPELINE_DEPTH;
+	depth = strtol(env, NULL, 10);
+	if (depth < 1)
+		depth = 1;
+	if (depth > INT_MAX)
+		depth = INT_MAX;
+	return depth;
+}
+
+static
+int get_env_ms(const char *name, int default_ms)
+{
+	const char *env;
+	long ms;
+
+	env = getenv(name);
+	if (!env)
+		return default_ms;
+	ms = strtol(env, NULL, 10);
+	if (ms < 0)
+		ms = 0;
+	if (ms > INT_MAX)
+		ms = INT_MAX;
+	return ms;
+}
+
+static
+size_t get_buffer_cache(void)
+{
+	const char *env;
+	long mb;
+
+	env = getenv("BABELTRACE_LIVE_BUFFER_CACHE_MB");
+	if (!env)
+		return LTTNG_LIVE_DEFAULT_BUFFER_CACHE;
+	mb = strtol(env, NULL, 10);
+	if (mb < 0)
+		mb = 0;
+	return (size_t) mb << 20;
+}
+
+static
+void lttng_live_relay_destroy(struct lttng_live_ctx *ctx)
+{
+	g_hash_table_destroy(ctx->session->ctf_traces);
+	g_free(ctx->session->streams);
+	g_free(ctx->session);
+	g_array_free(ctx->session_ids, TRUE);
+	g_ptr_array_free(ctx->prefetch_streams, TRUE);
+	g_free(ctx);
+}
+
+/* Connect to the relay daemon of one URL and list its sessions. */
+static
+int lttng_live_relay_add(struct lttng_live_viewer *viewer, const char *path)
 {
 	int ret = 0;
 	struct lttng_live_ctx *ctx;
@@ -227,41 +307,112 @@ static int lttng_live_open_trace_read(const char *path)
 			g_uint64p_equal);
 	ctx->port = -1;
 	ctx->session_ids = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+	ctx->pipeline_depth = get_pipeline_depth();
+	ctx->retry_min_ms = get_env_ms("BABELTRACE_LIVE_RETRY_MIN_MS",
+			LTTNG_LIVE_DEFAULT_RETRY_MIN_MS);
+	ctx->retry_max_ms = get_env_ms("BABELTRACE_LIVE_RETRY_MAX_MS",
+			LTTNG_LIVE_DEFAULT_RETRY_MAX_MS);
+	if (ctx->retry_min_ms < 1)
+		ctx->retry_min_ms = 1;
+	if (ctx->retry_max_ms < ctx->retry_min_ms)
+		ctx->retry_max_ms = ctx->retry_min_ms;
+	ctx->prefetch_streams = g_ptr_array_new();
+	ctx->buffer_pool = viewer->buffer_pool;
+	ctx->viewer = viewer;
+	g_ptr_array_add(viewer->relays, ctx);
 
 	ret = parse_url(path, ctx);
 	if (ret < 0) {
-		goto end_free;
-	}
-	ret = setup_sighandler();
-	if (ret < 0) {
-		goto end_free;
+		goto end;
 	}
 	ret = lttng_live_connect_viewer(ctx);
 	if (ret < 0) {
-		goto end_free;
+		goto end;
 	}
-	printf_verbose("LTTng-live connected to relayd\n");
+	printf_verbose("LTTng-live connected to relayd %s\n",
+			ctx->relay_hostname);
 
 	ret = lttng_live_establish_connection(ctx);
 	if (ret < 0) {
-		goto end_free;
+		goto end;
 	}
 
 	printf_verbose("Listing sessions\n");
 	ret = lttng_live_list_sessions(ctx, path);
+end:
+	return ret;
+}
+
+/*
+ * Statistics are written on SIGUSR1 to the file named by
+ * BABELTRACE_LIVE_STATS, and to this file at exit. Without it, or if it
+ * is "-", SIGUSR1 writes them on the standard error.
+ */
+static
+FILE *open_stats_fp(const char *stats_path)
+{
+	FILE *fp;
+
+	if (!stats_path || !strcmp(stats_path, "-"))
+		return stderr;
+	fp = fopen(stats_path, "a");
+	if (!fp) {
+		perror("[error] Unable to open BABELTRACE_LIVE_STATS");
+		return stderr;
+	}
+	return fp;
+}
+
+/*
+ * The path holds one URL per relay daemon, separated by commas: the
+ * sessions of all of them are read as one trace collection.
+ */
+static int lttng_live_open_trace_read(const char *path)
+{
+	int ret = 0;
+	struct lttng_live_viewer viewer;
+	gchar **urls = NULL;
+	const char *stats_path;
+	int i, nb_sessions = 0;
+
+	memset(&viewer, 0, sizeof(viewer));
+	viewer.relays = g_ptr_array_new();
+	viewer.buffer_pool = lttng_live_buffer_pool_create(get_buffer_cache());
+	stats_path = getenv("BABELTRACE_LIVE_STATS");
+	viewer.stats_fp = open_stats_fp(stats_path);
+
+	ret = setup_sighandler();
 	if (ret < 0) {
 		goto end_free;
 	}
+	urls = g_strsplit(path, ",", 0);
+	for (i = 0; urls[i]; i++) {
+		struct lttng_live_ctx *ctx;
+
+		ret = lttng_live_relay_add(&viewer, urls[i]);
+		if (ret < 0) {
+			goto end_free;
+		}
+		ctx = g_ptr_array_index(viewer.relays, i);
+		nb_sessions += ctx->session_ids->len;
+	}
 
-	if (ctx->session_ids->len > 0) {
-		ret = lttng_live_read(ctx);
+	if (nb_sessions > 0) {
+		ret = lttng_live_read(&viewer);
+		if (stats_path) {
+			lttng_live_stats_dump(&viewer, viewer.stats_fp);
+		}
 	}
 
 end_free:
-	g_hash_table_destroy(ctx->session->ctf_traces);
-	g_free(ctx->session);
-	g_free(ctx->session->streams);
-	g_free(ctx);
+	if (viewer.stats_fp != stderr) {
+		fclose(viewer.stats_fp);
+	}
+	for (i = 0; i < viewer.relays->len; i++)
+		lttng_live_relay_destroy(g_ptr_array_index(viewer.relays, i));
+	g_ptr_array_free(viewer.relays, TRUE);
+	lttng_live_buffer_pool_destroy(viewer.buffer_pool);
+	g_strfreev(urls);
 
 	if (lttng_live_should_quit()) {
 		ret = 0;
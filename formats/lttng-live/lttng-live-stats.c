@@ -0,0 +1,167 @@
+/*
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <dirent.h>
+#include <glib.h>
+
+#include "lttng-live.h"
+
+/*
+ * Latency histograms have one bucket per power of two microseconds:
+ * bucket 0 counts the values below 1 us, bucket n the values in
+ * [2^(n-1), 2^n) us, the last bucket everything above.
+ */
+void lttng_live_histogram_record(struct lttng_live_histogram *hist,
+		uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	unsigned int bucket = 0;
+
+	while (us && bucket < LTTNG_LIVE_HISTOGRAM_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	hist->buckets[bucket]++;
+	hist->count++;
+	hist->sum_ns += ns;
+	if (ns > hist->max_ns)
+		hist->max_ns = ns;
+}
+
+/*
+ * Write a string as a JSON string literal: paths and host names are
+ * given by the relay and the user, and may contain quotes, backslashes
+ * or control characters.
+ */
+static
+void dump_string(FILE *fp, const char *str)
+{
+	const unsigned char *p;
+
+	fputc('"', fp);
+	for (p = (const unsigned char *) str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+static
+void dump_histogram(FILE *fp, const char *name,
+		const struct lttng_live_histogram *hist)
+{
+	int i, last = -1;
+
+	for (i = 0; i < LTTNG_LIVE_HISTOGRAM_BUCKETS; i++) {
+		if (hist->buckets[i])
+			last = i;
+	}
+	fprintf(fp, "\"%s\": {\"count\": %" PRIu64 ", \"sum_us\": %" PRIu64
+		", \"max_us\": %" PRIu64 ", \"buckets\": [",
+		name, hist->count, hist->sum_ns / 1000, hist->max_ns / 1000);
+	for (i = 0; i <= last; i++)
+		fprintf(fp, "%s%" PRIu64, i ? ", " : "", hist->buckets[i]);
+	fprintf(fp, "]}");
+}
+
+static
+void dump_streams(FILE *fp, struct lttng_live_ctx *ctx)
+{
+	GHashTableIter it;
+	gpointer key, value;
+	int i, first = 1;
+
+	g_hash_table_iter_init(&it, ctx->session->ctf_traces);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		struct lttng_live_ctf_trace *trace = value;
+
+		for (i = 0; i < trace->streams->len; i++) {
+			struct lttng_live_viewer_stream *stream =
+				g_ptr_array_index(trace->streams, i);
+			struct lttng_live_stream_stats *stats = &stream->stats;
+
+			if (stream->metadata_flag)
+				continue;
+			fprintf(fp, "%s{\"trace_id\": %" PRIu64
+				", \"path\": ",
+				first ? "" : ", ", trace->ctf_trace_id);
+			dump_string(fp, stream->path);
+			fprintf(fp, ", \"hung_up\": %s"
+				", \"index_requests\": %" PRIu64
+				", \"index_retries\": %" PRIu64
+				", \"packets\": %" PRIu64
+				", \"bytes\": %" PRIu64 "}",
+				stream->id == -1ULL ? "true" : "false",
+				stats->index_requests, stats->index_retries,
+				stats->packets, stats->bytes);
+			first = 0;
+		}
+	}
+}
+
+/*
+ * Write the statistics of a viewer as one line of JSON. The streams of
+ * the traces removed at the end of a session only remain in the
+ * totals.
+ */
+void lttng_live_stats_dump(struct lttng_live_viewer *viewer, FILE *fp)
+{
+	struct lttng_live_stats *stats = &viewer->stats;
+	int i;
+
+	fprintf(fp, "{\"index_requests\": %" PRIu64
+		", \"index_retries\": %" PRIu64
+		", \"packets\": %" PRIu64 ", \"bytes\": %" PRIu64
+		", \"metadata_fetches\": %" PRIu64 ", \"events\": %" PRIu64
+		", ",
+		stats->index_requests, stats->index_retries, stats->packets,
+		stats->bytes, stats->metadata_fetches, stats->events);
+	dump_histogram(fp, "index_to_packet", &stats->index_to_packet);
+	fprintf(fp, ", ");
+	dump_histogram(fp, "packet_to_output", &stats->packet_to_output);
+	fprintf(fp, ", ");
+	dump_histogram(fp, "metadata_stall", &stats->metadata_stall);
+	fprintf(fp, ", ");
+	dump_histogram(fp, "heap_wait", &stats->heap_wait);
+	fprintf(fp, ", \"relays\": [");
+	for (i = 0; i < viewer->relays->len; i++) {
+		struct lttng_live_ctx *ctx =
+			g_ptr_array_index(viewer->relays, i);
+
+		fprintf(fp, "%s{\"host\": ", i ? ", " : "");
+		dump_string(fp, ctx->relay_hostname);
+		fprintf(fp, ", \"port\": %d, \"streams\": [", ctx->port);
+		dump_streams(fp, ctx);
+		fprintf(fp, "]}");
+	}
+	fprintf(fp, "]}\n");
+	fflush(fp);
+}
@@ -32,6 +32,85 @@
 #define LTTNG_LIVE_MAJOR			2
 #define LTTNG_LIVE_MINOR			4
 
+/*
+ * Maximum number of streams with requests in flight, see
+ * lttng_live_prefetch(). Overridden by BABELTRACE_LIVE_PIPELINE_DEPTH;
+ * a depth of 1 does one round trip per request.
+ */
+#define LTTNG_LIVE_DEFAULT_PIPELINE_DEPTH	64
+
+/*
+ * Bounds of the per-stream delay before asking again for the index of
+ * a stream which had none available: the delay doubles on each retry
+ * and is reset when an index is received. Overridden by
+ * BABELTRACE_LIVE_RETRY_MIN_MS and BABELTRACE_LIVE_RETRY_MAX_MS.
+ */
+#define LTTNG_LIVE_DEFAULT_RETRY_MIN_MS		1
+#define LTTNG_LIVE_DEFAULT_RETRY_MAX_MS		100
+
+/*
+ * Bytes of released packet buffers kept for reuse by the streams of a
+ * viewer session. Overridden by BABELTRACE_LIVE_BUFFER_CACHE_MB.
+ */
+#define LTTNG_LIVE_DEFAULT_BUFFER_CACHE		(64ULL << 20)
+
+/* Buckets of the latency histograms, see lttng_live_histogram_record(). */
+#define LTTNG_LIVE_HISTOGRAM_BUCKETS		32
+
+struct mmap_align;
+struct lttng_live_buffer_pool;
+
+struct lttng_live_histogram {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+	uint64_t buckets[LTTNG_LIVE_HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Statistics of a viewer, written by lttng_live_stats_dump() on SIGUSR1
+ * and, if BABELTRACE_LIVE_STATS is set, at exit.
+ */
+struct lttng_live_stats {
+	uint64_t index_requests;
+	uint64_t index_retries;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t metadata_fetches;
+	uint64_t events;
+	/* From the index response to the packet data received. */
+	struct lttng_live_histogram index_to_packet;
+	/* From the packet data received to its first event written. */
+	struct lttng_live_histogram packet_to_output;
+	/* Metadata fetches, during which no event is read. */
+	struct lttng_live_histogram metadata_stall;
+	/* Iterator waiting on a stream for its next packet. */
+	struct lttng_live_histogram heap_wait;
+};
+
+struct lttng_live_stream_stats {
+	uint64_t index_requests;
+	uint64_t index_retries;
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+/* Requests in flight on a relay connection, see lttng_live_prefetch(). */
+enum lttng_live_prefetch_stage {
+	LTTNG_LIVE_PREFETCH_IDLE = 0,
+	LTTNG_LIVE_PREFETCH_INDEX,
+	LTTNG_LIVE_PREFETCH_PACKET,
+};
+
+/* Relay daemons followed by one babeltrace live input. */
+struct lttng_live_viewer {
+	GPtrArray *relays;		/* struct lttng_live_ctx */
+	struct bt_context *bt_ctx;	/* Shared by the relays */
+	struct lttng_live_buffer_pool *buffer_pool;
+	struct lttng_live_stats stats;
+	FILE *stats_fp;			/* Destination of the dumps */
+};
+
 struct lttng_live_ctx {
 	char traced_hostname[MAXNAMLEN];
 	char session_name[MAXNAMLEN];
@@ -44,6 +123,16 @@ struct lttng_live_ctx {
 	struct lttng_live_session *session;
 	struct bt_context *bt_ctx;
 	GArray *session_ids;
+	int pipeline_depth;
+	uint64_t prefetch_seq;		/* Last batch of prefetched responses */
+	enum lttng_live_prefetch_stage prefetch_stage;
+	GPtrArray *prefetch_streams;	/* Batch of the requests in flight */
+	unsigned int prefetch_received;	/* Responses of the batch received */
+	struct lttng_live_viewer_stream *prefetch_requested;
+	int retry_min_ms;
+	int retry_max_ms;
+	struct lttng_live_buffer_pool *buffer_pool;	/* The viewer's */
+	struct lttng_live_viewer *viewer;
 };
 
 struct lttng_live_viewer_stream {
@@ -58,6 +147,25 @@ struct lttng_live_viewer_stream {
 	struct lttng_live_ctf_trace *ctf_trace;
 	struct lttng_viewer_index current_index;
 	char path[PATH_MAX];
+
+	/* Responses received ahead by lttng_live_prefetch(). */
+	int index_prefetched;		/* current_index not consumed yet */
+	uint64_t index_seq;		/* Batch of current_index */
+	int packet_prefetched;
+	uint64_t packet_offset;
+	uint32_t packet_status;		/* Big endian, as received */
+	uint32_t packet_len;		/* Big endian, as received */
+	uint32_t packet_flags;		/* Big endian, as received */
+	struct mmap_align *packet_mma;	/* From ctx->buffer_pool */
+
+	/* Back-off after LTTNG_VIEWER_INDEX_RETRY, see stream_backoff(). */
+	int retry_delay_ms;		/* 0 when the stream had an index */
+	uint64_t retry_time;		/* Monotonic, in ns */
+
+	struct lttng_live_stream_stats stats;
+	uint64_t index_time;		/* current_index received, monotonic */
+	uint64_t packet_time;		/* Packet data received, monotonic */
+	int output_pending;		/* No event of the packet written yet */
 };
 
 struct lttng_live_session {
@@ -67,6 +175,7 @@ struct lttng_live_session {
 	struct lttng_live_viewer_stream *streams;
 	/* HashTable mapping trace_ids to ptrs to struct lttng_live_ctf_trace */
 	GHashTable *ctf_traces;
+	int new_streams;		/* Received, not opened yet */
 };
 
 struct lttng_live_ctf_trace {
@@ -77,6 +186,8 @@ struct lttng_live_ctf_trace {
 	struct bt_trace_handle *handle;
 	int trace_id;
 	int in_use;
+	unsigned int streams_opened;	/* Prefix of streams in the trace */
+	uint64_t metadata_seq;		/* Batch before the last metadata fetch */
 };
 
 /* Just used in listing. */
@@ -88,12 +199,25 @@ struct lttng_live_relay_session {
 	char *hostname;
 };
 
+struct lttng_live_buffer_pool *lttng_live_buffer_pool_create(
+		size_t max_cached);
+void lttng_live_buffer_pool_destroy(struct lttng_live_buffer_pool *pool);
+struct mmap_align *lttng_live_buffer_get(struct lttng_live_buffer_pool *pool,
+		size_t len);
+void lttng_live_buffer_put(struct lttng_live_buffer_pool *pool,
+		struct mmap_align *mma);
+
+void lttng_live_histogram_record(struct lttng_live_histogram *hist,
+		uint64_t ns);
+void lttng_live_stats_dump(struct lttng_live_viewer *viewer, FILE *fp);
+
 int lttng_live_connect_viewer(struct lttng_live_ctx *ctx);
 int lttng_live_establish_connection(struct lttng_live_ctx *ctx);
 int lttng_live_list_sessions(struct lttng_live_ctx *ctx, const char *path);
 int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id);
-int lttng_live_read(struct lttng_live_ctx *ctx);
+int lttng_live_read(struct lttng_live_viewer *viewer);
 int lttng_live_get_new_streams(struct lttng_live_ctx *ctx, uint64_t id);
 int lttng_live_should_quit(void);
+int lttng_live_should_dump_stats(void);
 
 #endif /* _LTTNG_LIVE_H */
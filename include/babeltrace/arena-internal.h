@@ -0,0 +1,76 @@
+#ifndef _BABELTRACE_ARENA_INTERNAL_H
+#define _BABELTRACE_ARENA_INTERNAL_H
+
+/*
+ * BabelTrace
+ *
+ * Internal arena allocator header
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+
+struct bt_arena;
+
+/*
+ * bt_arena_create : create an arena, with a reference count of 1
+ *
+ * An arena hands out zeroed memory from a few large chunks, all freed
+ * at once with the arena. It must only be filled by one thread at a
+ * time.
+ */
+struct bt_arena *bt_arena_create(void);
+
+/*
+ * bt_arena_get and bt_arena_put : increment and decrement the
+ * reference count of an arena (NULL is ignored)
+ *
+ * The last bt_arena_put() calls the release callback of every object
+ * allocated with bt_arena_alloc_object(), most recent first, then frees
+ * the arena memory.
+ */
+void bt_arena_get(struct bt_arena *arena);
+void bt_arena_put(struct bt_arena *arena);
+
+/*
+ * bt_arena_alloc : allocate len zeroed bytes from the arena
+ */
+void *bt_arena_alloc(struct bt_arena *arena, size_t len);
+
+/*
+ * bt_arena_alloc_object : allocate len zeroed bytes from the arena,
+ * calling release(object) when the arena is destroyed
+ *
+ * release() lets objects free what they own outside of the arena.
+ */
+void *bt_arena_alloc_object(struct bt_arena *arena, size_t len,
+		void (*release)(void *object));
+
+/*
+ * bt_arena_cancel_release : do not call the release callback of an
+ * object allocated with bt_arena_alloc_object()
+ *
+ * For objects which are already released, e.g. on error paths.
+ */
+void bt_arena_cancel_release(void *object);
+
+#endif /* _BABELTRACE_ARENA_INTERNAL_H */
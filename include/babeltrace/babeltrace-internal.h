@@ -196,5 +196,6 @@ extern int opt_all_field_names,
 extern uint64_t opt_clock_offset;
 extern uint64_t opt_clock_offset_ns;
 extern int babeltrace_ctf_console_output;
+extern int babeltrace_ctf_verify;
 
 #endif
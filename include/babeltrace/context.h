@@ -87,6 +87,30 @@ int bt_context_add_trace(struct bt_context *ctx, const char *path,
 		struct bt_mmap_stream_list *stream_list,
 		FILE *metadata);
 
+/*
+ * bt_context_add_traces : Add several traces by path to the context
+ *
+ * Open the nr_paths traces found at paths, as bt_context_add_trace()
+ * does for a single path, with the same format and packet_seek
+ * parameters. The traces are opened concurrently (see the
+ * BABELTRACE_OPEN_THREADS environment variable), then added to the
+ * context in the order of paths, so that the trace handle ids do not
+ * depend on which trace finishes opening first.
+ *
+ * handle_ids is an array of nr_paths elements, filled with the trace
+ * handle id of each path (>= 0), or a negative value if that trace
+ * cannot be opened.
+ *
+ * Return: the number of traces added to the context (>= 0), a negative
+ * value on error.
+ */
+int bt_context_add_traces(struct bt_context *ctx,
+		const char * const *paths, int nr_paths,
+		const char *format,
+		void (*packet_seek)(struct bt_stream_pos *pos,
+			size_t index, int whence),
+		int *handle_ids);
+
 /*
  * bt_context_remove_trace: Remove a trace from the context.
  *
@@ -37,6 +37,8 @@ struct bt_ctf_field {
 	struct bt_object base;
 	struct bt_ctf_field_type *type;
 	int payload_set;
+	/* Set whenever the value changes, see bt_ctf_field_clear_modified() */
+	int modified;
 };
 
 struct bt_ctf_field_integer {
@@ -90,6 +92,14 @@ BT_HIDDEN
 int bt_ctf_field_structure_set_field(struct bt_ctf_field *structure,
 		const char *name, struct bt_ctf_field *value);
 
+/*
+ * Get a structure's field by index without acquiring a reference. The
+ * field is instanciated if it was not already.
+ */
+BT_HIDDEN
+struct bt_ctf_field *bt_ctf_field_structure_peek_field_by_index(
+		struct bt_ctf_field *structure, int index);
+
 /* Validate that the field's payload is set (returns 0 if set). */
 BT_HIDDEN
 int bt_ctf_field_validate(struct bt_ctf_field *field);
@@ -98,8 +108,24 @@ int bt_ctf_field_validate(struct bt_ctf_field *field);
 BT_HIDDEN
 int bt_ctf_field_reset(struct bt_ctf_field *field);
 
+/*
+ * Clear the "modified" flag of a field and of all its children. Returns 1
+ * if any of them had been modified (set, reset, replaced or created) since
+ * the last call, 0 otherwise.
+ */
+BT_HIDDEN
+int bt_ctf_field_clear_modified(struct bt_ctf_field *field);
+
 BT_HIDDEN
 int bt_ctf_field_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos);
 
+/*
+ * Write "len" bytes at the next position aligned on "alignment" bits,
+ * growing the packet as needed. Does not acquire any reference.
+ */
+BT_HIDDEN
+int bt_ctf_serialize_raw_bytes(struct ctf_stream_pos *pos, const void *data,
+		size_t len, unsigned int alignment);
+
 #endif /* BABELTRACE_CTF_WRITER_EVENT_FIELDS_INTERNAL_H */
@@ -84,6 +84,96 @@ extern struct bt_ctf_field *bt_ctf_field_structure_get_field(
 extern struct bt_ctf_field *bt_ctf_field_structure_get_field_by_index(
 		struct bt_ctf_field *structure, int index);
 
+/*
+ * bt_ctf_field_structure_set_unsigned_integer_by_index: set the value of
+ * a structure's unsigned integer field by index.
+ *
+ * Equivalent to setting the value of the field returned by
+ * bt_ctf_field_structure_get_field_by_index, without acquiring a
+ * reference on it. Field indexes may be resolved once using
+ * bt_ctf_field_type_structure_get_field or
+ * bt_ctf_event_class_get_field_index.
+ *
+ * @param structure Structure field instance.
+ * @param index Index of the field in the provided structure.
+ * @param value Unsigned integer field value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_field_structure_set_unsigned_integer_by_index(
+		struct bt_ctf_field *structure, int index, uint64_t value);
+
+/*
+ * bt_ctf_field_structure_set_signed_integer_by_index: set the value of
+ * a structure's signed integer field by index.
+ *
+ * @param structure Structure field instance.
+ * @param index Index of the field in the provided structure.
+ * @param value Signed integer field value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_field_structure_set_signed_integer_by_index(
+		struct bt_ctf_field *structure, int index, int64_t value);
+
+/*
+ * bt_ctf_field_structure_set_unsigned_integer_by_path: set the value of
+ * an unsigned integer field nested in structures.
+ *
+ * Same as bt_ctf_field_structure_set_unsigned_integer_by_index, for a
+ * field designated by the index of the field in each structure, as
+ * returned by bt_ctf_field_type_structure_get_field_path. This applies
+ * to any structure field, such as an event's context or header.
+ *
+ * @param structure Structure field instance.
+ * @param indexes Path of the field, from the provided structure.
+ * @param depth Number of indexes in the path.
+ * @param value Unsigned integer field value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_field_structure_set_unsigned_integer_by_path(
+		struct bt_ctf_field *structure, const int *indexes, int depth,
+		uint64_t value);
+
+/*
+ * bt_ctf_field_structure_set_signed_integer_by_path: set the value of
+ * a signed integer field nested in structures.
+ *
+ * @param structure Structure field instance.
+ * @param indexes Path of the field, from the provided structure.
+ * @param depth Number of indexes in the path.
+ * @param value Signed integer field value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_field_structure_set_signed_integer_by_path(
+		struct bt_ctf_field *structure, const int *indexes, int depth,
+		int64_t value);
+
+/*
+ * bt_ctf_field_structure_set_integers: set a structure's integer fields.
+ *
+ * Set the values of the structure's first "count" integer fields, in
+ * declaration order, skipping the fields which are not integers. Values
+ * destined to signed integer fields are interpreted as int64_t. Nested
+ * structures are skipped as well.
+ *
+ * Enumeration fields are not skipped, since callers would easily
+ * mistake them for integers: an error is returned if one is met before
+ * all the values are set.
+ *
+ * @param structure Structure field instance.
+ * @param values Array of "count" integer values.
+ * @param count Number of values to set.
+ *
+ * Returns 0 on success, a negative value on error, if the structure
+ * has less than "count" integer fields or if an enumeration field
+ * precedes the last one to be set.
+ */
+extern int bt_ctf_field_structure_set_integers(struct bt_ctf_field *structure,
+		const uint64_t *values, int count);
+
 /*
  * bt_ctf_field_array_get_field: get an array's field at position "index".
  *
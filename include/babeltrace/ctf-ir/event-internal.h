@@ -52,6 +52,11 @@ struct bt_ctf_event_class {
 	struct bt_ctf_field_type *context;
 	/* Structure type containing the event's fields */
 	struct bt_ctf_field_type *fields;
+	/*
+	 * Size, in bytes, of the payload when its layout is fixed and
+	 * byte-aligned, -1 otherwise. Computed when the class is frozen.
+	 */
+	int64_t raw_payload_size;
 	int frozen;
 };
 
@@ -63,6 +68,11 @@ struct bt_ctf_event {
 	struct bt_ctf_field *event_header;
 	struct bt_ctf_field *context_payload;
 	struct bt_ctf_field *fields_payload;
+	/*
+	 * Set while the event is queued for writing by the background
+	 * thread of its stream, see bt_ctf_stream_set_async_flush().
+	 */
+	int flushing;
 };
 
 BT_HIDDEN
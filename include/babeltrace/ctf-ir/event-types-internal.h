@@ -197,6 +197,16 @@ struct bt_ctf_field_path *bt_ctf_field_path_copy(
 BT_HIDDEN
 void bt_ctf_field_path_destroy(struct bt_ctf_field_path *path);
 
+/*
+ * Get the size, in bits, of a frozen type whose layout does not depend on
+ * the values of its fields, when starting from an offset aligned on the
+ * type's alignment. Returns a negative value if the type contains
+ * strings, sequences or variants.
+ */
+BT_HIDDEN
+int bt_ctf_field_type_get_fixed_layout_size(struct bt_ctf_field_type *type,
+		uint64_t *size);
+
 BT_HIDDEN
 int bt_ctf_field_type_structure_get_field_name_index(
 		struct bt_ctf_field_type *structure, const char *name);
@@ -466,6 +466,28 @@ extern
 struct bt_ctf_field_type *bt_ctf_field_type_structure_get_field_type_by_name(
 		struct bt_ctf_field_type *structure, const char *field_name);
 
+/*
+ * bt_ctf_field_type_structure_get_field_path: get the path of a field
+ *	nested in structures.
+ *
+ * Resolve "field_name", in which the names of nested structure fields
+ * are separated by dots (e.g. "pos.x"), to the index of the field in
+ * each structure, starting from "structure". The path may be resolved
+ * once, and then used with the bt_ctf_field_structure_set_*_by_path
+ * functions to avoid look-ups by name on every event.
+ *
+ * @param structure Structure type.
+ * @param field_name Dot-separated name of the field.
+ * @param indexes Array of "max_depth" elements receiving the path.
+ * @param max_depth Maximal depth of the path.
+ *
+ * Returns the depth of the path on success, a negative value on error or
+ * if the path is deeper than "max_depth".
+ */
+extern int bt_ctf_field_type_structure_get_field_path(
+		struct bt_ctf_field_type *structure, const char *field_name,
+		int *indexes, int max_depth);
+
 /*
  * bt_ctf_field_type_variant_create: create a variant field type.
  *
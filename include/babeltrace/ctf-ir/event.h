@@ -281,6 +281,42 @@ extern int bt_ctf_event_class_get_field(struct bt_ctf_event_class *event_class,
 extern struct bt_ctf_field_type *bt_ctf_event_class_get_field_by_name(
 		struct bt_ctf_event_class *event_class, const char *name);
 
+/*
+ * bt_ctf_event_class_get_field_index: Get the index of an event class' field.
+ *
+ * The returned index may be used with the bt_ctf_event_*_by_index and
+ * bt_ctf_event_set_payload_*_integer functions to avoid look-ups by name
+ * on every event.
+ *
+ * @param event_class Event class.
+ * @param name Name of the field.
+ *
+ * Returns the field's index on success, a negative value on error.
+ *
+ * Note: Returns an error if the payload is not a structure.
+ */
+extern int bt_ctf_event_class_get_field_index(
+		struct bt_ctf_event_class *event_class, const char *name);
+
+/*
+ * bt_ctf_event_class_get_field_path: Get the path of an event class' field.
+ *
+ * Resolve a payload field, possibly nested in structures, for use with
+ * the bt_ctf_event_set_payload_*_integer_by_path functions. See
+ * bt_ctf_field_type_structure_get_field_path, which also resolves the
+ * fields of the context and header types.
+ *
+ * @param event_class Event class.
+ * @param name Dot-separated name of the field (e.g. "pos.x").
+ * @param indexes Array of "max_depth" elements receiving the path.
+ * @param max_depth Maximal depth of the path.
+ *
+ * Returns the depth of the path on success, a negative value on error.
+ */
+extern int bt_ctf_event_class_get_field_path(
+		struct bt_ctf_event_class *event_class, const char *name,
+		int *indexes, int max_depth);
+
 /*
  * bt_ctf_event_class_get_context_type: Get an event class's context type
  *
@@ -446,6 +482,89 @@ extern int bt_ctf_event_set_payload(struct bt_ctf_event *event,
 extern struct bt_ctf_field *bt_ctf_event_get_payload_by_index(
 		struct bt_ctf_event *event, int index);
 
+/*
+ * bt_ctf_event_set_payload_unsigned_integer: set an event's unsigned
+ * integer field by index.
+ *
+ * No reference is acquired on the payload field, which makes this
+ * function suitable for hot paths. The indexes to be provided are the
+ * same as can be retrieved from the event class.
+ *
+ * @param event Event instance.
+ * @param index Index of field.
+ * @param value Unsigned integer value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_set_payload_unsigned_integer(
+		struct bt_ctf_event *event, int index, uint64_t value);
+
+/*
+ * bt_ctf_event_set_payload_signed_integer: set an event's signed
+ * integer field by index.
+ *
+ * @param event Event instance.
+ * @param index Index of field.
+ * @param value Signed integer value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_set_payload_signed_integer(
+		struct bt_ctf_event *event, int index, int64_t value);
+
+/*
+ * bt_ctf_event_set_payload_integers: set an event's integer fields.
+ *
+ * Set the event's first "count" integer payload fields, in declaration
+ * order, in a single call. See bt_ctf_field_structure_set_integers.
+ *
+ * Fields which are neither integers nor enumerations are skipped. An
+ * error is returned if an enumeration field precedes the last integer
+ * to be set, rather than assigning the following values to the wrong
+ * fields.
+ *
+ * @param event Event instance.
+ * @param values Array of "count" integer values.
+ * @param count Number of values.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_set_payload_integers(struct bt_ctf_event *event,
+		const uint64_t *values, int count);
+
+/*
+ * bt_ctf_event_set_payload_unsigned_integer_by_path: set an event's
+ * unsigned integer field, possibly nested in structures, by path.
+ *
+ * The path is obtained once per event class using
+ * bt_ctf_event_class_get_field_path.
+ *
+ * @param event Event instance.
+ * @param indexes Path of the field.
+ * @param depth Number of indexes in the path.
+ * @param value Unsigned integer value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_set_payload_unsigned_integer_by_path(
+		struct bt_ctf_event *event, const int *indexes, int depth,
+		uint64_t value);
+
+/*
+ * bt_ctf_event_set_payload_signed_integer_by_path: set an event's
+ * signed integer field, possibly nested in structures, by path.
+ *
+ * @param event Event instance.
+ * @param indexes Path of the field.
+ * @param depth Number of indexes in the path.
+ * @param value Signed integer value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_set_payload_signed_integer_by_path(
+		struct bt_ctf_event *event, const int *indexes, int depth,
+		int64_t value);
+
 /*
  * bt_ctf_event_get_header: get an event's header.
  *
@@ -43,6 +43,7 @@ struct ctf_event_declaration;
 struct ctf_clock;
 struct ctf_callsite;
 struct ctf_scanner;
+struct ctf_metadata_intern;
 
 struct ctf_stream_packet_limits {
 	uint64_t begin;
@@ -69,6 +70,7 @@ struct ctf_stream_definition {
 	GPtrArray *events_by_id;		/* Array of struct ctf_event_definition pointers indexed by id */
 	struct definition_scope *parent_def_scope;	/* for initialization */
 	int stream_definitions_created;
+	struct bt_arena *definition_arena;	/* owns the definitions above */
 
 	struct ctf_clock *current_clock;
 
@@ -205,6 +207,10 @@ struct ctf_trace {
 	struct declaration_struct *packet_header_decl;
 	struct ctf_scanner *scanner;
 	int restart_root_decl;
+	/* Declarations shared with other traces, or NULL */
+	struct ctf_metadata_intern *metadata_intern;
+	/* Owns the declarations, shared with the traces sharing them */
+	struct bt_arena *declaration_arena;
 
 	uint64_t major;
 	uint64_t minor;
@@ -260,6 +266,7 @@ struct ctf_stream_declaration {
 	} field_mask;
 
 	GPtrArray *streams;	/* Array of struct ctf_stream_definition pointers */
+	int events_appended;	/* Events declared since last propagation */
 };
 
 #define CTF_EVENT_SET_FIELD(ctf_event, field)				\
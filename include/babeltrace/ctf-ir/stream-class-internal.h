@@ -50,6 +50,12 @@ struct bt_ctf_stream_class {
 	struct bt_ctf_field_type *packet_context_type;
 	struct bt_ctf_field_type *event_header_type;
 	struct bt_ctf_field_type *event_context_type;
+	/*
+	 * Indexes of the "id" and "timestamp" event header fields, -1 if
+	 * absent. Resolved when the stream class is frozen.
+	 */
+	int event_header_id_index;
+	int event_header_timestamp_index;
 	int frozen;
 	int byte_order;
 };
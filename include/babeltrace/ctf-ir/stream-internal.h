@@ -35,6 +35,52 @@
 #include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/ctf/types.h>
 #include <glib.h>
+#include <pthread.h>
+
+/* Event appended using bt_ctf_stream_append_raw_event() */
+struct bt_ctf_stream_raw_event {
+	uint64_t id;
+	uint64_t timestamp;
+	/* Payload alignment, in bits */
+	unsigned int alignment;
+	/* Payload size, in bytes */
+	size_t size;
+	uint8_t payload[];
+};
+
+/*
+ * A packet handed over to the background flushing thread. The job owns
+ * the events, the sampled stream event contexts and copies of the
+ * packet header and context; it is released by the producing thread
+ * once written since reference counts are not thread-safe.
+ */
+struct bt_ctf_stream_packet_job {
+	GPtrArray *events;
+	GPtrArray *event_contexts;
+	GPtrArray *raw_events;
+	struct bt_ctf_field *packet_header;
+	struct bt_ctf_field *packet_context;
+	/* Pre-resolved packet context fields, may be NULL */
+	struct bt_ctf_field *content_size;
+	struct bt_ctf_field *packet_size;
+	int ret;
+};
+
+struct bt_ctf_stream_async_flush {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Jobs waiting to be written by the background thread */
+	GQueue *pending;
+	/* Written jobs waiting to be released by the producing thread */
+	GQueue *completed;
+	/* Number of jobs either pending or being written */
+	unsigned int in_flight;
+	unsigned int queue_depth;
+	enum bt_ctf_stream_flush_policy policy;
+	int error;
+	int quit;
+};
 
 struct bt_ctf_stream {
 	struct bt_object base;
@@ -47,12 +93,27 @@ struct bt_ctf_stream {
 	/* Array of pointers to bt_ctf_field associated with each event */
 	GPtrArray *event_headers;
 	GPtrArray *event_contexts;
+	/*
+	 * Array of pointers to bt_ctf_stream_raw_event, parallel to events.
+	 * Raw events have a NULL entry in events and regular events have a
+	 * NULL entry in raw_events.
+	 */
+	GPtrArray *raw_events;
 	struct ctf_stream_pos pos;
 	unsigned int flushed_packet_count;
 	struct bt_ctf_field *packet_header;
 	struct bt_ctf_field *packet_context;
 	struct bt_ctf_field *event_header;
 	struct bt_ctf_field *event_context;
+	/*
+	 * Copy of event_context taken at the last append, shared by all
+	 * the events appended while event_context is left unmodified.
+	 */
+	struct bt_ctf_field *event_context_snapshot;
+	/* Header used to serialize raw events, created on first use */
+	struct bt_ctf_field *raw_event_header;
+	/* NULL unless asynchronous flushing is enabled */
+	struct bt_ctf_stream_async_flush *async_flush;
 };
 
 /* Stream class should be frozen by the caller after creating a stream */
@@ -32,6 +32,7 @@
 
 #include <babeltrace/ctf-ir/stream-class.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +41,13 @@ extern "C" {
 struct bt_ctf_event;
 struct bt_ctf_stream;
 
+enum bt_ctf_stream_flush_policy {
+	/* Block the flushing thread until the queue has room. */
+	BT_CTF_STREAM_FLUSH_POLICY_BLOCK = 0,
+	/* Discard the packet's events and account for them as discarded. */
+	BT_CTF_STREAM_FLUSH_POLICY_DISCARD = 1,
+};
+
 /*
  * bt_ctf_stream_get_stream_class: get a stream's class.
  *
@@ -98,6 +106,36 @@ extern void bt_ctf_stream_append_discarded_events(struct bt_ctf_stream *stream,
 extern int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		struct bt_ctf_event *event);
 
+/*
+ * bt_ctf_stream_append_raw_event: append a pre-serialized event payload.
+ *
+ * Append an event of class "event_class" whose payload is already laid
+ * out, as it is to be written in the trace, in "payload". The event
+ * header is populated with the event class' id and "timestamp", and the
+ * payload is copied as-is in the packet when the stream is flushed,
+ * bypassing the creation and serialization of a field tree. The stream
+ * event context is sampled as done by bt_ctf_stream_append_event.
+ *
+ * This is only supported if the event class has no context and its
+ * payload only contains integers, enumerations, floating point numbers,
+ * arrays and structures of those, with a byte-aligned layout. The event
+ * header must only contain the "id" and/or "timestamp" unsigned integer
+ * fields. Fields must be laid out with their own alignment and byte
+ * order, relative to the start of the payload.
+ *
+ * @param stream Stream instance.
+ * @param event_class Event class, which must belong to the stream's class.
+ * @param timestamp Value of the event header's timestamp field.
+ * @param payload Pre-serialized payload.
+ * @param payload_size Size of the payload in bytes, which must match the
+ *	event class' payload layout.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_stream_append_raw_event(struct bt_ctf_stream *stream,
+		struct bt_ctf_event_class *event_class, uint64_t timestamp,
+		const void *payload, size_t payload_size);
+
 /*
  * bt_ctf_stream_get_packet_header: get a stream's packet header.
  *
@@ -209,12 +247,64 @@ extern int bt_ctf_stream_set_event_context(
  * they remained unset while populating the current packet. These default
  * attributes, along with their expected types, are detailed in stream-class.h.
  *
+ * If asynchronous flushing is enabled, the packet is only queued for
+ * writing (see bt_ctf_stream_set_async_flush).
+ *
  * @param stream Stream instance.
  *
  * Returns 0 on success, a negative value on error.
  */
 extern int bt_ctf_stream_flush(struct bt_ctf_stream *stream);
 
+/*
+ * bt_ctf_stream_set_async_flush: enable asynchronous flushing.
+ *
+ * Once enabled, bt_ctf_stream_flush hands the current packet over to a
+ * background I/O thread which performs its serialization, the file
+ * allocation and the mapping of the packet. The caller may immediately
+ * resume appending events to the next packet.
+ *
+ * At most "queue_depth" packets may be waiting to be written. When the
+ * queue is full, bt_ctf_stream_flush either waits for a packet to be
+ * written (BT_CTF_STREAM_FLUSH_POLICY_BLOCK) or drops the packet's
+ * events and adds them to the stream's discarded events count
+ * (BT_CTF_STREAM_FLUSH_POLICY_DISCARD).
+ *
+ * Errors encountered while writing a packet are reported by the next
+ * call to bt_ctf_stream_flush or bt_ctf_stream_wait_flush.
+ *
+ * The events of a flushed packet are serialized by the background
+ * thread: the stream owns them until the packet is written and
+ * released, which bt_ctf_stream_wait_flush guarantees. Until then,
+ * appending them again and the bt_ctf_event_set_* functions fail. The
+ * caller must not modify their fields, obtained through
+ * bt_ctf_event_get_payload and the like, either: neither the fields
+ * nor their reference counts are protected against the background
+ * thread.
+ *
+ * Asynchronous flushing may only be enabled once per stream.
+ *
+ * @param stream Stream instance.
+ * @param queue_depth Maximal number of packets waiting to be written (> 0).
+ * @param policy Policy to apply when the queue is full.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_stream_set_async_flush(struct bt_ctf_stream *stream,
+		unsigned int queue_depth,
+		enum bt_ctf_stream_flush_policy policy);
+
+/*
+ * bt_ctf_stream_wait_flush: wait for all flushed packets to be written.
+ *
+ * Has no effect if asynchronous flushing is not enabled on the stream.
+ *
+ * @param stream Stream instance.
+ *
+ * Returns 0 on success, a negative value if a packet could not be written.
+ */
+extern int bt_ctf_stream_wait_flush(struct bt_ctf_stream *stream);
+
 /*
  * bt_ctf_stream_get and bt_ctf_stream_put: increment and decrement the
  * stream's reference count.
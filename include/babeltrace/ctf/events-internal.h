@@ -56,6 +56,11 @@ struct bt_ctf_event_decl {
 	GPtrArray *packet_context_decl;
 };
 
+struct bt_ctf_field_key {
+	GQuark name;
+	GQuark underscore_name;		/* "_"-prefixed name */
+};
+
 struct bt_ctf_iter {
 	struct bt_iter parent;
 	struct bt_ctf_event current_ctf_event;	/* last read event */
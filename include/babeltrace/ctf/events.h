@@ -44,6 +44,7 @@ struct bt_declaration;
 struct bt_ctf_event;
 struct bt_ctf_event_decl;
 struct bt_ctf_field_decl;
+struct bt_ctf_field_key;
 
 /*
  * the top-level scopes in CTF
@@ -141,6 +142,31 @@ const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *event,
 		const struct bt_definition *scope,
 		const char *field);
 
+/*
+ * bt_ctf_field_key_create: create a key for the field named "field",
+ * to be passed to bt_ctf_get_field_by_key(). Consumers looking up the
+ * same fields in every event should create their keys once: lookups
+ * by key neither hash the name nor take any lock.
+ *
+ * Return NULL on error. The key must be freed with
+ * bt_ctf_field_key_destroy().
+ */
+struct bt_ctf_field_key *bt_ctf_field_key_create(const char *field);
+
+/*
+ * bt_ctf_field_key_destroy: free a key created by
+ * bt_ctf_field_key_create()
+ */
+void bt_ctf_field_key_destroy(struct bt_ctf_field_key *key);
+
+/*
+ * bt_ctf_get_field_by_key: same as bt_ctf_get_field(), with a field key
+ * instead of a field name
+ */
+const struct bt_definition *bt_ctf_get_field_by_key(const struct bt_ctf_event *event,
+		const struct bt_definition *scope,
+		const struct bt_ctf_field_key *key);
+
 /*
  * bt_ctf_get_index: if the field is an array or a sequence, return the element
  * at position index, otherwise return NULL;
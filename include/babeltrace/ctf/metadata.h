@@ -34,6 +34,7 @@
 #include <babeltrace/trace-handle-internal.h>
 #include <babeltrace/context-internal.h>
 #include <sys/types.h>
+#include <stdio.h>
 #include <dirent.h>
 #include <assert.h>
 #include <glib.h>
@@ -44,6 +45,9 @@
 struct ctf_file_stream {
 	struct ctf_stream_definition parent;
 	struct ctf_stream_pos pos;	/* current stream position */
+	/* Truncated last packet, only recorded in verify mode */
+	int truncated;
+	off_t truncated_offset;		/* in bytes */
 };
 
 #define HEADER_END		char end_field
@@ -63,4 +67,15 @@ struct metadata_packet_header {
 	HEADER_END;
 };
 
+/*
+ * Print a health report of an open trace on "fp", computed from its
+ * stream packet indexes only: packet counts, time ranges, gaps,
+ * overlaps, discarded events and truncation. Meant for traces opened
+ * with babeltrace_ctf_verify set.
+ *
+ * Return the number of problems found (overlapping or truncated
+ * packets), or a negative value on error.
+ */
+int ctf_verify_trace(FILE *fp, struct bt_trace_descriptor *descriptor);
+
 #endif /* _BABELTRACE_CTF_METADATA_H */
@@ -29,6 +29,7 @@
 
 #include <babeltrace/types.h>
 #include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/list.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -43,6 +44,8 @@
 #define LAST_OFFSET_POISON	((int64_t) ~0ULL)
 
 struct bt_stream_callbacks;
+struct bt_mmap_stream;
+struct ctf_file_stream;
 
 struct packet_index_time {
 	uint64_t timestamp_begin;
@@ -63,6 +66,74 @@ struct packet_index {
 	uint64_t packet_seq_num;	/* packet sequence number */
 };
 
+/*
+ * Compact packet index.
+ *
+ * Packets are grouped in chunks of PACKET_INDEX_CHUNK_LEN entries. A
+ * chunk keeps the offset, timestamps and counters of its first packet
+ * in full; each entry stores 32-bit deltas from them, and its packet
+ * size as a power of two. Packets which do not fit this encoding are
+ * kept in full in an escape array. Access by packet number is O(1),
+ * search by time is a binary search.
+ *
+ * Entries are decoded into a struct packet_index: use
+ * ctf_packet_index_set() to update one.
+ */
+#define PACKET_INDEX_CHUNK_LEN		256
+
+struct packet_index_chunk {
+	off_t offset;
+	uint64_t cycles_begin;
+	uint64_t real_begin;		/* valid if real_set */
+	uint64_t events_discarded;
+	uint64_t events_discarded_len;
+	uint64_t stream_instance_id;
+	uint64_t packet_seq_num;
+	int real_set;
+};
+
+struct packet_index_entry {
+	uint32_t offset;		/* from chunk, in bytes, or escape index */
+	uint32_t data_offset;		/* in bits, UINT32_MAX if unknown */
+	uint32_t padding;		/* packet_size - content_size, in bits */
+	uint32_t cycles_begin;		/* from chunk */
+	uint32_t cycles_duration;
+	uint32_t real_begin;		/* from chunk */
+	uint32_t real_duration;
+	uint32_t events_discarded;	/* from chunk */
+	uint32_t packet_seq_num;	/* from chunk */
+	uint8_t packet_size_order;	/* packet size is 1 << order bits */
+	uint8_t flags;			/* enum packet_index_entry_flags */
+};
+
+enum packet_index_entry_flags {
+	PACKET_INDEX_ESCAPED =	(1U << 0),	/* in the escape array */
+	PACKET_INDEX_NO_REAL =	(1U << 1),	/* ts_real not set */
+};
+
+struct packet_index_table {
+	unsigned int len;	/* number of packets */
+	GArray *chunks;		/* struct packet_index_chunk */
+	GArray *entries;	/* struct packet_index_entry */
+	GArray *escapes;	/* struct packet_index */
+};
+
+struct packet_index_table *ctf_packet_index_table_new(void);
+void ctf_packet_index_table_free(struct packet_index_table *table);
+void ctf_packet_index_append(struct packet_index_table *table,
+		const struct packet_index *index);
+void ctf_packet_index_get(const struct packet_index_table *table,
+		unsigned int i, struct packet_index *index);
+void ctf_packet_index_set(struct packet_index_table *table,
+		unsigned int i, const struct packet_index *index);
+/*
+ * Return the first packet whose real end timestamp is at or after
+ * "timestamp", or table->len if there is none. The real timestamps of
+ * the packets of a stream are increasing.
+ */
+unsigned int ctf_packet_index_search_real(
+		const struct packet_index_table *table, uint64_t timestamp);
+
 /*
  * Always update ctf_stream_pos with ctf_move_pos and ctf_init_pos.
  */
@@ -70,7 +141,7 @@ struct ctf_stream_pos {
 	struct bt_stream_pos parent;
 	int fd;			/* backing file fd. -1 if unset. */
 	FILE *index_fp;		/* backing index file fp. NULL if unset. */
-	GArray *packet_index;	/* contains struct packet_index */
+	struct packet_index_table *packet_index;
 	int prot;		/* mmap protection */
 	int flags;		/* mmap flags */
 
@@ -92,6 +163,11 @@ struct ctf_stream_pos {
 	int dummy;		/* dummy position, for length calculation */
 	struct bt_stream_callbacks *cb;	/* Callbacks registered for iterator. */
 	void *priv;
+
+	/* File descriptor pool (read-side file streams only) */
+	int fd_pooled;		/* fd closed and reopened by the fd pool */
+	int fd_pinned;		/* fd in use, cannot be closed */
+	struct bt_list_head fd_node;	/* fd pool LRU list node */
 };
 
 static inline
@@ -135,6 +211,25 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 		int fd, int open_flags);
 int ctf_fini_pos(struct ctf_stream_pos *pos);
 
+/*
+ * File descriptor pool. The fd of a read-side file stream is only
+ * needed to map packets: once added to the pool, it is closed when
+ * the number of open stream files exceeds the pool limit (least
+ * recently used first), and reopened when a packet is mapped.
+ *
+ * ctf_fd_pool_get() pins the fd of a pooled position (reopening it if
+ * needed) and returns 0, or a negative error value. ctf_fd_pool_put()
+ * releases it. Both are no-ops for positions not in the pool.
+ */
+BT_HIDDEN
+void ctf_fd_pool_add(struct ctf_stream_pos *pos);
+BT_HIDDEN
+void ctf_fd_pool_remove(struct ctf_stream_pos *pos);
+BT_HIDDEN
+int ctf_fd_pool_get(struct ctf_stream_pos *pos);
+BT_HIDDEN
+void ctf_fd_pool_put(struct ctf_stream_pos *pos);
+
 static inline
 int ctf_pos_access_ok(struct ctf_stream_pos *pos, uint64_t bit_len)
 {
@@ -249,5 +344,10 @@ void ctf_print_timestamp(FILE *fp, struct ctf_stream_definition *stream,
 			uint64_t timestamp);
 int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 			FILE *metadata_fp);
+int ctf_append_mmap_stream(struct bt_trace_descriptor *tdp,
+			struct bt_mmap_stream *mmap_info,
+			void (*packet_seek)(struct bt_stream_pos *pos,
+				size_t index, int whence),
+			struct ctf_file_stream **file_stream);
 
 #endif /* _BABELTRACE_CTF_TYPES_H */
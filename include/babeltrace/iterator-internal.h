@@ -31,6 +31,8 @@
 
 #include <babeltrace/ctf/events.h>
 
+struct ctf_file_stream;
+
 /*
  * struct bt_iter: data structure representing an iterator on a trace
  * collection.
@@ -69,5 +71,12 @@ int bt_iter_init(struct bt_iter *iter,
 void bt_iter_fini(struct bt_iter *iter);
 int bt_iter_add_trace(struct bt_iter *iter,
 		struct bt_trace_descriptor *td_read);
+/*
+ * bt_iter_add_stream - Add a stream opened after the iterator was
+ * created, read from its beginning. Must not be called while the
+ * iterator moves, i.e. from a packet_seek function.
+ */
+int bt_iter_add_stream(struct bt_iter *iter,
+		struct ctf_file_stream *file_stream);
 
 #endif /* _BABELTRACE_ITERATOR_INTERNAL_H */
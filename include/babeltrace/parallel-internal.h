@@ -0,0 +1,50 @@
+#ifndef _BABELTRACE_PARALLEL_INTERNAL_H
+#define _BABELTRACE_PARALLEL_INTERNAL_H
+
+/*
+ * BabelTrace
+ *
+ * Internal parallel work distribution header
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * bt_parallel_nr_threads : number of worker threads to use
+ *
+ * Taken from the BABELTRACE_OPEN_THREADS environment variable if set,
+ * else the number of online processors. Always at least 1.
+ */
+unsigned int bt_parallel_nr_threads(void);
+
+/*
+ * bt_parallel_for : call fn(index, priv) for each index in [0, nr_items)
+ *
+ * Items are handed out to up to nr_threads threads (the caller
+ * included) in no particular order: fn must store its result in a
+ * per-index slot, which the caller merges in index order once this
+ * function returns. Calls made from within a worker, or with
+ * nr_threads <= 1, run serially in the calling thread.
+ */
+void bt_parallel_for(unsigned int nr_items, unsigned int nr_threads,
+		void (*fn)(unsigned int index, void *priv), void *priv);
+
+#endif /* _BABELTRACE_PARALLEL_INTERNAL_H */
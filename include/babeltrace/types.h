@@ -47,6 +47,7 @@ struct bt_stream_pos;
 struct bt_format;
 struct bt_definition;
 struct ctf_clock;
+struct bt_arena;
 
 /* type scope */
 struct declaration_scope {
@@ -82,8 +83,11 @@ struct bt_declaration {
 	enum ctf_type_id id;
 	size_t alignment;	/* type alignment, in bits */
 	int ref;		/* number of references to the type */
+	struct bt_arena *arena;	/* owner arena, or NULL if refcounted */
 	/*
-	 * declaration_free called with declaration ref is decremented to 0.
+	 * declaration_free called with declaration ref is decremented to 0,
+	 * or when its arena is destroyed. Releases what the declaration
+	 * owns, but not the declaration itself.
 	 */
 	void (*declaration_free)(struct bt_declaration *declaration);
 	struct bt_definition *
@@ -92,7 +96,9 @@ struct bt_declaration {
 				  GQuark field_name, int index,
 				  const char *root_name);
 	/*
-	 * definition_free called with definition ref is decremented to 0.
+	 * definition_free called with definition ref is decremented to 0,
+	 * or when its arena is destroyed. Releases what the definition
+	 * owns, but not the definition itself.
 	 */
 	void (*definition_free)(struct bt_definition *definition);
 };
@@ -102,6 +108,7 @@ struct bt_definition {
 	int index;		/* Position of the definition in its container */
 	GQuark name;		/* Field name in its container (or 0 if unset) */
 	int ref;		/* number of references to the definition */
+	struct bt_arena *arena;	/* owner arena, or NULL if refcounted */
 	GQuark path;
 	struct definition_scope *scope;
 };
@@ -197,6 +204,11 @@ struct enum_range_to_quark {
 	GQuark quark;
 };
 
+struct enum_entry {
+	struct enum_range range;
+	GQuark quark;
+};
+
 /*
  * We optimize the common case (range of size 1: single value) by creating a
  * hash table mapping values to quark sets. We then lookup the ranges to
@@ -213,6 +225,7 @@ struct enum_table {
 	GHashTable *value_to_quark_set;		/* (value, GQuark GArray) */
 	struct bt_list_head range_to_quark;	/* (range, GQuark) */
 	GHashTable *quark_to_range_set;		/* (GQuark, range GArray) */
+	GArray *entries;			/* (range, GQuark), in insertion order */
 };
 
 struct declaration_enum {
@@ -251,6 +264,7 @@ struct declaration_struct {
 	GHashTable *fields_by_name;	/* Tuples (field name, field index) */
 	struct declaration_scope *scope;
 	GArray *fields;			/* Array of declaration_field */
+	GHashTable *aliases;		/* Underscore aliases, or NULL */
 };
 
 struct definition_struct {
@@ -264,6 +278,7 @@ struct declaration_untagged_variant {
 	GHashTable *fields_by_tag;	/* Tuples (field tag, field index) */
 	struct declaration_scope *scope;
 	GArray *fields;			/* Array of declaration_field */
+	GHashTable *aliases;		/* Underscore aliases, or NULL */
 };
 
 struct declaration_variant {
@@ -375,6 +390,27 @@ void bt_declaration_unref(struct bt_declaration *declaration);
 void bt_definition_ref(struct bt_definition *definition);
 void bt_definition_unref(struct bt_definition *definition);
 
+/*
+ * Declarations and definitions created by a thread while it has an
+ * arena set are allocated from that arena: they ignore reference
+ * counting and are freed with the arena, which must outlive their
+ * users. The setters return the previously set arena (NULL by
+ * default), to be restored by the caller.
+ */
+struct bt_arena *bt_declaration_set_arena(struct bt_arena *arena);
+struct bt_arena *bt_definition_set_arena(struct bt_arena *arena);
+
+/*
+ * Allocate a zeroed declaration or definition structure of len bytes,
+ * beginning with its struct bt_declaration or struct bt_definition.
+ * bt_declaration_dealloc() and bt_definition_dealloc() free them once
+ * their content is released.
+ */
+void *bt_declaration_alloc(size_t len);
+void bt_declaration_dealloc(struct bt_declaration *declaration);
+void *bt_definition_alloc(size_t len);
+void bt_definition_dealloc(struct bt_definition *definition);
+
 struct declaration_integer *bt_integer_declaration_new(size_t len, int byte_order,
 				  int signedness, size_t alignment,
 				  int base, enum ctf_string_encoding encoding,
@@ -527,6 +563,8 @@ void bt_append_scope_path(const char *path, GArray *q);
  */
 struct bt_definition *bt_lookup_definition(const struct bt_definition *definition,
 				     const char *field_name);
+struct bt_definition *bt_lookup_definition_quark(const struct bt_definition *definition,
+					   GQuark field_name);
 struct definition_integer *bt_lookup_integer(const struct bt_definition *definition,
 					  const char *field_name,
 					  int signedness);
@@ -536,6 +574,23 @@ struct definition_enum *bt_lookup_enum(const struct bt_definition *definition,
 struct bt_definition *bt_lookup_variant(const struct bt_definition *definition,
 				  const char *field_name);
 
+/*
+ * bt_quark_lookup: return the quark of an existing string, or 0 if the
+ * string has never been interned. Unlike g_quark_try_string(), it only
+ * takes the GLib quark lock the first time a thread looks a string up.
+ */
+GQuark bt_quark_lookup(const char *string);
+
+/*
+ * Underscore aliases: a field named "_foo" can be looked up as "foo".
+ * The alias table of a structure or variant declaration maps the
+ * unprefixed field name quark to the prefixed one. It is built as
+ * fields are added, and only read afterwards.
+ */
+void bt_declaration_add_field_alias(GHashTable **aliases, GQuark field_name);
+GQuark bt_lookup_field_alias(const struct bt_definition *definition,
+		GQuark field_name);
+
 static inline
 const char *rem_(const char *str)
 {
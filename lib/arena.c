@@ -0,0 +1,140 @@
+/*
+ * arena.c
+ *
+ * Babeltrace Library - arena allocator
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/arena-internal.h>
+#include <babeltrace/align.h>
+#include <stddef.h>
+#include <glib.h>
+
+#define ARENA_ALIGN		8
+#define ARENA_INIT_CHUNK_LEN	4096
+#define ARENA_MAX_CHUNK_LEN	(1UL << 20)
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t len;
+	size_t used_len;
+	char __attribute__ ((aligned (ARENA_ALIGN))) data[];
+};
+
+/* Header of the objects allocated with bt_arena_alloc_object(). */
+struct arena_object {
+	struct arena_object *next;
+	void (*release)(void *object);
+	char __attribute__ ((aligned (ARENA_ALIGN))) data[];
+};
+
+struct bt_arena {
+	int ref;
+	struct arena_chunk *chunks;	/* current chunk first */
+	struct arena_object *objects;	/* most recent first */
+};
+
+struct bt_arena *bt_arena_create(void)
+{
+	struct bt_arena *arena;
+
+	arena = g_new0(struct bt_arena, 1);
+	arena->ref = 1;
+	return arena;
+}
+
+void bt_arena_get(struct bt_arena *arena)
+{
+	if (!arena)
+		return;
+	g_atomic_int_inc(&arena->ref);
+}
+
+void bt_arena_put(struct bt_arena *arena)
+{
+	struct arena_object *object;
+	struct arena_chunk *chunk, *next;
+
+	if (!arena)
+		return;
+	if (!g_atomic_int_dec_and_test(&arena->ref))
+		return;
+	/*
+	 * Release callbacks may still look at other objects of the
+	 * arena: free the chunks only once they have all run.
+	 */
+	for (object = arena->objects; object; object = object->next) {
+		if (object->release)
+			object->release(object->data);
+	}
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		g_free(chunk);
+	}
+	g_free(arena);
+}
+
+void *bt_arena_alloc(struct bt_arena *arena, size_t len)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	void *p;
+
+	len = ALIGN(len, ARENA_ALIGN);
+	if (!chunk || chunk->len - chunk->used_len < len) {
+		size_t chunk_len;
+
+		/* Double the chunk size at each new chunk, up to a limit. */
+		chunk_len = chunk ? chunk->len << 1 : ARENA_INIT_CHUNK_LEN;
+		if (chunk_len > ARENA_MAX_CHUNK_LEN)
+			chunk_len = ARENA_MAX_CHUNK_LEN;
+		if (chunk_len < len)
+			chunk_len = len;
+		chunk = g_malloc0(sizeof(*chunk) + chunk_len);
+		chunk->len = chunk_len;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	p = &chunk->data[chunk->used_len];
+	chunk->used_len += len;
+	return p;
+}
+
+void *bt_arena_alloc_object(struct bt_arena *arena, size_t len,
+		void (*release)(void *object))
+{
+	struct arena_object *object;
+
+	object = bt_arena_alloc(arena, sizeof(*object) + len);
+	object->release = release;
+	object->next = arena->objects;
+	arena->objects = object;
+	return object->data;
+}
+
+void bt_arena_cancel_release(void *object)
+{
+	struct arena_object *header = (struct arena_object *)
+		((char *) object - offsetof(struct arena_object, data));
+
+	header->release = NULL;
+}
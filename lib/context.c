@@ -36,6 +36,7 @@
 #include <babeltrace/format.h>
 #include <babeltrace/format-internal.h>
 #include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/parallel-internal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -69,46 +70,19 @@ struct bt_context *bt_context_create(void)
 	return ctx;
 }
 
-int bt_context_add_trace(struct bt_context *ctx, const char *path,
-		const char *format_name,
-		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
-			int whence),
-		struct bt_mmap_stream_list *stream_list,
-		FILE *metadata)
+/*
+ * Register an opened trace descriptor in the context. Handle ids are
+ * allocated here, so the order of the calls determines them. The trace
+ * is closed on error.
+ */
+static
+int context_add_trace_descriptor(struct bt_context *ctx,
+		struct bt_format *fmt, struct bt_trace_descriptor *td,
+		const char *path)
 {
-	struct bt_trace_descriptor *td;
-	struct bt_format *fmt;
 	struct bt_trace_handle *handle;
 	int ret, closeret;
 
-	if (!ctx || !format_name || (!path && !stream_list))
-		return -EINVAL;
-
-	fmt = bt_lookup_format(g_quark_from_string(format_name));
-	if (!fmt) {
-		fprintf(stderr, "[error] [Context] Format \"%s\" unknown.\n\n",
-			format_name);
-		ret = -1;
-		goto end;
-	}
-	if (path) {
-		td = fmt->open_trace(path, O_RDONLY, packet_seek, NULL);
-		if (!td) {
-			fprintf(stderr, "[warning] [Context] Cannot open_trace of format %s at path %s.\n",
-					format_name, path);
-			ret = -1;
-			goto end;
-		}
-	} else {
-		td = fmt->open_mmap_trace(stream_list, packet_seek, metadata);
-		if (!td) {
-			fprintf(stderr, "[error] [Context] Cannot open_mmap_trace of format %s.\n\n",
-					format_name);
-			ret = -1;
-			goto end;
-		}
-	}
-
 	/* Create an handle for the trace */
 	handle = bt_trace_handle_create(ctx);
 	if (!handle) {
@@ -163,10 +137,115 @@ error:
 	if (closeret) {
 		fprintf(stderr, "Error in close_trace callback\n");
 	}
+	return ret;
+}
+
+int bt_context_add_trace(struct bt_context *ctx, const char *path,
+		const char *format_name,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence),
+		struct bt_mmap_stream_list *stream_list,
+		FILE *metadata)
+{
+	struct bt_trace_descriptor *td;
+	struct bt_format *fmt;
+	int ret;
+
+	if (!ctx || !format_name || (!path && !stream_list))
+		return -EINVAL;
+
+	fmt = bt_lookup_format(g_quark_from_string(format_name));
+	if (!fmt) {
+		fprintf(stderr, "[error] [Context] Format \"%s\" unknown.\n\n",
+			format_name);
+		ret = -1;
+		goto end;
+	}
+	if (path) {
+		td = fmt->open_trace(path, O_RDONLY, packet_seek, NULL);
+		if (!td) {
+			fprintf(stderr, "[warning] [Context] Cannot open_trace of format %s at path %s.\n",
+					format_name, path);
+			ret = -1;
+			goto end;
+		}
+	} else {
+		td = fmt->open_mmap_trace(stream_list, packet_seek, metadata);
+		if (!td) {
+			fprintf(stderr, "[error] [Context] Cannot open_mmap_trace of format %s.\n\n",
+					format_name);
+			ret = -1;
+			goto end;
+		}
+	}
+
+	ret = context_add_trace_descriptor(ctx, fmt, td, path);
 end:
 	return ret;
 }
 
+struct open_traces_work {
+	struct bt_format *fmt;
+	const char * const *paths;
+	void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+		int whence);
+	struct bt_trace_descriptor **tds;
+};
+
+static
+void open_trace_worker(unsigned int index, void *priv)
+{
+	struct open_traces_work *work = priv;
+
+	work->tds[index] = work->fmt->open_trace(work->paths[index],
+			O_RDONLY, work->packet_seek, NULL);
+}
+
+int bt_context_add_traces(struct bt_context *ctx,
+		const char * const *paths, int nr_paths,
+		const char *format_name,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence),
+		int *handle_ids)
+{
+	struct open_traces_work work;
+	struct bt_format *fmt;
+	int i, nr_added = 0;
+
+	if (!ctx || !paths || nr_paths < 0 || !format_name || !handle_ids)
+		return -EINVAL;
+
+	fmt = bt_lookup_format(g_quark_from_string(format_name));
+	if (!fmt) {
+		fprintf(stderr, "[error] [Context] Format \"%s\" unknown.\n\n",
+			format_name);
+		return -1;
+	}
+
+	work.fmt = fmt;
+	work.paths = paths;
+	work.packet_seek = packet_seek;
+	work.tds = g_new0(struct bt_trace_descriptor *, nr_paths);
+	bt_parallel_for(nr_paths, bt_parallel_nr_threads(),
+			open_trace_worker, &work);
+
+	/* Register in path order so that handle ids are stable. */
+	for (i = 0; i < nr_paths; i++) {
+		if (!work.tds[i]) {
+			fprintf(stderr, "[warning] [Context] Cannot open_trace of format %s at path %s.\n",
+					format_name, paths[i]);
+			handle_ids[i] = -1;
+			continue;
+		}
+		handle_ids[i] = context_add_trace_descriptor(ctx, fmt,
+				work.tds[i], paths[i]);
+		if (handle_ids[i] >= 0)
+			nr_added++;
+	}
+	g_free(work.tds);
+	return nr_added;
+}
+
 int bt_context_remove_trace(struct bt_context *ctx, int handle_id)
 {
 	int ret = 0;
@@ -122,38 +122,31 @@ void bt_iter_free_pos(struct bt_iter_pos *iter_pos)
  *
  * Return 0 if the seek succeded, EOF if we didn't find any packet
  * containing the timestamp, or a positive integer for error.
- *
- * TODO: this should be turned into a binary search! It is currently
- * doing a linear search in the packets. This is a O(n) operation on a
- * very frequent code path.
  */
 static int seek_file_stream_by_timestamp(struct ctf_file_stream *cfs,
 		uint64_t timestamp)
 {
 	struct ctf_stream_pos *stream_pos;
-	struct packet_index *index;
-	int i, ret;
+	unsigned int i;
+	int ret;
 
 	stream_pos = &cfs->pos;
-	for (i = 0; i < stream_pos->packet_index->len; i++) {
-		index = &g_array_index(stream_pos->packet_index,
-				struct packet_index, i);
-		if (index->ts_real.timestamp_end < timestamp)
-			continue;
+	i = ctf_packet_index_search_real(stream_pos->packet_index, timestamp);
+	if (i >= stream_pos->packet_index->len) {
+		/*
+		 * Cannot find the timestamp within the stream packets,
+		 * return EOF.
+		 */
+		return EOF;
+	}
 
-		stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
-		do {
-			ret = stream_read_event(cfs);
-		} while (cfs->parent.real_timestamp < timestamp && ret == 0);
+	stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
+	do {
+		ret = stream_read_event(cfs);
+	} while (cfs->parent.real_timestamp < timestamp && ret == 0);
 
-		/* Can return either EOF, 0, or error (> 0). */
-		return ret;
-	}
-	/*
-	 * Cannot find the timestamp within the stream packets, return
-	 * EOF.
-	 */
-	return EOF;
+	/* Can return either EOF, 0, or error (> 0). */
+	return ret;
 }
 
 /*
@@ -664,6 +657,24 @@ static int babeltrace_filestream_seek(struct ctf_file_stream *file_stream,
 	return ret;
 }
 
+int bt_iter_add_stream(struct bt_iter *iter,
+		struct ctf_file_stream *file_stream)
+{
+	struct bt_iter_pos pos;
+	int ret;
+
+	pos.type = BT_SEEK_BEGIN;
+	ret = babeltrace_filestream_seek(file_stream, &pos,
+			file_stream->parent.stream_id);
+	if (ret == EOF) {
+		return 0;
+	} else if (ret != 0 && ret != EAGAIN) {
+		return ret;
+	}
+	/* Add to heap */
+	return bt_heap_insert(iter->stream_heap, file_stream);
+}
+
 int bt_iter_add_trace(struct bt_iter *iter,
 		struct bt_trace_descriptor *td_read)
 {
@@ -684,25 +695,13 @@ int bt_iter_add_trace(struct bt_iter *iter,
 		for (filenr = 0; filenr < stream->streams->len;
 				filenr++) {
 			struct ctf_file_stream *file_stream;
-			struct bt_iter_pos pos;
 
 			file_stream = g_ptr_array_index(stream->streams,
 					filenr);
 			if (!file_stream)
 				continue;
 
-			pos.type = BT_SEEK_BEGIN;
-			ret = babeltrace_filestream_seek(file_stream,
-					&pos, stream_id);
-
-			if (ret == EOF) {
-				ret = 0;
-				continue;
-			} else if (ret != 0 && ret != EAGAIN) {
-				goto error;
-			}
-			/* Add to heap */
-			ret = bt_heap_insert(iter->stream_heap, file_stream);
+			ret = bt_iter_add_stream(iter, file_stream);
 			if (ret)
 				goto error;
 		}
@@ -0,0 +1,249 @@
+/*
+ * packet-index.c
+ *
+ * Babeltrace Library - compact CTF packet index
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/types.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <glib.h>
+
+struct packet_index_table *ctf_packet_index_table_new(void)
+{
+	struct packet_index_table *table;
+
+	table = g_new0(struct packet_index_table, 1);
+	table->chunks = g_array_new(FALSE, TRUE,
+			sizeof(struct packet_index_chunk));
+	table->entries = g_array_new(FALSE, TRUE,
+			sizeof(struct packet_index_entry));
+	table->escapes = g_array_new(FALSE, TRUE,
+			sizeof(struct packet_index));
+	return table;
+}
+
+void ctf_packet_index_table_free(struct packet_index_table *table)
+{
+	if (!table)
+		return;
+	(void) g_array_free(table->chunks, TRUE);
+	(void) g_array_free(table->entries, TRUE);
+	(void) g_array_free(table->escapes, TRUE);
+	g_free(table);
+}
+
+/* Store b - a in *delta if it fits 32 bits. */
+static
+int delta32(uint64_t a, uint64_t b, uint32_t *delta)
+{
+	if (b < a || b - a > UINT32_MAX)
+		return -1;
+	*delta = b - a;
+	return 0;
+}
+
+/*
+ * Encode "index" relative to its chunk. Return 0 on success, -1 if the
+ * packet must be escaped.
+ */
+static
+int encode_entry(struct packet_index_chunk *chunk,
+		const struct packet_index *index,
+		struct packet_index_entry *entry)
+{
+	uint64_t packet_size = index->packet_size;
+
+	memset(entry, 0, sizeof(*entry));
+	if (index->events_discarded_len != chunk->events_discarded_len
+			|| index->stream_instance_id != chunk->stream_instance_id)
+		return -1;
+	if (index->offset < chunk->offset
+			|| delta32(chunk->offset, index->offset, &entry->offset))
+		return -1;
+	if (index->data_offset == -1) {
+		entry->data_offset = UINT32_MAX;
+	} else if (index->data_offset < 0
+			|| index->data_offset >= UINT32_MAX) {
+		return -1;
+	} else {
+		entry->data_offset = index->data_offset;
+	}
+	/* Power of two packet size. */
+	if (!packet_size || (packet_size & (packet_size - 1)))
+		return -1;
+	while (packet_size >>= 1)
+		entry->packet_size_order++;
+	if (delta32(index->content_size, index->packet_size, &entry->padding))
+		return -1;
+	if (delta32(chunk->cycles_begin, index->ts_cycles.timestamp_begin,
+				&entry->cycles_begin)
+			|| delta32(index->ts_cycles.timestamp_begin,
+				index->ts_cycles.timestamp_end,
+				&entry->cycles_duration))
+		return -1;
+	if (!index->ts_real.timestamp_begin && !index->ts_real.timestamp_end) {
+		entry->flags |= PACKET_INDEX_NO_REAL;
+	} else {
+		/* Real timestamps are set after the packets are indexed. */
+		if (!chunk->real_set) {
+			chunk->real_begin = index->ts_real.timestamp_begin;
+			chunk->real_set = 1;
+		}
+		if (delta32(chunk->real_begin, index->ts_real.timestamp_begin,
+					&entry->real_begin)
+				|| delta32(index->ts_real.timestamp_begin,
+					index->ts_real.timestamp_end,
+					&entry->real_duration))
+			return -1;
+	}
+	if (delta32(chunk->events_discarded, index->events_discarded,
+				&entry->events_discarded)
+			|| delta32(chunk->packet_seq_num, index->packet_seq_num,
+				&entry->packet_seq_num))
+		return -1;
+	return 0;
+}
+
+static
+void store_entry(struct packet_index_table *table, unsigned int i,
+		const struct packet_index *index)
+{
+	struct packet_index_chunk *chunk;
+	struct packet_index_entry *entry, encoded;
+	uint32_t escape;
+
+	chunk = &g_array_index(table->chunks, struct packet_index_chunk,
+			i / PACKET_INDEX_CHUNK_LEN);
+	entry = &g_array_index(table->entries, struct packet_index_entry, i);
+	if (entry->flags & PACKET_INDEX_ESCAPED) {
+		/* Reuse the escape slot. */
+		g_array_index(table->escapes, struct packet_index,
+			entry->offset) = *index;
+		return;
+	}
+	if (!encode_entry(chunk, index, &encoded)) {
+		*entry = encoded;
+		return;
+	}
+	escape = table->escapes->len;
+	g_array_append_val(table->escapes, *index);
+	memset(entry, 0, sizeof(*entry));
+	entry->offset = escape;
+	entry->flags = PACKET_INDEX_ESCAPED;
+}
+
+void ctf_packet_index_append(struct packet_index_table *table,
+		const struct packet_index *index)
+{
+	unsigned int i = table->len;
+
+	if (!(i % PACKET_INDEX_CHUNK_LEN)) {
+		struct packet_index_chunk chunk;
+
+		memset(&chunk, 0, sizeof(chunk));
+		chunk.offset = index->offset;
+		chunk.cycles_begin = index->ts_cycles.timestamp_begin;
+		if (index->ts_real.timestamp_begin
+				|| index->ts_real.timestamp_end) {
+			chunk.real_begin = index->ts_real.timestamp_begin;
+			chunk.real_set = 1;
+		}
+		chunk.events_discarded = index->events_discarded;
+		chunk.events_discarded_len = index->events_discarded_len;
+		chunk.stream_instance_id = index->stream_instance_id;
+		chunk.packet_seq_num = index->packet_seq_num;
+		g_array_append_val(table->chunks, chunk);
+	}
+	g_array_set_size(table->entries, i + 1);
+	table->len++;
+	store_entry(table, i, index);
+}
+
+void ctf_packet_index_get(const struct packet_index_table *table,
+		unsigned int i, struct packet_index *index)
+{
+	const struct packet_index_chunk *chunk;
+	const struct packet_index_entry *entry;
+
+	assert(i < table->len);
+	entry = &g_array_index(table->entries, struct packet_index_entry, i);
+	if (entry->flags & PACKET_INDEX_ESCAPED) {
+		*index = g_array_index(table->escapes, struct packet_index,
+				entry->offset);
+		return;
+	}
+	chunk = &g_array_index(table->chunks, struct packet_index_chunk,
+			i / PACKET_INDEX_CHUNK_LEN);
+	index->offset = chunk->offset + entry->offset;
+	if (entry->data_offset == UINT32_MAX)
+		index->data_offset = -1;
+	else
+		index->data_offset = entry->data_offset;
+	index->packet_size = 1ULL << entry->packet_size_order;
+	index->content_size = index->packet_size - entry->padding;
+	index->events_discarded = chunk->events_discarded
+		+ entry->events_discarded;
+	index->events_discarded_len = chunk->events_discarded_len;
+	index->ts_cycles.timestamp_begin = chunk->cycles_begin
+		+ entry->cycles_begin;
+	index->ts_cycles.timestamp_end = index->ts_cycles.timestamp_begin
+		+ entry->cycles_duration;
+	if (entry->flags & PACKET_INDEX_NO_REAL) {
+		index->ts_real.timestamp_begin = 0;
+		index->ts_real.timestamp_end = 0;
+	} else {
+		index->ts_real.timestamp_begin = chunk->real_begin
+			+ entry->real_begin;
+		index->ts_real.timestamp_end = index->ts_real.timestamp_begin
+			+ entry->real_duration;
+	}
+	index->stream_instance_id = chunk->stream_instance_id;
+	index->packet_seq_num = chunk->packet_seq_num + entry->packet_seq_num;
+}
+
+void ctf_packet_index_set(struct packet_index_table *table,
+		unsigned int i, const struct packet_index *index)
+{
+	assert(i < table->len);
+	store_entry(table, i, index);
+}
+
+unsigned int ctf_packet_index_search_real(
+		const struct packet_index_table *table, uint64_t timestamp)
+{
+	unsigned int low = 0, high = table->len;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		struct packet_index index;
+
+		ctf_packet_index_get(table, mid, &index);
+		if (index.ts_real.timestamp_end < timestamp)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
@@ -0,0 +1,126 @@
+/*
+ * parallel.c
+ *
+ * Babeltrace Library - parallel work distribution
+ *
+ * Copyright 2016 - EfficiOS Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/parallel-internal.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+struct parallel_work {
+	void (*fn)(unsigned int index, void *priv);
+	void *priv;
+	unsigned int nr_items;
+	pthread_mutex_t lock;	/* protects next */
+	unsigned int next;	/* next item to hand out */
+};
+
+/* Set in worker threads, to run nested parallel loops serially. */
+static __thread int in_parallel_worker;
+
+unsigned int bt_parallel_nr_threads(void)
+{
+	const char *env;
+	long nr;
+
+	env = getenv("BABELTRACE_OPEN_THREADS");
+	if (env) {
+		nr = strtol(env, NULL, 10);
+	} else {
+		nr = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (nr < 1)
+		nr = 1;
+	return nr;
+}
+
+static
+void *parallel_worker(void *arg)
+{
+	struct parallel_work *work = arg;
+	unsigned int index;
+
+	in_parallel_worker = 1;
+	for (;;) {
+		pthread_mutex_lock(&work->lock);
+		index = work->next;
+		if (index < work->nr_items)
+			work->next++;
+		pthread_mutex_unlock(&work->lock);
+		if (index >= work->nr_items)
+			break;
+		work->fn(index, work->priv);
+	}
+	return NULL;
+}
+
+void bt_parallel_for(unsigned int nr_items, unsigned int nr_threads,
+		void (*fn)(unsigned int index, void *priv), void *priv)
+{
+	struct parallel_work work = {
+		.fn = fn,
+		.priv = priv,
+		.nr_items = nr_items,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.next = 0,
+	};
+	pthread_t *threads;
+	unsigned int i, nr_started = 0;
+	int ret;
+
+	if (nr_threads > nr_items)
+		nr_threads = nr_items;
+	if (nr_threads <= 1 || in_parallel_worker) {
+		for (i = 0; i < nr_items; i++)
+			fn(i, priv);
+		return;
+	}
+
+	/* The calling thread is the last worker. */
+	threads = g_new0(pthread_t, nr_threads - 1);
+	for (i = 0; i < nr_threads - 1; i++) {
+		ret = pthread_create(&threads[i], NULL, parallel_worker, &work);
+		if (ret) {
+			fprintf(stderr, "[warning] Unable to create worker thread: %s\n",
+				strerror(ret));
+			break;
+		}
+		nr_started++;
+	}
+	parallel_worker(&work);
+	in_parallel_worker = 0;
+	for (i = 0; i < nr_started; i++) {
+		ret = pthread_join(threads[i], NULL);
+		if (ret) {
+			fprintf(stderr, "[error] Unable to join worker thread: %s\n",
+				strerror(ret));
+		}
+	}
+	g_free(threads);
+}
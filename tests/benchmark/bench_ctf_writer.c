@@ -0,0 +1,804 @@
+/*
+ * bench_ctf_writer.c
+ *
+ * CTF Writer throughput benchmark
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Writes synthetic workloads using the CTF writer and prints one JSON
+ * object per workload on the standard output:
+ *
+ *   {"workload": "integers", "events": 1000000, "streams": 1,
+ *    "flush_every": 1024, "seconds": 1.2, "events_per_sec": ...,
+ *    "bytes": ..., "bytes_per_sec": ..., "allocs_per_event": ...,
+ *    "peak_rss_kb": ...}
+ *
+ * "allocs_per_event" is -1 when allocations can't be counted on this
+ * platform. "peak_rss_kb" is the peak resident set size of the whole
+ * process: run a single workload per invocation to compare it across
+ * workloads.
+ */
+
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/ctf-ir/stream-class.h>
+#include <babeltrace/ref.h>
+#include <babeltrace/compat/stdlib.h>
+#include <babeltrace/compat/limits.h>
+#include <babeltrace/compat/dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define DEFAULT_EVENT_COUNT	1000000
+#define DEFAULT_FLUSH_EVERY	1024
+#define DEFAULT_STREAM_COUNT	1
+#define SEQUENCE_LENGTH		16
+#define STRING_PAYLOAD		"benchmark string payload of moderate length"
+
+struct bench_config {
+	uint64_t event_count;
+	uint64_t flush_every;
+	unsigned int stream_count;
+	const char *output_dir;
+	int keep;
+};
+
+struct bench_context {
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_stream **streams;
+	unsigned int stream_count;
+	uint64_t time;
+};
+
+struct bench_workload {
+	const char *name;
+	/* Override of the configured stream count, 0 to use the default */
+	unsigned int stream_count;
+	/* Override of the configured flush period, 0 to use the default */
+	uint64_t flush_every;
+	int (*create_event_class)(struct bench_context *);
+	int (*append_event)(struct bench_context *, struct bt_ctf_stream *,
+		uint64_t);
+};
+
+#ifdef __GLIBC__
+/*
+ * Count the allocations performed by the library (and GLib) by
+ * interposing the allocator's entry points.
+ */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static uint64_t alloc_count;
+
+void *malloc(size_t size)
+{
+	alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	alloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+static
+int64_t get_alloc_count(void)
+{
+	return (int64_t) alloc_count;
+}
+#else
+static
+int64_t get_alloc_count(void)
+{
+	return -1;
+}
+#endif
+
+static
+double get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static
+long get_peak_rss_kb(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return -1;
+	}
+
+	/* ru_maxrss is expressed in kilobytes on Linux */
+	return usage.ru_maxrss;
+}
+
+static
+struct bt_ctf_field_type *create_aligned_integer(unsigned int size,
+		int is_signed)
+{
+	struct bt_ctf_field_type *type = bt_ctf_field_type_integer_create(size);
+
+	if (!type) {
+		goto end;
+	}
+
+	if (bt_ctf_field_type_integer_set_signed(type, is_signed) ||
+		bt_ctf_field_type_set_alignment(type, 8)) {
+		BT_PUT(type);
+	}
+end:
+	return type;
+}
+
+static
+int add_integer_field(struct bt_ctf_event_class *event_class,
+		unsigned int size, int is_signed, const char *name)
+{
+	int ret;
+	struct bt_ctf_field_type *type = create_aligned_integer(size,
+		is_signed);
+
+	if (!type) {
+		return -1;
+	}
+
+	ret = bt_ctf_event_class_add_field(event_class, type, name);
+	bt_put(type);
+	return ret;
+}
+
+static
+int set_integer_payload(struct bt_ctf_event *event, const char *name,
+		uint64_t value)
+{
+	int ret;
+	struct bt_ctf_field *field = bt_ctf_event_get_payload(event, name);
+
+	ret = bt_ctf_field_unsigned_integer_set_value(field, value);
+	bt_put(field);
+	return ret;
+}
+
+/* integers: four unsigned integer fields set through the field tree */
+static
+int create_integers_event_class(struct bench_context *ctx)
+{
+	int ret;
+
+	ret = add_integer_field(ctx->event_class, 64, 0, "a");
+	ret |= add_integer_field(ctx->event_class, 64, 0, "b");
+	ret |= add_integer_field(ctx->event_class, 32, 0, "c");
+	ret |= add_integer_field(ctx->event_class, 16, 0, "d");
+	return ret;
+}
+
+static
+int append_integers_event(struct bench_context *ctx,
+		struct bt_ctf_stream *stream, uint64_t i)
+{
+	int ret;
+	struct bt_ctf_event *event = bt_ctf_event_create(ctx->event_class);
+
+	if (!event) {
+		return -1;
+	}
+
+	ret = set_integer_payload(event, "a", i);
+	ret |= set_integer_payload(event, "b", ctx->time);
+	ret |= set_integer_payload(event, "c", i & 0xffffffff);
+	ret |= set_integer_payload(event, "d", i & 0xffff);
+	ret |= bt_ctf_stream_append_event(stream, event);
+	bt_put(event);
+	return ret;
+}
+
+/* integers-indexed: same layout, set with the index-based setters */
+static
+int append_integers_indexed_event(struct bench_context *ctx,
+		struct bt_ctf_stream *stream, uint64_t i)
+{
+	int ret;
+	const uint64_t values[] = {
+		i, ctx->time, i & 0xffffffff, i & 0xffff,
+	};
+	struct bt_ctf_event *event = bt_ctf_event_create(ctx->event_class);
+
+	if (!event) {
+		return -1;
+	}
+
+	ret = bt_ctf_event_set_payload_integers(event, values,
+		sizeof(values) / sizeof(*values));
+	ret |= bt_ctf_stream_append_event(stream, event);
+	bt_put(event);
+	return ret;
+}
+
+/* raw: same layout, appended as a pre-serialized payload */
+static
+int append_raw_event(struct bench_context *ctx,
+		struct bt_ctf_stream *stream, uint64_t i)
+{
+	uint8_t payload[22];
+	uint64_t a = i, b = ctx->time;
+	uint32_t c = i & 0xffffffff;
+	uint16_t d = i & 0xffff;
+
+	/* Fields use the trace's native byte order, which is the host's */
+	memcpy(&payload[0], &a, sizeof(a));
+	memcpy(&payload[8], &b, sizeof(b));
+	memcpy(&payload[16], &c, sizeof(c));
+	memcpy(&payload[20], &d, sizeof(d));
+	return bt_ctf_stream_append_raw_event(stream, ctx->event_class,
+		ctx->time, payload, sizeof(payload));
+}
+
+/* strings: three string fields */
+static
+int create_strings_event_class(struct bench_context *ctx)
+{
+	int ret;
+	struct bt_ctf_field_type *type = bt_ctf_field_type_string_create();
+
+	if (!type) {
+		return -1;
+	}
+
+	ret = bt_ctf_event_class_add_field(ctx->event_class, type, "s1");
+	ret |= bt_ctf_event_class_add_field(ctx->event_class, type, "s2");
+	ret |= bt_ctf_event_class_add_field(ctx->event_class, type, "s3");
+	bt_put(type);
+	return ret;
+}
+
+static
+int append_strings_event(struct bench_context *ctx,
+		struct bt_ctf_stream *stream, uint64_t i)
+{
+	int ret = 0, j;
+	const char *names[] = { "s1", "s2", "s3" };
+	struct bt_ctf_event *event = bt_ctf_event_create(ctx->event_class);
+
+	if (!event) {
+		return -1;
+	}
+
+	for (j = 0; j < 3; j++) {
+		struct bt_ctf_field *field = bt_ctf_event_get_payload(event,
+			names[j]);
+
+		ret |= bt_ctf_field_string_set_value(field, STRING_PAYLOAD);
+		bt_put(field);
+	}
+
+	ret |= bt_ctf_stream_append_event(stream, event);
+	bt_put(event);
+	return ret;
+}
+
+/* sequences: a sequence of SEQUENCE_LENGTH 32-bit integers */
+static
+int create_sequences_event_class(struct bench_context *ctx)
+{
+	int ret;
+	struct bt_ctf_field_type *element = NULL, *sequence = NULL;
+
+	ret = add_integer_field(ctx->event_class, 32, 0, "len");
+	element = create_aligned_integer(32, 0);
+	if (ret || !element) {
+		ret = -1;
+		goto end;
+	}
+
+	sequence = bt_ctf_field_type_sequence_create(element, "len");
+	if (!sequence) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_event_class_add_field(ctx->event_class, sequence, "seq");
+end:
+	bt_put(element);
+	bt_put(sequence);
+	return ret;
+}
+
+static
+int append_sequences_event(struct bench_context *ctx,
+		struct bt_ctf_stream *stream, uint64_t i)
+{
+	int ret, j;
+	struct bt_ctf_field *length = NULL, *sequence = NULL;
+	struct bt_ctf_event *event = bt_ctf_event_create(ctx->event_class);
+
+	if (!event) {
+		return -1;
+	}
+
+	length = bt_ctf_event_get_payload(event, "len");
+	sequence = bt_ctf_event_get_payload(event, "seq");
+	ret = bt_ctf_field_unsigned_integer_set_value(length,
+		SEQUENCE_LENGTH);
+	ret |= bt_ctf_field_sequence_set_length(sequence, length);
+	for (j = 0; j < SEQUENCE_LENGTH && !ret; j++) {
+		struct bt_ctf_field *element =
+			bt_ctf_field_sequence_get_field(sequence, j);
+
+		ret |= bt_ctf_field_unsigned_integer_set_value(element, i + j);
+		bt_put(element);
+	}
+
+	ret |= bt_ctf_stream_append_event(stream, event);
+	bt_put(length);
+	bt_put(sequence);
+	bt_put(event);
+	return ret;
+}
+
+/* variants: an enumeration tag selecting an integer or a string */
+static
+int create_variants_event_class(struct bench_context *ctx)
+{
+	int ret;
+	struct bt_ctf_field_type *container = NULL, *tag = NULL,
+		*variant = NULL, *integer = NULL, *string = NULL;
+
+	container = create_aligned_integer(8, 0);
+	integer = create_aligned_integer(64, 0);
+	string = bt_ctf_field_type_string_create();
+	if (!container || !integer || !string) {
+		ret = -1;
+		goto end;
+	}
+
+	tag = bt_ctf_field_type_enumeration_create(container);
+	if (!tag) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_enumeration_add_mapping_unsigned(tag,
+		"integer", 0, 0);
+	ret |= bt_ctf_field_type_enumeration_add_mapping_unsigned(tag,
+		"string", 1, 1);
+	if (ret) {
+		goto end;
+	}
+
+	variant = bt_ctf_field_type_variant_create(tag, "tag");
+	if (!variant) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_variant_add_field(variant, integer,
+		"integer");
+	ret |= bt_ctf_field_type_variant_add_field(variant, string, "string");
+	ret |= bt_ctf_event_class_add_field(ctx->event_class, tag, "tag");
+	ret |= bt_ctf_event_class_add_field(ctx->event_class, variant,
+		"variant");
+end:
+	bt_put(container);
+	bt_put(tag);
+	bt_put(variant);
+	bt_put(integer);
+	bt_put(string);
+	return ret;
+}
+
+static
+int append_variants_event(struct bench_context *ctx,
+		struct bt_ctf_stream *stream, uint64_t i)
+{
+	int ret;
+	struct bt_ctf_field *tag = NULL, *container = NULL, *variant = NULL,
+		*selected = NULL;
+	struct bt_ctf_event *event = bt_ctf_event_create(ctx->event_class);
+
+	if (!event) {
+		return -1;
+	}
+
+	tag = bt_ctf_event_get_payload(event, "tag");
+	container = bt_ctf_field_enumeration_get_container(tag);
+	variant = bt_ctf_event_get_payload(event, "variant");
+	ret = bt_ctf_field_unsigned_integer_set_value(container, i & 1);
+	selected = bt_ctf_field_variant_get_field(variant, tag);
+	if (!selected) {
+		ret = -1;
+		goto end;
+	}
+
+	if (i & 1) {
+		ret |= bt_ctf_field_string_set_value(selected, STRING_PAYLOAD);
+	} else {
+		ret |= bt_ctf_field_unsigned_integer_set_value(selected, i);
+	}
+
+	ret |= bt_ctf_stream_append_event(stream, event);
+end:
+	bt_put(tag);
+	bt_put(container);
+	bt_put(variant);
+	bt_put(selected);
+	bt_put(event);
+	return ret;
+}
+
+static
+const struct bench_workload workloads[] = {
+	{ "integers", 0, 0, create_integers_event_class,
+		append_integers_event },
+	{ "integers-indexed", 0, 0, create_integers_event_class,
+		append_integers_indexed_event },
+	{ "raw", 0, 0, create_integers_event_class, append_raw_event },
+	{ "strings", 0, 0, create_strings_event_class,
+		append_strings_event },
+	{ "sequences", 0, 0, create_sequences_event_class,
+		append_sequences_event },
+	{ "variants", 0, 0, create_variants_event_class,
+		append_variants_event },
+	{ "many-streams", 64, 0, create_integers_event_class,
+		append_integers_event },
+	{ "small-packets", 0, 16, create_integers_event_class,
+		append_integers_event },
+	{ "large-packets", 0, 262144, create_integers_event_class,
+		append_integers_event },
+};
+
+static
+void remove_trace_dir(const char *path)
+{
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+
+	if (!dir) {
+		return;
+	}
+
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		unlinkat(bt_dirfd(dir), entry->d_name, 0);
+	}
+
+	closedir(dir);
+	rmdir(path);
+}
+
+/* Sum of the sizes of the trace's stream files. */
+static
+uint64_t get_stream_bytes(const char *path)
+{
+	uint64_t bytes = 0;
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+
+	if (!dir) {
+		return 0;
+	}
+
+	while ((entry = readdir(dir))) {
+		struct stat st;
+
+		if (entry->d_name[0] == '.' ||
+			!strcmp(entry->d_name, "metadata")) {
+			continue;
+		}
+
+		if (!fstatat(bt_dirfd(dir), entry->d_name, &st, 0) &&
+			S_ISREG(st.st_mode)) {
+			bytes += st.st_size;
+		}
+	}
+
+	closedir(dir);
+	return bytes;
+}
+
+static
+void bench_context_fini(struct bench_context *ctx)
+{
+	unsigned int i;
+
+	if (ctx->streams) {
+		for (i = 0; i < ctx->stream_count; i++) {
+			bt_put(ctx->streams[i]);
+		}
+		free(ctx->streams);
+	}
+
+	bt_put(ctx->event_class);
+	bt_put(ctx->stream_class);
+	bt_put(ctx->clock);
+	bt_put(ctx->writer);
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+static
+int bench_context_init(struct bench_context *ctx,
+		const struct bench_workload *workload,
+		unsigned int stream_count, const char *trace_path)
+{
+	int ret = 0;
+	unsigned int i;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->writer = bt_ctf_writer_create(trace_path);
+	ctx->clock = bt_ctf_clock_create("bench_clock");
+	ctx->stream_class = bt_ctf_stream_class_create("bench_stream");
+	ctx->event_class = bt_ctf_event_class_create("bench_event");
+	ctx->streams = calloc(stream_count, sizeof(*ctx->streams));
+	ctx->stream_count = stream_count;
+	if (!ctx->writer || !ctx->clock || !ctx->stream_class ||
+		!ctx->event_class || !ctx->streams) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_writer_add_clock(ctx->writer, ctx->clock);
+	ret |= bt_ctf_stream_class_set_clock(ctx->stream_class, ctx->clock);
+	ret |= workload->create_event_class(ctx);
+	ret |= bt_ctf_stream_class_add_event_class(ctx->stream_class,
+		ctx->event_class);
+	if (ret) {
+		goto end;
+	}
+
+	for (i = 0; i < stream_count; i++) {
+		ctx->streams[i] = bt_ctf_writer_create_stream(ctx->writer,
+			ctx->stream_class);
+		if (!ctx->streams[i]) {
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+static
+int run_workload(const struct bench_workload *workload,
+		const struct bench_config *config)
+{
+	int ret;
+	uint64_t i, bytes, flush_every;
+	int64_t allocs_begin, allocs_end;
+	unsigned int stream_count;
+	double begin, seconds;
+	char trace_path[PATH_MAX];
+	struct bench_context ctx;
+
+	stream_count = workload->stream_count ? workload->stream_count :
+		config->stream_count;
+	flush_every = workload->flush_every ? workload->flush_every :
+		config->flush_every;
+	snprintf(trace_path, sizeof(trace_path), "%s/bench-%s-XXXXXX",
+		config->output_dir, workload->name);
+	if (!bt_mkdtemp(trace_path)) {
+		perror("# mkdtemp");
+		return -1;
+	}
+
+	ret = bench_context_init(&ctx, workload, stream_count, trace_path);
+	if (ret) {
+		fprintf(stderr, "# Failed to set up workload \"%s\"\n",
+			workload->name);
+		goto end;
+	}
+
+	allocs_begin = get_alloc_count();
+	begin = get_time();
+	for (i = 0; i < config->event_count; i++) {
+		struct bt_ctf_stream *stream =
+			ctx.streams[i % stream_count];
+
+		ret = bt_ctf_clock_set_time(ctx.clock, ++ctx.time);
+		ret |= workload->append_event(&ctx, stream, i);
+		if (ret) {
+			fprintf(stderr, "# Failed to append event %" PRIu64
+				" of workload \"%s\"\n", i, workload->name);
+			goto end;
+		}
+
+		/* Each stream flushes every "flush_every" of its events */
+		if ((i / stream_count + 1) % flush_every == 0) {
+			ret = bt_ctf_stream_flush(stream);
+			if (ret) {
+				goto end;
+			}
+		}
+	}
+
+	for (i = 0; i < stream_count; i++) {
+		ret = bt_ctf_stream_flush(ctx.streams[i]);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	/* Includes closing the streams and writing the metadata */
+	bench_context_fini(&ctx);
+	seconds = get_time() - begin;
+	allocs_end = get_alloc_count();
+	bytes = get_stream_bytes(trace_path);
+
+	printf("{\"workload\": \"%s\", \"events\": %" PRIu64
+		", \"streams\": %u, \"flush_every\": %" PRIu64
+		", \"seconds\": %.6f, \"events_per_sec\": %.1f"
+		", \"bytes\": %" PRIu64 ", \"bytes_per_sec\": %.1f"
+		", \"allocs_per_event\": %.2f, \"peak_rss_kb\": %ld}\n",
+		workload->name, config->event_count, stream_count, flush_every,
+		seconds, (double) config->event_count / seconds,
+		bytes, (double) bytes / seconds,
+		allocs_begin < 0 ? -1.0 :
+			(double) (allocs_end - allocs_begin) /
+			(double) config->event_count,
+		get_peak_rss_kb());
+	fflush(stdout);
+end:
+	bench_context_fini(&ctx);
+	if (!config->keep) {
+		remove_trace_dir(trace_path);
+	}
+	return ret;
+}
+
+static
+void print_usage(FILE *fp)
+{
+	unsigned int i;
+
+	fprintf(fp, "Usage: bench_ctf_writer [OPTIONS] [WORKLOAD]...\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "Options:\n");
+	fprintf(fp, "  -n, --events N        Number of events per workload (default: %d)\n",
+		DEFAULT_EVENT_COUNT);
+	fprintf(fp, "  -f, --flush-every N   Flush each stream every N events (default: %d)\n",
+		DEFAULT_FLUSH_EVERY);
+	fprintf(fp, "  -s, --streams N       Number of streams (default: %d)\n",
+		DEFAULT_STREAM_COUNT);
+	fprintf(fp, "  -o, --output DIR      Directory in which traces are written (default: /tmp)\n");
+	fprintf(fp, "  -k, --keep            Keep the written traces\n");
+	fprintf(fp, "  -h, --help            Show this help\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "Workloads (default: all):\n");
+	for (i = 0; i < sizeof(workloads) / sizeof(*workloads); i++) {
+		fprintf(fp, "  %s\n", workloads[i].name);
+	}
+}
+
+static
+const struct bench_workload *find_workload(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(workloads) / sizeof(*workloads); i++) {
+		if (!strcmp(workloads[i].name, name)) {
+			return &workloads[i];
+		}
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = 0;
+	unsigned int i;
+	struct bench_config config = {
+		.event_count = DEFAULT_EVENT_COUNT,
+		.flush_every = DEFAULT_FLUSH_EVERY,
+		.stream_count = DEFAULT_STREAM_COUNT,
+		.output_dir = "/tmp",
+		.keep = 0,
+	};
+	const struct option long_options[] = {
+		{ "events", required_argument, NULL, 'n' },
+		{ "flush-every", required_argument, NULL, 'f' },
+		{ "streams", required_argument, NULL, 's' },
+		{ "output", required_argument, NULL, 'o' },
+		{ "keep", no_argument, NULL, 'k' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "n:f:s:o:kh", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			config.event_count = strtoull(optarg, NULL, 0);
+			break;
+		case 'f':
+			config.flush_every = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			config.stream_count = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			config.output_dir = optarg;
+			break;
+		case 'k':
+			config.keep = 1;
+			break;
+		case 'h':
+			print_usage(stdout);
+			return 0;
+		default:
+			print_usage(stderr);
+			return 1;
+		}
+	}
+
+	if (!config.event_count || !config.flush_every ||
+		!config.stream_count) {
+		print_usage(stderr);
+		return 1;
+	}
+
+	if (optind == argc) {
+		for (i = 0; i < sizeof(workloads) / sizeof(*workloads); i++) {
+			ret |= run_workload(&workloads[i], &config);
+		}
+	} else {
+		for (; optind < argc; optind++) {
+			const struct bench_workload *workload =
+				find_workload(argv[optind]);
+
+			if (!workload) {
+				fprintf(stderr, "# Unknown workload \"%s\"\n",
+					argv[optind]);
+				ret = -1;
+				continue;
+			}
+
+			ret |= run_workload(workload, &config);
+		}
+	}
+
+	return ret ? 1 : 0;
+}
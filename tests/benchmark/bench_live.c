@@ -0,0 +1,249 @@
+/*
+ * bench_live.c
+ *
+ * lttng-live viewer benchmark
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Serves a trace through the mock relay daemon of the test utilities,
+ * with a simulated round trip latency, and reads it with the babeltrace
+ * lttng-live input, once per pipeline depth. Prints one JSON object per
+ * run on the standard output:
+ *
+ *   {"depth": 64, "latency_ms": 5, "seconds": 0.2, "requests": 310,
+ *    "packets": 150, "bytes": 614400, "packets_per_sec": ...,
+ *    "bytes_per_sec": ...}
+ *
+ * With a depth of 1, every index and packet request waits for the
+ * previous response, so the run time is dominated by the number of
+ * round trips.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define DEFAULT_LATENCY_MS	5
+#define DEFAULT_TRACE		CTF_TRACES_DIR "/lttng-modules-2.0-pre5"
+#define MAX_DEPTHS		16
+
+static
+double get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/*
+ * Start the mock relay daemon, with its standard output connected to
+ * "out".
+ */
+static
+pid_t start_relayd(const char *trace, long latency_ms, FILE **out)
+{
+	char latency[32];
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds)) {
+		perror("# pipe");
+		return -1;
+	}
+	snprintf(latency, sizeof(latency), "%ld", latency_ms);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("# fork");
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	if (!pid) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execl(MOCK_RELAYD_BIN, MOCK_RELAYD_BIN, "-l", latency, trace,
+			(char *) NULL);
+		perror("# exec " MOCK_RELAYD_BIN);
+		_exit(127);
+	}
+	close(fds[1]);
+	*out = fdopen(fds[0], "r");
+	return pid;
+}
+
+/* Read the live session with babeltrace, discarding the text output. */
+static
+int run_viewer(const char *url, int depth)
+{
+	char depth_str[32];
+	pid_t pid;
+	int status, fd;
+
+	snprintf(depth_str, sizeof(depth_str), "%d", depth);
+	pid = fork();
+	if (pid < 0) {
+		perror("# fork");
+		return -1;
+	}
+	if (!pid) {
+		fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0)
+			dup2(fd, STDOUT_FILENO);
+		setenv("BABELTRACE_LIVE_PIPELINE_DEPTH", depth_str, 1);
+		execl(BABELTRACE_BIN, BABELTRACE_BIN, "-i", "lttng-live",
+			url, (char *) NULL);
+		perror("# exec " BABELTRACE_BIN);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "# babeltrace failed (depth %d)\n", depth);
+		return -1;
+	}
+	return 0;
+}
+
+static
+int run_depth(const char *trace, long latency_ms, int depth)
+{
+	uint64_t requests = 0, packets = 0, bytes = 0;
+	char line[256], url[128];
+	double begin, seconds;
+	FILE *out = NULL;
+	pid_t pid;
+	int port, ret = 0;
+
+	pid = start_relayd(trace, latency_ms, &out);
+	if (pid < 0)
+		return -1;
+	if (!out || !fgets(line, sizeof(line), out)
+			|| sscanf(line, "%d", &port) != 1) {
+		fprintf(stderr, "# mock relayd did not start\n");
+		kill(pid, SIGTERM);
+		ret = -1;
+		goto end;
+	}
+	snprintf(url, sizeof(url), "net://127.0.0.1:%d/host/mock/mock", port);
+
+	begin = get_time();
+	ret = run_viewer(url, depth);
+	seconds = get_time() - begin;
+	if (ret) {
+		kill(pid, SIGTERM);
+		goto end;
+	}
+
+	if (!fgets(line, sizeof(line), out)
+			|| sscanf(line, "requests %" SCNu64 " packets %" SCNu64
+				" bytes %" SCNu64, &requests, &packets,
+				&bytes) != 3) {
+		fprintf(stderr, "# no statistics from mock relayd\n");
+		ret = -1;
+		goto end;
+	}
+
+	printf("{\"depth\": %d, \"latency_ms\": %ld, \"seconds\": %.6f"
+		", \"requests\": %" PRIu64 ", \"packets\": %" PRIu64
+		", \"bytes\": %" PRIu64 ", \"packets_per_sec\": %.1f"
+		", \"bytes_per_sec\": %.1f}\n",
+		depth, latency_ms, seconds, requests, packets, bytes,
+		(double) packets / seconds, (double) bytes / seconds);
+	fflush(stdout);
+end:
+	if (out)
+		fclose(out);
+	waitpid(pid, NULL, 0);
+	return ret;
+}
+
+static
+void print_usage(FILE *fp)
+{
+	fprintf(fp, "Usage: bench_live [OPTIONS] [TRACE]\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "Options:\n");
+	fprintf(fp, "  -l, --latency MS      Simulated round trip latency (default: %d)\n",
+		DEFAULT_LATENCY_MS);
+	fprintf(fp, "  -d, --depth N         Pipeline depth to run, may be repeated\n");
+	fprintf(fp, "                        (default: 1 and 64)\n");
+	fprintf(fp, "  -h, --help            Show this help\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "Without TRACE argument, %s is used.\n", DEFAULT_TRACE);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, i, ret = 0;
+	long latency_ms = DEFAULT_LATENCY_MS;
+	int depths[MAX_DEPTHS] = { 1, 64 };
+	int nr_depths = 0;
+	const char *trace = DEFAULT_TRACE;
+	const struct option long_options[] = {
+		{ "latency", required_argument, NULL, 'l' },
+		{ "depth", required_argument, NULL, 'd' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "l:d:h", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'l':
+			latency_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'd':
+			if (nr_depths == MAX_DEPTHS) {
+				print_usage(stderr);
+				return 1;
+			}
+			depths[nr_depths++] = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(stdout);
+			return 0;
+		default:
+			print_usage(stderr);
+			return 1;
+		}
+	}
+
+	if (latency_ms < 0 || optind < argc - 1) {
+		print_usage(stderr);
+		return 1;
+	}
+	if (optind < argc)
+		trace = argv[optind];
+	if (!nr_depths)
+		nr_depths = 2;
+
+	for (i = 0; i < nr_depths; i++)
+		ret |= run_depth(trace, latency_ms, depths[i]);
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * bench_metadata_parse.c
+ *
+ * CTF metadata parsing benchmark
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Repeatedly opens and closes CTF traces and prints one JSON object
+ * per trace on the standard output:
+ *
+ *   {"trace": "sequence", "metadata_bytes": 2840, "iterations": 1000,
+ *    "seconds": 0.4, "opens_per_sec": ..., "metadata_bytes_per_sec": ...,
+ *    "allocs_per_open": ..., "peak_rss_kb": ...}
+ *
+ * Each trace is closed before being opened again, so the metadata is
+ * parsed on every iteration: the in-memory metadata sharing between
+ * open traces never kicks in, and the on-disk metadata cache is
+ * disabled. Opening a trace also indexes its stream files, which is
+ * negligible next to the metadata for the traces of the test corpus.
+ * Traces from the corpus which warn when opened do so once per
+ * iteration: redirect the standard error to keep the output readable.
+ */
+
+#include <babeltrace/babeltrace.h>
+#include <babeltrace/context.h>
+#include <babeltrace/compat/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define DEFAULT_ITERATIONS	1000
+
+#ifdef __GLIBC__
+/*
+ * Count the allocations performed by the library (and GLib) by
+ * interposing the allocator's entry points.
+ */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static uint64_t alloc_count;
+
+void *malloc(size_t size)
+{
+	alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	alloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+static
+int64_t get_alloc_count(void)
+{
+	return (int64_t) alloc_count;
+}
+#else
+static
+int64_t get_alloc_count(void)
+{
+	return -1;
+}
+#endif
+
+static
+double get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static
+long get_peak_rss_kb(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return -1;
+	}
+
+	/* ru_maxrss is expressed in kilobytes on Linux */
+	return usage.ru_maxrss;
+}
+
+static
+const char *get_trace_name(const char *path)
+{
+	const char *name = strrchr(path, '/');
+
+	return name ? name + 1 : path;
+}
+
+static
+int run_trace(const char *path, unsigned int iterations)
+{
+	int ret = 0;
+	unsigned int i;
+	int64_t allocs_begin, allocs_end;
+	double begin, seconds;
+	char metadata_path[PATH_MAX];
+	struct stat st;
+	struct bt_context *ctx;
+
+	snprintf(metadata_path, sizeof(metadata_path), "%s/metadata", path);
+	if (stat(metadata_path, &st)) {
+		fprintf(stderr, "# No metadata in \"%s\"\n", path);
+		return -1;
+	}
+
+	ctx = bt_context_create();
+	if (!ctx) {
+		return -1;
+	}
+
+	allocs_begin = get_alloc_count();
+	begin = get_time();
+	for (i = 0; i < iterations; i++) {
+		int handle_id;
+
+		handle_id = bt_context_add_trace(ctx, path, "ctf", NULL,
+			NULL, NULL);
+		if (handle_id < 0) {
+			fprintf(stderr, "# Failed to open trace \"%s\"\n",
+				path);
+			ret = -1;
+			goto end;
+		}
+
+		ret = bt_context_remove_trace(ctx, handle_id);
+		if (ret) {
+			goto end;
+		}
+	}
+	seconds = get_time() - begin;
+	allocs_end = get_alloc_count();
+
+	printf("{\"trace\": \"%s\", \"metadata_bytes\": %" PRIu64
+		", \"iterations\": %u, \"seconds\": %.6f"
+		", \"opens_per_sec\": %.1f, \"metadata_bytes_per_sec\": %.1f"
+		", \"allocs_per_open\": %.2f, \"peak_rss_kb\": %ld}\n",
+		get_trace_name(path), (uint64_t) st.st_size, iterations,
+		seconds, (double) iterations / seconds,
+		(double) st.st_size * iterations / seconds,
+		allocs_begin < 0 ? -1.0 :
+			(double) (allocs_end - allocs_begin) /
+			(double) iterations,
+		get_peak_rss_kb());
+	fflush(stdout);
+end:
+	bt_context_put(ctx);
+	return ret;
+}
+
+/* Benchmark every trace directory found in "dir_path". */
+static
+int run_corpus(const char *dir_path, unsigned int iterations)
+{
+	int ret = 0;
+	DIR *dir = opendir(dir_path);
+	struct dirent *entry;
+
+	if (!dir) {
+		perror("# opendir");
+		return -1;
+	}
+
+	while ((entry = readdir(dir))) {
+		char path[PATH_MAX];
+		struct stat st;
+
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s/metadata", dir_path,
+			entry->d_name);
+		if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s", dir_path,
+			entry->d_name);
+		ret |= run_trace(path, iterations);
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+static
+void print_usage(FILE *fp)
+{
+	fprintf(fp, "Usage: bench_metadata_parse [OPTIONS] [TRACE]...\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "Options:\n");
+	fprintf(fp, "  -n, --iterations N    Number of opens per trace (default: %d)\n",
+		DEFAULT_ITERATIONS);
+	fprintf(fp, "  -c, --corpus DIR      Benchmark every trace in DIR (default: %s)\n",
+		CTF_TRACES_DIR);
+	fprintf(fp, "  -h, --help            Show this help\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "Without TRACE arguments, the traces of the corpus are used.\n");
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = 0;
+	unsigned int iterations = DEFAULT_ITERATIONS;
+	const char *corpus = CTF_TRACES_DIR;
+	const struct option long_options[] = {
+		{ "iterations", required_argument, NULL, 'n' },
+		{ "corpus", required_argument, NULL, 'c' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "n:c:h", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			corpus = optarg;
+			break;
+		case 'h':
+			print_usage(stdout);
+			return 0;
+		default:
+			print_usage(stderr);
+			return 1;
+		}
+	}
+
+	if (!iterations) {
+		print_usage(stderr);
+		return 1;
+	}
+
+	/* Measure parsing, not loading the compiled metadata cache */
+	unsetenv("BABELTRACE_METADATA_CACHE");
+
+	if (optind == argc) {
+		ret = run_corpus(corpus, iterations);
+	} else {
+		for (; optind < argc; optind++) {
+			ret |= run_trace(argv[optind], iterations);
+		}
+	}
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,452 @@
+#
+# Copyright (C) - 2016 EfficiOS Inc.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License, version 2 only, as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program; if not, write to the Free Software Foundation, Inc., 51
+# Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Compare the native readers of the Python bindings against the per-field
+# Event accessors, on every trace of the directory given as argument.
+# Output is TAP.
+
+import gc
+import math
+import os
+import struct
+import sys
+
+import babeltrace.common as common
+import babeltrace.nativebt as nbt
+import babeltrace.reader as reader
+
+_test_nr = 0
+
+
+def ok(cond, description):
+    global _test_nr
+
+    _test_nr += 1
+    print('{}ok {} - {}'.format('' if cond else 'not ', _test_nr,
+                                description))
+    sys.stdout.flush()
+
+    return cond
+
+
+def diag(message):
+    for line in str(message).splitlines():
+        print('# {}'.format(line))
+
+
+def open_trace(path):
+    tc = reader.TraceCollection()
+
+    if tc.add_trace(path, 'ctf') is None:
+        return None
+
+    return tc
+
+
+def numeric_value(event, name):
+    # (valid, value) of a field as read by event_batches(), through the
+    # per-field accessors.
+    field = event._field(name)
+
+    if field is None:
+        return False, None
+
+    # bt_ctf_get_field() already resolved variants.
+    if field.type == common.CTFTypeId.ENUM:
+        field = reader._Definition(nbt._bt_ctf_get_enum_int(field._d),
+                                   field.scope)
+
+    if field.type in (common.CTFTypeId.INTEGER, common.CTFTypeId.FLOAT):
+        return True, field.value
+
+    return False, None
+
+
+def reference_fields(event):
+    # (name, value) of the fields of an event, in the first scope having
+    # each name, and the number of fields of all scopes.
+    fields = []
+    count = 0
+
+    for scope in reader._scopes:
+        scope_names = event.field_list_with_scope(scope)
+        count += len(scope_names)
+
+        for name in scope_names:
+            if name not in [field[0] for field in fields]:
+                fields.append((name, event.field_with_scope(name, scope)))
+
+    return fields, count
+
+
+def mapping_matches(event):
+    # Whether the mapping methods of an event match its per-field
+    # accessors.
+    fields, count = reference_fields(event)
+
+    return (event.keys() == [field[0] for field in fields] and
+            event.values() == [field[1] for field in fields] and
+            event.as_dict() == dict(fields) and len(event) == count)
+
+
+def event_reference(event):
+    # Everything a snapshot of an event must give back.
+    fields, count = reference_fields(event)
+    scopes = [[(name, event.field_with_scope(name, scope))
+               for name in event.field_list_with_scope(scope)]
+              for scope in reader._scopes]
+
+    return event.name, event.timestamp, event.cycles, fields, count, scopes
+
+
+def snapshot_reference(snapshot):
+    # Same as event_reference(), from a snapshot, or None if its mapping
+    # methods disagree.
+    fields = list(zip(snapshot.keys(), snapshot.values()))
+    scopes = [[(name, snapshot.field_with_scope(name, scope))
+               for name in snapshot.field_list_with_scope(scope)]
+              for scope in reader._scopes]
+
+    if snapshot.as_dict() != dict(fields) or \
+            any(snapshot[name] != value for name, value in fields):
+        return None
+
+    return (snapshot.name, snapshot.timestamp, snapshot.cycles, fields,
+            len(snapshot), scopes)
+
+
+class EventRecord:
+    # What the per-field accessors give for one event.
+    def __init__(self, event, names):
+        self.name = event.name
+        self.timestamp = event.timestamp
+        self.numeric = dict((name, numeric_value(event, name))
+                            for name in names)
+        self.mapping_matches = mapping_matches(event)
+        self.reference = event_reference(event)
+
+
+def field_names(path):
+    tc = open_trace(path)
+    names = []
+
+    for event in tc.events:
+        for scope in reader._scopes:
+            for name in event.field_list_with_scope(scope):
+                if name not in names:
+                    names.append(name)
+
+    return names
+
+
+def read_records(path, names):
+    tc = open_trace(path)
+
+    return [EventRecord(event, names) for event in tc.events]
+
+
+def to_column(value, typecode):
+    # Conversion made by the native reader to the column type.
+    if typecode == 'd':
+        return float(value)
+
+    value = int(value)
+
+    if typecode == 'Q':
+        return value & 0xffffffffffffffff
+
+    return struct.unpack('q', struct.pack('Q',
+                                          value & 0xffffffffffffffff))[0]
+
+
+def check_batches(trace, path, names, records):
+    tc = open_trace(path)
+    batches = list(tc.event_batches(fields=names, batch_size=7,
+                                    use_numpy=False))
+    count = sum(len(batch) for batch in batches)
+    typecodes = dict((name, set(batch.fields[name].typecode
+                                for batch in batches))
+                     for name in names)
+    timestamps = []
+    event_names = []
+    mismatches = []
+    i = 0
+
+    for batch in batches:
+        for j in range(len(batch)):
+            timestamps.append(batch.timestamps[j])
+            event_names.append(batch.names[batch.name_ids[j]])
+
+            for name in names:
+                valid, value = records[i].numeric[name]
+                got_valid = batch.valid[name][j] == 1
+                got = batch.fields[name][j]
+                typecode = batch.fields[name].typecode
+
+                if got_valid != valid or (valid and
+                                          got != to_column(value, typecode)):
+                    mismatches.append((i, name, valid, value, got_valid,
+                                       got))
+
+            i += 1
+
+    ok(count == len(records) and
+       timestamps == [record.timestamp for record in records] and
+       event_names == [record.name for record in records],
+       'event_batches() timestamps and names match for {}'.format(trace))
+
+    if not ok(not mismatches,
+              'event_batches() fields match for {}'.format(trace)):
+        diag(mismatches[:10])
+
+    ok(all(len(codes) <= 1 for codes in typecodes.values()),
+       'event_batches() column types are stable for {}'.format(trace))
+
+    return batches
+
+
+def same_number(got, expected):
+    if got is None or expected is None:
+        return got is expected
+
+    if isinstance(got, float) or isinstance(expected, float):
+        return math.isclose(got, expected, rel_tol=1e-9, abs_tol=1e-9)
+
+    # Integer sums wrap around as 64-bit integers.
+    return (got - expected) % (1 << 64) == 0
+
+
+def check_aggregate(trace, path, names, records):
+    # Group by event name and aggregate every field, against the same
+    # computation on the values read by the per-field accessors.
+    numeric = [name for name in names
+               if any(record.numeric[name][0] for record in records)]
+    aggregates = [(op, name) for name in numeric
+                  for op in ('sum', 'min', 'max')]
+    expected = {}
+
+    for record in records:
+        row = expected.setdefault(record.name,
+                                  [0] + [None] * len(aggregates))
+        row[0] += 1
+
+        for i, (op, name) in enumerate(aggregates):
+            valid, value = record.numeric[name]
+
+            if not valid:
+                continue
+
+            if row[i + 1] is None:
+                row[i + 1] = value
+            elif op == 'sum':
+                row[i + 1] += value
+            elif op == 'min':
+                row[i + 1] = min(row[i + 1], value)
+            else:
+                row[i + 1] = max(row[i + 1], value)
+
+    rows = open_trace(path).aggregate(group_by=(None,),
+                                      aggregates=aggregates)
+    mismatches = []
+
+    for row in rows:
+        values = expected.pop(row[0], None)
+
+        if values is None or len(row) != len(values) + 1 or \
+                not all(same_number(got, value)
+                        for got, value in zip(row[1:], values)):
+            mismatches.append((row, values))
+
+    if not ok(not mismatches and not expected,
+              'aggregate() matches the events of {}'.format(trace)):
+        diag(mismatches[:10])
+
+
+def check_variant_aggregate(trace_dir):
+    tc = open_trace(os.path.join(trace_dir, 'variant-payload'))
+    rows = tc.aggregate(group_by=('tag',), aggregates=[('sum', 'value'),
+                                                       ('min', 'value'),
+                                                       ('max', 'value')])
+    expected = {
+        'u32': (6, 24000000060, 4000000000, 4000000020),
+        's16': (6, -66000, -21000, -1000),
+        'f64': (6, 75.0, 2.5, 22.5),
+        'str': (6, None, None, None),
+    }
+
+    ok(sorted(rows) == sorted((tag,) + values
+                              for tag, values in expected.items()),
+       'aggregate() reads the current option of a variant')
+
+
+def check_mapping(trace, records):
+    ok(all(record.mapping_matches for record in records),
+       'keys(), values() and as_dict() match for {}'.format(trace))
+
+
+def snapshots_match(snapshots, records):
+    return len(snapshots) == len(records) and \
+        all(snapshot is not None and
+            snapshot_reference(snapshot) == record.reference
+            for snapshot, record in zip(snapshots, records))
+
+
+def check_snapshots(trace, path, records):
+    tc = open_trace(path)
+    snapshots = []
+    matches = True
+
+    for event, record in zip(tc.events, records):
+        snapshot = event.snapshot()
+        matches = snapshot_reference(snapshot) == record.reference and \
+            matches
+        snapshots.append(snapshot)
+
+    ok(matches and len(snapshots) == len(records),
+       'Snapshots match the events of {}'.format(trace))
+
+    del tc
+    gc.collect()
+    ok(snapshots_match(snapshots, records),
+       'Snapshots of {} outlive their iterator and trace collection'.format(
+           trace))
+
+
+# Smaller than the records of every trace, and than some of them.
+SMALL_CHUNK_SIZES = (64, 512)
+
+
+def check_small_chunks(trace, path, records):
+    matches = True
+
+    for chunk_size in SMALL_CHUNK_SIZES:
+        arena = nbt._bt_python_snapshot_arena_create(chunk_size)
+        tc = open_trace(path)
+        snapshots = []
+
+        for event in tc.events:
+            snapshot_ptr = nbt._bt_python_snapshot_create(arena, event._e)
+
+            if snapshot_ptr is None:
+                snapshots.append(None)
+                continue
+
+            snapshots.append(reader.EventSnapshot._create(snapshot_ptr))
+
+            # Released at once: its chunk may be recycled.
+            snapshot_ptr = nbt._bt_python_snapshot_create(arena, event._e)
+
+            if snapshot_ptr is not None:
+                nbt._bt_python_snapshot_put(snapshot_ptr)
+
+        del tc
+        nbt._bt_python_snapshot_arena_destroy(arena)
+        matches = snapshots_match(snapshots, records) and matches
+
+    ok(matches, 'Snapshots of {} in small chunks outlive their arena'.format(
+        trace))
+
+
+def check_mapping_after_removal(trace_dir, traces):
+    # The event types of removed traces must not be used by the next
+    # ones, which may reuse their addresses.
+    tc = reader.TraceCollection()
+    matches = True
+
+    for trace in traces:
+        handle = tc.add_trace(os.path.join(trace_dir, trace), 'ctf')
+
+        if handle is None:
+            continue
+
+        for event in tc.events:
+            matches = mapping_matches(event) and matches
+
+        tc.remove_trace(handle)
+
+    ok(matches, 'Mapping methods match once the previous traces are removed')
+
+
+def check_variant_batches(batches):
+    # Options: u32, s16, f64 and str, in turn.
+    values = []
+    valid = []
+
+    for batch in batches:
+        values.extend(batch.fields['value'])
+        valid.extend(batch.valid['value'])
+
+    expected_values = []
+    expected_valid = []
+
+    for i in range(len(values)):
+        option = i % 4
+        expected_valid.append(0 if option == 3 else 1)
+
+        if option == 0:
+            expected_values.append(4000000000.0 + i)
+        elif option == 1:
+            expected_values.append(-1000.0 * i)
+        elif option == 2:
+            expected_values.append(i + 0.5)
+        else:
+            expected_values.append(0.0)
+
+    ok(len(values) == 24 and
+       all(batch.fields['value'].typecode == 'd' for batch in batches) and
+       values == expected_values and valid == expected_valid,
+       'event_batches() reads the current option of a variant')
+
+
+TESTS_PER_TRACE = 9
+
+
+def main():
+    trace_dir = sys.argv[1]
+    traces = sorted(os.listdir(trace_dir))
+
+    print('1..{}'.format(len(traces) * TESTS_PER_TRACE + 3))
+
+    variant_batches = []
+
+    for trace in traces:
+        path = os.path.join(trace_dir, trace)
+
+        if not ok(open_trace(path) is not None,
+                  'Open trace {}'.format(trace)):
+            for i in range(TESTS_PER_TRACE - 1):
+                ok(False, 'Cannot open trace {}'.format(trace))
+
+            continue
+
+        names = field_names(path)
+        records = read_records(path, names)
+        batches = check_batches(trace, path, names, records)
+        check_mapping(trace, records)
+        check_aggregate(trace, path, names, records)
+        check_snapshots(trace, path, records)
+        check_small_chunks(trace, path, records)
+
+        if trace == 'variant-payload':
+            variant_batches = batches
+
+    check_variant_batches(variant_batches)
+    check_variant_aggregate(trace_dir)
+    check_mapping_after_removal(trace_dir, traces)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,142 @@
+/*
+ * test_arena.c
+ *
+ * Babeltrace arena allocator tests
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/arena-internal.h>
+#include <babeltrace/types.h>
+#include <babeltrace/endian.h>
+#include <stdint.h>
+#include <string.h>
+#include "tap/tap.h"
+
+#define NR_OBJECTS	1000
+#define NR_TESTS	11
+
+static int nr_released;
+static int release_order_ok = 1;
+
+static
+void release_object(void *object)
+{
+	int *index = object;
+
+	/* Most recent first */
+	if (*index != NR_OBJECTS - 1 - nr_released)
+		release_order_ok = 0;
+	nr_released++;
+}
+
+static
+void test_alloc(void)
+{
+	struct bt_arena *arena;
+	char *small, *big;
+	int i, zeroed = 1, aligned = 1;
+
+	arena = bt_arena_create();
+	ok(arena, "Create an arena");
+	for (i = 0; i < NR_OBJECTS; i++) {
+		int *index;
+
+		index = bt_arena_alloc_object(arena, sizeof(*index) + i % 13,
+				release_object);
+		if (*index)
+			zeroed = 0;
+		if ((uintptr_t) index % 8)
+			aligned = 0;
+		*index = i;
+	}
+	small = bt_arena_alloc(arena, 3);
+	big = bt_arena_alloc(arena, 1 << 22);
+	if (small[0] || small[2] || big[0] || big[(1 << 22) - 1])
+		zeroed = 0;
+	memset(big, 0xff, 1 << 22);
+	ok(zeroed, "Arena memory is zeroed");
+	ok(aligned, "Arena objects are aligned");
+
+	bt_arena_get(arena);
+	bt_arena_put(arena);
+	ok(nr_released == 0, "Objects outlive a reference which is not the last");
+	bt_arena_put(arena);
+	ok(nr_released == NR_OBJECTS, "Objects are released with the arena");
+	ok(release_order_ok, "Objects are released most recent first");
+}
+
+static
+void count_release(void *object)
+{
+	nr_released++;
+}
+
+static
+void test_cancel_release(void)
+{
+	struct bt_arena *arena;
+	void *a, *b;
+
+	nr_released = 0;
+	arena = bt_arena_create();
+	a = bt_arena_alloc_object(arena, 16, count_release);
+	b = bt_arena_alloc_object(arena, 16, count_release);
+	bt_arena_cancel_release(a);
+	(void) b;
+	bt_arena_put(arena);
+	ok(nr_released == 1, "Cancelled releases are skipped");
+}
+
+static
+void test_declarations(void)
+{
+	struct bt_arena *arena, *prev;
+	struct declaration_integer *heap_decl, *arena_decl;
+
+	heap_decl = bt_integer_declaration_new(32, BYTE_ORDER, 0, 8, 10,
+			CTF_STRING_NONE, NULL);
+	ok(heap_decl && !heap_decl->p.arena,
+		"Declarations are refcounted without an arena");
+
+	arena = bt_arena_create();
+	prev = bt_declaration_set_arena(arena);
+	arena_decl = bt_integer_declaration_new(32, BYTE_ORDER, 0, 8, 10,
+			CTF_STRING_NONE, NULL);
+	ok(bt_declaration_set_arena(prev) == arena,
+		"Setting the declaration arena returns the previous one");
+	ok(arena_decl && arena_decl->p.arena == arena,
+		"Declarations are allocated from the arena of the thread");
+
+	/* Reference counting is a no-op for arena declarations. */
+	bt_declaration_unref(&arena_decl->p);
+	bt_declaration_unref(&arena_decl->p);
+	ok(arena_decl->len == 32 && arena_decl->p.id == CTF_TYPE_INTEGER,
+		"Arena declarations outlive their references");
+	bt_arena_put(arena);
+	bt_declaration_unref(&heap_decl->p);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NR_TESTS);
+
+	test_alloc();
+	test_cancel_release();
+	test_declarations();
+
+	return exit_status();
+}
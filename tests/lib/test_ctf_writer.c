@@ -28,6 +28,11 @@
 #include <babeltrace/ctf-ir/stream-class.h>
 #include <babeltrace/ref.h>
 #include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf-ir/stream-internal.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/context.h>
+#include <babeltrace/types.h>
 #include <babeltrace/values.h>
 #include <unistd.h>
 #include <babeltrace/compat/stdlib.h>
@@ -41,6 +46,7 @@
 #include <fcntl.h>
 #include <babeltrace/compat/dirent.h>
 #include "tap/tap.h"
+#include "common.h"
 #include <math.h>
 #include <float.h>
 #include <sys/stat.h>
@@ -278,6 +284,69 @@ close_fp:
 	}
 }
 
+/*
+ * Create a writer of its own trace in the temporary directory "path",
+ * with a clock, for the tests which read back the events they write.
+ */
+struct bt_ctf_writer *create_scratch_writer(char *path,
+		struct bt_ctf_clock **clock)
+{
+	struct bt_ctf_writer *writer = NULL;
+
+	*clock = NULL;
+	if (!bt_mkdtemp(path)) {
+		perror("# mkdtemp");
+		goto error;
+	}
+
+	writer = bt_ctf_writer_create(path);
+	*clock = bt_ctf_clock_create("scratch_clock");
+	if (!writer || !*clock || bt_ctf_writer_add_clock(writer, *clock)) {
+		goto error;
+	}
+
+	return writer;
+error:
+	bt_put(writer);
+	BT_PUT(*clock);
+	return NULL;
+}
+
+void remove_scratch_trace(const char *path)
+{
+	DIR *trace_dir;
+	struct dirent *entry;
+
+	trace_dir = opendir(path);
+	if (!trace_dir) {
+		return;
+	}
+
+	while ((entry = readdir(trace_dir))) {
+		if (entry->d_name[0] != '.') {
+			unlinkat(bt_dirfd(trace_dir), entry->d_name, 0);
+		}
+	}
+
+	closedir(trace_dir);
+	rmdir(path);
+}
+
+/* Value of an integer field of the current event, or -1ULL. */
+uint64_t read_integer_field(const struct bt_ctf_event *event,
+		enum bt_ctf_scope scope, const char *name)
+{
+	const struct bt_definition *scope_def, *field;
+
+	scope_def = bt_ctf_get_top_level_scope(event, scope);
+	field = scope_def ? bt_ctf_get_field(event, scope_def, name) : NULL;
+	if (!field) {
+		return -1ULL;
+	}
+
+	return bt_ctf_get_uint64(field);
+}
+
 void event_copy_tests(struct bt_ctf_event *event)
 {
 	struct bt_ctf_event *copy;
@@ -2629,6 +2698,1070 @@ end:
 	bt_put(clock);
 }
 
+void test_async_flush_stream(struct bt_ctf_writer *writer)
+{
+	int i, ret = 0;
+	struct bt_ctf_trace *trace = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field_type *integer_type = NULL, *string_type = NULL;
+	struct bt_ctf_field *integer = NULL, *packet_header = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_event *event = NULL;
+
+	trace = bt_ctf_writer_get_trace(writer);
+	if (!trace) {
+		fail("Failed to get trace from writer");
+		goto end;
+	}
+
+	clock = bt_ctf_trace_get_clock(trace, 0);
+	if (!clock) {
+		fail("Failed to get clock from trace");
+		goto end;
+	}
+
+	stream_class = bt_ctf_stream_class_create("async_flush_stream");
+	if (!stream_class) {
+		fail("Failed to create stream class");
+		goto end;
+	}
+
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	if (ret) {
+		fail("Failed to set stream class clock");
+		goto end;
+	}
+
+	event_class = bt_ctf_event_class_create("async_event");
+	integer_type = bt_ctf_field_type_integer_create(32);
+	string_type = bt_ctf_field_type_string_create();
+	if (!event_class || !integer_type || !string_type) {
+		fail("Failed to create event class or field types");
+		goto end;
+	}
+
+	ret = bt_ctf_event_class_add_field(event_class, integer_type,
+		"seq");
+	ret |= bt_ctf_event_class_add_field(event_class, string_type,
+		"msg");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		fail("Failed to populate event class");
+		goto end;
+	}
+
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		fail("Failed to create stream");
+		goto end;
+	}
+
+	packet_header = bt_ctf_stream_get_packet_header(stream);
+	integer = bt_ctf_field_structure_get_field(packet_header,
+		"custom_trace_packet_header_field");
+	if (!integer) {
+		fail("Failed to retrieve custom_trace_packet_header_field");
+		goto end;
+	}
+
+	ret = bt_ctf_field_unsigned_integer_set_value(integer, 1);
+	if (ret) {
+		fail("Failed to set custom_trace_packet_header_field value");
+		goto end;
+	}
+
+	ok(bt_ctf_stream_set_async_flush(NULL, 2,
+		BT_CTF_STREAM_FLUSH_POLICY_BLOCK) < 0,
+		"bt_ctf_stream_set_async_flush handles a NULL stream correctly");
+	ok(bt_ctf_stream_set_async_flush(stream, 0,
+		BT_CTF_STREAM_FLUSH_POLICY_BLOCK) < 0,
+		"bt_ctf_stream_set_async_flush rejects a queue depth of 0");
+	ok(!bt_ctf_stream_set_async_flush(stream, 2,
+		BT_CTF_STREAM_FLUSH_POLICY_BLOCK),
+		"Enable asynchronous flushing on a stream");
+	ok(bt_ctf_stream_set_async_flush(stream, 2,
+		BT_CTF_STREAM_FLUSH_POLICY_DISCARD) < 0,
+		"bt_ctf_stream_set_async_flush can't be enabled twice");
+
+	for (i = 0; i < 1000; i++) {
+		struct bt_ctf_field *field;
+
+		event = bt_ctf_event_create(event_class);
+		if (!event) {
+			ret = -1;
+			break;
+		}
+
+		field = bt_ctf_event_get_payload(event, "seq");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_put(field);
+		field = bt_ctf_event_get_payload(event, "msg");
+		ret |= bt_ctf_field_string_set_value(field,
+			"Written by the flushing thread");
+		bt_put(field);
+		ret |= bt_ctf_clock_set_time(clock, ++current_time);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		BT_PUT(event);
+		if (ret) {
+			break;
+		}
+
+		if (i % 100 == 99) {
+			ret = bt_ctf_stream_flush(stream);
+			if (ret) {
+				break;
+			}
+		}
+	}
+	ok(ret == 0, "Flush packets asynchronously while appending events");
+	ok(bt_ctf_stream_wait_flush(stream) == 0,
+		"bt_ctf_stream_wait_flush reports all packets as written");
+	ok(bt_ctf_stream_wait_flush(NULL) < 0,
+		"bt_ctf_stream_wait_flush handles a NULL stream correctly");
+end:
+	bt_put(clock);
+	bt_put(trace);
+	bt_put(stream);
+	bt_put(stream_class);
+	bt_put(event_class);
+	bt_put(event);
+	bt_put(integer);
+	bt_put(packet_header);
+	bt_put(integer_type);
+	bt_put(string_type);
+}
+
+/* Packets dropped by a full queue, then read back. */
+void test_async_flush_discard(void)
+{
+	int ret = 0, nr_events = 0, nr_mismatches = 0;
+	uint64_t i, nr_appended = 0, discarded = 0, last_discarded = -1ULL;
+	char path[] = "/tmp/ctfwriter_discard_XXXXXX";
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL, *event_stream;
+	struct bt_ctf_field_type *integer_type = NULL;
+	struct bt_ctf_field *field = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_event *event = NULL, *held_event = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *read_event;
+	uint64_t clock_time = 1000;
+	/* A large first packet keeps the single queue slot busy. */
+	const uint64_t packet_sizes[] = { 10000, 10, 10, 10, 10, 10 };
+
+	writer = create_scratch_writer(path, &clock);
+	if (!writer) {
+		fail("Failed to create the discarding stream trace");
+		goto end;
+	}
+
+	stream_class = bt_ctf_stream_class_create("async_discard_stream");
+	event_class = bt_ctf_event_class_create("async_discard_event");
+	integer_type = bt_ctf_field_type_integer_create(32);
+	if (!stream_class || !event_class || !integer_type) {
+		fail("Failed to create discarding stream objects");
+		goto end;
+	}
+
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, integer_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		fail("Failed to populate discarding stream class");
+		goto end;
+	}
+
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream || bt_ctf_stream_set_async_flush(stream, 1,
+			BT_CTF_STREAM_FLUSH_POLICY_DISCARD)) {
+		fail("Failed to create a discarding stream");
+		goto end;
+	}
+
+	for (i = 0; i < sizeof(packet_sizes) / sizeof(*packet_sizes); i++) {
+		uint64_t j;
+
+		for (j = 0; j < packet_sizes[i]; j++) {
+			event = bt_ctf_event_create(event_class);
+			field = event ? bt_ctf_event_get_payload(event, "seq") :
+				NULL;
+			if (!field) {
+				ret = -1;
+				break;
+			}
+
+			ret |= bt_ctf_field_unsigned_integer_set_value(field,
+				nr_appended++);
+			ret |= bt_ctf_clock_set_time(clock, ++clock_time);
+			ret |= bt_ctf_stream_append_event(stream, event);
+			if (!held_event) {
+				held_event = event;
+				bt_get(held_event);
+			}
+			BT_PUT(field);
+			BT_PUT(event);
+		}
+
+		ret |= bt_ctf_stream_flush(stream);
+		if (ret) {
+			break;
+		}
+
+		if (i == 0) {
+			field = bt_ctf_event_get_payload(held_event, "seq");
+			ok(bt_ctf_stream_append_event(stream, held_event) < 0,
+				"An event queued for writing can't be appended again");
+			event_stream = bt_ctf_event_get_stream(held_event);
+			ok(event_stream == stream,
+				"A rejected append leaves the queued event in its stream");
+			BT_PUT(event_stream);
+			ok(bt_ctf_event_set_payload(held_event, "seq",
+				field) < 0,
+				"An event queued for writing can't be modified");
+			BT_PUT(field);
+		}
+	}
+	ok(ret == 0, "Flush packets without waiting on a discarding stream");
+
+	ret = bt_ctf_stream_get_discarded_events_count(stream, &discarded);
+	ok(!ret && discarded > 0,
+		"Packets are discarded while the queue is full");
+
+	/* Written once the queue is drained: carries the whole count. */
+	for (i = 0; i < 10; i++) {
+		event = bt_ctf_event_create(event_class);
+		field = event ? bt_ctf_event_get_payload(event, "seq") : NULL;
+		if (!field) {
+			ret = -1;
+			break;
+		}
+
+		ret |= bt_ctf_field_unsigned_integer_set_value(field,
+			nr_appended++);
+		ret |= bt_ctf_clock_set_time(clock, ++clock_time);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		BT_PUT(field);
+		BT_PUT(event);
+	}
+	ok(!ret && !bt_ctf_stream_wait_flush(stream) &&
+		!bt_ctf_stream_flush(stream) &&
+		!bt_ctf_stream_wait_flush(stream),
+		"Flush a last packet once the queue is drained");
+
+	field = bt_ctf_event_get_payload(held_event, "seq");
+	ok(!bt_ctf_event_set_payload(held_event, "seq", field),
+		"A written event is released by bt_ctf_stream_wait_flush");
+	BT_PUT(field);
+	bt_ctf_writer_flush_metadata(writer);
+
+	ctx = create_context_with_path(path);
+	iter = ctx ? bt_ctf_iter_create(ctx, NULL, NULL) : NULL;
+	if (!iter) {
+		fail("Failed to read back the discarding stream trace");
+		goto end;
+	}
+
+	while ((read_event = bt_ctf_iter_read_event(iter))) {
+		uint64_t seq;
+
+		/* All the events discarded so far precede this packet. */
+		seq = read_integer_field(read_event, BT_EVENT_FIELDS, "seq");
+		last_discarded = read_integer_field(read_event,
+			BT_STREAM_PACKET_CONTEXT, "events_discarded");
+		if (seq - nr_events != last_discarded) {
+			nr_mismatches++;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter))) {
+			break;
+		}
+	}
+	ok(nr_events + discarded == nr_appended,
+		"Events which were not discarded are written");
+	ok(!nr_mismatches && last_discarded == discarded,
+		"Written packets account for the events discarded before them");
+end:
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_put(field);
+	bt_put(event);
+	bt_put(held_event);
+	bt_put(stream);
+	bt_put(event_class);
+	bt_put(stream_class);
+	bt_put(integer_type);
+	bt_put(clock);
+	bt_put(writer);
+	remove_scratch_trace(path);
+}
+
+void test_payload_index_setters(struct bt_ctf_writer *writer)
+{
+	int i, ret = 0, seq_index, value_index;
+	int y_path[2], cpu_path[2];
+	const uint64_t values[] = { 42, 43, 44 };
+	uint64_t uint_value;
+	int64_t int_value;
+	struct bt_ctf_trace *trace = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field_type *uint_type = NULL, *int_type = NULL,
+		*string_type = NULL, *enum_type = NULL, *pos_type = NULL,
+		*context_type = NULL;
+	struct bt_ctf_field *integer = NULL, *packet_header = NULL,
+		*field = NULL, *context = NULL, *nested = NULL;
+	struct bt_ctf_event_class *event_class = NULL,
+		*path_event_class = NULL;
+	struct bt_ctf_event *event = NULL;
+
+	trace = bt_ctf_writer_get_trace(writer);
+	clock = bt_ctf_trace_get_clock(trace, 0);
+	stream_class = bt_ctf_stream_class_create("payload_index_stream");
+	event_class = bt_ctf_event_class_create("payload_index_event");
+	uint_type = bt_ctf_field_type_integer_create(32);
+	int_type = bt_ctf_field_type_integer_create(32);
+	string_type = bt_ctf_field_type_string_create();
+	if (!trace || !clock || !stream_class || !event_class ||
+		!uint_type || !int_type || !string_type) {
+		fail("Failed to create payload index stream objects");
+		goto end;
+	}
+
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_field_type_integer_set_signed(int_type, 1);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_type, "seq");
+	ret |= bt_ctf_event_class_add_field(event_class, string_type, "msg");
+	ret |= bt_ctf_event_class_add_field(event_class, int_type, "value");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		fail("Failed to populate payload index stream class");
+		goto end;
+	}
+
+	/* Integers nested in a structure, after an enumeration */
+	path_event_class = bt_ctf_event_class_create("payload_path_event");
+	enum_type = bt_ctf_field_type_enumeration_create(uint_type);
+	pos_type = bt_ctf_field_type_structure_create();
+	context_type = bt_ctf_field_type_structure_create();
+	if (!path_event_class || !enum_type || !pos_type || !context_type) {
+		fail("Failed to create payload path event class objects");
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_enumeration_add_mapping(enum_type, "IDLE",
+		0, 0);
+	ret |= bt_ctf_field_type_structure_add_field(pos_type, uint_type, "x");
+	ret |= bt_ctf_field_type_structure_add_field(pos_type, int_type, "y");
+	ret |= bt_ctf_field_type_structure_add_field(context_type, uint_type,
+		"cpu");
+	ret |= bt_ctf_event_class_add_field(path_event_class, enum_type,
+		"state");
+	ret |= bt_ctf_event_class_add_field(path_event_class, pos_type, "pos");
+	ret |= bt_ctf_event_class_set_context_type(path_event_class,
+		context_type);
+	ret |= bt_ctf_stream_class_add_event_class(stream_class,
+		path_event_class);
+	if (ret) {
+		fail("Failed to populate payload path event class");
+		goto end;
+	}
+
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		fail("Failed to create stream");
+		goto end;
+	}
+
+	packet_header = bt_ctf_stream_get_packet_header(stream);
+	integer = bt_ctf_field_structure_get_field(packet_header,
+		"custom_trace_packet_header_field");
+	if (!integer || bt_ctf_field_unsigned_integer_set_value(integer, 3)) {
+		fail("Failed to set custom_trace_packet_header_field value");
+		goto end;
+	}
+
+	ok(bt_ctf_event_class_get_field_index(NULL, "seq") < 0,
+		"bt_ctf_event_class_get_field_index handles a NULL event class correctly");
+	ok(bt_ctf_event_class_get_field_index(event_class, "unknown") < 0,
+		"bt_ctf_event_class_get_field_index rejects an unknown field name");
+	seq_index = bt_ctf_event_class_get_field_index(event_class, "seq");
+	ok(seq_index == 0,
+		"bt_ctf_event_class_get_field_index returns the correct index");
+	value_index = bt_ctf_event_class_get_field_index(event_class, "value");
+	ok(value_index == 2,
+		"bt_ctf_event_class_get_field_index returns the correct index after a non-integer field");
+
+	event = bt_ctf_event_create(event_class);
+	assert(event);
+	ok(bt_ctf_event_set_payload_signed_integer(event, seq_index, 1) < 0,
+		"bt_ctf_event_set_payload_signed_integer rejects an unsigned field");
+	ok(bt_ctf_event_set_payload_unsigned_integer(event, value_index, 1) < 0,
+		"bt_ctf_event_set_payload_unsigned_integer rejects a signed field");
+	ok(bt_ctf_event_set_payload_unsigned_integer(event, 3, 1) < 0,
+		"bt_ctf_event_set_payload_unsigned_integer rejects an invalid index");
+	ok(bt_ctf_event_set_payload_integers(event, values, 3) < 0,
+		"bt_ctf_event_set_payload_integers rejects more values than integer fields");
+	ok(!bt_ctf_event_set_payload_integers(event, values, 2),
+		"Set an event's integer fields with bt_ctf_event_set_payload_integers");
+	field = bt_ctf_event_get_payload(event, "seq");
+	ok(!bt_ctf_field_unsigned_integer_get_value(field, &uint_value) &&
+		uint_value == 42,
+		"bt_ctf_event_set_payload_integers sets the first integer field");
+	BT_PUT(field);
+	field = bt_ctf_event_get_payload(event, "value");
+	ok(!bt_ctf_field_signed_integer_get_value(field, &int_value) &&
+		int_value == 43,
+		"bt_ctf_event_set_payload_integers skips non-integer fields");
+	BT_PUT(field);
+	BT_PUT(event);
+
+	ok(bt_ctf_event_class_get_field_path(path_event_class, "pos.y",
+		y_path, 2) == 2 && y_path[0] == 1 && y_path[1] == 1,
+		"bt_ctf_event_class_get_field_path resolves a nested field");
+	ok(bt_ctf_event_class_get_field_path(path_event_class, "pos.y",
+		y_path, 1) < 0,
+		"bt_ctf_event_class_get_field_path rejects a path deeper than the array");
+	ok(bt_ctf_event_class_get_field_path(path_event_class, "pos.z",
+		y_path, 2) < 0 &&
+		bt_ctf_event_class_get_field_path(path_event_class,
+		"state.x", y_path, 2) < 0,
+		"bt_ctf_event_class_get_field_path rejects an unknown field");
+	ok(bt_ctf_field_type_structure_get_field_path(context_type, "cpu",
+		cpu_path, 2) == 1 && cpu_path[0] == 0,
+		"bt_ctf_field_type_structure_get_field_path resolves a context field");
+
+	event = bt_ctf_event_create(path_event_class);
+	assert(event);
+	ok(bt_ctf_event_set_payload_unsigned_integer_by_path(event, y_path, 2,
+		1) < 0,
+		"bt_ctf_event_set_payload_unsigned_integer_by_path rejects a signed field");
+	ok(bt_ctf_event_set_payload_signed_integer_by_path(event, y_path, 1,
+		1) < 0,
+		"bt_ctf_event_set_payload_signed_integer_by_path rejects the path of a structure");
+	ok(!bt_ctf_event_set_payload_signed_integer_by_path(event, y_path, 2,
+		-7), "Set a nested integer field by path");
+	field = bt_ctf_event_get_payload(event, "pos");
+	nested = bt_ctf_field_structure_get_field(field, "y");
+	ok(!bt_ctf_field_signed_integer_get_value(nested, &int_value) &&
+		int_value == -7,
+		"bt_ctf_event_set_payload_signed_integer_by_path sets the nested field");
+	BT_PUT(nested);
+	BT_PUT(field);
+	context = bt_ctf_event_get_event_context(event);
+	ok(!bt_ctf_field_structure_set_unsigned_integer_by_path(context,
+		cpu_path, 1, 3),
+		"Set an event context field by path");
+	nested = bt_ctf_field_structure_get_field(context, "cpu");
+	ok(!bt_ctf_field_unsigned_integer_get_value(nested, &uint_value) &&
+		uint_value == 3,
+		"bt_ctf_field_structure_set_unsigned_integer_by_path sets the context field");
+	BT_PUT(nested);
+	ok(bt_ctf_event_set_payload_integers(event, values, 1) < 0,
+		"bt_ctf_event_set_payload_integers rejects a payload starting with an enumeration");
+	BT_PUT(event);
+
+	for (i = 0; i < 100; i++) {
+		event = bt_ctf_event_create(event_class);
+		if (!event) {
+			ret = -1;
+			break;
+		}
+
+		ret |= bt_ctf_event_set_payload_unsigned_integer(event,
+			seq_index, i);
+		ret |= bt_ctf_event_set_payload_signed_integer(event,
+			value_index, -i);
+		field = bt_ctf_event_get_payload(event, "msg");
+		ret |= bt_ctf_field_string_set_value(field,
+			"Set by index");
+		BT_PUT(field);
+		ret |= bt_ctf_clock_set_time(clock, ++current_time);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		BT_PUT(event);
+		if (ret) {
+			break;
+		}
+	}
+	ok(ret == 0, "Append events whose integer fields are set by index");
+	ok(bt_ctf_stream_flush(stream) == 0,
+		"Flush a packet of events whose integer fields are set by index");
+end:
+	bt_put(clock);
+	bt_put(trace);
+	bt_put(stream);
+	bt_put(stream_class);
+	bt_put(event_class);
+	bt_put(path_event_class);
+	bt_put(event);
+	bt_put(field);
+	bt_put(context);
+	bt_put(nested);
+	bt_put(integer);
+	bt_put(packet_header);
+	bt_put(uint_type);
+	bt_put(int_type);
+	bt_put(string_type);
+	bt_put(enum_type);
+	bt_put(pos_type);
+	bt_put(context_type);
+}
+
+void test_event_context_snapshot(void)
+{
+	int i, ret = 0, nr_events = 0, nr_mismatches = 0;
+	char path[] = "/tmp/ctfwriter_context_XXXXXX";
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field_type *integer_type = NULL, *context_type = NULL;
+	struct bt_ctf_field *context = NULL, *cpu = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_event *event = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *read_event;
+	uint64_t clock_time = 1000;
+
+	writer = create_scratch_writer(path, &clock);
+	if (!writer) {
+		fail("Failed to create the event context snapshot trace");
+		goto end;
+	}
+
+	stream_class = bt_ctf_stream_class_create("context_snapshot_stream");
+	event_class = bt_ctf_event_class_create("context_snapshot_event");
+	integer_type = bt_ctf_field_type_integer_create(32);
+	context_type = bt_ctf_field_type_structure_create();
+	if (!stream_class || !event_class || !integer_type || !context_type) {
+		fail("Failed to create event context snapshot objects");
+		goto end;
+	}
+
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_field_type_structure_add_field(context_type,
+		integer_type, "cpu");
+	ret |= bt_ctf_stream_class_set_event_context_type(stream_class,
+		context_type);
+	ret |= bt_ctf_event_class_add_field(event_class, integer_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		fail("Failed to populate event context snapshot stream class");
+		goto end;
+	}
+
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	context = stream ? bt_ctf_stream_get_event_context(stream) : NULL;
+	cpu = context ? bt_ctf_field_structure_get_field(context, "cpu") : NULL;
+	if (!cpu) {
+		fail("Failed to get the stream event context");
+		goto end;
+	}
+
+	/* Three events on CPU 1, then two on CPU 2 */
+	for (i = 0; i < 5; i++) {
+		if (i == 0 || i == 3) {
+			ret |= bt_ctf_field_unsigned_integer_set_value(cpu,
+				i ? 2 : 1);
+		}
+
+		event = bt_ctf_event_create(event_class);
+		if (!event) {
+			ret = -1;
+			break;
+		}
+
+		ret |= bt_ctf_event_set_payload_unsigned_integer(event, 0, i);
+		ret |= bt_ctf_clock_set_time(clock, ++clock_time);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		BT_PUT(event);
+	}
+	ok(ret == 0, "Append events with an unchanged, then a changed, event context");
+
+	ok(stream->event_contexts->len == 5,
+		"A stream event context is sampled for each appended event");
+	if (stream->event_contexts->len == 5) {
+		ok(g_ptr_array_index(stream->event_contexts, 0) ==
+			g_ptr_array_index(stream->event_contexts, 1) &&
+			g_ptr_array_index(stream->event_contexts, 1) ==
+			g_ptr_array_index(stream->event_contexts, 2),
+			"An unmodified stream event context snapshot is shared");
+		ok(g_ptr_array_index(stream->event_contexts, 2) !=
+			g_ptr_array_index(stream->event_contexts, 3),
+			"A modified stream event context is copied");
+		ok(g_ptr_array_index(stream->event_contexts, 3) ==
+			g_ptr_array_index(stream->event_contexts, 4),
+			"The new snapshot is shared until the next modification");
+	} else {
+		skip(3, "Unexpected number of stream event contexts");
+	}
+
+	ok(bt_ctf_stream_flush(stream) == 0,
+		"Flush the events of the event context snapshot stream");
+	bt_ctf_writer_flush_metadata(writer);
+
+	ctx = create_context_with_path(path);
+	iter = ctx ? bt_ctf_iter_create(ctx, NULL, NULL) : NULL;
+	if (!iter) {
+		fail("Failed to read back the event context snapshot trace");
+		goto end;
+	}
+
+	while ((read_event = bt_ctf_iter_read_event(iter))) {
+		uint64_t seq, expected_cpu;
+
+		seq = read_integer_field(read_event, BT_EVENT_FIELDS, "seq");
+		expected_cpu = seq < 3 ? 1 : 2;
+		if (seq != nr_events || read_integer_field(read_event,
+				BT_STREAM_EVENT_CONTEXT, "cpu") !=
+				expected_cpu) {
+			nr_mismatches++;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter))) {
+			break;
+		}
+	}
+	ok(nr_events == 5 && !nr_mismatches,
+		"Shared and copied stream event contexts are serialized correctly");
+end:
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_put(event);
+	bt_put(cpu);
+	bt_put(context);
+	bt_put(stream);
+	bt_put(event_class);
+	bt_put(stream_class);
+	bt_put(integer_type);
+	bt_put(context_type);
+	bt_put(clock);
+	bt_put(writer);
+	remove_scratch_trace(path);
+}
+
+void test_raw_event_stream(struct bt_ctf_writer *writer)
+{
+	int i, ret = 0;
+	uint8_t payload[6];
+	struct bt_ctf_trace *trace = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field_type *uint16_type = NULL, *uint32_type = NULL,
+		*string_type = NULL;
+	struct bt_ctf_field *integer = NULL, *packet_header = NULL;
+	struct bt_ctf_event_class *event_class = NULL,
+		*string_event_class = NULL;
+	struct bt_ctf_event *event = NULL;
+
+	trace = bt_ctf_writer_get_trace(writer);
+	clock = bt_ctf_trace_get_clock(trace, 0);
+	stream_class = bt_ctf_stream_class_create("raw_event_stream");
+	event_class = bt_ctf_event_class_create("raw_event");
+	string_event_class = bt_ctf_event_class_create("raw_string_event");
+	uint16_type = bt_ctf_field_type_integer_create(16);
+	uint32_type = bt_ctf_field_type_integer_create(32);
+	string_type = bt_ctf_field_type_string_create();
+	if (!trace || !clock || !stream_class || !event_class ||
+		!string_event_class || !uint16_type || !uint32_type ||
+		!string_type) {
+		fail("Failed to create raw event stream objects");
+		goto end;
+	}
+
+	/* Raw payloads must be byte-aligned */
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_field_type_set_alignment(uint16_type, 8);
+	ret |= bt_ctf_field_type_set_alignment(uint32_type, 8);
+	ret |= bt_ctf_field_type_set_byte_order(uint16_type,
+		BT_CTF_BYTE_ORDER_LITTLE_ENDIAN);
+	ret |= bt_ctf_field_type_set_byte_order(uint32_type,
+		BT_CTF_BYTE_ORDER_LITTLE_ENDIAN);
+	ret |= bt_ctf_event_class_add_field(event_class, uint16_type,
+		"small");
+	ret |= bt_ctf_event_class_add_field(event_class, uint32_type,
+		"large");
+	ret |= bt_ctf_event_class_add_field(string_event_class, string_type,
+		"msg");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	ret |= bt_ctf_stream_class_add_event_class(stream_class,
+		string_event_class);
+	if (ret) {
+		fail("Failed to populate raw event stream class");
+		goto end;
+	}
+
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		fail("Failed to create stream");
+		goto end;
+	}
+
+	packet_header = bt_ctf_stream_get_packet_header(stream);
+	integer = bt_ctf_field_structure_get_field(packet_header,
+		"custom_trace_packet_header_field");
+	if (!integer || bt_ctf_field_unsigned_integer_set_value(integer, 2)) {
+		fail("Failed to set custom_trace_packet_header_field value");
+		goto end;
+	}
+
+	memset(payload, 0, sizeof(payload));
+	ok(bt_ctf_stream_append_raw_event(NULL, event_class, current_time,
+		payload, sizeof(payload)) < 0,
+		"bt_ctf_stream_append_raw_event handles a NULL stream correctly");
+	ok(bt_ctf_stream_append_raw_event(stream, event_class, current_time,
+		payload, sizeof(payload) - 1) < 0,
+		"bt_ctf_stream_append_raw_event rejects a payload of the wrong size");
+	ok(bt_ctf_stream_append_raw_event(stream, string_event_class,
+		current_time, payload, sizeof(payload)) < 0,
+		"bt_ctf_stream_append_raw_event rejects an event class with a variable layout");
+
+	for (i = 0; i < 100; i++) {
+		/* "small" and "large" fields, in little endian */
+		payload[0] = i & 0xff;
+		payload[1] = 0;
+		payload[2] = i & 0xff;
+		payload[3] = 0xaa;
+		payload[4] = 0x55;
+		payload[5] = 0;
+		ret |= bt_ctf_stream_append_raw_event(stream, event_class,
+			++current_time, payload, sizeof(payload));
+
+		/* Interleave regular events */
+		if (i % 10 == 0) {
+			event = bt_ctf_event_create(event_class);
+			ret |= bt_ctf_event_set_payload_unsigned_integer(event,
+				0, i);
+			ret |= bt_ctf_event_set_payload_unsigned_integer(event,
+				1, i);
+			ret |= bt_ctf_clock_set_time(clock, ++current_time);
+			ret |= bt_ctf_stream_append_event(stream, event);
+			BT_PUT(event);
+		}
+	}
+	ok(ret == 0, "Append raw events interleaved with regular events");
+	ok(bt_ctf_stream_flush(stream) == 0,
+		"Flush a packet containing raw events");
+end:
+	bt_put(clock);
+	bt_put(trace);
+	bt_put(stream);
+	bt_put(stream_class);
+	bt_put(event_class);
+	bt_put(string_event_class);
+	bt_put(event);
+	bt_put(integer);
+	bt_put(packet_header);
+	bt_put(uint16_type);
+	bt_put(uint32_type);
+	bt_put(string_type);
+}
+
+/*
+ * Interleave raw events with the same events appended normally, and
+ * check that both read back identically.
+ */
+void test_raw_event_read_back(void)
+{
+	int i, ret = 0, nr_events = 0, nr_mismatches = 0;
+	char path[] = "/tmp/ctfwriter_raw_XXXXXX";
+	uint8_t payload[6];
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field_type *uint16_type = NULL, *uint32_type = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_event *event = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *read_event;
+	uint64_t clock_time = 1000;
+
+	writer = create_scratch_writer(path, &clock);
+	if (!writer) {
+		fail("Failed to create the raw event trace");
+		goto end;
+	}
+
+	stream_class = bt_ctf_stream_class_create("raw_read_back_stream");
+	event_class = bt_ctf_event_class_create("raw_read_back_event");
+	uint16_type = bt_ctf_field_type_integer_create(16);
+	uint32_type = bt_ctf_field_type_integer_create(32);
+	if (!stream_class || !event_class || !uint16_type || !uint32_type) {
+		fail("Failed to create raw event read back objects");
+		goto end;
+	}
+
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_field_type_set_alignment(uint16_type, 8);
+	ret |= bt_ctf_field_type_set_alignment(uint32_type, 8);
+	ret |= bt_ctf_field_type_set_byte_order(uint16_type,
+		BT_CTF_BYTE_ORDER_LITTLE_ENDIAN);
+	ret |= bt_ctf_field_type_set_byte_order(uint32_type,
+		BT_CTF_BYTE_ORDER_LITTLE_ENDIAN);
+	ret |= bt_ctf_event_class_add_field(event_class, uint16_type,
+		"small");
+	ret |= bt_ctf_event_class_add_field(event_class, uint32_type,
+		"large");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (ret || !stream) {
+		fail("Failed to populate raw event read back stream");
+		goto end;
+	}
+
+	/* Even events are raw, odd ones are appended normally */
+	for (i = 0; i < 20; i++) {
+		uint32_t large = i * 1000 + 7;
+
+		if (i % 2 == 0) {
+			payload[0] = i & 0xff;
+			payload[1] = (i >> 8) & 0xff;
+			payload[2] = large & 0xff;
+			payload[3] = (large >> 8) & 0xff;
+			payload[4] = (large >> 16) & 0xff;
+			payload[5] = (large >> 24) & 0xff;
+			ret |= bt_ctf_stream_append_raw_event(stream,
+				event_class, ++clock_time, payload,
+				sizeof(payload));
+			continue;
+		}
+
+		event = bt_ctf_event_create(event_class);
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		ret |= bt_ctf_event_set_payload_unsigned_integer(event, 0, i);
+		ret |= bt_ctf_event_set_payload_unsigned_integer(event, 1,
+			large);
+		ret |= bt_ctf_clock_set_time(clock, ++clock_time);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		BT_PUT(event);
+	}
+	ok(ret == 0, "Append raw and regular events with the same layout");
+	ok(bt_ctf_stream_flush(stream) == 0,
+		"Flush the raw event read back stream");
+	bt_ctf_writer_flush_metadata(writer);
+
+	ctx = create_context_with_path(path);
+	iter = ctx ? bt_ctf_iter_create(ctx, NULL, NULL) : NULL;
+	if (!iter) {
+		fail("Failed to read back the raw event trace");
+		goto end;
+	}
+
+	while ((read_event = bt_ctf_iter_read_event(iter))) {
+		if (read_integer_field(read_event, BT_EVENT_FIELDS,
+				"small") != nr_events ||
+				read_integer_field(read_event, BT_EVENT_FIELDS,
+					"large") != nr_events * 1000 + 7 ||
+				bt_ctf_get_cycles(read_event) !=
+					1001 + nr_events) {
+			nr_mismatches++;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter))) {
+			break;
+		}
+	}
+	ok(nr_events == 20 && !nr_mismatches,
+		"Raw events read back like the same events appended normally");
+end:
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_put(event);
+	bt_put(stream);
+	bt_put(event_class);
+	bt_put(stream_class);
+	bt_put(uint16_type);
+	bt_put(uint32_type);
+	bt_put(clock);
+	bt_put(writer);
+	remove_scratch_trace(path);
+}
+
+/* Whether looking a field up by name and by key give the same definition. */
+int field_lookups_match(const struct bt_ctf_event *event,
+		const struct bt_definition *scope, const char *name,
+		const struct bt_definition *expected)
+{
+	struct bt_ctf_field_key *key;
+	const struct bt_definition *by_key;
+
+	key = bt_ctf_field_key_create(name);
+	if (!key) {
+		return 0;
+	}
+	by_key = bt_ctf_get_field_by_key(event, scope, key);
+	bt_ctf_field_key_destroy(key);
+	return by_key == expected &&
+		bt_ctf_get_field(event, scope, name) == expected;
+}
+
+void test_field_keys(void)
+{
+	int i, ret = 0, nr_events = 0, nr_mismatches = 0;
+	char path[] = "/tmp/ctfwriter_keys_XXXXXX";
+	const char *never_interned = "test_field_keys_never_interned_name";
+	const char *late_interned = "test_field_keys_late_interned_name";
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field_type *uint32_type = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_event *event = NULL;
+	struct bt_ctf_field_key *plain_key = NULL, *prefixed_key = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *read_event;
+	uint64_t clock_time = 1000;
+	GQuark quark;
+
+	ok(bt_quark_lookup(never_interned) == 0,
+		"bt_quark_lookup returns 0 for a string never interned");
+	quark = bt_quark_lookup(late_interned);
+	ok(quark == 0 && bt_quark_lookup(late_interned) == 0,
+		"bt_quark_lookup returns 0 for a string not interned yet");
+	quark = g_quark_from_string(late_interned);
+	ok(bt_quark_lookup(late_interned) == quark &&
+		bt_quark_lookup(late_interned) == quark,
+		"bt_quark_lookup finds a string interned after a miss");
+
+	writer = create_scratch_writer(path, &clock);
+	if (!writer) {
+		fail("Failed to create the field key trace");
+		goto end;
+	}
+
+	stream_class = bt_ctf_stream_class_create("field_key_stream");
+	event_class = bt_ctf_event_class_create("field_key_event");
+	uint32_type = bt_ctf_field_type_integer_create(32);
+	if (!stream_class || !event_class || !uint32_type) {
+		fail("Failed to create field key objects");
+		goto end;
+	}
+
+	ret = bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint32_type, "plain");
+	ret |= bt_ctf_event_class_add_field(event_class, uint32_type,
+		"_prefixed");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (ret || !stream) {
+		fail("Failed to populate field key stream");
+		goto end;
+	}
+
+	for (i = 0; i < 10; i++) {
+		event = bt_ctf_event_create(event_class);
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		ret |= bt_ctf_event_set_payload_unsigned_integer(event, 0, i);
+		ret |= bt_ctf_event_set_payload_unsigned_integer(event, 1,
+			i * 10 + 1);
+		ret |= bt_ctf_clock_set_time(clock, ++clock_time);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		BT_PUT(event);
+	}
+	ok(ret == 0, "Append events with plain and prefixed fields");
+	ok(bt_ctf_stream_flush(stream) == 0, "Flush the field key stream");
+	bt_ctf_writer_flush_metadata(writer);
+
+	plain_key = bt_ctf_field_key_create("plain");
+	prefixed_key = bt_ctf_field_key_create("prefixed");
+	ok(plain_key && prefixed_key, "Create field keys");
+	ok(!bt_ctf_field_key_create(NULL),
+		"bt_ctf_field_key_create handles NULL correctly");
+
+	ctx = create_context_with_path(path);
+	iter = ctx ? bt_ctf_iter_create(ctx, NULL, NULL) : NULL;
+	if (!iter || !plain_key || !prefixed_key) {
+		fail("Failed to read back the field key trace");
+		goto end;
+	}
+
+	while ((read_event = bt_ctf_iter_read_event(iter))) {
+		const struct bt_definition *scope, *plain, *prefixed;
+
+		scope = bt_ctf_get_top_level_scope(read_event,
+			BT_EVENT_FIELDS);
+		plain = bt_ctf_get_field_by_key(read_event, scope, plain_key);
+		prefixed = bt_ctf_get_field_by_key(read_event, scope,
+			prefixed_key);
+		if (!plain || !prefixed ||
+				bt_ctf_get_uint64(plain) != nr_events ||
+				bt_ctf_get_uint64(prefixed) !=
+					nr_events * 10 + 1 ||
+				!field_lookups_match(read_event, scope,
+					"plain", plain) ||
+				!field_lookups_match(read_event, scope,
+					"prefixed", prefixed) ||
+				!field_lookups_match(read_event, scope,
+					"_prefixed", prefixed) ||
+				!field_lookups_match(read_event, scope,
+					"missing", NULL)) {
+			nr_mismatches++;
+		}
+		if (nr_events == 0) {
+			ok(!bt_ctf_get_field(read_event, scope,
+				never_interned) &&
+				bt_quark_lookup(never_interned) == 0,
+				"Looking up a never interned name neither finds nor interns it");
+			ok(!bt_ctf_get_field_by_key(read_event, scope, NULL) &&
+				!bt_ctf_get_field_by_key(read_event, NULL,
+					plain_key),
+				"bt_ctf_get_field_by_key handles NULL correctly");
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter))) {
+			break;
+		}
+	}
+	ok(nr_events == 10 && !nr_mismatches,
+		"Lookups by key match lookups by name, plain and prefixed");
+end:
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_field_key_destroy(plain_key);
+	bt_ctf_field_key_destroy(prefixed_key);
+	bt_put(event);
+	bt_put(stream);
+	bt_put(event_class);
+	bt_put(stream_class);
+	bt_put(uint32_type);
+	bt_put(clock);
+	bt_put(writer);
+	remove_scratch_trace(path);
+}
+
 void append_existing_event_class(struct bt_ctf_stream_class *stream_class)
 {
 	struct bt_ctf_event_class *event_class;
@@ -2692,7 +3825,7 @@ int main(int argc, char **argv)
 	plan_no_plan();
 
 	if (!bt_mkdtemp(trace_path)) {
-		perror("# perror");
+		perror("# mkdtemp");
 	}
 
 	strcpy(metadata_path, trace_path);
@@ -3263,6 +4396,20 @@ int main(int argc, char **argv)
 
 	test_custom_event_header_stream(writer);
 
+	test_async_flush_stream(writer);
+
+	test_async_flush_discard();
+
+	test_payload_index_setters(writer);
+
+	test_event_context_snapshot();
+
+	test_raw_event_stream(writer);
+
+	test_raw_event_read_back();
+
+	test_field_keys();
+
 	metadata_string = bt_ctf_writer_get_metadata_string(writer);
 	ok(metadata_string, "Get metadata string");
 
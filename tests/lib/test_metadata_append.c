@@ -0,0 +1,148 @@
+/*
+ * test_metadata_append.c
+ *
+ * Babeltrace incremental metadata append tests
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/context.h>
+#include <babeltrace/context-internal.h>
+#include <babeltrace/trace-handle-internal.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/compat/memstream.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <string.h>
+#include "tap/tap.h"
+
+#define NR_TESTS	10
+
+/* Metadata of a live trace, as received in several chunks. */
+static const char metadata_initial[] =
+	"/* CTF 1.8 */\n"
+	"typealias integer { size = 32; align = 8; signed = false; } := uint32_t;\n"
+	"trace {\n"
+	"	major = 1;\n"
+	"	minor = 8;\n"
+	"	byte_order = le;\n"
+	"	packet.header := struct { uint32_t magic; uint32_t stream_id; };\n"
+	"};\n"
+	"stream {\n"
+	"	id = 0;\n"
+	"	event.header := struct { uint32_t id; };\n"
+	"};\n"
+	"event { name = \"first\"; id = 0; stream_id = 0; fields := struct { uint32_t a; }; };\n";
+
+static const char metadata_second[] =
+	"event { name = \"second\"; id = 1; stream_id = 0; fields := struct { uint32_t a; }; };\n";
+
+/*
+ * Registers a type and an event, then fails on an event ID which is
+ * already used.
+ */
+static const char metadata_failing[] =
+	"typealias integer { size = 16; align = 8; signed = false; } := uint16_t;\n"
+	"event { name = \"third\"; id = 2; stream_id = 0; fields := struct { uint16_t b; }; };\n"
+	"event { name = \"duplicate\"; id = 1; stream_id = 0; fields := struct { uint32_t a; }; };\n";
+
+/* Uses the type registered by the failed append. */
+static const char metadata_after_failure[] =
+	"event { name = \"fourth\"; id = 3; stream_id = 0; fields := struct { uint16_t b; }; };\n";
+
+static
+void packet_seek(struct bt_stream_pos *pos, size_t index, int whence)
+{
+}
+
+static
+FILE *open_chunk(const char *chunk)
+{
+	return babeltrace_fmemopen((void *) chunk, strlen(chunk), "rb");
+}
+
+/* Whether the trace declares exactly the events named in "names". */
+static
+int check_event_names(struct bt_context *ctx, int handle_id,
+		const char **names, unsigned int nr_names)
+{
+	struct bt_ctf_event_decl * const *list;
+	unsigned int count, i;
+
+	if (bt_ctf_get_event_decl_list(handle_id, ctx, &list, &count)
+			|| count != nr_names)
+		return 0;
+	for (i = 0; i < count; i++) {
+		const char *name = bt_ctf_get_decl_event_name(list[i]);
+
+		if (!name || strcmp(name, names[i]))
+			return 0;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	const char *names[] = { "first", "second", "third", "fourth" };
+	struct bt_mmap_stream_list mmap_list;
+	struct bt_trace_handle *handle;
+	struct bt_trace_descriptor *td;
+	struct bt_context *ctx;
+	int handle_id;
+
+	plan_tests(NR_TESTS);
+
+	ctx = bt_context_create();
+	BT_INIT_LIST_HEAD(&mmap_list.head);
+	handle_id = bt_context_add_trace(ctx, NULL, "ctf", packet_seek,
+			&mmap_list, open_chunk(metadata_initial));
+	ok(handle_id >= 0, "Open a trace from its initial metadata");
+	if (handle_id < 0) {
+		skip(NR_TESTS - 1, "Cannot open the trace");
+		goto end;
+	}
+	handle = g_hash_table_lookup(ctx->trace_handles,
+			(gpointer) (unsigned long) handle_id);
+	td = handle->td;
+	ok(check_event_names(ctx, handle_id, names, 1),
+		"The initial metadata declares one event");
+
+	ok(ctf_append_trace_metadata(td, open_chunk(metadata_second)) == 0,
+		"Append a metadata chunk");
+	ok(check_event_names(ctx, handle_id, names, 2),
+		"The appended event is declared");
+
+	ok(ctf_append_trace_metadata(td, open_chunk(metadata_failing)) != 0,
+		"Appending a duplicate event ID fails");
+	ok(check_event_names(ctx, handle_id, names, 3),
+		"The event appended before the failure is kept");
+
+	ok(ctf_append_trace_metadata(td,
+			open_chunk(metadata_after_failure)) == 0,
+		"Append a metadata chunk after a failed append");
+	ok(check_event_names(ctx, handle_id, names, 4),
+		"The event appended after the failure is declared");
+
+	ok(ctf_append_trace_metadata(td, open_chunk(metadata_second)) != 0,
+		"Appending an event twice fails");
+	ok(check_event_names(ctx, handle_id, names, 4),
+		"Failed appends leave the declared events unchanged");
+
+	bt_context_remove_trace(ctx, handle_id);
+end:
+	bt_context_put(ctx);
+	return 0;
+}
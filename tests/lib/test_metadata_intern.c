@@ -0,0 +1,221 @@
+/*
+ * test_metadata_intern.c
+ *
+ * Babeltrace shared metadata declarations tests
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/context.h>
+#include <babeltrace/context-internal.h>
+#include <babeltrace/trace-handle-internal.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <stdio.h>
+#include <stdlib.h>
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS	13
+
+struct read_result {
+	uint64_t nr_events;
+	uint64_t timestamp_sum;
+};
+
+static
+struct ctf_trace *get_trace(struct bt_context *ctx, int handle_id)
+{
+	struct bt_trace_handle *handle;
+
+	handle = g_hash_table_lookup(ctx->trace_handles,
+			(gpointer) (unsigned long) handle_id);
+	return container_of(handle->td, struct ctf_trace, parent);
+}
+
+/* Read every event of the context, which fails on a truncated read. */
+static
+int read_events(struct bt_context *ctx, struct read_result *result)
+{
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	int ret = 0;
+
+	result->nr_events = 0;
+	result->timestamp_sum = 0;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		return -1;
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		if (!bt_ctf_event_name(event)) {
+			ret = -1;
+			break;
+		}
+		result->nr_events++;
+		result->timestamp_sum += bt_ctf_get_timestamp(event);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	bt_ctf_iter_destroy(iter);
+	return ret;
+}
+
+static
+int same_events(struct read_result *result, struct read_result *expected,
+		unsigned int nr_traces)
+{
+	return result->nr_events == nr_traces * expected->nr_events
+		&& result->timestamp_sum == nr_traces * expected->timestamp_sum;
+}
+
+/* Whether both traces use the same declarations. */
+static
+int declarations_shared(struct ctf_trace *a, struct ctf_trace *b)
+{
+	int i;
+
+	if (!a->metadata_intern || a->metadata_intern != b->metadata_intern)
+		return 0;
+	if (a->declaration_arena != b->declaration_arena
+	    || a->packet_header_decl != b->packet_header_decl)
+		return 0;
+	if (a->streams->len != b->streams->len)
+		return 0;
+	for (i = 0; i < a->streams->len; i++) {
+		struct ctf_stream_declaration *sa, *sb;
+		int j;
+
+		sa = g_ptr_array_index(a->streams, i);
+		sb = g_ptr_array_index(b->streams, i);
+		if (!sa || !sb) {
+			if (sa != sb)
+				return 0;
+			continue;
+		}
+		/* Each trace has its own stream classes. */
+		if (sa == sb || sa->event_header_decl != sb->event_header_decl
+		    || sa->events_by_id->len != sb->events_by_id->len)
+			return 0;
+		for (j = 0; j < sa->events_by_id->len; j++) {
+			struct ctf_event_declaration *ea, *eb;
+
+			ea = g_ptr_array_index(sa->events_by_id, j);
+			eb = g_ptr_array_index(sb->events_by_id, j);
+			if (!ea || !eb) {
+				if (ea != eb)
+					return 0;
+				continue;
+			}
+			if (ea == eb || ea->fields_decl != eb->fields_decl)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Open the trace twice in one context, then close the two instances
+ * in the order given: the remaining one must still be readable.
+ */
+static
+void test_close_order(const char *path, struct read_result *expected,
+		int close_first)
+{
+	struct read_result result;
+	struct bt_context *ctx;
+	int handle_ids[2];
+
+	ctx = bt_context_create();
+	handle_ids[0] = bt_context_add_trace(ctx, path, "ctf", NULL, NULL, NULL);
+	handle_ids[1] = bt_context_add_trace(ctx, path, "ctf", NULL, NULL, NULL);
+	if (handle_ids[0] < 0 || handle_ids[1] < 0) {
+		fail("Open the trace twice in a context");
+		skip(3, "Cannot open the trace twice");
+		goto end;
+	}
+	pass("Open the trace twice in a context");
+	ok(declarations_shared(get_trace(ctx, handle_ids[0]),
+			get_trace(ctx, handle_ids[1])),
+		"Both traces share their declarations");
+	ok(!read_events(ctx, &result) && same_events(&result, expected, 2),
+		"Both traces are read");
+	bt_context_remove_trace(ctx, handle_ids[close_first]);
+	ok(!read_events(ctx, &result) && same_events(&result, expected, 1),
+		"Closing the %s trace leaves the other one readable",
+		close_first ? "second" : "first");
+end:
+	bt_context_put(ctx);
+}
+
+int main(int argc, char **argv)
+{
+	struct read_result expected, result;
+	struct bt_context *ctx, *other_ctx;
+	int handle_id;
+
+	plan_tests(NR_TESTS);
+
+	if (argc < 2) {
+		diag("Invalid arguments: need a trace path");
+		skip(NR_TESTS, "Missing trace path");
+		return 0;
+	}
+
+	ctx = create_context_with_path(argv[1]);
+	if (!ctx) {
+		diag("Cannot open the trace at %s", argv[1]);
+		skip(NR_TESTS, "Cannot open the trace");
+		return 0;
+	}
+	ok(!read_events(ctx, &expected) && expected.nr_events > 0,
+		"Read the trace alone");
+	bt_context_put(ctx);
+
+	/*
+	 * The first instance interns the metadata, the second one shares
+	 * it: close each of them first.
+	 */
+	test_close_order(argv[1], &expected, 0);
+	test_close_order(argv[1], &expected, 1);
+
+	/* Sharing across contexts. */
+	ctx = create_context_with_path(argv[1]);
+	other_ctx = create_context_with_path(argv[1]);
+	ok(ctx && other_ctx, "Open the trace in two contexts");
+	if (ctx)
+		bt_context_put(ctx);
+	ok(other_ctx && !read_events(other_ctx, &result)
+			&& same_events(&result, &expected, 1),
+		"Closing the first context leaves the trace of the other one readable");
+	if (other_ctx)
+		bt_context_put(other_ctx);
+
+	/* All instances are closed: the metadata is interned again. */
+	ctx = bt_context_create();
+	handle_id = bt_context_add_trace(ctx, argv[1], "ctf", NULL, NULL, NULL);
+	ok(handle_id >= 0 && get_trace(ctx, handle_id)->metadata_intern,
+		"Reopen the trace once all of its instances are closed");
+	ok(handle_id >= 0 && !read_events(ctx, &result)
+			&& same_events(&result, &expected, 1),
+		"The reopened trace is read");
+	bt_context_put(ctx);
+	return 0;
+}
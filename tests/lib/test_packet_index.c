@@ -0,0 +1,139 @@
+/*
+ * test_packet_index.c
+ *
+ * Babeltrace compact packet index tests
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/ctf/types.h>
+#include <string.h>
+#include "tap/tap.h"
+
+#define NR_PACKETS	(3 * PACKET_INDEX_CHUNK_LEN + 17)
+#define PACKET_SIZE	(4096 * 8)
+
+static
+void make_packet(unsigned int i, struct packet_index *index)
+{
+	memset(index, 0, sizeof(*index));
+	index->offset = (off_t) i * (PACKET_SIZE / 8);
+	index->data_offset = 256;
+	index->packet_size = PACKET_SIZE;
+	index->content_size = PACKET_SIZE - 8 * (i % 100);
+	index->ts_cycles.timestamp_begin = 1000000000ULL + i * 1000;
+	index->ts_cycles.timestamp_end = 1000000000ULL + i * 1000 + 900;
+	index->events_discarded = i / 10;
+	index->events_discarded_len = 32;
+	index->packet_seq_num = i;
+	/* A few packets which do not fit the compact encoding. */
+	if (i % 97 == 5)
+		index->packet_size += 8;
+	if (i == 42)
+		index->data_offset = -1;
+}
+
+static
+int packet_equal(const struct packet_index *a, const struct packet_index *b)
+{
+	return a->offset == b->offset
+		&& a->data_offset == b->data_offset
+		&& a->packet_size == b->packet_size
+		&& a->content_size == b->content_size
+		&& a->events_discarded == b->events_discarded
+		&& a->events_discarded_len == b->events_discarded_len
+		&& a->ts_cycles.timestamp_begin == b->ts_cycles.timestamp_begin
+		&& a->ts_cycles.timestamp_end == b->ts_cycles.timestamp_end
+		&& a->ts_real.timestamp_begin == b->ts_real.timestamp_begin
+		&& a->ts_real.timestamp_end == b->ts_real.timestamp_end
+		&& a->stream_instance_id == b->stream_instance_id
+		&& a->packet_seq_num == b->packet_seq_num;
+}
+
+static
+int check_all(struct packet_index_table *table, uint64_t real_offset)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_PACKETS; i++) {
+		struct packet_index expected, index;
+
+		make_packet(i, &expected);
+		if (real_offset) {
+			expected.ts_real.timestamp_begin = real_offset
+				+ expected.ts_cycles.timestamp_begin;
+			expected.ts_real.timestamp_end = real_offset
+				+ expected.ts_cycles.timestamp_end;
+		}
+		ctf_packet_index_get(table, i, &index);
+		if (!packet_equal(&expected, &index)) {
+			diag("packet %u differs", i);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(void)
+{
+	struct packet_index_table *table;
+	struct packet_index index;
+	uint64_t real_offset = 1400000000000000000ULL;
+	unsigned int i;
+
+	plan_no_plan();
+
+	table = ctf_packet_index_table_new();
+	ok(table && table->len == 0, "new packet index is empty");
+
+	for (i = 0; i < NR_PACKETS; i++) {
+		make_packet(i, &index);
+		ctf_packet_index_append(table, &index);
+	}
+	ok(table->len == NR_PACKETS, "all packets are appended");
+	ok(table->escapes->len < NR_PACKETS / 10,
+		"most packets use the compact encoding");
+	ok(check_all(table, 0), "packets are decoded as appended");
+
+	/* Real timestamps are set once the trace is in a collection. */
+	for (i = 0; i < NR_PACKETS; i++) {
+		ctf_packet_index_get(table, i, &index);
+		index.ts_real.timestamp_begin = real_offset
+			+ index.ts_cycles.timestamp_begin;
+		index.ts_real.timestamp_end = real_offset
+			+ index.ts_cycles.timestamp_end;
+		ctf_packet_index_set(table, i, &index);
+	}
+	ok(table->escapes->len < NR_PACKETS / 10,
+		"real timestamps use the compact encoding");
+	ok(check_all(table, real_offset), "packets are decoded as updated");
+
+	ok(ctf_packet_index_search_real(table, 0) == 0,
+		"search before the first packet finds the first packet");
+	ctf_packet_index_get(table, 300, &index);
+	ok(ctf_packet_index_search_real(table,
+			index.ts_real.timestamp_end) == 300,
+		"search at a packet end finds that packet");
+	ok(ctf_packet_index_search_real(table,
+			index.ts_real.timestamp_end + 1) == 301,
+		"search after a packet end finds the next packet");
+	ok(ctf_packet_index_search_real(table, -1ULL) == NR_PACKETS,
+		"search after the last packet finds nothing");
+
+	ctf_packet_index_table_free(table);
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * test_parallel_open.c
+ *
+ * Babeltrace concurrent trace opening tests
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/context.h>
+#include <babeltrace/trace-handle.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <tap/tap.h>
+
+#define NR_TESTS	11
+
+/* The trace in the middle cannot be opened. */
+static const char *trace_names[] = {
+	"succeed/wk-heartbeat-u",
+	"succeed/lttng-modules-2.0-pre5",
+	"does-not-exist",
+	"succeed/sequence",
+	"succeed/wk-heartbeat-u",
+};
+
+#define NR_TRACES	(sizeof(trace_names) / sizeof(trace_names[0]))
+#define NR_VALID_TRACES	(NR_TRACES - 1)
+
+/* Summary of the events read from one trace. */
+struct trace_digest {
+	uint64_t nr_events;
+	uint64_t timestamp_sum;
+	uint64_t name_hash_sum;
+};
+
+struct open_result {
+	int nr_added;
+	int handle_ids[NR_TRACES];
+	struct trace_digest digests[NR_TRACES];
+	int read_ret;
+};
+
+static
+int read_digests(struct bt_context *ctx, struct trace_digest *digests)
+{
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	int ret = 0;
+
+	memset(digests, 0, NR_TRACES * sizeof(*digests));
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		return -1;
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		int handle_id = bt_ctf_event_get_handle_id(event);
+		const char *name = bt_ctf_event_name(event);
+
+		if (handle_id < 0 || handle_id >= NR_TRACES || !name) {
+			ret = -1;
+			break;
+		}
+		digests[handle_id].nr_events++;
+		digests[handle_id].timestamp_sum += bt_ctf_get_timestamp(event);
+		digests[handle_id].name_hash_sum += g_str_hash(name);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	bt_ctf_iter_destroy(iter);
+	return ret;
+}
+
+/* Whether the handles of the context refer to the paths they were given for. */
+static
+int check_paths(struct bt_context *ctx, const char **paths,
+		const int *handle_ids)
+{
+	int i;
+
+	for (i = 0; i < NR_TRACES; i++) {
+		const char *path;
+
+		if (handle_ids[i] < 0)
+			continue;
+		path = bt_trace_handle_get_path(ctx, handle_ids[i]);
+		if (!path || strcmp(path, paths[i]))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Open the traces with bt_context_add_traces(), using nr_threads
+ * threads, or one bt_context_add_trace() call per path if nr_threads
+ * is NULL.
+ */
+static
+void open_traces(const char **paths, const char *nr_threads,
+		struct open_result *result)
+{
+	struct bt_context *ctx;
+	int i;
+
+	ctx = bt_context_create();
+	if (nr_threads) {
+		setenv("BABELTRACE_OPEN_THREADS", nr_threads, 1);
+		result->nr_added = bt_context_add_traces(ctx, paths,
+				NR_TRACES, "ctf", NULL, result->handle_ids);
+		unsetenv("BABELTRACE_OPEN_THREADS");
+	} else {
+		result->nr_added = 0;
+		for (i = 0; i < NR_TRACES; i++) {
+			result->handle_ids[i] = bt_context_add_trace(ctx,
+					paths[i], "ctf", NULL, NULL, NULL);
+			if (result->handle_ids[i] >= 0)
+				result->nr_added++;
+		}
+	}
+	ok(check_paths(ctx, paths, result->handle_ids),
+		"Trace handles match their path (%s threads)",
+		nr_threads ? nr_threads : "no");
+	result->read_ret = read_digests(ctx, result->digests);
+	bt_context_put(ctx);
+}
+
+static
+void check_same(struct open_result *result, struct open_result *expected,
+		const char *nr_threads)
+{
+	ok(result->nr_added == expected->nr_added,
+		"Same number of traces added with %s threads", nr_threads);
+	ok(!memcmp(result->handle_ids, expected->handle_ids,
+			sizeof(result->handle_ids)),
+		"Same handle ids with %s threads", nr_threads);
+	ok(!result->read_ret && !memcmp(result->digests, expected->digests,
+			sizeof(result->digests)),
+		"Same events read with %s threads", nr_threads);
+}
+
+int main(int argc, char **argv)
+{
+	struct open_result serial, one_thread, parallel;
+	const char *paths[NR_TRACES];
+	int i;
+
+	plan_tests(NR_TESTS);
+
+	if (argc < 2) {
+		diag("Invalid arguments: need the trace directory");
+		skip(NR_TESTS, "Missing trace directory");
+		return 0;
+	}
+	for (i = 0; i < NR_TRACES; i++)
+		paths[i] = g_build_filename(argv[1], trace_names[i], NULL);
+
+	open_traces(paths, NULL, &serial);
+	ok(serial.nr_added == NR_VALID_TRACES && serial.handle_ids[2] < 0,
+		"Open the traces one by one, except the invalid one");
+	ok(!serial.read_ret && serial.digests[0].nr_events > 0,
+		"Read the traces opened one by one");
+
+	open_traces(paths, "1", &one_thread);
+	check_same(&one_thread, &serial, "1");
+	open_traces(paths, "4", &parallel);
+	check_same(&parallel, &serial, "4");
+
+	for (i = 0; i < NR_TRACES; i++)
+		g_free((char *) paths[i]);
+	return 0;
+}
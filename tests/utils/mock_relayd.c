@@ -0,0 +1,611 @@
+/*
+ * mock_relayd.c
+ *
+ * Minimal lttng-relayd serving a CTF trace over the live viewer protocol
+ *
+ * Copyright (c) 2016 EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * usage: mock_relayd [-l LATENCY_MS] [-r RETRIES] [-s] TRACE
+ *
+ * Listens on an ephemeral port of the loopback interface, prints it on
+ * the standard output, and serves a single viewer connection: session
+ * "mock" of host "mock" holds the streams of TRACE, whose packets are
+ * each sent once, after which the streams hang up. The viewer URL is
+ * net://127.0.0.1:PORT/host/mock/mock.
+ *
+ * Each response is sent LATENCY_MS after its request was received,
+ * without delaying the following requests, which emulates a relay
+ * daemon one round trip of LATENCY_MS away. With RETRIES, each index
+ * is only served after answering LTTNG_VIEWER_INDEX_RETRY that many
+ * times, as for a stream without new data yet. With -s, only the first
+ * data stream is announced when attaching, the others being announced
+ * along with its first index, as for streams created during the
+ * session. When the viewer
+ * disconnects, a line with the number of requests, packets and packet
+ * bytes served is printed on the standard output.
+ */
+
+#include <babeltrace/babeltrace.h>
+#include <babeltrace/context.h>
+#include <babeltrace/context-internal.h>
+#include <babeltrace/trace-handle-internal.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/endian.h>
+#include <formats/lttng-live/lttng-viewer-abi.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <glib.h>
+
+#define MOCK_NAME		"mock"
+
+struct mock_stream {
+	uint64_t id;			/* viewer stream id */
+	uint64_t ctf_stream_id;		/* stream class id */
+	int fd;
+	char path[PATH_MAX];
+	struct packet_index_table *packet_index;
+	unsigned int next_packet;
+	long retries_left;
+	int hung_up;
+};
+
+struct response {
+	struct response *next;
+	struct timespec due;
+	size_t len;
+	char data[];
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct response *head, *tail;
+	int done;
+} queue = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static GPtrArray *streams;	/* struct mock_stream, metadata first */
+static char *metadata;
+static size_t metadata_len;
+static int metadata_sent;
+static long latency_ms;
+static long retries;
+static int late_streams;
+static unsigned int announced;	/* Streams sent to the viewer */
+static int client_sock = -1;
+static uint64_t nr_requests, nr_packets, packet_bytes;
+
+static
+int recv_all(int fd, void *buf, size_t len)
+{
+	size_t copied = 0;
+	ssize_t ret;
+
+	while (copied < len) {
+		ret = recv(fd, (char *) buf + copied, len - copied, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		copied += ret;
+	}
+	return 0;
+}
+
+static
+int send_all(int fd, const void *buf, size_t len)
+{
+	size_t copied = 0;
+	ssize_t ret;
+
+	while (copied < len) {
+		ret = send(fd, (const char *) buf + copied, len - copied,
+				MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		copied += ret;
+	}
+	return 0;
+}
+
+/* Queue a response, to be sent latency_ms from now. */
+static
+void respond(const void *header, size_t header_len,
+		const void *payload, size_t payload_len)
+{
+	struct response *response;
+
+	response = malloc(sizeof(*response) + header_len + payload_len);
+	if (!response)
+		abort();
+	response->next = NULL;
+	response->len = header_len + payload_len;
+	memcpy(response->data, header, header_len);
+	if (payload_len)
+		memcpy(response->data + header_len, payload, payload_len);
+	clock_gettime(CLOCK_MONOTONIC, &response->due);
+	response->due.tv_sec += latency_ms / 1000;
+	response->due.tv_nsec += (latency_ms % 1000) * 1000000;
+	if (response->due.tv_nsec >= 1000000000) {
+		response->due.tv_sec++;
+		response->due.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&queue.lock);
+	if (queue.tail)
+		queue.tail->next = response;
+	else
+		queue.head = response;
+	queue.tail = response;
+	pthread_cond_signal(&queue.cond);
+	pthread_mutex_unlock(&queue.lock);
+}
+
+static
+void *sender_thread(void *arg)
+{
+	struct response *response;
+
+	for (;;) {
+		pthread_mutex_lock(&queue.lock);
+		while (!queue.head && !queue.done)
+			pthread_cond_wait(&queue.cond, &queue.lock);
+		response = queue.head;
+		if (response) {
+			queue.head = response->next;
+			if (!queue.head)
+				queue.tail = NULL;
+		}
+		pthread_mutex_unlock(&queue.lock);
+		if (!response)
+			break;
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				&response->due, NULL) == EINTR)
+			;
+		if (send_all(client_sock, response->data, response->len))
+			fprintf(stderr, "[mock_relayd] send failed\n");
+		free(response);
+	}
+	return NULL;
+}
+
+static
+struct mock_stream *lookup_stream(uint64_t id)
+{
+	if (id >= streams->len)
+		return NULL;
+	return g_ptr_array_index(streams, id);
+}
+
+static
+int all_streams_hung_up(void)
+{
+	int i;
+
+	if (announced < streams->len)
+		return 0;
+	for (i = 1; i < streams->len; i++) {
+		struct mock_stream *stream = g_ptr_array_index(streams, i);
+
+		if (!stream->hung_up)
+			return 0;
+	}
+	return 1;
+}
+
+static
+void cmd_connect(void)
+{
+	struct lttng_viewer_connect connect;
+
+	if (recv_all(client_sock, &connect, sizeof(connect)))
+		return;
+	connect.viewer_session_id = htobe64(1);
+	connect.major = htobe32(2);
+	connect.minor = htobe32(4);
+	respond(&connect, sizeof(connect), NULL, 0);
+}
+
+static
+void cmd_list_sessions(void)
+{
+	struct {
+		struct lttng_viewer_list_sessions list;
+		struct lttng_viewer_session session;
+	} __attribute__((__packed__)) rp;
+
+	memset(&rp, 0, sizeof(rp));
+	rp.list.sessions_count = htobe32(1);
+	rp.session.id = htobe64(1);
+	rp.session.live_timer = htobe32(1000);
+	rp.session.clients = htobe32(1);
+	rp.session.streams = htobe32(streams->len);
+	strcpy(rp.session.hostname, MOCK_NAME);
+	strcpy(rp.session.session_name, MOCK_NAME);
+	respond(&rp, sizeof(rp), NULL, 0);
+}
+
+static
+void cmd_create_session(void)
+{
+	struct lttng_viewer_create_session_response rp;
+
+	rp.status = htobe32(LTTNG_VIEWER_CREATE_SESSION_OK);
+	respond(&rp, sizeof(rp), NULL, 0);
+}
+
+/* Send the streams [first, last) after a response header. */
+static
+void respond_streams(const void *header, size_t header_len,
+		unsigned int first, unsigned int last)
+{
+	struct lttng_viewer_stream *list;
+	unsigned int i;
+
+	list = calloc(last - first, sizeof(*list));
+	if (!list)
+		abort();
+	for (i = first; i < last; i++) {
+		struct mock_stream *stream = g_ptr_array_index(streams, i);
+		struct lttng_viewer_stream *entry = &list[i - first];
+
+		entry->id = htobe64(stream->id);
+		entry->ctf_trace_id = htobe64(1);
+		entry->metadata_flag = htobe32(i == 0);
+		snprintf(entry->path_name, sizeof(entry->path_name),
+			"%s", MOCK_NAME);
+		snprintf(entry->channel_name, sizeof(entry->channel_name),
+			"%s", stream->path);
+	}
+	respond(header, header_len, list, (last - first) * sizeof(*list));
+	free(list);
+}
+
+static
+void cmd_attach_session(void)
+{
+	struct lttng_viewer_attach_session_request rq;
+	struct lttng_viewer_attach_session_response rp;
+
+	if (recv_all(client_sock, &rq, sizeof(rq)))
+		return;
+	/* The metadata and the first data stream. */
+	if (late_streams && streams->len > 2)
+		announced = 2;
+	else
+		announced = streams->len;
+	rp.status = htobe32(LTTNG_VIEWER_ATTACH_OK);
+	rp.streams_count = htobe32(announced);
+	respond_streams(&rp, sizeof(rp), 0, announced);
+}
+
+static
+void cmd_get_metadata(void)
+{
+	struct lttng_viewer_get_metadata rq;
+	struct lttng_viewer_metadata_packet rp;
+
+	if (recv_all(client_sock, &rq, sizeof(rq)))
+		return;
+	memset(&rp, 0, sizeof(rp));
+	if (metadata_sent) {
+		rp.status = htobe32(LTTNG_VIEWER_NO_NEW_METADATA);
+		respond(&rp, sizeof(rp), NULL, 0);
+		return;
+	}
+	metadata_sent = 1;
+	rp.status = htobe32(LTTNG_VIEWER_METADATA_OK);
+	rp.len = htobe64(metadata_len);
+	respond(&rp, sizeof(rp), metadata, metadata_len);
+}
+
+static
+void cmd_get_next_index(void)
+{
+	struct lttng_viewer_get_next_index rq;
+	struct lttng_viewer_index rp;
+	struct mock_stream *stream;
+	struct packet_index index;
+
+	if (recv_all(client_sock, &rq, sizeof(rq)))
+		return;
+	memset(&rp, 0, sizeof(rp));
+	stream = lookup_stream(be64toh(rq.stream_id));
+	if (!stream || !stream->packet_index) {
+		rp.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
+	} else if (stream->retries_left) {
+		stream->retries_left--;
+		rp.status = htobe32(LTTNG_VIEWER_INDEX_RETRY);
+	} else if (stream->next_packet >= stream->packet_index->len) {
+		stream->hung_up = 1;
+		rp.status = htobe32(LTTNG_VIEWER_INDEX_HUP);
+	} else {
+		stream->retries_left = retries;
+		ctf_packet_index_get(stream->packet_index,
+				stream->next_packet++, &index);
+		rp.offset = htobe64(index.offset);
+		rp.packet_size = htobe64(index.packet_size);
+		rp.content_size = htobe64(index.content_size);
+		rp.timestamp_begin = htobe64(index.ts_cycles.timestamp_begin);
+		rp.timestamp_end = htobe64(index.ts_cycles.timestamp_end);
+		rp.events_discarded = htobe64(index.events_discarded);
+		rp.stream_id = htobe64(stream->ctf_stream_id);
+		rp.status = htobe32(LTTNG_VIEWER_INDEX_OK);
+		if (announced < streams->len)
+			rp.flags = htobe32(LTTNG_VIEWER_FLAG_NEW_STREAM);
+	}
+	respond(&rp, sizeof(rp), NULL, 0);
+}
+
+static
+void cmd_get_packet(void)
+{
+	struct lttng_viewer_get_packet rq;
+	struct lttng_viewer_trace_packet rp;
+	struct mock_stream *stream;
+	uint32_t len;
+	char *data;
+
+	if (recv_all(client_sock, &rq, sizeof(rq)))
+		return;
+	memset(&rp, 0, sizeof(rp));
+	stream = lookup_stream(be64toh(rq.stream_id));
+	len = be32toh(rq.len);
+	data = malloc(len);
+	if (!data)
+		abort();
+	if (!stream || pread(stream->fd, data, len,
+			be64toh(rq.offset)) != len) {
+		rp.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+		respond(&rp, sizeof(rp), NULL, 0);
+	} else {
+		rp.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
+		rp.len = htobe32(len);
+		respond(&rp, sizeof(rp), data, len);
+		nr_packets++;
+		packet_bytes += len;
+	}
+	free(data);
+}
+
+static
+void cmd_get_new_streams(void)
+{
+	struct lttng_viewer_new_streams_request rq;
+	struct lttng_viewer_new_streams_response rp;
+
+	if (recv_all(client_sock, &rq, sizeof(rq)))
+		return;
+	memset(&rp, 0, sizeof(rp));
+	if (announced < streams->len) {
+		rp.status = htobe32(LTTNG_VIEWER_NEW_STREAMS_OK);
+		rp.streams_count = htobe32(streams->len - announced);
+		respond_streams(&rp, sizeof(rp), announced, streams->len);
+		announced = streams->len;
+		return;
+	}
+	if (all_streams_hung_up())
+		rp.status = htobe32(LTTNG_VIEWER_NEW_STREAMS_HUP);
+	else
+		rp.status = htobe32(LTTNG_VIEWER_NEW_STREAMS_NO_NEW);
+	respond(&rp, sizeof(rp), NULL, 0);
+}
+
+static
+int serve(void)
+{
+	struct lttng_viewer_cmd cmd;
+
+	while (!recv_all(client_sock, &cmd, sizeof(cmd))) {
+		nr_requests++;
+		switch (be32toh(cmd.cmd)) {
+		case LTTNG_VIEWER_CONNECT:
+			cmd_connect();
+			break;
+		case LTTNG_VIEWER_LIST_SESSIONS:
+			cmd_list_sessions();
+			break;
+		case LTTNG_VIEWER_CREATE_SESSION:
+			cmd_create_session();
+			break;
+		case LTTNG_VIEWER_ATTACH_SESSION:
+			cmd_attach_session();
+			break;
+		case LTTNG_VIEWER_GET_METADATA:
+			cmd_get_metadata();
+			break;
+		case LTTNG_VIEWER_GET_NEXT_INDEX:
+			cmd_get_next_index();
+			break;
+		case LTTNG_VIEWER_GET_PACKET:
+			cmd_get_packet();
+			break;
+		case LTTNG_VIEWER_GET_NEW_STREAMS:
+			cmd_get_new_streams();
+			break;
+		default:
+			fprintf(stderr, "[mock_relayd] unknown command %u\n",
+				be32toh(cmd.cmd));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static
+int load_trace(struct bt_context *ctx, const char *path)
+{
+	struct bt_trace_handle *handle;
+	struct ctf_trace *td;
+	struct mock_stream *stream;
+	char metadata_path[PATH_MAX];
+	int i, j, id;
+
+	id = bt_context_add_trace(ctx, path, "ctf", NULL, NULL, NULL);
+	if (id < 0) {
+		fprintf(stderr, "[mock_relayd] cannot open trace %s\n", path);
+		return -1;
+	}
+	handle = g_hash_table_lookup(ctx->trace_handles,
+			(gpointer) (unsigned long) id);
+	td = container_of(handle->td, struct ctf_trace, parent);
+
+	snprintf(metadata_path, sizeof(metadata_path), "%s/metadata", path);
+	if (!g_file_get_contents(metadata_path, &metadata, &metadata_len,
+			NULL)) {
+		fprintf(stderr, "[mock_relayd] cannot read %s\n",
+			metadata_path);
+		return -1;
+	}
+
+	streams = g_ptr_array_new();
+	stream = g_new0(struct mock_stream, 1);
+	stream->fd = -1;
+	strcpy(stream->path, "metadata");
+	g_ptr_array_add(streams, stream);
+
+	for (i = 0; i < td->streams->len; i++) {
+		struct ctf_stream_declaration *stream_class;
+
+		stream_class = g_ptr_array_index(td->streams, i);
+		if (!stream_class)
+			continue;
+		for (j = 0; j < stream_class->streams->len; j++) {
+			struct ctf_stream_definition *ctf_stream;
+			struct ctf_file_stream *cfs;
+			char stream_path[PATH_MAX];
+
+			ctf_stream = g_ptr_array_index(stream_class->streams, j);
+			if (!ctf_stream)
+				continue;
+			cfs = container_of(ctf_stream, struct ctf_file_stream,
+					parent);
+			stream = g_new0(struct mock_stream, 1);
+			stream->id = streams->len;
+			stream->ctf_stream_id = cfs->parent.stream_id;
+			stream->packet_index = cfs->pos.packet_index;
+			stream->retries_left = retries;
+			snprintf(stream->path, sizeof(stream->path), "%s",
+				cfs->parent.path);
+			snprintf(stream_path, sizeof(stream_path), "%s/%s",
+				path, cfs->parent.path);
+			stream->fd = open(stream_path, O_RDONLY);
+			if (stream->fd < 0) {
+				perror(stream_path);
+				return -1;
+			}
+			g_ptr_array_add(streams, stream);
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	struct bt_context *ctx;
+	pthread_t sender;
+	int opt, listen_sock, one = 1;
+
+	while ((opt = getopt(argc, argv, "l:r:s")) != -1) {
+		switch (opt) {
+		case 'l':
+			latency_ms = strtol(optarg, NULL, 10);
+			break;
+		case 'r':
+			retries = strtol(optarg, NULL, 10);
+			break;
+		case 's':
+			late_streams = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1)
+		goto usage;
+
+	ctx = bt_context_create();
+	if (!ctx || load_trace(ctx, argv[optind]))
+		return EXIT_FAILURE;
+
+	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_sock < 0) {
+		perror("socket");
+		return EXIT_FAILURE;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(listen_sock, (struct sockaddr *) &addr, sizeof(addr))
+			|| listen(listen_sock, 1)
+			|| getsockname(listen_sock, (struct sockaddr *) &addr,
+				&addr_len)) {
+		perror("bind");
+		return EXIT_FAILURE;
+	}
+	printf("%d\n", ntohs(addr.sin_port));
+	fflush(stdout);
+
+	client_sock = accept(listen_sock, NULL, NULL);
+	if (client_sock < 0) {
+		perror("accept");
+		return EXIT_FAILURE;
+	}
+	(void) setsockopt(client_sock, IPPROTO_TCP, TCP_NODELAY, &one,
+			sizeof(one));
+	if (pthread_create(&sender, NULL, sender_thread, NULL))
+		return EXIT_FAILURE;
+
+	(void) serve();
+
+	pthread_mutex_lock(&queue.lock);
+	queue.done = 1;
+	pthread_cond_signal(&queue.cond);
+	pthread_mutex_unlock(&queue.lock);
+	pthread_join(sender, NULL);
+	close(client_sock);
+	close(listen_sock);
+
+	printf("requests %" PRIu64 " packets %" PRIu64 " bytes %" PRIu64 "\n",
+		nr_requests, nr_packets, packet_bytes);
+	bt_context_put(ctx);
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "usage: mock_relayd [-l LATENCY_MS] [-r RETRIES] [-s] TRACE\n");
+	return EXIT_FAILURE;
+}
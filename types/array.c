@@ -66,7 +66,6 @@ void _array_declaration_free(struct bt_declaration *declaration)
 
 	bt_free_declaration_scope(array_declaration->scope);
 	bt_declaration_unref(array_declaration->elem);
-	g_free(array_declaration);
 }
 
 struct declaration_array *
@@ -77,7 +76,7 @@ struct declaration_array *
 	struct declaration_array *array_declaration;
 	struct bt_declaration *declaration;
 
-	array_declaration = g_new(struct declaration_array, 1);
+	array_declaration = bt_declaration_alloc(sizeof(struct declaration_array));
 	declaration = &array_declaration->p;
 	array_declaration->len = len;
 	bt_declaration_ref(elem_declaration);
@@ -104,7 +103,7 @@ struct bt_definition *
 	int ret;
 	int i;
 
-	array = g_new(struct definition_array, 1);
+	array = bt_definition_alloc(sizeof(struct definition_array));
 	bt_declaration_ref(&array_declaration->p);
 	array->p.declaration = declaration;
 	array->declaration = array_declaration;
@@ -161,12 +160,12 @@ error:
 		struct bt_definition *field;
 
 		field = g_ptr_array_index(array->elems, i);
-		field->declaration->definition_free(field);
+		bt_definition_unref(field);
 	}
 	(void) g_ptr_array_free(array->elems, TRUE);
 	bt_free_definition_scope(array->p.scope);
 	bt_declaration_unref(array->p.declaration);
-	g_free(array);
+	bt_definition_dealloc(&array->p);
 	return NULL;
 }
 
@@ -184,13 +183,12 @@ void _array_definition_free(struct bt_definition *definition)
 			struct bt_definition *field;
 
 			field = g_ptr_array_index(array->elems, i);
-			field->declaration->definition_free(field);
+			bt_definition_unref(field);
 		}
 		(void) g_ptr_array_free(array->elems, TRUE);
 	}
 	bt_free_definition_scope(array->p.scope);
 	bt_declaration_unref(array->p.declaration);
-	g_free(array);
 }
 
 uint64_t bt_array_len(struct definition_array *array)
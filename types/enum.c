@@ -299,6 +299,21 @@ void bt_enum_unsigned_insert_range_to_quark(struct declaration_enum *enum_declar
 	rtoq->quark = q;
 }
 
+/*
+ * Lookups depend on the order in which the ranges are inserted, so keep
+ * it to allow rebuilding an identical table.
+ */
+static
+void bt_enum_append_entry(struct declaration_enum *enum_declaration,
+			const struct enum_range *range, GQuark q)
+{
+	struct enum_entry entry;
+
+	entry.range = *range;
+	entry.quark = q;
+	g_array_append_val(enum_declaration->table.entries, entry);
+}
+
 void bt_enum_signed_insert(struct declaration_enum *enum_declaration,
                         int64_t start, int64_t end, GQuark q)
 {
@@ -331,6 +346,7 @@ void bt_enum_signed_insert(struct declaration_enum *enum_declaration,
 	range = &g_array_index(array, struct enum_range, array->len - 1);
 	range->start._signed = start;
 	range->end._signed = end;
+	bt_enum_append_entry(enum_declaration, range, q);
 }
 
 void bt_enum_unsigned_insert(struct declaration_enum *enum_declaration,
@@ -366,6 +382,7 @@ void bt_enum_unsigned_insert(struct declaration_enum *enum_declaration,
 	range = &g_array_index(array, struct enum_range, array->len - 1);
 	range->start._unsigned = start;
 	range->end._unsigned = end;
+	bt_enum_append_entry(enum_declaration, range, q);
 }
 
 size_t bt_enum_get_nr_enumerators(struct declaration_enum *enum_declaration)
@@ -386,8 +403,8 @@ void _enum_declaration_free(struct bt_declaration *declaration)
 		g_free(iter);
 	}
 	g_hash_table_destroy(enum_declaration->table.quark_to_range_set);
+	g_array_free(enum_declaration->table.entries, TRUE);
 	bt_declaration_unref(&enum_declaration->integer_declaration->p);
-	g_free(enum_declaration);
 }
 
 struct declaration_enum *
@@ -395,7 +412,7 @@ struct declaration_enum *
 {
 	struct declaration_enum *enum_declaration;
 
-	enum_declaration = g_new(struct declaration_enum, 1);
+	enum_declaration = bt_declaration_alloc(sizeof(struct declaration_enum));
 
 	enum_declaration->table.value_to_quark_set = g_hash_table_new_full(enum_val_hash,
 							    enum_val_equal,
@@ -405,6 +422,8 @@ struct declaration_enum *
 	enum_declaration->table.quark_to_range_set = g_hash_table_new_full(g_direct_hash,
 							g_direct_equal,
 							NULL, enum_range_set_free);
+	enum_declaration->table.entries = g_array_new(FALSE, FALSE,
+							sizeof(struct enum_entry));
 	bt_declaration_ref(&integer_declaration->p);
 	enum_declaration->integer_declaration = integer_declaration;
 	enum_declaration->p.id = CTF_TYPE_ENUM;
@@ -429,7 +448,7 @@ struct bt_definition *
 	struct bt_definition *definition_integer_parent;
 	int ret;
 
-	_enum = g_new(struct definition_enum, 1);
+	_enum = bt_definition_alloc(sizeof(struct definition_enum));
 	bt_declaration_ref(&enum_declaration->p);
 	_enum->p.declaration = declaration;
 	_enum->declaration = enum_declaration;
@@ -466,5 +485,4 @@ void _enum_definition_free(struct bt_definition *definition)
 	bt_declaration_unref(_enum->p.declaration);
 	if (_enum->value)
 		g_array_unref(_enum->value);
-	g_free(_enum);
 }
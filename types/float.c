@@ -48,7 +48,6 @@ void _float_declaration_free(struct bt_declaration *declaration)
 	bt_declaration_unref(&float_declaration->exp->p);
 	bt_declaration_unref(&float_declaration->mantissa->p);
 	bt_declaration_unref(&float_declaration->sign->p);
-	g_free(float_declaration);
 }
 
 struct declaration_float *
@@ -58,7 +57,7 @@ struct declaration_float *
 	struct declaration_float *float_declaration;
 	struct bt_declaration *declaration;
 
-	float_declaration = g_new(struct declaration_float, 1);
+	float_declaration = bt_declaration_alloc(sizeof(struct declaration_float));
 	declaration = &float_declaration->p;
 	declaration->id = CTF_TYPE_FLOAT;
 	declaration->alignment = alignment;
@@ -92,7 +91,7 @@ struct bt_definition *
 	struct definition_float *_float;
 	struct bt_definition *tmp;
 
-	_float = g_new(struct definition_float, 1);
+	_float = bt_definition_alloc(sizeof(struct definition_float));
 	bt_declaration_ref(&float_declaration->p);
 	_float->p.declaration = declaration;
 	_float->declaration = float_declaration;
@@ -148,5 +147,4 @@ void _float_definition_free(struct bt_definition *definition)
 	bt_definition_unref(&_float->mantissa->p);
 	bt_free_definition_scope(_float->p.scope);
 	bt_declaration_unref(_float->p.declaration);
-	g_free(_float);
 }
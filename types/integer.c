@@ -43,9 +43,7 @@ void _integer_definition_free(struct bt_definition *definition);
 static
 void _integer_declaration_free(struct bt_declaration *declaration)
 {
-	struct declaration_integer *integer_declaration =
-		container_of(declaration, struct declaration_integer, p);
-	g_free(integer_declaration);
+	/* Nothing owned besides the declaration itself. */
 }
 
 struct declaration_integer *
@@ -56,7 +54,7 @@ struct declaration_integer *
 {
 	struct declaration_integer *integer_declaration;
 
-	integer_declaration = g_new(struct declaration_integer, 1);
+	integer_declaration = bt_declaration_alloc(sizeof(struct declaration_integer));
 	integer_declaration->p.id = CTF_TYPE_INTEGER;
 	integer_declaration->p.alignment = alignment;
 	integer_declaration->p.declaration_free = _integer_declaration_free;
@@ -84,7 +82,7 @@ struct bt_definition *
 	struct definition_integer *integer;
 	int ret;
 
-	integer = g_new(struct definition_integer, 1);
+	integer = bt_definition_alloc(sizeof(struct definition_integer));
 	bt_declaration_ref(&integer_declaration->p);
 	integer->p.declaration = declaration;
 	integer->declaration = integer_declaration;
@@ -112,7 +110,6 @@ void _integer_definition_free(struct bt_definition *definition)
 		container_of(definition, struct definition_integer, p);
 
 	bt_declaration_unref(integer->p.declaration);
-	g_free(integer);
 }
 
 enum ctf_string_encoding bt_get_int_encoding(const struct bt_definition *field)
@@ -96,7 +96,6 @@ void _sequence_declaration_free(struct bt_declaration *declaration)
 	bt_free_declaration_scope(sequence_declaration->scope);
 	g_array_free(sequence_declaration->length_name, TRUE);
 	bt_declaration_unref(sequence_declaration->elem);
-	g_free(sequence_declaration);
 }
 
 struct declaration_sequence *
@@ -107,7 +106,7 @@ struct declaration_sequence *
 	struct declaration_sequence *sequence_declaration;
 	struct bt_declaration *declaration;
 
-	sequence_declaration = g_new(struct declaration_sequence, 1);
+	sequence_declaration = bt_declaration_alloc(sizeof(struct declaration_sequence));
 	declaration = &sequence_declaration->p;
 
 	sequence_declaration->length_name = g_array_new(FALSE, TRUE, sizeof(GQuark));
@@ -137,7 +136,7 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 	struct bt_definition *len_parent;
 	int ret;
 
-	sequence = g_new(struct definition_sequence, 1);
+	sequence = bt_definition_alloc(sizeof(struct definition_sequence));
 	bt_declaration_ref(&sequence_declaration->p);
 	sequence->p.declaration = declaration;
 	sequence->declaration = sequence_declaration;
@@ -193,7 +192,7 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 error:
 	bt_free_definition_scope(sequence->p.scope);
 	bt_declaration_unref(&sequence_declaration->p);
-	g_free(sequence);
+	bt_definition_dealloc(&sequence->p);
 	return NULL;
 }
 
@@ -212,14 +211,13 @@ void _sequence_definition_free(struct bt_definition *definition)
 			struct bt_definition *field;
 
 			field = g_ptr_array_index(sequence->elems, i);
-			field->declaration->definition_free(field);
+			bt_definition_unref(field);
 		}
 		(void) g_ptr_array_free(sequence->elems, TRUE);
 	}
 	bt_definition_unref(len_definition);
 	bt_free_definition_scope(sequence->p.scope);
 	bt_declaration_unref(sequence->p.declaration);
-	g_free(sequence);
 }
 
 uint64_t bt_sequence_len(struct definition_sequence *sequence)
@@ -42,9 +42,7 @@ void _string_definition_free(struct bt_definition *definition);
 static
 void _string_declaration_free(struct bt_declaration *declaration)
 {
-	struct declaration_string *string_declaration =
-		container_of(declaration, struct declaration_string, p);
-	g_free(string_declaration);
+	/* Nothing owned besides the declaration itself. */
 }
 
 struct declaration_string *
@@ -52,7 +50,7 @@ struct declaration_string *
 {
 	struct declaration_string *string_declaration;
 
-	string_declaration = g_new(struct declaration_string, 1);
+	string_declaration = bt_declaration_alloc(sizeof(struct declaration_string));
 	string_declaration->p.id = CTF_TYPE_STRING;
 	string_declaration->p.alignment = CHAR_BIT;
 	string_declaration->p.declaration_free = _string_declaration_free;
@@ -75,7 +73,7 @@ struct bt_definition *
 	struct definition_string *string;
 	int ret;
 
-	string = g_new(struct definition_string, 1);
+	string = bt_definition_alloc(sizeof(struct definition_string));
 	bt_declaration_ref(&string_declaration->p);
 	string->p.declaration = declaration;
 	string->declaration = string_declaration;
@@ -106,7 +104,6 @@ void _string_definition_free(struct bt_definition *definition)
 
 	bt_declaration_unref(string->p.declaration);
 	g_free(string->value);
-	g_free(string);
 }
 
 enum ctf_string_encoding bt_get_string_encoding(const struct bt_definition *field)
@@ -69,6 +69,8 @@ void _struct_declaration_free(struct bt_declaration *declaration)
 
 	bt_free_declaration_scope(struct_declaration->scope);
 	g_hash_table_destroy(struct_declaration->fields_by_name);
+	if (struct_declaration->aliases)
+		g_hash_table_destroy(struct_declaration->aliases);
 
 	for (i = 0; i < struct_declaration->fields->len; i++) {
 		struct declaration_field *declaration_field =
@@ -77,7 +79,6 @@ void _struct_declaration_free(struct bt_declaration *declaration)
 		bt_declaration_unref(declaration_field->declaration);
 	}
 	g_array_free(struct_declaration->fields, true);
-	g_free(struct_declaration);
 }
 
 struct declaration_struct *
@@ -87,7 +88,7 @@ struct declaration_struct *
 	struct declaration_struct *struct_declaration;
 	struct bt_declaration *declaration;
 
-	struct_declaration = g_new(struct declaration_struct, 1);
+	struct_declaration = bt_declaration_alloc(sizeof(struct declaration_struct));
 	declaration = &struct_declaration->p;
 	struct_declaration->fields_by_name = g_hash_table_new(g_direct_hash,
 						       g_direct_equal);
@@ -95,6 +96,7 @@ struct declaration_struct *
 						sizeof(struct declaration_field),
 						DEFAULT_NR_STRUCT_FIELDS);
 	struct_declaration->scope = bt_new_declaration_scope(parent_scope);
+	struct_declaration->aliases = NULL;
 	declaration->id = CTF_TYPE_STRUCT;
 	declaration->alignment = max(1, min_align);
 	declaration->declaration_free = _struct_declaration_free;
@@ -117,7 +119,7 @@ struct bt_definition *
 	int i;
 	int ret;
 
-	_struct = g_new(struct definition_struct, 1);
+	_struct = bt_definition_alloc(sizeof(struct definition_struct));
 	bt_declaration_ref(&struct_declaration->p);
 	_struct->p.declaration = declaration;
 	_struct->declaration = struct_declaration;
@@ -159,7 +161,7 @@ error:
 	}
 	bt_free_definition_scope(_struct->p.scope);
 	bt_declaration_unref(&struct_declaration->p);
-	g_free(_struct);
+	bt_definition_dealloc(&_struct->p);
 	return NULL;
 }
 
@@ -178,7 +180,6 @@ void _struct_definition_free(struct bt_definition *definition)
 	bt_free_definition_scope(_struct->p.scope);
 	bt_declaration_unref(_struct->p.declaration);
 	g_ptr_array_free(_struct->fields, TRUE);
-	g_free(_struct);
 }
 
 void bt_struct_declaration_add_field(struct declaration_struct *struct_declaration,
@@ -198,6 +199,7 @@ void bt_struct_declaration_add_field(struct declaration_struct *struct_declarati
 	g_hash_table_insert(struct_declaration->fields_by_name,
 			    (gpointer) (unsigned long) field->name,
 			    (gpointer) index);
+	bt_declaration_add_field_alias(&struct_declaration->aliases, field->name);
 	/*
 	 * Alignment of structure is the max alignment of declarations contained
 	 * therein.
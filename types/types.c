@@ -31,10 +31,22 @@
 #include <babeltrace/format.h>
 #include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/types.h>
+#include <babeltrace/arena-internal.h>
 #include <babeltrace/compat/limits.h>
 #include <glib.h>
+#include <pthread.h>
 #include <errno.h>
 
+/*
+ * Per-thread cache of the quarks looked up by name. GLib serializes
+ * quark lookups on a global lock; quarks and their strings are never
+ * freed, so a thread can keep them in its own table keyed by the
+ * interned string and skip that lock on later lookups.
+ */
+static __thread GHashTable *quark_cache;
+static pthread_key_t quark_cache_key;
+static pthread_once_t quark_cache_once = PTHREAD_ONCE_INIT;
+
 static
 GQuark prefix_quark(const char *prefix, GQuark quark)
 {
@@ -279,30 +291,118 @@ int bt_register_field_definition(GQuark field_name, struct bt_definition *defini
 	return 0;
 }
 
+/* Arenas of the current thread, see bt_declaration_set_arena(). */
+static __thread struct bt_arena *declaration_arena, *definition_arena;
+
+/*
+ * Declarations are shared by the streams of a trace, and between traces
+ * with identical metadata, which may be opened concurrently: their
+ * reference count is atomic.
+ */
 void bt_declaration_ref(struct bt_declaration *declaration)
 {
-	declaration->ref++;
+	if (declaration->arena)
+		return;
+	g_atomic_int_inc(&declaration->ref);
 }
 
 void bt_declaration_unref(struct bt_declaration *declaration)
 {
-	if (!declaration)
+	if (!declaration || declaration->arena)
 		return;
-	if (!--declaration->ref)
+	if (g_atomic_int_dec_and_test(&declaration->ref)) {
 		declaration->declaration_free(declaration);
+		bt_declaration_dealloc(declaration);
+	}
 }
 
 void bt_definition_ref(struct bt_definition *definition)
 {
+	if (definition->arena)
+		return;
 	definition->ref++;
 }
 
 void bt_definition_unref(struct bt_definition *definition)
 {
-	if (!definition)
+	if (!definition || definition->arena)
 		return;
-	if (!--definition->ref)
+	if (!--definition->ref) {
 		definition->declaration->definition_free(definition);
+		bt_definition_dealloc(definition);
+	}
+}
+
+struct bt_arena *bt_declaration_set_arena(struct bt_arena *arena)
+{
+	struct bt_arena *prev = declaration_arena;
+
+	declaration_arena = arena;
+	return prev;
+}
+
+struct bt_arena *bt_definition_set_arena(struct bt_arena *arena)
+{
+	struct bt_arena *prev = definition_arena;
+
+	definition_arena = arena;
+	return prev;
+}
+
+static
+void arena_declaration_release(void *object)
+{
+	struct bt_declaration *declaration = object;
+
+	declaration->declaration_free(declaration);
+}
+
+static
+void arena_definition_release(void *object)
+{
+	struct bt_definition *definition = object;
+
+	definition->declaration->definition_free(definition);
+}
+
+void *bt_declaration_alloc(size_t len)
+{
+	struct bt_declaration *declaration;
+
+	if (!declaration_arena)
+		return g_malloc0(len);
+	declaration = bt_arena_alloc_object(declaration_arena, len,
+			arena_declaration_release);
+	declaration->arena = declaration_arena;
+	return declaration;
+}
+
+void bt_declaration_dealloc(struct bt_declaration *declaration)
+{
+	if (declaration->arena)
+		bt_arena_cancel_release(declaration);
+	else
+		g_free(declaration);
+}
+
+void *bt_definition_alloc(size_t len)
+{
+	struct bt_definition *definition;
+
+	if (!definition_arena)
+		return g_malloc0(len);
+	definition = bt_arena_alloc_object(definition_arena, len,
+			arena_definition_release);
+	definition->arena = definition_arena;
+	return definition;
+}
+
+void bt_definition_dealloc(struct bt_definition *definition)
+{
+	if (definition->arena)
+		bt_arena_cancel_release(definition);
+	else
+		g_free(definition);
 }
 
 struct declaration_scope *
@@ -612,16 +712,103 @@ void bt_free_definition_scope(struct definition_scope *scope)
 	g_free(scope);
 }
 
-struct bt_definition *bt_lookup_definition(const struct bt_definition *definition,
-				     const char *field_name)
+static
+void quark_cache_destroy(void *cache)
+{
+	g_hash_table_destroy(cache);
+}
+
+static
+void quark_cache_key_create(void)
+{
+	(void) pthread_key_create(&quark_cache_key, quark_cache_destroy);
+}
+
+GQuark bt_quark_lookup(const char *string)
+{
+	GQuark quark;
+
+	if (!quark_cache) {
+		pthread_once(&quark_cache_once, quark_cache_key_create);
+		quark_cache = g_hash_table_new(g_str_hash, g_str_equal);
+		/* Freed on thread exit. */
+		(void) pthread_setspecific(quark_cache_key, quark_cache);
+	}
+	quark = (GQuark) (unsigned long) g_hash_table_lookup(quark_cache, string);
+	if (quark)
+		return quark;
+	/*
+	 * Misses are not cached: the string may be interned later, by
+	 * metadata parsed after this lookup.
+	 */
+	quark = g_quark_try_string(string);
+	if (quark)
+		g_hash_table_insert(quark_cache,
+				    (gpointer) g_quark_to_string(quark),
+				    (gpointer) (unsigned long) quark);
+	return quark;
+}
+
+void bt_declaration_add_field_alias(GHashTable **aliases, GQuark field_name)
+{
+	const char *name = g_quark_to_string(field_name);
+	GQuark alias;
+
+	if (name[0] != '_' || name[1] == '\0')
+		return;
+	alias = g_quark_from_string(&name[1]);
+	if (!*aliases)
+		*aliases = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_insert(*aliases, (gpointer) (unsigned long) alias,
+			    (gpointer) (unsigned long) field_name);
+}
+
+GQuark bt_lookup_field_alias(const struct bt_definition *definition,
+		GQuark field_name)
+{
+	const struct bt_declaration *declaration = definition->declaration;
+	GHashTable *aliases;
+
+	switch (declaration->id) {
+	case CTF_TYPE_STRUCT:
+		aliases = container_of(declaration,
+				const struct declaration_struct, p)->aliases;
+		break;
+	case CTF_TYPE_VARIANT:
+		aliases = container_of(declaration,
+				const struct declaration_variant,
+				p)->untagged_variant->aliases;
+		break;
+	default:
+		return 0;
+	}
+	if (!aliases)
+		return 0;
+	return (GQuark) (unsigned long) g_hash_table_lookup(aliases,
+			(gconstpointer) (unsigned long) field_name);
+}
+
+struct bt_definition *bt_lookup_definition_quark(const struct bt_definition *definition,
+					   GQuark field_name)
 {
 	struct definition_scope *scope = get_definition_scope(definition);
 
 	if (!scope)
 		return NULL;
 
-	return lookup_field_definition_scope(g_quark_from_string(field_name),
-					     scope);
+	return lookup_field_definition_scope(field_name, scope);
+}
+
+struct bt_definition *bt_lookup_definition(const struct bt_definition *definition,
+				     const char *field_name)
+{
+	GQuark quark;
+
+	/* A name that was never interned cannot be a field name. */
+	quark = bt_quark_lookup(field_name);
+	if (!quark)
+		return NULL;
+	return bt_lookup_definition_quark(definition, quark);
 }
 
 struct definition_integer *bt_lookup_integer(const struct bt_definition *definition,
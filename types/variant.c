@@ -61,6 +61,8 @@ void _untagged_variant_declaration_free(struct bt_declaration *declaration)
 
 	bt_free_declaration_scope(untagged_variant_declaration->scope);
 	g_hash_table_destroy(untagged_variant_declaration->fields_by_tag);
+	if (untagged_variant_declaration->aliases)
+		g_hash_table_destroy(untagged_variant_declaration->aliases);
 
 	for (i = 0; i < untagged_variant_declaration->fields->len; i++) {
 		struct declaration_field *declaration_field =
@@ -69,7 +71,6 @@ void _untagged_variant_declaration_free(struct bt_declaration *declaration)
 		bt_declaration_unref(declaration_field->declaration);
 	}
 	g_array_free(untagged_variant_declaration->fields, true);
-	g_free(untagged_variant_declaration);
 }
 
 struct declaration_untagged_variant *bt_untagged_bt_variant_declaration_new(
@@ -78,7 +79,7 @@ struct declaration_untagged_variant *bt_untagged_bt_variant_declaration_new(
 	struct declaration_untagged_variant *untagged_variant_declaration;
 	struct bt_declaration *declaration;
 
-	untagged_variant_declaration = g_new(struct declaration_untagged_variant, 1);
+	untagged_variant_declaration = bt_declaration_alloc(sizeof(struct declaration_untagged_variant));
 	declaration = &untagged_variant_declaration->p;
 	untagged_variant_declaration->fields_by_tag = g_hash_table_new(g_direct_hash,
 						       g_direct_equal);
@@ -86,6 +87,7 @@ struct declaration_untagged_variant *bt_untagged_bt_variant_declaration_new(
 						 sizeof(struct declaration_field),
 						 DEFAULT_NR_STRUCT_FIELDS);
 	untagged_variant_declaration->scope = bt_new_declaration_scope(parent_scope);
+	untagged_variant_declaration->aliases = NULL;
 	declaration->id = CTF_TYPE_UNTAGGED_VARIANT;
 	declaration->alignment = 1;
 	declaration->declaration_free = _untagged_variant_declaration_free;
@@ -103,7 +105,6 @@ void _variant_declaration_free(struct bt_declaration *declaration)
 
 	bt_declaration_unref(&variant_declaration->untagged_variant->p);
 	g_array_free(variant_declaration->tag_name, TRUE);
-	g_free(variant_declaration);
 }
 
 struct declaration_variant *
@@ -112,7 +113,7 @@ struct declaration_variant *
 	struct declaration_variant *variant_declaration;
 	struct bt_declaration *declaration;
 
-	variant_declaration = g_new(struct declaration_variant, 1);
+	variant_declaration = bt_declaration_alloc(sizeof(struct declaration_variant));
 	declaration = &variant_declaration->p;
 	variant_declaration->untagged_variant = untagged_variant;
 	bt_declaration_ref(&untagged_variant->p);
@@ -140,7 +141,7 @@ struct bt_definition *
 	unsigned long i;
 	int ret;
 
-	variant = g_new(struct definition_variant, 1);
+	variant = bt_definition_alloc(sizeof(struct definition_variant));
 	bt_declaration_ref(&variant_declaration->p);
 	variant->p.declaration = declaration;
 	variant->declaration = variant_declaration;
@@ -189,7 +190,7 @@ struct bt_definition *
 error:
 	bt_free_definition_scope(variant->p.scope);
 	bt_declaration_unref(&variant_declaration->p);
-	g_free(variant);
+	bt_definition_dealloc(&variant->p);
 	return NULL;
 }
 
@@ -209,7 +210,6 @@ void _variant_definition_free(struct bt_definition *definition)
 	bt_free_definition_scope(variant->p.scope);
 	bt_declaration_unref(variant->p.declaration);
 	g_ptr_array_free(variant->fields, TRUE);
-	g_free(variant);
 }
 
 void bt_untagged_variant_declaration_add_field(struct declaration_untagged_variant *untagged_variant_declaration,
@@ -229,6 +229,8 @@ void bt_untagged_variant_declaration_add_field(struct declaration_untagged_varia
 	g_hash_table_insert(untagged_variant_declaration->fields_by_tag,
 			    (gpointer) (unsigned long) field->name,
 			    (gpointer) index);
+	bt_declaration_add_field_alias(&untagged_variant_declaration->aliases,
+				       field->name);
 	/*
 	 * Alignment of variant is based on the alignment of its currently
 	 * selected choice, so we leave variant alignment as-is (statically